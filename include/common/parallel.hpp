@@ -0,0 +1,24 @@
+#pragma once
+
+#include "common/types.hpp"
+
+typedef void (*ParallelFn)(usize begin, usize end, void *context);
+
+// Number of threads parallel_for spreads work over, including the calling thread
+u32 parallel_worker_count();
+
+// Splits [0, count) into chunks of exactly `batch` items (the last one may be shorter) and runs `fn` on them across
+// the worker pool, returning once every chunk is done. The chunk index of a range is `begin / batch`, which callers
+// can use to index per-chunk partial results. Calls made from inside a job, or while another thread owns the pool,
+// run inline on the calling thread.
+void parallel_for(usize count, usize batch, ParallelFn fn, void *context);
+
+template <typename F> void parallel_for(usize count, usize batch, const F &fn) {
+    parallel_for(
+        count, batch, [](usize begin, usize end, void *context) { (*(const F *)context)(begin, end); },
+        (void *)&fn);
+}
+
+inline usize parallel_chunk_count(usize count, usize batch) {
+    return (count + batch - 1) / batch;
+}
@@ -25,11 +25,36 @@ template <usize N> struct Polygon {
     Vec2 vertices[N];
 };
 
+// Segment along the local y axis, inflated by the radius
 struct Capsule2D {
     f32 radius;
     f32 half_length;
 };
 
+// Non-owning view of a convex polygon's vertices, so any Polygon<N> can be stored in a Shape2
+struct PolygonView {
+    const Vec2 *vertices;
+    usize vertex_count;
+};
+
+template <usize N> inline PolygonView polygon_view(const Polygon<N> &polygon) {
+    return {polygon.vertices, N};
+}
+
+enum class ShapeKind2 { None, Triangle, Rectangle, Circle, Ellipse, Polygon, Capsule };
+
+struct Shape2 {
+    ShapeKind2 kind;
+    union {
+        Triangle triangle;
+        Rectangle rectangle;
+        Circle circle;
+        Ellipse ellipse;
+        PolygonView polygon;
+        Capsule2D capsule;
+    };
+};
+
 // 3D
 struct Cuboid {
     Vec3 half_size;
@@ -39,6 +64,7 @@ struct Sphere {
     f32 radius;
 };
 
+// Cylinder and ConicalFrustum are centered on the origin with their axis along local y
 struct Cylinder {
     f32 radius;
     f32 half_height;
@@ -49,3 +75,15 @@ struct ConicalFrustum {
     f32 radius_bottom;
     f32 height;
 };
+
+enum class ShapeKind3 { None, Cuboid, Sphere, Cylinder, ConicalFrustum };
+
+struct Shape3 {
+    ShapeKind3 kind;
+    union {
+        Cuboid cuboid;
+        Sphere sphere;
+        Cylinder cylinder;
+        ConicalFrustum conical_frustum;
+    };
+};
@@ -35,6 +35,11 @@ struct Rot2 {
             .bivector = scalar * other.bivector + bivector * other.scalar,
         };
     }
+
+    // Get the reverse of this rotor, which undoes its rotation
+    Rot2 reverse() const {
+        return {.scalar = scalar, .bivector = -bivector};
+    }
 };
 
 struct Rot3 {
@@ -96,12 +101,12 @@ struct Rot3 {
         float b23b31 = b23 * b31;
         float b31b12 = b31 * b12;
 
-        // Calculate rotated coordinates
-        float x = xx * (ss + b12_2 - b23_2 - b31_2) + yy * (2.0f * (b31b12 - b23s)) + zz * (2.0f * (b12b23 + b31s));
+        // Calculate rotated coordinates; b23, b31 and b12 rotate about x, y and z respectively
+        float x = xx * (ss + b23_2 - b31_2 - b12_2) + yy * (2.0f * (b23b31 - b12s)) + zz * (2.0f * (b12b23 + b31s));
 
-        float y = xx * (2.0f * (b31b12 + b23s)) + yy * (ss - b12_2 + b23_2 - b31_2) + zz * (2.0f * (b23b31 - b12s));
+        float y = xx * (2.0f * (b23b31 + b12s)) + yy * (ss - b23_2 + b31_2 - b12_2) + zz * (2.0f * (b31b12 - b23s));
 
-        float z = xx * (2.0f * (b12b23 - b31s)) + yy * (2.0f * (b23b31 + b12s)) + zz * (ss - b12_2 - b23_2 + b31_2);
+        float z = xx * (2.0f * (b12b23 - b31s)) + yy * (2.0f * (b31b12 + b23s)) + zz * (ss - b23_2 - b31_2 + b12_2);
 
         return {x, y, z};
     }
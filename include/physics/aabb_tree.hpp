@@ -0,0 +1,115 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/collider.hpp"
+
+struct AabbTreeNode2 {
+    Aabb2 aabb;
+    i32 parent; // next free node while on the free list
+    i32 children[2];
+    i32 height; // 0 for leaves, -1 for free nodes
+    u32 body;
+};
+
+struct AabbTreeNode3 {
+    Aabb3 aabb;
+    i32 parent;
+    i32 children[2];
+    i32 height;
+    u32 body;
+};
+
+// Called for every body whose fat box overlaps the query; returning false ends the query
+typedef bool (*TreeQueryFn)(u32 body, void *context);
+
+// Called for every body whose fat box the ray enters at `distance` (in units of the ray direction) within the current
+// limit; returns the new limit, so returning the hit distance finds the closest hit and returning 0 stops
+typedef float (*TreeRayFn)(u32 body, float distance, void *context);
+
+// Dynamic bounding volume hierarchy over the shaped bodies, suited to widely varying shape sizes. Leaves store fat
+// boxes padded by `margin`; a body is only reinserted once its tight box leaves its fat box. Insertion descends by
+// the surface area heuristic and every ancestor is rebalanced with tree rotations.
+struct AabbTree2 {
+    float margin;
+
+    AabbTreeNode2 *nodes;
+    usize node_capacity;
+    i32 root;
+    i32 free_list;
+
+    usize body_count;
+    usize body_capacity;
+    i32 *leaves; // leaf node of each body, -1 without a shape
+    Aabb2 *bounds;
+    u8 *escaped;
+
+    usize buffer_count;
+    PairBuffer *buffers;
+    PairBuffer pairs;
+};
+
+struct AabbTree3 {
+    float margin;
+
+    AabbTreeNode3 *nodes;
+    usize node_capacity;
+    i32 root;
+    i32 free_list;
+
+    usize body_count;
+    usize body_capacity;
+    i32 *leaves;
+    Aabb3 *bounds;
+    u8 *escaped;
+
+    usize buffer_count;
+    PairBuffer *buffers;
+    PairBuffer pairs;
+};
+
+void init_aabb_tree(AabbTree2 &tree, float margin);
+void init_aabb_tree(AabbTree3 &tree, float margin);
+void deinit_aabb_tree(AabbTree2 &tree);
+void deinit_aabb_tree(AabbTree3 &tree);
+
+// Synchronizes the leaves with the bodies, returning how many leaves were inserted or reinserted
+usize update_aabb_tree(AabbTree2 &tree, const Body2 *bodies, usize body_count);
+usize update_aabb_tree(AabbTree3 &tree, const Body3 *bodies, usize body_count);
+
+// Collects every pair of bodies with overlapping fat boxes into `tree.pairs`, querying the tree in parallel
+usize find_tree_pairs(AabbTree2 &tree);
+usize find_tree_pairs(AabbTree3 &tree);
+
+void query_aabb_tree(const AabbTree2 &tree, const Aabb2 &aabb, TreeQueryFn fn, void *context);
+void query_aabb_tree(const AabbTree3 &tree, const Aabb3 &aabb, TreeQueryFn fn, void *context);
+
+void raycast_aabb_tree(const AabbTree2 &tree, Vec2 origin, Vec2 direction, float max_distance, TreeRayFn fn,
+                       void *context);
+void raycast_aabb_tree(const AabbTree3 &tree, Vec3 origin, Vec3 direction, float max_distance, TreeRayFn fn,
+                       void *context);
+
+template <typename F> void query_aabb_tree(const AabbTree2 &tree, const Aabb2 &aabb, const F &fn) {
+    query_aabb_tree(
+        tree, aabb, [](u32 body, void *context) { return (bool)(*(const F *)context)(body); }, (void *)&fn);
+}
+
+template <typename F> void query_aabb_tree(const AabbTree3 &tree, const Aabb3 &aabb, const F &fn) {
+    query_aabb_tree(
+        tree, aabb, [](u32 body, void *context) { return (bool)(*(const F *)context)(body); }, (void *)&fn);
+}
+
+template <typename F>
+void raycast_aabb_tree(const AabbTree2 &tree, Vec2 origin, Vec2 direction, float max_distance, const F &fn) {
+    raycast_aabb_tree(
+        tree, origin, direction, max_distance,
+        [](u32 body, float distance, void *context) { return (float)(*(const F *)context)(body, distance); },
+        (void *)&fn);
+}
+
+template <typename F>
+void raycast_aabb_tree(const AabbTree3 &tree, Vec3 origin, Vec3 direction, float max_distance, const F &fn) {
+    raycast_aabb_tree(
+        tree, origin, direction, max_distance,
+        [](u32 body, float distance, void *context) { return (float)(*(const F *)context)(body, distance); },
+        (void *)&fn);
+}
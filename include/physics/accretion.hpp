@@ -0,0 +1,51 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+#include "physics/spatial_hash.hpp"
+
+// Collisional merging for planet formation: shaped bodies closer than the sum of their bounding radii become one,
+// keeping their total mass and momentum at their center of mass. Overlaps are found by the spatial hash and
+// grouped with union-find, so a body touching several others absorbs them all in one call.
+//
+// The survivor of each group is its lowest-indexed body, or its kinematic one (which absorbs the others' mass without
+// moving; groups joining two kinematic bodies are not merged). A circle or sphere survivor grows to hold the group's
+// combined area or volume; other shapes keep their size. The body array is then compacted on the worker pool, so
+// body_count shrinks as the system accretes.
+struct Accretion2 {
+    SpatialHash2 hash;
+
+    usize body_capacity;
+    u32 *parents;      // union-find forest, then each survivor's new index
+    u32 *destinations; // where each body went in the compacted array; merged bodies point at their survivor
+    u32 *absorbed;     // bodies merged into another during the last call
+    usize absorbed_count;
+    Body2 *scratch;
+
+    usize chunk_capacity;
+    u32 *chunk_offsets;
+};
+
+struct Accretion3 {
+    SpatialHash3 hash;
+
+    usize body_capacity;
+    u32 *parents;
+    u32 *destinations;
+    u32 *absorbed;
+    usize absorbed_count;
+    Body3 *scratch;
+
+    usize chunk_capacity;
+    u32 *chunk_offsets;
+};
+
+void init_accretion(Accretion2 &accretion);
+void init_accretion(Accretion3 &accretion);
+void deinit_accretion(Accretion2 &accretion);
+void deinit_accretion(Accretion3 &accretion);
+
+// Merges overlapping bodies and compacts the array in place, returning the new body count. Afterwards
+// `destinations[i]` maps every old index to its new one, for remapping anything else indexed by body.
+usize merge_overlapping_bodies(Accretion2 &accretion, Body2 *bodies, usize body_count);
+usize merge_overlapping_bodies(Accretion3 &accretion, Body3 *bodies, usize body_count);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Ahmad-Cohen neighbor scheme: the acceleration of each body is split into an irregular part from the bodies inside
+// `neighbor_radius`, summed every step, and a regular part from everything else, recomputed every `regular_interval`
+// steps and extrapolated linearly in between. Neighbor lists are rebuilt together with the regular part.
+struct NeighborScheme2 {
+    usize body_count;
+    float neighbor_radius;
+    u32 regular_interval;
+    u32 steps_since_regular;
+    bool primed;
+
+    Vec2 *accelerations; // total acceleration at the current time, reused by the next step's opening kick
+    Vec2 *regular;       // far-field acceleration at the last regular step
+    Vec2 *regular_rate;  // its time derivative, used for extrapolation
+
+    u32 *neighbor_offsets; // body_count + 1 offsets into `neighbors`
+    u32 *neighbors;
+    usize neighbor_capacity;
+};
+
+struct NeighborScheme3 {
+    usize body_count;
+    float neighbor_radius;
+    u32 regular_interval;
+    u32 steps_since_regular;
+    bool primed;
+
+    Vec3 *accelerations;
+    Vec3 *regular;
+    Vec3 *regular_rate;
+
+    u32 *neighbor_offsets;
+    u32 *neighbors;
+    usize neighbor_capacity;
+};
+
+void init_neighbor_scheme(NeighborScheme2 &scheme, usize body_count, float neighbor_radius, u32 regular_interval);
+void init_neighbor_scheme(NeighborScheme3 &scheme, usize body_count, float neighbor_radius, u32 regular_interval);
+void deinit_neighbor_scheme(NeighborScheme2 &scheme);
+void deinit_neighbor_scheme(NeighborScheme3 &scheme);
+
+// Kick-drift-kick step using the split acceleration, leaving sleeping bodies in place. The scheme must have been
+// initialized for `body_count` bodies.
+void integrate_ahmad_cohen(NeighborScheme2 &scheme, Body2 *bodies, usize body_count, float dt);
+void integrate_ahmad_cohen(NeighborScheme3 &scheme, Body3 *bodies, usize body_count, float dt);
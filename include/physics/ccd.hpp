@@ -0,0 +1,95 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/collider.hpp"
+#include "physics/gjk.hpp"
+
+// Straight-line motion of a shape over one step, holding its rotation
+struct Sweep2 {
+    Vec2 start, end;
+    Rot2 rotation;
+};
+
+struct Sweep3 {
+    Vec3 start, end;
+    Rot3 rotation;
+};
+
+// First touch of a fast body against another during the step. `time` is the fraction of the step at which they meet,
+// the normal points from body to other, and the point lies on the contact.
+struct Impact2 {
+    u32 body, other;
+    float time;
+    Vec2 normal;
+    Vec2 point;
+};
+
+struct Impact3 {
+    u32 body, other;
+    float time;
+    Vec3 normal;
+    Vec3 point;
+};
+
+// Earliest fraction of the step at which the two sweeps bring the shapes within a small tolerance, found by
+// conservative advancement on GJK distances. A shape of kind None is treated as a point, so rays can be swept
+// against shapes. Returns false if they never touch, or if they already overlap at the start (which the discrete
+// narrowphase handles).
+bool time_of_impact(const Shape2 &a, const Sweep2 &sweep_a, const Shape2 &b, const Sweep2 &sweep_b, float &time,
+                    ConvexQuery2 &contact);
+bool time_of_impact(const Shape3 &a, const Sweep3 &sweep_a, const Shape3 &b, const Sweep3 &sweep_b, float &time,
+                    ConvexQuery3 &contact);
+
+// Continuous collision for bodies that move further than their own size within a step, which discrete checks let
+// tunnel through thin bodies. Bracket the integration step:
+//
+//     begin_continuous_step(ccd, bodies, count);
+//     integrate_physics(bodies, count, dt);
+//     end_continuous_step(ccd, bodies, count);
+//
+// Only dynamic fast movers (point bodies included) are swept, against every shaped body; candidates come from a sort
+// of the swept bounds along x. A mover that hits something is put back where it first touches and loses the velocity
+// carrying it into the surface. Everything else keeps its discrete step.
+struct ContinuousCollision2 {
+    usize body_capacity;
+    Vec2 *start_positions;
+    Aabb2 *swept; // bounds of each body over the whole step
+
+    u32 *order; // shaped bodies by swept.min.x
+    usize order_count;
+
+    u32 *movers;
+    usize mover_count;
+
+    Impact2 *impacts;
+    usize impact_count;
+};
+
+struct ContinuousCollision3 {
+    usize body_capacity;
+    Vec3 *start_positions;
+    Aabb3 *swept;
+
+    u32 *order;
+    usize order_count;
+
+    u32 *movers;
+    usize mover_count;
+
+    Impact3 *impacts;
+    usize impact_count;
+};
+
+void init_continuous_collision(ContinuousCollision2 &ccd);
+void init_continuous_collision(ContinuousCollision3 &ccd);
+void deinit_continuous_collision(ContinuousCollision2 &ccd);
+void deinit_continuous_collision(ContinuousCollision3 &ccd);
+
+// Records where the bodies start the step
+void begin_continuous_step(ContinuousCollision2 &ccd, const Body2 *bodies, usize body_count);
+void begin_continuous_step(ContinuousCollision3 &ccd, const Body3 *bodies, usize body_count);
+
+// Sweeps the fast movers from their recorded start to their current position and pulls back the ones that hit
+// something. Returns the number of impacts, left in `ccd.impacts` ordered by body.
+usize end_continuous_step(ContinuousCollision2 &ccd, Body2 *bodies, usize body_count);
+usize end_continuous_step(ContinuousCollision3 &ccd, Body3 *bodies, usize body_count);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "graphics/shapes.hpp"
+#include "physics/gravity.hpp"
+
+struct Aabb2 {
+    Vec2 min, max;
+};
+
+struct Aabb3 {
+    Vec3 min, max;
+};
+
+// Candidate pair reported by a broadphase, with a < b
+struct BroadphasePair {
+    u32 a, b;
+};
+
+// Growable list of pairs, reused across calls
+struct PairBuffer {
+    BroadphasePair *pairs;
+    usize count;
+    usize capacity;
+};
+
+// Appends the pair ordered so that a < b
+void push_pair(PairBuffer &buffer, u32 a, u32 b);
+
+inline bool aabb_overlap(const Aabb2 &a, const Aabb2 &b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+inline bool aabb_overlap(const Aabb3 &a, const Aabb3 &b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y &&
+           a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+// World-space bounds of a shape placed by the transform; ShapeKind::None yields a point at the position
+Aabb2 compute_aabb(const Shape2 &shape, const Transform2 &transform);
+Aabb3 compute_aabb(const Shape3 &shape, const Transform3 &transform);
+
+// Radius of the smallest origin-centered circle/sphere containing the shape in its local frame
+float bounding_radius(const Shape2 &shape);
+float bounding_radius(const Shape3 &shape);
+
+// Rotational inertia of the shape as a solid of uniform density and the given mass, about the local origin the body
+// rotates around. Every 3D shape is symmetric about its local axes, so its inertia is the diagonal returned as the
+// moments about local x, y and z. ShapeKind::None yields zero, which the contact solver reads as not rotating.
+float moment_of_inertia(const Shape2 &shape, float mass);
+Vec3 moment_of_inertia(const Shape3 &shape, float mass);
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/narrowphase.hpp"
+#include "physics/pair_table.hpp"
+
+// One direction a contact pushes along. The arms are each body's offset to the contact point crossed with the
+// direction, and the angular terms are those arms through the body's world inverse inertia, which is the spin a unit
+// impulse gives it. Tilt rows push nothing and twist about an axis in the contact plane: their direction is zero and
+// both arms are the axis.
+struct ContactRow2 {
+    Vec2 direction;
+    float arm_a, arm_b;
+    float angular_a, angular_b;
+    float mass;    // effective mass along the direction, rotation included
+    float impulse; // accumulated over the step
+};
+
+struct ContactRow3 {
+    Vec3 direction;
+    Vec3 arm_a, arm_b;
+    Vec3 angular_a, angular_b;
+    float mass;
+    float impulse;
+};
+
+// Velocity constraint built from one contact. A body with an inverse mass of zero (kinematic or massless) is never
+// written to.
+struct ContactConstraint2 {
+    u32 a, b;
+    float inverse_mass_a, inverse_mass_b;
+    ContactRow2 normal;
+    ContactRow2 tangent;
+    ContactRow2 tilt; // resists rocking over a flat patch, up to the normal impulse times patch_radius
+    float patch_radius;
+    float bounce_speed;   // separating speed the normal impulse drives towards, from restitution
+    float recovery_speed; // separating speed that pushes out the penetration, applied to positions only
+    float recovery_mass;  // effective mass of the translation-only recovery
+    float recovery_impulse;
+};
+
+struct ContactConstraint3 {
+    u32 a, b;
+    float inverse_mass_a, inverse_mass_b;
+    ContactRow3 normal;
+    ContactRow3 tangents[2];
+    ContactRow3 tilts[2]; // about the two tangents
+    ContactRow3 twist;    // friction against spinning about the normal, which a patch has and a point doesn't
+    float patch_radius;
+    float bounce_speed;
+    float recovery_speed;
+    float recovery_mass;
+    float recovery_impulse;
+};
+
+// Impulse a pair ended the previous step with, used to warm start it
+struct CachedImpulse2 {
+    float normal;
+    Vec2 friction; // world space, so it survives the tangent basis changing
+    float tilt;
+};
+
+struct CachedImpulse3 {
+    float normal;
+    Vec3 friction;
+    Vec3 angular; // tilt and twist together, as a world-space axis scaled by the angular impulse
+};
+
+// Sequential-impulse contact solver with restitution and Coulomb friction. Impulses act at the contact points, so
+// they spin bodies by the inertia of their shapes (see moment_of_inertia), and a contact over a flat patch also
+// resists tilting as far as the patch's edges would, which keeps one contact per pair from rocking boxes over, and
+// (in 3D) twisting as far as friction over the patch would.
+// Dynamic bodies joined by contacts form islands (union-find over the contact graph, kinematic bodies not joining
+// them), and the islands are solved independently on the worker pool, largest first. Each pair's accumulated impulses
+// are kept between steps and applied up front, so resting stacks start from last step's answer and settle in a
+// handful of iterations.
+// Penetration is pushed out by a separate recovery velocity that moves positions without entering the bodies'
+// velocities, so it adds no energy.
+// Islands that have come to rest can be put to sleep with update_sleep, after which the solver skips them until a
+// contact with an awake body wakes the whole island.
+struct ContactSolver2 {
+    float restitution;
+    float friction;
+    u32 iterations;
+
+    usize body_capacity;
+    u32 *parents;           // union-find forest over the bodies
+    u32 *island_of;         // island index of each body's root, or ~0u
+    usize island_count;
+    u32 *island_starts;     // island_count + 1 offsets into constraints
+    u32 *island_order;      // islands by decreasing constraint count
+    f32 *island_rest_times; // scratch for update_sleep: least rest time of each root's island
+    u32 *sleep_islands;     // root of each sleeping body's island when it fell asleep
+    u8 *island_wakes;       // scratch for solve_contacts: sleeping islands to wake, by root
+    Vec2 *recovery_velocities;
+
+    usize constraint_capacity;
+    usize constraint_count;
+    ContactConstraint2 *constraints; // grouped by island, in contact order within each
+    u32 *contact_islands;            // scratch: island of each contact, or ~0u when it moves no body
+
+    PairTable impulse_table; // pair -> index into previous_impulses
+    CachedImpulse2 *impulses; // parallel to constraints
+    CachedImpulse2 *previous_impulses;
+};
+
+struct ContactSolver3 {
+    float restitution;
+    float friction;
+    u32 iterations;
+
+    usize body_capacity;
+    u32 *parents;
+    u32 *island_of;
+    usize island_count;
+    u32 *island_starts;
+    u32 *island_order;
+    f32 *island_rest_times;
+    u32 *sleep_islands;
+    u8 *island_wakes;
+    Vec3 *recovery_velocities;
+
+    usize constraint_capacity;
+    usize constraint_count;
+    ContactConstraint3 *constraints;
+    u32 *contact_islands;
+
+    PairTable impulse_table;
+    CachedImpulse3 *impulses;
+    CachedImpulse3 *previous_impulses;
+};
+
+void init_contact_solver(ContactSolver2 &solver, float restitution, float friction, u32 iterations);
+void init_contact_solver(ContactSolver3 &solver, float restitution, float friction, u32 iterations);
+void deinit_contact_solver(ContactSolver2 &solver);
+void deinit_contact_solver(ContactSolver3 &solver);
+
+// Adjusts body velocities so the contacts stop approaching, and moves the bodies out of penetration; the rest of the
+// motion is left to the integrator. Returns the number of islands solved.
+usize solve_contacts(ContactSolver2 &solver, Body2 *bodies, usize body_count, const Contact2 *contacts,
+                     usize contact_count, float dt);
+usize solve_contacts(ContactSolver3 &solver, Body3 *bodies, usize body_count, const Contact3 *contacts,
+                     usize contact_count, float dt);
+
+// Puts islands whose bodies have all stayed slow for a while to sleep, zeroing their velocities. Only bodies held by
+// contacts come to rest; one drifting free, however slowly, stays awake so gravity keeps acting on it. Call after
+// solve_contacts and integration, with the same bodies. Returns the number of sleeping bodies.
+usize update_sleep(ContactSolver2 &solver, Body2 *bodies, usize body_count, float dt);
+usize update_sleep(ContactSolver3 &solver, Body3 *bodies, usize body_count, float dt);
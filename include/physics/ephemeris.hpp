@@ -0,0 +1,70 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Position of a body at an absolute time, sampled while an ephemeris is fitted
+typedef Vec2 (*EphemerisFn2)(f64 time, void *context);
+typedef Vec3 (*EphemerisFn3)(f64 time, void *context);
+
+// One body's trajectory as equal-length segments, each a Chebyshev series per axis
+struct EphemerisTrack {
+    u32 body;
+    f64 start;
+    f64 segment_duration;
+    u32 first_coefficient; // of the track's first segment
+    u32 segment_count;
+};
+
+// Precomputed trajectories ("rails") for kinematic bodies such as big moons and planets, stored the way planetary
+// ephemerides are: every segment interpolates the trajectory at the Chebyshev nodes of its time span, which keeps the
+// error close to the best polynomial fit of that degree with no fitting solve. Evaluation at arbitrary times runs in
+// structure-of-arrays lanes of a forward recurrence that yields the position and its derivative together, on the
+// worker pool, so placing every railed body each step is cheap and the N-body work only covers the free ones.
+struct Ephemeris2 {
+    u32 degree; // of each segment's series
+
+    usize track_count;
+    usize track_capacity;
+    EphemerisTrack *tracks;
+
+    usize coefficient_count;
+    usize coefficient_capacity;
+    f64 *coefficients; // per segment, degree + 1 for each axis in turn
+};
+
+struct Ephemeris3 {
+    u32 degree;
+
+    usize track_count;
+    usize track_capacity;
+    EphemerisTrack *tracks;
+
+    usize coefficient_count;
+    usize coefficient_capacity;
+    f64 *coefficients;
+};
+
+void init_ephemeris(Ephemeris2 &ephemeris, u32 degree);
+void init_ephemeris(Ephemeris3 &ephemeris, u32 degree);
+void deinit_ephemeris(Ephemeris2 &ephemeris);
+void deinit_ephemeris(Ephemeris3 &ephemeris);
+
+// Fits a track for `body` over [start, end] from positions sampled with `fn`, which is called on the calling thread
+// only. Returns the track's index.
+u32 add_ephemeris_track(Ephemeris2 &ephemeris, u32 body, f64 start, f64 end, f64 segment_duration, EphemerisFn2 fn,
+                        void *context);
+u32 add_ephemeris_track(Ephemeris3 &ephemeris, u32 body, f64 start, f64 end, f64 segment_duration, EphemerisFn3 fn,
+                        void *context);
+
+// Position, and velocity unless `velocities` is null, of one track at each of `times`. Times outside the track's span
+// give the state at its nearer end.
+void evaluate_ephemeris(const Ephemeris2 &ephemeris, u32 track, const f64 *times, usize count, Vec2 *positions,
+                        Vec2 *velocities);
+void evaluate_ephemeris(const Ephemeris3 &ephemeris, u32 track, const f64 *times, usize count, Vec3 *positions,
+                        Vec3 *velocities);
+
+// Puts every tracked body where its rail has it at `time`, with the rail's velocity. Call it after integrate_physics,
+// which still drifts kinematic bodies, and before computing accelerations.
+void update_ephemeris_bodies(const Ephemeris2 &ephemeris, Body2 *bodies, f64 time);
+void update_ephemeris_bodies(const Ephemeris3 &ephemeris, Body3 *bodies, f64 time);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Scalar whose sign change marks an event, of a body's position and velocity relative to another body, or to the
+// origin when the watch has none
+typedef float (*EventFn2)(Vec2 relative_position, Vec2 relative_velocity, const void *context);
+typedef float (*EventFn3)(Vec3 relative_position, Vec3 relative_velocity, const void *context);
+
+enum class EventDirection : u8 { Both, Rising, Falling };
+
+const u32 NO_EVENT_BODY = ~0u;
+
+struct EventWatch2 {
+    u32 body;
+    u32 other; // NO_EVENT_BODY to measure from the origin
+    EventFn2 fn;
+    const void *context;
+    EventDirection direction;
+    bool primed; // whether `value` holds the function at the end of the last step
+    float value;
+};
+
+struct EventWatch3 {
+    u32 body;
+    u32 other;
+    EventFn3 fn;
+    const void *context;
+    EventDirection direction;
+    bool primed;
+    float value;
+};
+
+// Where and when in a step a watch's function crossed zero, with the body's interpolated state at that moment
+struct Event2 {
+    u32 watch;
+    float time; // since the start of the step
+    Vec2 position;
+    Vec2 velocity;
+};
+
+struct Event3 {
+    u32 watch;
+    float time;
+    Vec3 position;
+    Vec3 velocity;
+};
+
+// Finds events inside a step instead of at its ends, so their timing does not depend on the step size. Each watch's
+// function is evaluated once per step at the end state; when its sign changes, the bodies' paths over the step are
+// rebuilt as cubic Hermite curves from their start and end positions and velocities, and the crossing is located on
+// them with the Illinois variant of regula falsi. An even number of crossings inside one step cancels out and is
+// missed, as with any end-point test.
+struct EventDetector2 {
+    float time_tolerance; // crossings are located to within this many seconds
+    u32 max_iterations;
+
+    usize watch_count;
+    usize watch_capacity;
+    EventWatch2 *watches;
+    f32 *times; // per watch, the crossing found this step or a negative value
+    Vec2 *start_positions;
+    Vec2 *start_velocities;
+    usize body_capacity;
+};
+
+struct EventDetector3 {
+    float time_tolerance;
+    u32 max_iterations;
+
+    usize watch_count;
+    usize watch_capacity;
+    EventWatch3 *watches;
+    f32 *times;
+    Vec3 *start_positions;
+    Vec3 *start_velocities;
+    usize body_capacity;
+};
+
+void init_event_detector(EventDetector2 &detector, float time_tolerance);
+void init_event_detector(EventDetector3 &detector, float time_tolerance);
+void deinit_event_detector(EventDetector2 &detector);
+void deinit_event_detector(EventDetector3 &detector);
+
+// Returns the watch's index, which events report
+u32 add_event_watch(EventDetector2 &detector, u32 body, u32 other, EventFn2 fn, const void *context,
+                    EventDirection direction);
+u32 add_event_watch(EventDetector3 &detector, u32 body, u32 other, EventFn3 fn, const void *context,
+                    EventDirection direction);
+void clear_event_watches(EventDetector2 &detector);
+void clear_event_watches(EventDetector3 &detector);
+
+// Records the bodies' state before a step; call it before stepping and detect_events after
+void begin_event_step(EventDetector2 &detector, const Body2 *bodies, usize body_count);
+void begin_event_step(EventDetector3 &detector, const Body3 *bodies, usize body_count);
+
+// Writes up to `capacity` of the events in the step of length `dt` just taken, earliest first, and returns how many
+// there were, which may exceed `capacity`
+usize detect_events(EventDetector2 &detector, const Body2 *bodies, usize body_count, float dt, Event2 *events,
+                    usize capacity);
+usize detect_events(EventDetector3 &detector, const Body3 *bodies, usize body_count, float dt, Event3 *events,
+                    usize capacity);
+
+// Radial velocity; rises through zero at closest approach and falls through zero at the farthest point
+float closest_approach_event(Vec2 relative_position, Vec2 relative_velocity, const void *context);
+float closest_approach_event(Vec3 relative_position, Vec3 relative_velocity, const void *context);
+
+// Distance from a sphere of radius *(const float *)context; falls through zero on entering it, so the sum of two radii
+// detects a collision and a sphere of influence detects capture
+float sphere_event(Vec2 relative_position, Vec2 relative_velocity, const void *context);
+float sphere_event(Vec3 relative_position, Vec3 relative_velocity, const void *context);
+
+struct EventPlane2 {
+    Vec2 normal;
+    float offset;
+};
+
+struct EventPlane3 {
+    Vec3 normal;
+    float offset;
+};
+
+// Signed distance to the plane (a line in 2D) dot(normal, p) = offset, given as context
+float plane_event(Vec2 relative_position, Vec2 relative_velocity, const void *context);
+float plane_event(Vec3 relative_position, Vec3 relative_velocity, const void *context);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// The combined gravitational acceleration of the massive kinematic bodies, baked into nested grids so receivers pay a
+// lookup instead of a sum over every source each step. Level 0 is the finest and every further level covers twice the
+// span at the same resolution, all centered on the sources; receivers sample the finest level that holds them with
+// multilinear interpolation. Beyond the coarsest level the field is the sources' total mass at their center of mass
+// once the receiver is several times their spread away, and the direct sum over the sources closer in. Near a source,
+// where the field is too steep to interpolate, the nodes are flagged and receivers there sum the sources directly.
+//
+// The grids are rebuilt only when the set of sources, or one's position or mass, has changed since the last build.
+struct FieldCache2 {
+    u32 resolution;  // nodes per axis of each level
+    u32 level_count;
+    float extent;    // half the side of the coarsest level
+    Vec2 center;
+    Vec2 center_of_mass;
+    float total_mass;
+    float source_spread; // distance from the center of mass to the farthest source
+
+    usize source_count;
+    usize source_capacity;
+    Vec2 *source_positions;
+    f32 *source_masses;
+
+    f32 *fields; // the acceleration at every node, level after level
+    u8 *near;    // nodes close enough to a source to need the direct sum
+};
+
+struct FieldCache3 {
+    u32 resolution;
+    u32 level_count;
+    float extent;
+    Vec3 center;
+    Vec3 center_of_mass;
+    float total_mass;
+    float source_spread;
+
+    usize source_count;
+    usize source_capacity;
+    Vec3 *source_positions;
+    f32 *source_masses;
+
+    f32 *fields;
+    u8 *near;
+};
+
+void init_field_cache(FieldCache2 &cache, u32 resolution, u32 level_count, float extent);
+void init_field_cache(FieldCache3 &cache, u32 resolution, u32 level_count, float extent);
+void deinit_field_cache(FieldCache2 &cache);
+void deinit_field_cache(FieldCache3 &cache);
+
+// Takes the kinematic bodies with mass as the sources and rebuilds the grids if they differ from the last build.
+// Returns whether it rebuilt.
+bool update_field_cache(FieldCache2 &cache, const Body2 *bodies, usize body_count);
+bool update_field_cache(FieldCache3 &cache, const Body3 *bodies, usize body_count);
+
+// Acceleration the sources give at a point, using GRAVITATIONAL_PARAMETER like compute_accelerations
+Vec2 sample_field_cache(const FieldCache2 &cache, Vec2 point);
+Vec3 sample_field_cache(const FieldCache3 &cache, Vec3 point);
+
+// Adds the sources' pull to `accelerations` for each awake dynamic body. Fill them with compute_dynamic_accelerations
+// first, which leaves the kinematic sources out; compute_accelerations and accelerate_rigid_bodies already sum them.
+void add_cached_field(const FieldCache2 &cache, const Body2 *bodies, usize body_count, Vec2 *accelerations);
+void add_cached_field(const FieldCache3 &cache, const Body3 *bodies, usize body_count, Vec3 *accelerations);
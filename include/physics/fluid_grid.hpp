@@ -0,0 +1,70 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Eulerian smoke on a uniform grid of cell-centered velocities, after Stam's stable fluids: every step advects the
+// velocity semi-Lagrangianly, adds vorticity confinement (Fedkiw et al.) to give back the swirl that advection smooths
+// out, projects the velocity onto its divergence-free part, and carries the smoke density along. The walls of the box
+// are solid, so the flow slides along them without passing through.
+//
+// The arrays hold one extra ring of boundary cells around the interior. Every pass runs over rows of cells on the
+// worker pool; the pressure solve is red-black Gauss-Seidel, whose half sweeps only read cells of the other color, so
+// rows update in parallel and the cells of a row vectorize.
+struct FluidGrid2 {
+    u32 size[2]; // interior cells per axis
+    float cell_size;
+    Vec2 origin;         // world position of the interior's lower corner
+    float vorticity;     // confinement strength; zero turns it off
+    float density_decay; // fraction of the smoke lost per second
+    u32 pressure_iterations;
+
+    f32 *velocities[2]; // per axis, including the boundary ring
+    f32 *velocity_scratch[2];
+    f32 *densities;
+    f32 *density_scratch;
+    f32 *pressures; // kept between steps to warm-start the solve
+    f32 *divergences;
+};
+
+struct FluidGrid3 {
+    u32 size[3];
+    float cell_size;
+    Vec3 origin;
+    float vorticity;
+    float density_decay;
+    u32 pressure_iterations;
+
+    f32 *velocities[3];
+    f32 *velocity_scratch[3];
+    f32 *densities;
+    f32 *density_scratch;
+    f32 *pressures;
+    f32 *divergences;
+};
+
+void init_fluid_grid(FluidGrid2 &grid, u32 width, u32 height, float cell_size, Vec2 origin);
+void init_fluid_grid(FluidGrid3 &grid, u32 width, u32 height, u32 depth, float cell_size, Vec3 origin);
+void deinit_fluid_grid(FluidGrid2 &grid);
+void deinit_fluid_grid(FluidGrid3 &grid);
+
+// Adds smoke and pulls the velocity toward `velocity` inside a ball, both falling off linearly toward its edge
+void add_fluid_source(FluidGrid2 &grid, Vec2 position, float radius, Vec2 velocity, float density);
+void add_fluid_source(FluidGrid3 &grid, Vec3 position, float radius, Vec3 velocity, float density);
+
+void step_fluid_grid(FluidGrid2 &grid, float dt);
+void step_fluid_grid(FluidGrid3 &grid, float dt);
+
+// Flow velocity at a world position, interpolated between cell centers and clamped to the box
+Vec2 sample_fluid_velocity(const FluidGrid2 &grid, Vec2 position);
+Vec3 sample_fluid_velocity(const FluidGrid3 &grid, Vec3 position);
+
+// Gives the awake, massless dynamic bodies the flow's velocity (sampled at the midpoint of their step), so
+// integrate_physics carries them along as tracers
+void advect_fluid_tracers(const FluidGrid2 &grid, Body2 *bodies, usize body_count, float dt);
+void advect_fluid_tracers(const FluidGrid3 &grid, Body3 *bodies, usize body_count, float dt);
+
+// Drags the awake dynamic bodies with mass toward the flow velocity at `drag` per second, an external force to apply
+// before integrate_physics
+void apply_fluid_drag(const FluidGrid2 &grid, Body2 *bodies, usize body_count, float drag, float dt);
+void apply_fluid_drag(const FluidGrid3 &grid, Body3 *bodies, usize body_count, float drag, float dt);
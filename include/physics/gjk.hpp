@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Support points of the last GJK simplex in each shape's local frame. Passing the cache of the previous step back in
+// restarts GJK from where it converged, which for coherent motion finishes in one or two iterations.
+struct SimplexCache2 {
+    u32 count;
+    Vec2 local_a[3];
+    Vec2 local_b[3];
+};
+
+struct SimplexCache3 {
+    u32 count;
+    Vec3 local_a[4];
+    Vec3 local_b[4];
+};
+
+struct ConvexQuery2 {
+    bool overlapping;
+    float distance; // separation, or penetration depth when overlapping
+    Vec2 normal;    // from a to b
+    Vec2 point_a;   // closest (deepest when overlapping) point on each shape
+    Vec2 point_b;
+    float patch_radius; // half-width of the flat patch overlapping shapes touch over, zero where they meet at a point
+    u32 iterations;
+};
+
+struct ConvexQuery3 {
+    bool overlapping;
+    float distance;
+    Vec3 normal;
+    Vec3 point_a;
+    Vec3 point_b;
+    float patch_radius; // radius of the largest disk inside the patch
+    u32 iterations;
+};
+
+// GJK distance between two convex shapes placed by their transforms, followed by EPA for the penetration depth when
+// they overlap. Every shape kind is treated as convex; polygons must be. `cache` may be null. Returns false if either
+// shape is ShapeKind::None.
+bool query_convex(const Shape2 &a, const Transform2 &transform_a, const Shape2 &b, const Transform2 &transform_b,
+                  SimplexCache2 *cache, ConvexQuery2 &result);
+bool query_convex(const Shape3 &a, const Transform3 &transform_a, const Shape3 &b, const Transform3 &transform_b,
+                  SimplexCache3 *cache, ConvexQuery3 &result);
@@ -1,10 +1,18 @@
 #pragma once
 
 #include "common/types.hpp"
+#include "graphics/shapes.hpp"
 #include "math/rotor.hpp"
 #include "math/vec2.hpp"
 #include "math/vec3.hpp"
 
+const float GRAVITATIONAL_CONSTANT = 6.674e-11;
+const float GRAVITATIONAL_FACTOR = 1.0e2;
+
+// Newtonian coupling (G * M gives the acceleration per unit distance squared) used by the integrators that advance
+// bodies by a timestep rather than by a per-call velocity impulse
+const float GRAVITATIONAL_PARAMETER = GRAVITATIONAL_CONSTANT * GRAVITATIONAL_FACTOR;
+
 enum class BodyKind { Kinematic, Dynamic };
 
 struct Dampening {
@@ -16,12 +24,14 @@ struct Transform2 {
     Vec2 position;
     Vec2 velocity;
     Rot2 rotation;
+    float angular_velocity; // radians per second, counter-clockwise
 };
 
 struct Transform3 {
     Vec3 position;
     Vec3 velocity;
     Rot3 rotation;
+    Vec3 angular_velocity; // world-space rotation axis scaled by radians per second
 };
 
 struct Body2 {
@@ -29,6 +39,9 @@ struct Body2 {
     Transform2 transform;
     float mass;
     Dampening dampening;
+    Shape2 shape; // ShapeKind2::None for point bodies, which collision detection ignores
+    bool sleeping;    // at rest and skipped by integration, gravity and the contact solver until woken
+    float sleep_time; // seconds spent below the sleep thresholds
 };
 
 struct Body3 {
@@ -36,10 +49,68 @@ struct Body3 {
     Transform3 transform;
     float mass;
     Dampening dampening;
+    Shape3 shape;
+    bool sleeping;
+    float sleep_time;
 };
 
+// Bodies put to sleep by update_sleep stay put until a contact with an awake body wakes their island. Anything else
+// that changes a sleeping body's motion, such as an applied force, must wake it first.
+inline void wake_body(Body2 &body) {
+    body.sleeping = false;
+    body.sleep_time = 0.0f;
+}
+
+inline void wake_body(Body3 &body) {
+    body.sleeping = false;
+    body.sleep_time = 0.0f;
+}
+
+// Awake dynamic bodies and moving or spinning kinematic ones are the only things that can wake a sleeping body. The
+// narrowphase skips pairs in which neither body can, and the contact solver wakes islands touched by one that can.
+inline bool can_disturb(const Body2 &body) {
+    return !body.sleeping && (body.kind == BodyKind::Dynamic || body.transform.velocity.length_squared() > 0.0f ||
+                              body.transform.angular_velocity != 0.0f);
+}
+
+inline bool can_disturb(const Body3 &body) {
+    return !body.sleeping && (body.kind == BodyKind::Dynamic || body.transform.velocity.length_squared() > 0.0f ||
+                              body.transform.angular_velocity.length_squared() > 0.0f);
+}
+
 void accelerate_rigid_bodies(Body2 *bodies, usize body_count);
 void accelerate_rigid_bodies(Body3 *bodies, usize body_count);
 
+// Newtonian acceleration of each dynamic body from all others using GRAVITATIONAL_PARAMETER, written to
+// `accelerations` instead of being applied. Kinematic and sleeping bodies receive zero.
+void compute_accelerations(const Body2 *bodies, usize body_count, Vec2 *accelerations);
+void compute_accelerations(const Body3 *bodies, usize body_count, Vec3 *accelerations);
+
+// The same with only dynamic bodies as sources. Pair it with add_cached_field, which adds the pull of the kinematic
+// ones from a FieldCache; compute_accelerations would count them twice.
+void compute_dynamic_accelerations(const Body2 *bodies, usize body_count, Vec2 *accelerations);
+void compute_dynamic_accelerations(const Body3 *bodies, usize body_count, Vec3 *accelerations);
+
+// Gravitational acceleration and potential (energy per unit mass) at a point in space
+struct FieldSample2 {
+    Vec2 acceleration;
+    float potential;
+};
+
+struct FieldSample3 {
+    Vec3 acceleration;
+    float potential;
+};
+
+// The field every body with mass produces at each of `points`, using GRAVITATIONAL_PARAMETER like
+// compute_accelerations, for probes and visualizations that should not be bodies themselves. Points are split across
+// the worker pool; each task sums the bodies in cache-sized blocks over structure-of-arrays lanes of points, so the
+// inner loop vectorizes. A point on top of a body skips that body.
+void evaluate_field(const Body2 *bodies, usize body_count, const Vec2 *points, usize point_count, FieldSample2 *out);
+void evaluate_field(const Body3 *bodies, usize body_count, const Vec3 *points, usize point_count, FieldSample3 *out);
+
+// Advances positions and rotations of the awake bodies by their velocities, after applying dampening. Rotors are
+// stepped in fixed-size batches laid out one component per array, so the update and renormalization vectorize across
+// bodies.
 void integrate_physics(Body2 *bodies, usize body_count, float dt);
 void integrate_physics(Body3 *bodies, usize body_count, float dt);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+#include "physics/spring.hpp"
+
+// Backward Euler integrator for stiff springs and strong dampening. Each step takes one linearized Newton step,
+// (M - dt D - dt^2 K) dv = dt (f + dt K v), solved matrix-free with Jacobi-preconditioned conjugate gradients on the
+// worker pool and warm-started from the previous step's velocity change.
+//
+// Kinematic and sleeping bodies are held fixed, and a sleeping body joined by a spring to an awake dynamic one is
+// woken. Bodies with mass below EPSILON are treated as unit mass. The spring topology is captured at init, so the
+// solver must be re-initialized when springs are added or removed.
+struct ImplicitSolver2 {
+    usize body_count;
+    usize spring_count;
+    u32 max_iterations;
+    float tolerance; // relative residual
+
+    u32 *spring_offsets; // body_count + 1 offsets into `spring_indices`, the springs attached to each body
+    u32 *spring_indices;
+
+    Vec2 *delta_velocity; // solution of the last step, used as the initial guess
+    Vec2 *rhs;
+    Vec2 *residual;
+    Vec2 *direction;
+    Vec2 *product;
+    Vec2 *preconditioner; // inverse diagonal
+    Vec2 *spring_axes;
+    float *spring_lateral;
+    float *spring_axial;
+    f64 *partials;
+};
+
+struct ImplicitSolver3 {
+    usize body_count;
+    usize spring_count;
+    u32 max_iterations;
+    float tolerance;
+
+    u32 *spring_offsets;
+    u32 *spring_indices;
+
+    Vec3 *delta_velocity;
+    Vec3 *rhs;
+    Vec3 *residual;
+    Vec3 *direction;
+    Vec3 *product;
+    Vec3 *preconditioner;
+    Vec3 *spring_axes;
+    float *spring_lateral;
+    float *spring_axial;
+    f64 *partials;
+};
+
+void init_implicit_solver(ImplicitSolver2 &solver, usize body_count, const Spring *springs, usize spring_count);
+void init_implicit_solver(ImplicitSolver3 &solver, usize body_count, const Spring *springs, usize spring_count);
+void deinit_implicit_solver(ImplicitSolver2 &solver);
+void deinit_implicit_solver(ImplicitSolver3 &solver);
+
+// Advances the bodies by dt. `external_accelerations` (e.g. from compute_accelerations) is optional and treated
+// explicitly. Returns the number of conjugate gradient iterations used.
+u32 integrate_implicit(ImplicitSolver2 &solver, Body2 *bodies, usize body_count, const Spring *springs,
+                       const Vec2 *external_accelerations, float dt);
+u32 integrate_implicit(ImplicitSolver3 &solver, Body3 *bodies, usize body_count, const Spring *springs,
+                       const Vec3 *external_accelerations, float dt);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "math/vec2.hpp"
+#include "math/vec3.hpp"
+
+// Advances a body on the two-body orbit around a fixed center with gravitational parameter mu, using the universal
+// variable formulation so circular, elliptic, parabolic and hyperbolic orbits share one code path. Position and
+// velocity are relative to the center. Solved in double precision; returns false if the solver did not converge, in
+// which case the state is left untouched.
+bool kepler_drift(Vec2 &position, Vec2 &velocity, f64 mu, f64 dt);
+bool kepler_drift(Vec3 &position, Vec3 &velocity, f64 mu, f64 dt);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+enum class PhotonState : u8 { Traveling, Escaped, Captured };
+
+// Light rays bent by the bodies with mass, in the weak-field limit of general relativity: a photon keeps the speed of
+// light and turns under twice the Newtonian pull across its path. Rays advance in steps along their length that scale
+// with the distance to the nearest lens, so they cross empty space in a few long steps and slow down only where they
+// bend. A ray stops once it leaves the region moving outward (Escaped), or comes within a lens's bounding radius or
+// Schwarzschild radius, whichever is larger (Captured).
+//
+// Rays are stored as structure-of-arrays and traced in lanes of 64 on the worker pool, summing the lenses for the
+// whole lane at once so the inner loop vectorizes across rays. A lane stops as soon as all of its rays have stopped.
+struct PhotonBundle2 {
+    float speed_of_light;
+    Vec2 region_center;
+    float region_radius;
+    float step_fraction; // step length as a fraction of the distance to the nearest lens
+    float min_step;
+    float max_step;
+    u32 max_steps;
+
+    usize photon_count;
+    usize photon_capacity;
+    f32 *positions[2];
+    f32 *directions[2]; // unit length
+    PhotonState *states;
+};
+
+struct PhotonBundle3 {
+    float speed_of_light;
+    Vec3 region_center;
+    float region_radius;
+    float step_fraction;
+    float min_step;
+    float max_step;
+    u32 max_steps;
+
+    usize photon_count;
+    usize photon_capacity;
+    f32 *positions[3];
+    f32 *directions[3];
+    PhotonState *states;
+};
+
+// Step lengths default to fractions of the region's radius
+void init_photon_bundle(PhotonBundle2 &bundle, float speed_of_light, Vec2 region_center, float region_radius);
+void init_photon_bundle(PhotonBundle3 &bundle, float speed_of_light, Vec3 region_center, float region_radius);
+void deinit_photon_bundle(PhotonBundle2 &bundle);
+void deinit_photon_bundle(PhotonBundle3 &bundle);
+
+void clear_photons(PhotonBundle2 &bundle);
+void clear_photons(PhotonBundle3 &bundle);
+void add_photon(PhotonBundle2 &bundle, Vec2 position, Vec2 direction);
+void add_photon(PhotonBundle3 &bundle, Vec3 position, Vec3 direction);
+
+// Appends one ray per pixel of a pinhole camera, row by row from the top-left, so after tracing, pixel (x, y) is photon
+// first + y * width + x, where first is the photon count before the call. An escaped photon's direction is where the
+// pixel sees the sky behind the lenses; a captured one sees a lens.
+void add_camera_photons(PhotonBundle3 &bundle, Vec3 eye, Vec3 forward, Vec3 up, float vertical_field_of_view,
+                        u32 width, u32 height);
+
+// Advances every traveling photon until it escapes, is captured or has taken max_steps steps
+void trace_photons(PhotonBundle2 &bundle, const Body2 *lenses, usize lens_count);
+void trace_photons(PhotonBundle3 &bundle, const Body3 *lenses, usize lens_count);
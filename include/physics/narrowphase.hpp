@@ -0,0 +1,77 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/collider.hpp"
+#include "physics/gjk.hpp"
+#include "physics/pair_table.hpp"
+
+// Contact between bodies a and b. The normal points from a to b, depth is the penetration along it and the point
+// lies midway through the overlap. Shapes touching face to face get the point in the middle of the shared patch and
+// its size in patch_radius, which is zero for contacts at a point.
+struct Contact2 {
+    u32 a, b;
+    Vec2 normal;
+    Vec2 point;
+    float depth;
+    float patch_radius;
+};
+
+struct Contact3 {
+    u32 a, b;
+    Vec3 normal;
+    Vec3 point;
+    float depth;
+    float patch_radius;
+};
+
+// Shape combinations with a dedicated contact kernel. Circles take part in the capsule kernel as zero-length capsules.
+// Every other pairing of shaped bodies goes to the Convex bucket, which runs GJK/EPA.
+enum class ContactBucket2 { CircleCircle, CircleRectangle, CapsuleCapsule, Convex, Count };
+enum class ContactBucket3 { SphereSphere, SphereCuboid, Convex, Count };
+
+// Batched contact generation. Broadphase pairs are sorted into one bucket per shape combination, and each bucket runs
+// its kernel over fixed-size lanes: the shapes are gathered into structure-of-arrays scratch, the kernel is a
+// branch-free loop the compiler vectorizes, and the hits are compacted into `contacts`. Lanes run on the worker pool.
+// Convex pairs keep their GJK simplex between calls, looked up by pair in `cache_table`, so persistent contacts are
+// warm started.
+struct Narrowphase2 {
+    PairBuffer buckets[(usize)ContactBucket2::Count]; // ordered so body a has the shape named first
+
+    PairTable cache_table; // convex pair -> index into previous_caches
+    SimplexCache2 *caches; // parallel to the Convex bucket
+    SimplexCache2 *previous_caches;
+    usize cache_capacity;
+
+    usize chunk_capacity;
+    u32 *chunk_counts;
+
+    Contact2 *contacts;
+    usize contact_count;
+    usize contact_capacity;
+};
+
+struct Narrowphase3 {
+    PairBuffer buckets[(usize)ContactBucket3::Count];
+
+    PairTable cache_table;
+    SimplexCache3 *caches;
+    SimplexCache3 *previous_caches;
+    usize cache_capacity;
+
+    usize chunk_capacity;
+    u32 *chunk_counts;
+
+    Contact3 *contacts;
+    usize contact_count;
+    usize contact_capacity;
+};
+
+void init_narrowphase(Narrowphase2 &narrowphase);
+void init_narrowphase(Narrowphase3 &narrowphase);
+void deinit_narrowphase(Narrowphase2 &narrowphase);
+void deinit_narrowphase(Narrowphase3 &narrowphase);
+
+// Generates at most one contact per pair into `narrowphase.contacts`, grouped by bucket. Pairs involving a body
+// without a shape are skipped, as are pairs where a sleeping body meets nothing that could wake it.
+usize generate_contacts(Narrowphase2 &narrowphase, const Body2 *bodies, const BroadphasePair *pairs, usize pair_count);
+usize generate_contacts(Narrowphase3 &narrowphase, const Body3 *bodies, const BroadphasePair *pairs, usize pair_count);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Future positions of selected bodies, step by step from the snapshot a request was made with
+struct OrbitPrediction2 {
+    u64 generation; // of the request that produced it
+    u32 step_count; // positions per body after the initial one
+    float dt;
+
+    usize body_count;
+    usize body_capacity;
+    u32 *bodies;     // indices of the selected bodies in the snapshot
+    Vec2 *positions; // step_count + 1 per selected body, body after body
+    usize position_capacity;
+};
+
+struct OrbitPrediction3 {
+    u64 generation;
+    u32 step_count;
+    float dt;
+
+    usize body_count;
+    usize body_capacity;
+    u32 *bodies;
+    Vec3 *positions;
+    usize position_capacity;
+};
+
+// Advances a snapshot by one step of dt. It runs on the worker thread while the caller keeps going, so it may only read
+// `context`.
+typedef void (*OrbitStepFn2)(Body2 *bodies, usize body_count, float dt, const void *context);
+typedef void (*OrbitStepFn3)(Body3 *bodies, usize body_count, float dt, const void *context);
+
+struct OrbitWorker2;
+struct OrbitWorker3;
+
+// Predicts trajectories on a background thread so the frame never waits on them. A request snapshots the bodies and
+// supersedes every earlier one: the worker abandons a stale integration within a few steps and starts on the newest
+// snapshot. Finished predictions are handed over through a triple buffer, so the reader and the worker never block
+// each other.
+//
+// The snapshot is advanced with the request's step function, which should be the step the simulation takes so the
+// predicted orbits follow the simulated ones. Without one it falls back to a leapfrog over compute_accelerations, with
+// kinematic bodies coasting at their velocity and collisions and dampening ignored; that force law differs from
+// accelerate_rigid_bodies', so it only matches simulations stepped the same way.
+//
+// Requests and reads must come from a single thread.
+struct OrbitPredictor2 {
+    OrbitWorker2 *worker;
+};
+
+struct OrbitPredictor3 {
+    OrbitWorker3 *worker;
+};
+
+// Starts the worker thread
+void init_orbit_predictor(OrbitPredictor2 &predictor);
+void init_orbit_predictor(OrbitPredictor3 &predictor);
+// Cancels any integration in flight and joins the worker thread
+void deinit_orbit_predictor(OrbitPredictor2 &predictor);
+void deinit_orbit_predictor(OrbitPredictor3 &predictor);
+
+// Queues a prediction of `step_count` steps of `dt` for the bodies at `selected` and returns its generation. The
+// bodies are copied, so the caller may keep simulating; selected indices past `body_count` are dropped. `step` may be
+// nullptr for the built-in leapfrog, and `context` is passed to it.
+u64 request_orbit_prediction(OrbitPredictor2 &predictor, const Body2 *bodies, usize body_count, const u32 *selected,
+                             usize selected_count, u32 step_count, float dt, OrbitStepFn2 step, const void *context);
+u64 request_orbit_prediction(OrbitPredictor3 &predictor, const Body3 *bodies, usize body_count, const u32 *selected,
+                             usize selected_count, u32 step_count, float dt, OrbitStepFn3 step, const void *context);
+
+// Abandons the pending and running requests without starting a new one
+void cancel_orbit_prediction(OrbitPredictor2 &predictor);
+void cancel_orbit_prediction(OrbitPredictor3 &predictor);
+
+// The newest finished prediction, or nullptr before the first one. It stays valid until the next call, and may be
+// from an older request than the last one made; compare its generation to tell.
+const OrbitPrediction2 *latest_orbit_prediction(OrbitPredictor2 &predictor);
+const OrbitPrediction3 *latest_orbit_prediction(OrbitPredictor3 &predictor);
+
+// accelerate_rigid_bodies then integrate_physics, the step of the usual simulation loop, as an OrbitStepFn
+void step_rigid_bodies(Body2 *bodies, usize body_count, float dt, const void *context);
+void step_rigid_bodies(Body3 *bodies, usize body_count, float dt, const void *context);
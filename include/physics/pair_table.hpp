@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common/types.hpp"
+
+// Open-addressing set of unordered body pairs with a u32 payload per pair (linear probing, backward-shift deletion).
+// Used to track persistent overlaps and per-pair cached data between steps.
+struct PairTable {
+    u64 *keys;
+    u32 *values;
+    usize capacity; // power of two, or 0 before the first insertion
+    usize count;
+};
+
+void init_pair_table(PairTable &table);
+void deinit_pair_table(PairTable &table);
+void clear_pair_table(PairTable &table);
+
+// Returns the payload slot of the pair, inserting it with a zero payload if absent
+u32 *pair_table_insert(PairTable &table, u32 a, u32 b, bool *inserted = nullptr);
+
+// Returns the payload slot of the pair, or nullptr if absent
+u32 *pair_table_find(const PairTable &table, u32 a, u32 b);
+
+// Returns whether the pair was present
+bool pair_table_remove(PairTable &table, u32 a, u32 b);
+
+inline bool pair_table_slot_used(const PairTable &table, usize slot) {
+    return table.keys[slot] != ~0ull;
+}
+
+inline u32 pair_table_slot_a(const PairTable &table, usize slot) {
+    return (u32)(table.keys[slot] >> 32);
+}
+
+inline u32 pair_table_slot_b(const PairTable &table, usize slot) {
+    return (u32)table.keys[slot];
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+struct PararealConfig {
+    u32 slice_count;    // time slices refined in parallel
+    u32 coarse_steps;   // leapfrog steps the coarse propagator takes per slice
+    u32 max_iterations; // upper bound on refinement sweeps; slice_count sweeps reproduce the serial result exactly
+    float tolerance;    // largest position correction between sweeps at which the trajectory counts as converged
+};
+
+// Advances the bodies by `step_count` leapfrog steps of `dt` using Parareal: the run is cut into time slices seeded by
+// a cheap coarse leapfrog, then every slice is re-integrated with the fine step on the worker pool and the coarse
+// sweep is corrected with the fine results until the slice boundaries stop moving. Lets few-body, long-horizon runs
+// use more than one core. Returns the number of refinement sweeps.
+u32 integrate_parareal(Body2 *bodies, usize body_count, float dt, usize step_count, const PararealConfig &config);
+u32 integrate_parareal(Body3 *bodies, usize body_count, float dt, usize step_count, const PararealConfig &config);
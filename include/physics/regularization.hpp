@@ -0,0 +1,15 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Kick-drift-kick step that regularizes close encounters. Dynamic bodies that are each other's nearest neighbor and
+// closer than `pair_radius` are advanced as a pair: the center of mass feels the rest of the system through kicks,
+// while the relative motion is integrated in Kustaanheimo-Stiefel (Levi-Civita in 2D) coordinates, where the
+// singular two-body force becomes a smooth harmonic oscillator. Close binaries then cost a handful of regularized
+// substeps instead of forcing a tiny global dt.
+//
+// Uses GRAVITATIONAL_PARAMETER point-mass gravity; dampening is applied to bodies that are not part of a pair.
+// Sleeping bodies still attract the others but are neither paired nor moved.
+void integrate_regularized(Body2 *bodies, usize body_count, float dt, float pair_radius);
+void integrate_regularized(Body3 *bodies, usize body_count, float dt, float pair_radius);
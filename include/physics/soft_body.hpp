@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "graphics/mesh.hpp"
+#include "math/vec3.hpp"
+
+// Colors the edge graph can use before the remaining edges are solved serially, one at a time
+const u32 SOFT_BODY_MAX_COLORS = 64;
+
+// Distance constraint between two particles. Stretch edges follow the mesh's triangle edges; bend edges join the
+// vertices opposite an edge two triangles share, so folding along it stretches them.
+struct SoftEdge {
+    u32 a, b;
+    float rest_length;
+    float compliance; // inverse stiffness; zero is rigid
+};
+
+// Deformable mesh simulated with small-step XPBD: every substep predicts the particles under gravity, corrects each
+// edge once and takes the velocities from how far the particles moved. The particles are the mesh's vertices, so
+// vertices that should stay joined across a seam must be shared through the index buffer.
+//
+// The edges are colored once, when the body is created, so that no two edges of a color share a particle; each color
+// is solved on the worker pool in structure-of-arrays lanes whose arithmetic vectorizes. Normals are rebuilt per
+// vertex from the triangles around it, so that pass has no write conflicts either.
+struct SoftBody {
+    u32 substeps;
+    Vec3 gravity;
+    float damping; // fraction of velocity lost per second
+
+    usize particle_count;
+    Vec3 *positions;
+    Vec3 *previous_positions;
+    Vec3 *velocities;
+    Vec3 *normals;
+    f32 *inverse_masses; // set an entry to zero to pin that vertex in place
+
+    usize edge_count;
+    SoftEdge *edges; // grouped by color
+    u32 color_count; // including the serial color, when used
+    u32 color_starts[SOFT_BODY_MAX_COLORS + 2];
+
+    usize triangle_count;
+    u32 *triangles;        // three particle indices each
+    u32 *vertex_triangles; // triangles around each vertex, indexed by vertex_triangle_starts
+    u32 *vertex_triangle_starts;
+};
+
+// Builds a soft body from the mesh's current vertices and triangles (its indices, or consecutive vertex triples when
+// it has none), spreading `mass` evenly over the vertices. Rest lengths are taken from the mesh as it is now.
+void init_soft_body(SoftBody &body, const Mesh &mesh, float mass, float stretch_compliance, float bend_compliance,
+                    u32 substeps);
+void deinit_soft_body(SoftBody &body);
+
+// Advances the particles by dt and rebuilds their normals
+void step_soft_body(SoftBody &body, float dt);
+
+// Copies positions and normals into the mesh's vertices and streams them to the GPU with update_mesh_vertices
+void update_soft_body_mesh(const SoftBody &body, Mesh &mesh);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/collider.hpp"
+
+struct SpatialHashEntry {
+    i32 cell[3];
+    u32 bucket;
+    u32 body;
+};
+
+// Uniform-grid broadphase for bodies carrying a shape, rebuilt from scratch every call in O(N) on the worker pool.
+// Each body's AABB is inserted into every cell it touches, cells are hashed into buckets with a parallel two-pass
+// counting sort, and pairs sharing a cell are tested. A pair is reported only from the cell holding the minimum
+// corner of the two boxes' intersection, so no deduplication pass is needed.
+//
+// The cell size follows the shape-size distribution (the 90th percentile of the largest AABB dimension) unless
+// `fixed_cell_size` is set. Bodies spanning more than a few cells per axis are tested against everything directly
+// instead of flooding the grid.
+struct SpatialHash2 {
+    float fixed_cell_size; // 0 picks the cell size from the shapes on every call
+    float cell_size;
+
+    usize body_capacity;
+    Aabb2 *bounds;
+    u32 *entry_counts; // per body, prefix-summed into entry offsets
+    u32 *oversized;
+    usize oversized_count;
+
+    usize entry_capacity;
+    SpatialHashEntry *entries;
+    SpatialHashEntry *sorted_entries;
+
+    usize bucket_capacity;
+    u32 *bucket_offsets;
+    usize histogram_capacity;
+    u32 *histograms;
+
+    usize buffer_count;
+    PairBuffer *buffers; // one per parallel chunk, concatenated into `pairs`
+
+    BroadphasePair *pairs;
+    usize pair_count;
+    usize pair_capacity;
+};
+
+struct SpatialHash3 {
+    float fixed_cell_size;
+    float cell_size;
+
+    usize body_capacity;
+    Aabb3 *bounds;
+    u32 *entry_counts;
+    u32 *oversized;
+    usize oversized_count;
+
+    usize entry_capacity;
+    SpatialHashEntry *entries;
+    SpatialHashEntry *sorted_entries;
+
+    usize bucket_capacity;
+    u32 *bucket_offsets;
+    usize histogram_capacity;
+    u32 *histograms;
+
+    usize buffer_count;
+    PairBuffer *buffers;
+
+    BroadphasePair *pairs;
+    usize pair_count;
+    usize pair_capacity;
+};
+
+void init_spatial_hash(SpatialHash2 &hash);
+void init_spatial_hash(SpatialHash3 &hash);
+void deinit_spatial_hash(SpatialHash2 &hash);
+void deinit_spatial_hash(SpatialHash3 &hash);
+
+// Finds all pairs of shaped bodies whose AABBs overlap; the result is in `hash.pairs[0, hash.pair_count)` in a
+// deterministic order. Bodies with ShapeKind::None are ignored.
+usize find_overlapping_pairs(SpatialHash2 &hash, const Body2 *bodies, usize body_count);
+usize find_overlapping_pairs(SpatialHash3 &hash, const Body3 *bodies, usize body_count);
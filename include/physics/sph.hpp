@@ -0,0 +1,79 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Smoothed-particle hydrodynamics over bodies used as fluid particles. Density and the pressure force use the spiky
+// kernel and its gradient in the symmetric p / rho^2 form, so pressure forces are momentum- and energy-consistent
+// (equation of state stiffness * (density - rest_density), never pulling). Viscosity uses the viscosity kernel's
+// Laplacian. All kernels have support radius smoothing_length.
+//
+// Every call bins the particles into cells one smoothing length wide and radix-sorts them by the cells' Morton codes,
+// so particles in nearby cells sit near each other in memory. Each cell looks up its neighboring cells once, and the
+// density and force passes run over cells on the worker pool, gathering the neighbors into lanes that vectorize.
+// Kinematic bodies take part as boundary particles that push the fluid but are not pushed back.
+struct Sph2 {
+    float smoothing_length;
+    float rest_density;
+    float stiffness;
+    float viscosity;
+
+    usize particle_capacity;
+    usize particle_count;
+    u64 *codes; // Morton code of each particle's cell, sorted
+    u64 *code_scratch;
+    u32 *order; // body index of each sorted particle
+    u32 *order_scratch;
+    f32 *positions[2]; // per axis, in sorted order, like the arrays below
+    f32 *velocities[2];
+    f32 *masses;
+    f32 *densities;
+    f32 *pressures;
+
+    usize histogram_capacity;
+    u32 *histograms; // per-chunk digit counts for the radix sort
+
+    usize cell_capacity;
+    usize cell_count;
+    u64 *cell_codes;
+    u32 *cell_starts;    // cell_count + 1 offsets into the sorted particles
+    u32 *cell_neighbors; // the 9 cells around each cell (itself included), or ~0u where empty
+};
+
+struct Sph3 {
+    float smoothing_length;
+    float rest_density;
+    float stiffness;
+    float viscosity;
+
+    usize particle_capacity;
+    usize particle_count;
+    u64 *codes;
+    u64 *code_scratch;
+    u32 *order;
+    u32 *order_scratch;
+    f32 *positions[3];
+    f32 *velocities[3];
+    f32 *masses;
+    f32 *densities;
+    f32 *pressures;
+
+    usize histogram_capacity;
+    u32 *histograms;
+
+    usize cell_capacity;
+    usize cell_count;
+    u64 *cell_codes;
+    u32 *cell_starts;
+    u32 *cell_neighbors; // 27 per cell
+};
+
+void init_sph(Sph2 &sph, float smoothing_length, float rest_density, float stiffness, float viscosity);
+void init_sph(Sph3 &sph, float smoothing_length, float rest_density, float stiffness, float viscosity);
+void deinit_sph(Sph2 &sph);
+void deinit_sph(Sph3 &sph);
+
+// Adds the pressure and viscosity accelerations times dt to the velocities of the awake dynamic bodies; positions are
+// left to the integrator. Afterwards `densities[k]` and `pressures[k]` belong to `bodies[order[k]]`.
+void apply_sph_forces(Sph2 &sph, Body2 *bodies, usize body_count, float dt);
+void apply_sph_forces(Sph3 &sph, Body3 *bodies, usize body_count, float dt);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "common/types.hpp"
+
+// Damped spring between bodies `a` and `b` (indices into the body array)
+struct Spring {
+    u32 a, b;
+    float rest_length;
+    float stiffness;
+    float damping; // along the spring axis
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/collider.hpp"
+#include "physics/pair_table.hpp"
+
+struct SweepEndpoint {
+    float value;
+    u32 data; // body << 1 | 1 for a max endpoint
+};
+
+// Incremental sweep-and-prune broadphase. Endpoint lists stay sorted between calls and are repaired with insertion
+// sort, so coherent motion costs O(N + swaps); overlaps only begin or end where two endpoints swap. The active
+// overlaps live in `overlaps`, and each update reports the pairs that began and ended overlapping.
+//
+// Adding or removing bodies, or changing whether a body has a shape, triggers a full rebuild.
+struct SweepAndPrune2 {
+    usize body_count;
+    usize body_capacity;
+    Aabb2 *bounds;
+    u8 *tracked;
+
+    usize endpoint_count;
+    SweepEndpoint *endpoints[2];
+
+    PairTable overlaps;
+    PairBuffer began;
+    PairBuffer ended;
+};
+
+struct SweepAndPrune3 {
+    usize body_count;
+    usize body_capacity;
+    Aabb3 *bounds;
+    u8 *tracked;
+
+    usize endpoint_count;
+    SweepEndpoint *endpoints[3];
+
+    PairTable overlaps;
+    PairBuffer began;
+    PairBuffer ended;
+};
+
+void init_sweep_and_prune(SweepAndPrune2 &sap);
+void init_sweep_and_prune(SweepAndPrune3 &sap);
+void deinit_sweep_and_prune(SweepAndPrune2 &sap);
+void deinit_sweep_and_prune(SweepAndPrune3 &sap);
+
+// Refreshes the bounds of every shaped body and updates the overlap set, filling `began` and `ended`
+void update_sweep_and_prune(SweepAndPrune2 &sap, const Body2 *bodies, usize body_count);
+void update_sweep_and_prune(SweepAndPrune3 &sap, const Body3 *bodies, usize body_count);
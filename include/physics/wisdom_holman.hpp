@@ -0,0 +1,15 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+
+// Wisdom-Holman symplectic step for systems dominated by one central mass, split in democratic heliocentric
+// coordinates: every body drifts analytically on its Kepler orbit around `bodies[central_index]` and the mutual pull
+// of the remaining bodies is applied as kicks. Stays accurate with timesteps around 1/20 of the shortest orbital
+// period.
+//
+// The step is conservative, so dampening is ignored. Kinematic bodies other than the central one keep moving in a
+// straight line and do not perturb the others; sleeping ones stay put and do not perturb them either. A sleeping
+// central body is woken.
+void integrate_wisdom_holman(Body2 *bodies, usize body_count, usize central_index, float dt);
+void integrate_wisdom_holman(Body3 *bodies, usize body_count, usize central_index, float dt);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "common/types.hpp"
+#include "physics/gravity.hpp"
+#include "physics/spring.hpp"
+
+// Colors the constraint graph can use before the remaining rows are solved serially, one at a time
+const u32 XPBD_MAX_COLORS = 64;
+
+// Distance keeps the anchors rest_length apart, BallSocket keeps them together and Hinge additionally keeps the
+// bodies' axes aligned, leaving only rotation about them free. In 2D a hinge is a ball socket.
+enum class JointKind { Distance, BallSocket, Hinge };
+
+// Joint between bodies `a` and `b` (indices into the body array), with anchors in each body's local frame
+struct Joint2 {
+    JointKind kind;
+    u32 a, b;
+    Vec2 anchor_a, anchor_b;
+    float rest_length;
+    float compliance; // inverse stiffness; zero is rigid
+};
+
+struct Joint3 {
+    JointKind kind;
+    u32 a, b;
+    Vec3 anchor_a, anchor_b;
+    Vec3 axis_a, axis_b; // hinge axis in each body's local frame
+    float rest_length;
+    float compliance;
+};
+
+enum class XpbdRowKind : u8 { Point, Align };
+
+// Scalar constraint the joints and springs are broken into. Point rows hold the anchors rest_length apart; align rows
+// turn the bodies until their axes (stored in the anchors) line up.
+struct XpbdRow2 {
+    XpbdRowKind kind;
+    u32 a, b;
+    Vec2 anchor_a, anchor_b;
+    float rest_length;
+    float compliance;
+    float damping;
+};
+
+struct XpbdRow3 {
+    XpbdRowKind kind;
+    u32 a, b;
+    Vec3 anchor_a, anchor_b;
+    float rest_length;
+    float compliance;
+    float damping;
+};
+
+// Extended position-based dynamics for joints and springs. Each step is split into substeps that integrate the bodies
+// with integrate_physics and then correct their positions and rotations once per row, moving the velocities by the
+// same corrections over the substep, so stiff joints stay stable with a fixed amount of work. Compliance gives soft
+// constraints a stiffness that does not depend on the step size or iteration count; springs map onto rows with
+// compliance 1 / stiffness.
+//
+// Rows are greedily colored so that no two rows of a color move the same body, and each color is solved on the worker
+// pool in structure-of-arrays lanes whose arithmetic vectorizes, then scattered back without write conflicts.
+// Kinematic, massless and sleeping bodies are never moved; a sleeping body joined to an awake dynamic one is woken.
+// Bodies without a shape have no inertia and are not turned by off-center anchors.
+struct XpbdSolver2 {
+    u32 substeps;
+
+    usize body_capacity;
+    f32 *inverse_masses;
+    f32 *inverse_inertias;
+    u64 *color_masks; // colors already used by rows on each body
+
+    usize row_capacity;
+    usize row_count;
+    XpbdRow2 *rows;    // grouped by color, then kind
+    XpbdRow2 *scratch; // rows in joint order, before grouping
+    u8 *row_colors;
+    f32 *lambdas; // accumulated multiplier of each row over the substep
+
+    u32 batch_starts[(XPBD_MAX_COLORS + 1) * 2 + 1]; // offsets into rows of each (color, kind) batch
+};
+
+struct XpbdSolver3 {
+    u32 substeps;
+
+    usize body_capacity;
+    f32 *inverse_masses;
+    Vec3 *inverse_moments; // inverse principal inertia in the body frame
+    f32 *inverse_inertias; // world-space inverse inertia tensors, six per body: xx, yy, zz, xy, xz, yz
+    u64 *color_masks;
+
+    usize row_capacity;
+    usize row_count;
+    XpbdRow3 *rows;
+    XpbdRow3 *scratch;
+    u8 *row_colors;
+    f32 *lambdas;
+
+    u32 batch_starts[(XPBD_MAX_COLORS + 1) * 2 + 1];
+};
+
+void init_xpbd_solver(XpbdSolver2 &solver, u32 substeps);
+void init_xpbd_solver(XpbdSolver3 &solver, u32 substeps);
+void deinit_xpbd_solver(XpbdSolver2 &solver);
+void deinit_xpbd_solver(XpbdSolver3 &solver);
+
+// Advances the bodies by dt in place of integrate_physics, enforcing the joints and springs. External forces should
+// already be in the velocities. Returns the number of colors the rows were split into.
+u32 step_xpbd(XpbdSolver2 &solver, Body2 *bodies, usize body_count, const Joint2 *joints, usize joint_count,
+              const Spring *springs, usize spring_count, float dt);
+u32 step_xpbd(XpbdSolver3 &solver, Body3 *bodies, usize body_count, const Joint3 *joints, usize joint_count,
+              const Spring *springs, usize spring_count, float dt);
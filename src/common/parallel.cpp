@@ -0,0 +1,146 @@
+#include "common/parallel.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct ParallelJob {
+    ParallelFn fn;
+    void *context;
+    usize count;
+    usize batch;
+    std::atomic<usize> next;
+    u32 busy; // workers currently inside the job, guarded by the pool mutex
+};
+
+struct ThreadPool {
+    std::thread *threads;
+    u32 thread_count;
+
+    std::mutex submit_mutex; // held by the thread that owns the pool for the duration of a job
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    ParallelJob *job;
+    u64 generation;
+    bool shutdown;
+
+    ThreadPool();
+    ~ThreadPool();
+};
+
+static thread_local bool inside_parallel_job = false;
+
+static void run_chunks(ParallelJob &job) {
+    for (;;) {
+        usize begin = job.next.fetch_add(job.batch);
+        if (begin >= job.count) {
+            return;
+        }
+
+        usize end = begin + job.batch < job.count ? begin + job.batch : job.count;
+        job.fn(begin, end, job.context);
+    }
+}
+
+static void worker_main(ThreadPool *pool) {
+    inside_parallel_job = true;
+    u64 seen_generation = 0;
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;) {
+        pool->wake.wait(lock, [&] { return pool->shutdown || (pool->job && pool->generation != seen_generation); });
+        if (pool->shutdown) {
+            return;
+        }
+
+        seen_generation = pool->generation;
+        ParallelJob *job = pool->job;
+        job->busy++;
+
+        lock.unlock();
+        run_chunks(*job);
+        lock.lock();
+
+        if (--job->busy == 0) {
+            pool->done.notify_all();
+        }
+    }
+}
+
+ThreadPool::ThreadPool() : job(nullptr), generation(0), shutdown(false) {
+    u32 hardware_threads = std::thread::hardware_concurrency();
+    thread_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    threads = thread_count ? new std::thread[thread_count] : nullptr;
+
+    for (u32 i = 0; i < thread_count; i++) {
+        threads[i] = std::thread(worker_main, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+    wake.notify_all();
+
+    for (u32 i = 0; i < thread_count; i++) {
+        threads[i].join();
+    }
+    delete[] threads;
+}
+
+static ThreadPool &get_thread_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+u32 parallel_worker_count() {
+    return get_thread_pool().thread_count + 1;
+}
+
+void parallel_for(usize count, usize batch, ParallelFn fn, void *context) {
+    if (count == 0) return;
+    if (batch == 0) batch = 1;
+
+    ThreadPool &pool = get_thread_pool();
+
+    // Single chunk, nested call or contended pool: no point waking anyone
+    if (count <= batch || pool.thread_count == 0 || inside_parallel_job || !pool.submit_mutex.try_lock()) {
+        for (usize begin = 0; begin < count; begin += batch) {
+            fn(begin, begin + batch < count ? begin + batch : count, context);
+        }
+        return;
+    }
+
+    ParallelJob job;
+    job.fn = fn;
+    job.context = context;
+    job.count = count;
+    job.batch = batch;
+    job.next.store(0);
+    job.busy = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.job = &job;
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+
+    inside_parallel_job = true;
+    run_chunks(job);
+    inside_parallel_job = false;
+
+    // Every chunk has been claimed; wait for the workers still finishing theirs, then retire the job so late wakers
+    // don't pick it up
+    {
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        pool.done.wait(lock, [&] { return job.busy == 0; });
+        pool.job = nullptr;
+    }
+
+    pool.submit_mutex.unlock();
+}
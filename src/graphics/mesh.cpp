@@ -230,12 +230,18 @@ void update_mesh_vertices(Mesh &mesh, Vertex *vertices, usize count) {
     if (count == 0 || !vertices) return;
 
     // Update local copy
+    usize previous_count = mesh.vertex_count;
     set_vertices(mesh, vertices, count);
 
-    // Update GPU buffer if already built
+    // Update GPU buffer if already built. Meshes updated every frame (e.g. soft bodies) overwrite the buffer in place
+    // while the vertex count stays the same, and otherwise reallocate it as dynamic storage.
     if (mesh.built) {
         glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, mesh.vertex_count * sizeof(Vertex), mesh.vertices, GL_STATIC_DRAW);
+        if (count == previous_count) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.vertex_count * sizeof(Vertex), mesh.vertices);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, mesh.vertex_count * sizeof(Vertex), mesh.vertices, GL_DYNAMIC_DRAW);
+        }
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 }
@@ -0,0 +1,476 @@
+#include "physics/aabb_tree.hpp"
+#include "common/parallel.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const i32 NULL_NODE = -1;
+static const usize TREE_BATCH = 1024;
+static const u32 TREE_STACK_SIZE = 256; // traversal stack kept on the call stack; deeper trees allocate one
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline bool has_shape(const Body2 &body) {
+    return body.shape.kind != ShapeKind2::None;
+}
+
+static inline bool has_shape(const Body3 &body) {
+    return body.shape.kind != ShapeKind3::None;
+}
+
+static inline Aabb2 aabb_union(const Aabb2 &a, const Aabb2 &b) {
+    return {{std::fmin(a.min.x, b.min.x), std::fmin(a.min.y, b.min.y)},
+            {std::fmax(a.max.x, b.max.x), std::fmax(a.max.y, b.max.y)}};
+}
+
+static inline Aabb3 aabb_union(const Aabb3 &a, const Aabb3 &b) {
+    return {{std::fmin(a.min.x, b.min.x), std::fmin(a.min.y, b.min.y), std::fmin(a.min.z, b.min.z)},
+            {std::fmax(a.max.x, b.max.x), std::fmax(a.max.y, b.max.y), std::fmax(a.max.z, b.max.z)}};
+}
+
+// Surface area heuristic cost: perimeter in 2D, surface area in 3D
+static inline float aabb_cost(const Aabb2 &a) {
+    Vec2 size = a.max - a.min;
+    return 2.0f * (size.x + size.y);
+}
+
+static inline float aabb_cost(const Aabb3 &a) {
+    Vec3 size = a.max - a.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static inline bool aabb_contains(const Aabb2 &outer, const Aabb2 &inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && inner.max.x <= outer.max.x &&
+           inner.max.y <= outer.max.y;
+}
+
+static inline bool aabb_contains(const Aabb3 &outer, const Aabb3 &inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+static inline Aabb2 fatten(const Aabb2 &a, float margin) {
+    return {a.min - Vec2{margin, margin}, a.max + Vec2{margin, margin}};
+}
+
+static inline Aabb3 fatten(const Aabb3 &a, float margin) {
+    return {a.min - Vec3{margin, margin, margin}, a.max + Vec3{margin, margin, margin}};
+}
+
+template <typename Tree> static i32 allocate_node(Tree &tree) {
+    if (tree.free_list == NULL_NODE) {
+        usize old_capacity = tree.node_capacity;
+        tree.node_capacity = old_capacity ? old_capacity * 2 : 64;
+        tree.nodes = (decltype(tree.nodes))realloc(tree.nodes, tree.node_capacity * sizeof(*tree.nodes));
+
+        for (usize i = old_capacity; i < tree.node_capacity; i++) {
+            tree.nodes[i].parent = i + 1 < tree.node_capacity ? (i32)(i + 1) : NULL_NODE;
+            tree.nodes[i].height = -1;
+        }
+        tree.free_list = (i32)old_capacity;
+    }
+
+    i32 index = tree.free_list;
+    auto &node = tree.nodes[index];
+    tree.free_list = node.parent;
+    node.parent = NULL_NODE;
+    node.children[0] = NULL_NODE;
+    node.children[1] = NULL_NODE;
+    node.height = 0;
+    node.body = 0;
+    return index;
+}
+
+template <typename Tree> static void free_node(Tree &tree, i32 index) {
+    tree.nodes[index].parent = tree.free_list;
+    tree.nodes[index].height = -1;
+    tree.free_list = index;
+}
+
+template <typename Tree> static void replace_child(Tree &tree, i32 parent, i32 old_child, i32 new_child) {
+    if (parent == NULL_NODE) {
+        tree.root = new_child;
+    } else if (tree.nodes[parent].children[0] == old_child) {
+        tree.nodes[parent].children[0] = new_child;
+    } else {
+        tree.nodes[parent].children[1] = new_child;
+    }
+}
+
+template <typename Tree> static void refit(Tree &tree, i32 index) {
+    auto &node = tree.nodes[index];
+    const auto &left = tree.nodes[node.children[0]];
+    const auto &right = tree.nodes[node.children[1]];
+    node.aabb = aabb_union(left.aabb, right.aabb);
+    node.height = 1 + (left.height > right.height ? left.height : right.height);
+}
+
+// Rotates the taller grandchild up when the children of `a` differ in height by more than one, returning the node
+// now at the position of `a`
+template <typename Tree> static i32 balance(Tree &tree, i32 a) {
+    auto *nodes = tree.nodes;
+    if (nodes[a].height < 2) return a;
+
+    for (u32 side = 0; side < 2; side++) {
+        i32 short_child = nodes[a].children[side];
+        i32 tall_child = nodes[a].children[1 - side];
+        if (nodes[tall_child].height - nodes[short_child].height <= 1) continue;
+
+        // Tall child takes the place of `a`, adopting `a` and its own taller child; its shorter child moves to `a`
+        i32 first = nodes[tall_child].children[0];
+        i32 second = nodes[tall_child].children[1];
+        i32 keep = nodes[first].height > nodes[second].height ? first : second;
+        i32 give = keep == first ? second : first;
+
+        nodes[tall_child].parent = nodes[a].parent;
+        replace_child(tree, nodes[a].parent, a, tall_child);
+
+        nodes[tall_child].children[0] = a;
+        nodes[tall_child].children[1] = keep;
+        nodes[a].parent = tall_child;
+
+        nodes[a].children[1 - side] = give;
+        nodes[give].parent = a;
+
+        refit(tree, a);
+        refit(tree, tall_child);
+        return tall_child;
+    }
+
+    return a;
+}
+
+template <typename Tree> static void refit_ancestors(Tree &tree, i32 index) {
+    while (index != NULL_NODE) {
+        index = balance(tree, index);
+        refit(tree, index);
+        index = tree.nodes[index].parent;
+    }
+}
+
+template <typename Tree> static void insert_leaf(Tree &tree, i32 leaf) {
+    auto *nodes = tree.nodes;
+    if (tree.root == NULL_NODE) {
+        tree.root = leaf;
+        nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Descend toward the sibling that minimizes the added surface area, stopping where pairing here is cheaper
+    auto leaf_aabb = nodes[leaf].aabb;
+    i32 index = tree.root;
+    while (nodes[index].height > 0) {
+        float area = aabb_cost(nodes[index].aabb);
+        float combined_area = aabb_cost(aabb_union(nodes[index].aabb, leaf_aabb));
+        float cost = 2.0f * combined_area;
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        float child_costs[2];
+        for (u32 c = 0; c < 2; c++) {
+            const auto &child = nodes[nodes[index].children[c]];
+            float enlarged = aabb_cost(aabb_union(leaf_aabb, child.aabb));
+            child_costs[c] = (child.height > 0 ? enlarged - aabb_cost(child.aabb) : enlarged) + inheritance_cost;
+        }
+
+        if (cost < child_costs[0] && cost < child_costs[1]) break;
+        index = nodes[index].children[child_costs[0] < child_costs[1] ? 0 : 1];
+    }
+
+    i32 sibling = index;
+    i32 old_parent = nodes[sibling].parent;
+    i32 new_parent = allocate_node(tree);
+    nodes = tree.nodes;
+
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].children[0] = sibling;
+    nodes[new_parent].children[1] = leaf;
+    replace_child(tree, old_parent, sibling, new_parent);
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    refit_ancestors(tree, new_parent);
+}
+
+template <typename Tree> static void remove_leaf(Tree &tree, i32 leaf) {
+    auto *nodes = tree.nodes;
+    if (leaf == tree.root) {
+        tree.root = NULL_NODE;
+        return;
+    }
+
+    i32 parent = nodes[leaf].parent;
+    i32 grandparent = nodes[parent].parent;
+    i32 sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+    replace_child(tree, grandparent, parent, sibling);
+    nodes[sibling].parent = grandparent;
+    free_node(tree, parent);
+
+    refit_ancestors(tree, grandparent);
+}
+
+template <typename Tree, typename Body, typename Aabb>
+static usize update_aabb_tree_impl(Tree &tree, const Body *bodies, usize body_count) {
+    // Bodies past the new count lose their leaves
+    for (usize i = body_count; i < tree.body_count; i++) {
+        if (tree.leaves[i] != NULL_NODE) {
+            remove_leaf(tree, tree.leaves[i]);
+            free_node(tree, tree.leaves[i]);
+        }
+    }
+
+    if (body_count > tree.body_capacity) {
+        tree.body_capacity = body_count;
+        tree.leaves = (i32 *)realloc(tree.leaves, body_count * sizeof(i32));
+        tree.bounds = (Aabb *)realloc(tree.bounds, body_count * sizeof(Aabb));
+        tree.escaped = (u8 *)realloc(tree.escaped, body_count * sizeof(u8));
+    }
+    for (usize i = tree.body_count; i < body_count; i++) {
+        tree.leaves[i] = NULL_NODE;
+    }
+    tree.body_count = body_count;
+
+    // Tight bounds and containment checks in parallel; the structural changes are serial
+    Aabb *bounds = tree.bounds;
+    u8 *escaped = tree.escaped;
+    const i32 *leaves = tree.leaves;
+    const auto *nodes = tree.nodes;
+    parallel_for(body_count, TREE_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            bool shaped = has_shape(bodies[i]);
+            if (shaped && bodies[i].sleeping && leaves[i] != NULL_NODE) {
+                // Sleeping bodies have not moved since their leaf was fitted
+                escaped[i] = false;
+                continue;
+            }
+
+            if (shaped) {
+                bounds[i] = compute_aabb(bodies[i].shape, bodies[i].transform);
+            }
+
+            if (leaves[i] == NULL_NODE) {
+                escaped[i] = shaped;
+            } else {
+                escaped[i] = !shaped || !aabb_contains(nodes[leaves[i]].aabb, bounds[i]);
+            }
+        }
+    });
+
+    usize moved = 0;
+    for (usize i = 0; i < body_count; i++) {
+        if (!escaped[i]) continue;
+
+        i32 leaf = tree.leaves[i];
+        if (leaf != NULL_NODE) {
+            remove_leaf(tree, leaf);
+            if (!has_shape(bodies[i])) {
+                free_node(tree, leaf);
+                tree.leaves[i] = NULL_NODE;
+                continue;
+            }
+        } else {
+            leaf = allocate_node(tree);
+            tree.leaves[i] = leaf;
+            tree.nodes[leaf].body = (u32)i;
+        }
+
+        tree.nodes[leaf].aabb = fatten(bounds[i], tree.margin);
+        insert_leaf(tree, leaf);
+        moved++;
+    }
+
+    return moved;
+}
+
+// A depth-first walk holds at most one pending sibling per level below the root, plus the node being expanded, so a
+// stack of the root's height plus one never overflows. `local` is used when that fits in TREE_STACK_SIZE.
+template <typename Tree> static i32 *traversal_stack(const Tree &tree, i32 *local) {
+    usize capacity = (usize)tree.nodes[tree.root].height + 1;
+    return capacity <= TREE_STACK_SIZE ? local : (i32 *)malloc(capacity * sizeof(i32));
+}
+
+template <typename Tree, typename Aabb>
+static void query_aabb_tree_impl(const Tree &tree, const Aabb &aabb, TreeQueryFn fn, void *context) {
+    if (tree.root == NULL_NODE) return;
+
+    i32 local[TREE_STACK_SIZE];
+    i32 *stack = traversal_stack(tree, local);
+    u32 stack_count = 0;
+    stack[stack_count++] = tree.root;
+
+    while (stack_count) {
+        const auto &node = tree.nodes[stack[--stack_count]];
+        if (!aabb_overlap(node.aabb, aabb)) continue;
+
+        if (node.height == 0) {
+            if (!fn(node.body, context)) break;
+        } else {
+            stack[stack_count++] = node.children[0];
+            stack[stack_count++] = node.children[1];
+        }
+    }
+
+    if (stack != local) free(stack);
+}
+
+// Slab test; returns the entry distance, or a negative value on a miss
+template <u32 D, typename Aabb, typename Vec>
+static float ray_enter(const Aabb &aabb, const Vec &origin, const Vec &inverse_direction, float max_distance) {
+    float enter = 0.0f;
+    float exit = max_distance;
+
+    for (u32 k = 0; k < D; k++) {
+        float near = (axis(aabb.min, k) - axis(origin, k)) * axis(inverse_direction, k);
+        float far = (axis(aabb.max, k) - axis(origin, k)) * axis(inverse_direction, k);
+        // fmin/fmax drop the NaN from a zero direction component starting on a slab boundary
+        enter = std::fmax(enter, std::fmin(near, far));
+        exit = std::fmin(exit, std::fmax(near, far));
+    }
+
+    return enter <= exit ? enter : -1.0f;
+}
+
+template <u32 D, typename Tree, typename Vec>
+static void raycast_aabb_tree_impl(const Tree &tree, Vec origin, Vec direction, float max_distance, TreeRayFn fn,
+                                   void *context) {
+    if (tree.root == NULL_NODE) return;
+
+    Vec inverse_direction = direction;
+    for (u32 k = 0; k < D; k++) {
+        (&inverse_direction.x)[k] = 1.0f / axis(direction, k);
+    }
+
+    i32 local[TREE_STACK_SIZE];
+    i32 *stack = traversal_stack(tree, local);
+    u32 stack_count = 0;
+    stack[stack_count++] = tree.root;
+
+    while (stack_count && max_distance > 0.0f) {
+        const auto &node = tree.nodes[stack[--stack_count]];
+        float enter = ray_enter<D>(node.aabb, origin, inverse_direction, max_distance);
+        if (enter < 0.0f) continue;
+
+        if (node.height == 0) {
+            max_distance = fn(node.body, enter, context);
+        } else {
+            stack[stack_count++] = node.children[0];
+            stack[stack_count++] = node.children[1];
+        }
+    }
+
+    if (stack != local) free(stack);
+}
+
+template <typename Tree> static usize find_tree_pairs_impl(Tree &tree) {
+    tree.pairs.count = 0;
+
+    usize chunk_count = parallel_chunk_count(tree.body_count, TREE_BATCH);
+    if (chunk_count > tree.buffer_count) {
+        tree.buffers = (PairBuffer *)realloc(tree.buffers, chunk_count * sizeof(PairBuffer));
+        memset(tree.buffers + tree.buffer_count, 0, (chunk_count - tree.buffer_count) * sizeof(PairBuffer));
+        tree.buffer_count = chunk_count;
+    }
+
+    const Tree &view = tree;
+    PairBuffer *buffers = tree.buffers;
+    parallel_for(tree.body_count, TREE_BATCH, [&](usize begin, usize end) {
+        PairBuffer &buffer = buffers[begin / TREE_BATCH];
+        buffer.count = 0;
+
+        for (usize i = begin; i < end; i++) {
+            i32 leaf = view.leaves[i];
+            if (leaf == NULL_NODE) continue;
+
+            query_aabb_tree(view, view.nodes[leaf].aabb, [&](u32 body) {
+                if (body > i) push_pair(buffer, (u32)i, body);
+                return true;
+            });
+        }
+    });
+
+    for (usize c = 0; c < chunk_count; c++) {
+        for (usize p = 0; p < buffers[c].count; p++) {
+            push_pair(tree.pairs, buffers[c].pairs[p].a, buffers[c].pairs[p].b);
+        }
+    }
+
+    return tree.pairs.count;
+}
+
+template <typename Tree> static void init_aabb_tree_impl(Tree &tree, float margin) {
+    tree = {};
+    tree.margin = margin;
+    tree.root = NULL_NODE;
+    tree.free_list = NULL_NODE;
+}
+
+template <typename Tree> static void deinit_aabb_tree_impl(Tree &tree) {
+    for (usize c = 0; c < tree.buffer_count; c++) {
+        free(tree.buffers[c].pairs);
+    }
+
+    free(tree.buffers);
+    free(tree.pairs.pairs);
+    free(tree.nodes);
+    free(tree.leaves);
+    free(tree.bounds);
+    free(tree.escaped);
+
+    tree = {};
+}
+
+void init_aabb_tree(AabbTree2 &tree, float margin) {
+    init_aabb_tree_impl(tree, margin);
+}
+
+void init_aabb_tree(AabbTree3 &tree, float margin) {
+    init_aabb_tree_impl(tree, margin);
+}
+
+void deinit_aabb_tree(AabbTree2 &tree) {
+    deinit_aabb_tree_impl(tree);
+}
+
+void deinit_aabb_tree(AabbTree3 &tree) {
+    deinit_aabb_tree_impl(tree);
+}
+
+usize update_aabb_tree(AabbTree2 &tree, const Body2 *bodies, usize body_count) {
+    return update_aabb_tree_impl<AabbTree2, Body2, Aabb2>(tree, bodies, body_count);
+}
+
+usize update_aabb_tree(AabbTree3 &tree, const Body3 *bodies, usize body_count) {
+    return update_aabb_tree_impl<AabbTree3, Body3, Aabb3>(tree, bodies, body_count);
+}
+
+usize find_tree_pairs(AabbTree2 &tree) {
+    return find_tree_pairs_impl(tree);
+}
+
+usize find_tree_pairs(AabbTree3 &tree) {
+    return find_tree_pairs_impl(tree);
+}
+
+void query_aabb_tree(const AabbTree2 &tree, const Aabb2 &aabb, TreeQueryFn fn, void *context) {
+    query_aabb_tree_impl(tree, aabb, fn, context);
+}
+
+void query_aabb_tree(const AabbTree3 &tree, const Aabb3 &aabb, TreeQueryFn fn, void *context) {
+    query_aabb_tree_impl(tree, aabb, fn, context);
+}
+
+void raycast_aabb_tree(const AabbTree2 &tree, Vec2 origin, Vec2 direction, float max_distance, TreeRayFn fn,
+                       void *context) {
+    raycast_aabb_tree_impl<2>(tree, origin, direction, max_distance, fn, context);
+}
+
+void raycast_aabb_tree(const AabbTree3 &tree, Vec3 origin, Vec3 direction, float max_distance, TreeRayFn fn,
+                       void *context) {
+    raycast_aabb_tree_impl<3>(tree, origin, direction, max_distance, fn, context);
+}
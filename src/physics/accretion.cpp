@@ -0,0 +1,216 @@
+#include "physics/accretion.hpp"
+#include "common/parallel.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize ACCRETION_BATCH = 4096;
+
+static inline u32 find_root(u32 *parents, u32 body) {
+    while (parents[body] != body) {
+        parents[body] = parents[parents[body]]; // path halving
+        body = parents[body];
+    }
+    return body;
+}
+
+// Read-only variant for the parallel flattening pass, where other threads are reading the same forest
+static inline u32 find_root(const u32 *parents, u32 body) {
+    while (parents[body] != body) {
+        body = parents[body];
+    }
+    return body;
+}
+
+static inline bool has_radius_shape(const Shape2 &shape) {
+    return shape.kind == ShapeKind2::Circle;
+}
+
+static inline bool has_radius_shape(const Shape3 &shape) {
+    return shape.kind == ShapeKind3::Sphere;
+}
+
+// Size that adds up when bodies merge: area in 2D, volume in 3D (both up to a constant factor)
+static inline f32 bulk(const Shape2 &shape) {
+    f32 radius = bounding_radius(shape);
+    return radius * radius;
+}
+
+static inline f32 bulk(const Shape3 &shape) {
+    f32 radius = bounding_radius(shape);
+    return radius * radius * radius;
+}
+
+static inline void set_bulk(Shape2 &shape, f32 bulk) {
+    shape.circle.radius = std::sqrt(bulk);
+}
+
+static inline void set_bulk(Shape3 &shape, f32 bulk) {
+    shape.sphere.radius = std::cbrt(bulk);
+}
+
+template <typename Accretion, typename Body> static void reserve_bodies(Accretion &accretion, usize count) {
+    if (count > accretion.body_capacity) {
+        usize capacity = count + count / 2;
+        accretion.body_capacity = capacity;
+        accretion.parents = (u32 *)realloc(accretion.parents, capacity * sizeof(u32));
+        accretion.destinations = (u32 *)realloc(accretion.destinations, capacity * sizeof(u32));
+        accretion.absorbed = (u32 *)realloc(accretion.absorbed, capacity * sizeof(u32));
+        accretion.scratch = (Body *)realloc(accretion.scratch, capacity * sizeof(Body));
+    }
+
+    usize chunks = parallel_chunk_count(count, ACCRETION_BATCH) + 1;
+    if (chunks > accretion.chunk_capacity) {
+        accretion.chunk_capacity = chunks;
+        accretion.chunk_offsets = (u32 *)realloc(accretion.chunk_offsets, chunks * sizeof(u32));
+    }
+}
+
+// Unites the groups of every overlapping pair, recording each body that stops being a root as absorbed
+template <typename Accretion, typename Body> static void group_overlaps(Accretion &accretion, const Body *bodies) {
+    u32 *parents = accretion.parents;
+    accretion.absorbed_count = 0;
+
+    for (usize p = 0; p < accretion.hash.pair_count; p++) {
+        const BroadphasePair &pair = accretion.hash.pairs[p];
+        const Body &a = bodies[pair.a], &b = bodies[pair.b];
+        f32 reach = bounding_radius(a.shape) + bounding_radius(b.shape);
+        auto offset = b.transform.position - a.transform.position;
+        if (offset.dot(offset) >= reach * reach) continue;
+
+        u32 root_a = find_root(parents, pair.a), root_b = find_root(parents, pair.b);
+        if (root_a == root_b) continue;
+
+        bool kinematic_a = bodies[root_a].kind == BodyKind::Kinematic;
+        bool kinematic_b = bodies[root_b].kind == BodyKind::Kinematic;
+        if (kinematic_a && kinematic_b) continue;
+
+        bool keep_a = kinematic_a || (!kinematic_b && root_a < root_b);
+        u32 survivor = keep_a ? root_a : root_b, merged = keep_a ? root_b : root_a;
+        parents[merged] = survivor;
+        accretion.absorbed[accretion.absorbed_count++] = merged;
+    }
+}
+
+// Folds a merged body into its survivor. Weighted means are associative, so folding a group one body at a time in any
+// order gives its total mass, momentum and center of mass.
+template <typename Body> static void absorb(Body &survivor, const Body &merged) {
+    f32 total = survivor.mass + merged.mass;
+    if (survivor.kind == BodyKind::Dynamic && total > 0.0f) {
+        f32 share = merged.mass / total;
+        survivor.transform.position += (merged.transform.position - survivor.transform.position) * share;
+        survivor.transform.velocity += (merged.transform.velocity - survivor.transform.velocity) * share;
+    }
+    if (has_radius_shape(survivor.shape)) {
+        set_bulk(survivor.shape, bulk(survivor.shape) + bulk(merged.shape));
+    }
+    survivor.mass = total;
+    wake_body(survivor);
+}
+
+template <typename Accretion, typename Body>
+static usize merge_overlapping_bodies_impl(Accretion &accretion, Body *bodies, usize body_count) {
+    reserve_bodies<Accretion, Body>(accretion, body_count);
+    u32 *parents = accretion.parents, *destinations = accretion.destinations;
+
+    find_overlapping_pairs(accretion.hash, bodies, body_count);
+    parallel_for(body_count, ACCRETION_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            parents[i] = (u32)i;
+        }
+    });
+    group_overlaps(accretion, bodies);
+    if (accretion.absorbed_count == 0) {
+        parallel_for(body_count, ACCRETION_BATCH, [&](usize begin, usize end) {
+            for (usize i = begin; i < end; i++) {
+                destinations[i] = (u32)i;
+            }
+        });
+        return body_count;
+    }
+
+    parallel_for(body_count, ACCRETION_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            destinations[i] = find_root((const u32 *)parents, (u32)i);
+        }
+    });
+
+    for (usize k = 0; k < accretion.absorbed_count; k++) {
+        u32 merged = accretion.absorbed[k];
+        absorb(bodies[destinations[merged]], bodies[merged]);
+    }
+
+    // Survivors keep their order: count them per chunk, offset the chunks, then scatter into the scratch array and
+    // record each survivor's new index in `parents`, which the forest no longer needs
+    usize chunks = parallel_chunk_count(body_count, ACCRETION_BATCH);
+    u32 *offsets = accretion.chunk_offsets;
+    parallel_for(body_count, ACCRETION_BATCH, [&](usize begin, usize end) {
+        u32 count = 0;
+        for (usize i = begin; i < end; i++) {
+            count += destinations[i] == i;
+        }
+        offsets[begin / ACCRETION_BATCH + 1] = count;
+    });
+    offsets[0] = 0;
+    for (usize c = 0; c < chunks; c++) {
+        offsets[c + 1] += offsets[c];
+    }
+
+    parallel_for(body_count, ACCRETION_BATCH, [&](usize begin, usize end) {
+        u32 next = offsets[begin / ACCRETION_BATCH];
+        for (usize i = begin; i < end; i++) {
+            if (destinations[i] != i) continue;
+            parents[i] = next;
+            accretion.scratch[next++] = bodies[i];
+        }
+    });
+
+    usize survivor_count = offsets[chunks];
+    parallel_for(body_count, ACCRETION_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            destinations[i] = parents[destinations[i]];
+            if (i < survivor_count) bodies[i] = accretion.scratch[i];
+        }
+    });
+
+    return survivor_count;
+}
+
+template <typename Accretion> static void init_accretion_impl(Accretion &accretion) {
+    accretion = {};
+    init_spatial_hash(accretion.hash);
+}
+
+template <typename Accretion> static void deinit_accretion_impl(Accretion &accretion) {
+    deinit_spatial_hash(accretion.hash);
+    free(accretion.parents);
+    free(accretion.destinations);
+    free(accretion.absorbed);
+    free(accretion.scratch);
+    free(accretion.chunk_offsets);
+
+    accretion = {};
+}
+
+void init_accretion(Accretion2 &accretion) {
+    init_accretion_impl(accretion);
+}
+
+void init_accretion(Accretion3 &accretion) {
+    init_accretion_impl(accretion);
+}
+
+void deinit_accretion(Accretion2 &accretion) {
+    deinit_accretion_impl(accretion);
+}
+
+void deinit_accretion(Accretion3 &accretion) {
+    deinit_accretion_impl(accretion);
+}
+
+usize merge_overlapping_bodies(Accretion2 &accretion, Body2 *bodies, usize body_count) {
+    return merge_overlapping_bodies_impl(accretion, bodies, body_count);
+}
+
+usize merge_overlapping_bodies(Accretion3 &accretion, Body3 *bodies, usize body_count) {
+    return merge_overlapping_bodies_impl(accretion, bodies, body_count);
+}
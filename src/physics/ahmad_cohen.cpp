@@ -0,0 +1,181 @@
+#include "physics/ahmad_cohen.hpp"
+#include <cmath>
+#include <cstdlib>
+
+template <typename Scheme, typename Vec>
+static void init_neighbor_scheme_impl(Scheme &scheme, usize body_count, float neighbor_radius, u32 regular_interval) {
+    scheme = {
+        .body_count = body_count,
+        .neighbor_radius = neighbor_radius,
+        .regular_interval = regular_interval > 0 ? regular_interval : 1,
+        .steps_since_regular = 0,
+        .primed = false,
+        .accelerations = (Vec *)calloc(body_count, sizeof(Vec)),
+        .regular = (Vec *)calloc(body_count, sizeof(Vec)),
+        .regular_rate = (Vec *)calloc(body_count, sizeof(Vec)),
+        .neighbor_offsets = (u32 *)calloc(body_count + 1, sizeof(u32)),
+        .neighbors = nullptr,
+        .neighbor_capacity = 0,
+    };
+}
+
+template <typename Scheme> static void deinit_neighbor_scheme_impl(Scheme &scheme) {
+    free(scheme.accelerations);
+    free(scheme.regular);
+    free(scheme.regular_rate);
+    free(scheme.neighbor_offsets);
+    free(scheme.neighbors);
+
+    scheme.accelerations = nullptr;
+    scheme.regular = nullptr;
+    scheme.regular_rate = nullptr;
+    scheme.neighbor_offsets = nullptr;
+    scheme.neighbors = nullptr;
+    scheme.neighbor_capacity = 0;
+    scheme.body_count = 0;
+}
+
+// Near-field acceleration of body i from its neighbor list
+template <typename Scheme, typename Body, typename Vec>
+static Vec irregular_acceleration(const Scheme &scheme, const Body *bodies, usize i) {
+    Vec acceleration = Vec::ZERO();
+    if (bodies[i].kind != BodyKind::Dynamic || bodies[i].sleeping) {
+        return acceleration;
+    }
+
+    for (u32 n = scheme.neighbor_offsets[i]; n < scheme.neighbor_offsets[i + 1]; n++) {
+        const Body &neighbor = bodies[scheme.neighbors[n]];
+
+        Vec delta_position = neighbor.transform.position - bodies[i].transform.position;
+        float distance_squared = delta_position.length_squared();
+        if (distance_squared <= 0.0f) {
+            continue;
+        }
+
+        float inverse_distance_cubed = 1.0f / (distance_squared * std::sqrt(distance_squared));
+        acceleration += delta_position * (GRAVITATIONAL_PARAMETER * neighbor.mass * inverse_distance_cubed);
+    }
+
+    return acceleration;
+}
+
+template <typename Scheme, typename Body>
+static void rebuild_neighbor_lists(Scheme &scheme, const Body *bodies, usize body_count) {
+    float radius_squared = scheme.neighbor_radius * scheme.neighbor_radius;
+    usize neighbor_count = 0;
+
+    for (usize i = 0; i < body_count; i++) {
+        scheme.neighbor_offsets[i] = (u32)neighbor_count;
+        if (bodies[i].kind != BodyKind::Dynamic || bodies[i].sleeping) {
+            continue;
+        }
+
+        for (usize j = 0; j < body_count; j++) {
+            if (i == j || bodies[j].mass <= 0.0f) {
+                continue;
+            }
+
+            float distance_squared = (bodies[j].transform.position - bodies[i].transform.position).length_squared();
+            if (distance_squared >= radius_squared) {
+                continue;
+            }
+
+            if (neighbor_count == scheme.neighbor_capacity) {
+                scheme.neighbor_capacity = scheme.neighbor_capacity ? scheme.neighbor_capacity * 2 : body_count;
+                scheme.neighbors = (u32 *)realloc(scheme.neighbors, scheme.neighbor_capacity * sizeof(u32));
+            }
+            scheme.neighbors[neighbor_count++] = (u32)j;
+        }
+    }
+
+    scheme.neighbor_offsets[body_count] = (u32)neighbor_count;
+}
+
+// Full evaluation: the total force is split with the old neighbor lists to measure how the regular part changed since
+// the last regular step, then the lists are rebuilt and the regular part is re-based on them
+template <typename Scheme, typename Body, typename Vec>
+static void regular_step(Scheme &scheme, const Body *bodies, usize body_count, float elapsed) {
+    compute_accelerations(bodies, body_count, scheme.accelerations);
+
+    if (scheme.primed && elapsed > 0.0f) {
+        for (usize i = 0; i < body_count; i++) {
+            Vec regular = scheme.accelerations[i] - irregular_acceleration<Scheme, Body, Vec>(scheme, bodies, i);
+            scheme.regular_rate[i] = (regular - scheme.regular[i]) / elapsed;
+        }
+    }
+
+    rebuild_neighbor_lists(scheme, bodies, body_count);
+
+    for (usize i = 0; i < body_count; i++) {
+        scheme.regular[i] = scheme.accelerations[i] - irregular_acceleration<Scheme, Body, Vec>(scheme, bodies, i);
+    }
+
+    scheme.steps_since_regular = 0;
+    scheme.primed = true;
+}
+
+template <typename Scheme, typename Body, typename Vec>
+static void integrate_ahmad_cohen_impl(Scheme &scheme, Body *bodies, usize body_count, float dt) {
+    if (body_count != scheme.body_count) {
+        return;
+    }
+
+    if (!scheme.primed) {
+        regular_step<Scheme, Body, Vec>(scheme, bodies, body_count, 0.0f);
+    }
+
+    // Sleeping bodies stay put; the extrapolated regular part of one that fell asleep since the last regular step is
+    // not zero, so they are skipped rather than kicked by it
+    float half_dt = 0.5f * dt;
+    for (usize i = 0; i < body_count; i++) {
+        auto &body = bodies[i];
+        if (body.sleeping) {
+            continue;
+        }
+
+        body.transform.velocity += scheme.accelerations[i] * half_dt;
+        body.transform.velocity *= (1.0f - body.dampening.linear * dt);
+        body.transform.position += body.transform.velocity * dt;
+    }
+
+    scheme.steps_since_regular++;
+    if (scheme.steps_since_regular >= scheme.regular_interval) {
+        regular_step<Scheme, Body, Vec>(scheme, bodies, body_count, scheme.steps_since_regular * dt);
+    } else {
+        float elapsed = scheme.steps_since_regular * dt;
+        for (usize i = 0; i < body_count; i++) {
+            Vec regular = scheme.regular[i] + scheme.regular_rate[i] * elapsed;
+            scheme.accelerations[i] = irregular_acceleration<Scheme, Body, Vec>(scheme, bodies, i) + regular;
+        }
+    }
+
+    for (usize i = 0; i < body_count; i++) {
+        if (!bodies[i].sleeping) {
+            bodies[i].transform.velocity += scheme.accelerations[i] * half_dt;
+        }
+    }
+}
+
+void init_neighbor_scheme(NeighborScheme2 &scheme, usize body_count, float neighbor_radius, u32 regular_interval) {
+    init_neighbor_scheme_impl<NeighborScheme2, Vec2>(scheme, body_count, neighbor_radius, regular_interval);
+}
+
+void init_neighbor_scheme(NeighborScheme3 &scheme, usize body_count, float neighbor_radius, u32 regular_interval) {
+    init_neighbor_scheme_impl<NeighborScheme3, Vec3>(scheme, body_count, neighbor_radius, regular_interval);
+}
+
+void deinit_neighbor_scheme(NeighborScheme2 &scheme) {
+    deinit_neighbor_scheme_impl(scheme);
+}
+
+void deinit_neighbor_scheme(NeighborScheme3 &scheme) {
+    deinit_neighbor_scheme_impl(scheme);
+}
+
+void integrate_ahmad_cohen(NeighborScheme2 &scheme, Body2 *bodies, usize body_count, float dt) {
+    integrate_ahmad_cohen_impl<NeighborScheme2, Body2, Vec2>(scheme, bodies, body_count, dt);
+}
+
+void integrate_ahmad_cohen(NeighborScheme3 &scheme, Body3 *bodies, usize body_count, float dt) {
+    integrate_ahmad_cohen_impl<NeighborScheme3, Body3, Vec3>(scheme, bodies, body_count, dt);
+}
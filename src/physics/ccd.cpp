@@ -0,0 +1,246 @@
+#include "physics/ccd.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static const u32 CCD_MAX_ITERATIONS = 24;
+static const f32 CCD_TOLERANCE = 1.0e-3f; // stopping distance, relative to the length of the relative motion
+static const f32 CCD_MIN_TOLERANCE = 1.0e-5f;
+static const usize CCD_BATCH = 16;
+static const usize BOUNDS_BATCH = 1024;
+static const f32 NO_IMPACT = 2.0f; // impact time of a mover that hits nothing
+
+static Shape2 as_convex(const Shape2 &shape) {
+    if (shape.kind != ShapeKind2::None) return shape;
+    Shape2 point;
+    point.kind = ShapeKind2::Circle;
+    point.circle.radius = 0.0f;
+    return point;
+}
+
+static Shape3 as_convex(const Shape3 &shape) {
+    if (shape.kind != ShapeKind3::None) return shape;
+    Shape3 point;
+    point.kind = ShapeKind3::Sphere;
+    point.sphere.radius = 0.0f;
+    return point;
+}
+
+static inline Aabb2 sweep_bounds(Aabb2 box, Vec2 shift) {
+    return {{std::fmin(box.min.x, box.min.x + shift.x), std::fmin(box.min.y, box.min.y + shift.y)},
+            {std::fmax(box.max.x, box.max.x + shift.x), std::fmax(box.max.y, box.max.y + shift.y)}};
+}
+
+static inline Aabb3 sweep_bounds(Aabb3 box, Vec3 shift) {
+    return {{std::fmin(box.min.x, box.min.x + shift.x), std::fmin(box.min.y, box.min.y + shift.y),
+             std::fmin(box.min.z, box.min.z + shift.z)},
+            {std::fmax(box.max.x, box.max.x + shift.x), std::fmax(box.max.y, box.max.y + shift.y),
+             std::fmax(box.max.z, box.max.z + shift.z)}};
+}
+
+static inline bool has_shape(const Body2 &body) {
+    return body.shape.kind != ShapeKind2::None;
+}
+
+static inline bool has_shape(const Body3 &body) {
+    return body.shape.kind != ShapeKind3::None;
+}
+
+// Advances time by the distance over the closing speed along the current normal. Under pure translation the distance
+// is convex in time, so each step lands at or before the first touch and never skips past it.
+template <typename Transform, typename Cache, typename Shape, typename Sweep, typename Query>
+static bool time_of_impact_impl(const Shape &shape_a, const Sweep &sweep_a, const Shape &shape_b, const Sweep &sweep_b,
+                                float &time, Query &contact) {
+    Shape a = as_convex(shape_a), b = as_convex(shape_b);
+    auto motion_a = sweep_a.end - sweep_a.start;
+    auto motion_b = sweep_b.end - sweep_b.start;
+    auto relative = motion_a - motion_b;
+    f32 tolerance = std::fmax(CCD_TOLERANCE * relative.length(), CCD_MIN_TOLERANCE);
+
+    Transform transform_a = {}, transform_b = {};
+    transform_a.rotation = sweep_a.rotation;
+    transform_b.rotation = sweep_b.rotation;
+    Cache cache = {};
+    f32 t = 0.0f;
+
+    for (u32 iteration = 0; iteration < CCD_MAX_ITERATIONS; iteration++) {
+        transform_a.position = sweep_a.start + motion_a * t;
+        transform_b.position = sweep_b.start + motion_b * t;
+        if (!query_convex(a, transform_a, b, transform_b, &cache, contact)) return false;
+
+        if (contact.overlapping) {
+            if (iteration == 0) return false;
+            break;
+        }
+        if (contact.distance <= tolerance) break;
+
+        f32 closing = relative.dot(contact.normal);
+        if (closing <= 0.0f) return false;
+
+        // Aim half a tolerance short of touching so the loop ends in a few steps even on curved shapes
+        t += (contact.distance - 0.5f * tolerance) / closing;
+        if (t > 1.0f) return false;
+    }
+
+    time = t;
+    return true;
+}
+
+template <typename Vec, typename CCD> static void reserve_bodies(CCD &ccd, usize body_count) {
+    if (body_count <= ccd.body_capacity) return;
+
+    ccd.body_capacity = body_count + body_count / 2;
+    ccd.start_positions = (Vec *)realloc(ccd.start_positions, ccd.body_capacity * sizeof(Vec));
+    ccd.swept = (decltype(ccd.swept))realloc(ccd.swept, ccd.body_capacity * sizeof(*ccd.swept));
+    ccd.order = (u32 *)realloc(ccd.order, ccd.body_capacity * sizeof(u32));
+    ccd.movers = (u32 *)realloc(ccd.movers, ccd.body_capacity * sizeof(u32));
+    ccd.impacts = (decltype(ccd.impacts))realloc(ccd.impacts, ccd.body_capacity * sizeof(*ccd.impacts));
+}
+
+template <typename Vec, typename CCD, typename Body>
+static void begin_continuous_step_impl(CCD &ccd, const Body *bodies, usize body_count) {
+    reserve_bodies<Vec>(ccd, body_count);
+    for (usize i = 0; i < body_count; i++) {
+        ccd.start_positions[i] = bodies[i].transform.position;
+    }
+}
+
+template <typename Vec, typename Sweep, typename Query, typename CCD, typename Body>
+static usize end_continuous_step_impl(CCD &ccd, Body *bodies, usize body_count) {
+    parallel_for(body_count, BOUNDS_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Body &body = bodies[i];
+            auto box = compute_aabb(body.shape, body.transform);
+            ccd.swept[i] = sweep_bounds(box, ccd.start_positions[i] - body.transform.position);
+        }
+    });
+
+    ccd.order_count = 0;
+    ccd.mover_count = 0;
+    f32 max_extent = 0.0f;
+    for (usize i = 0; i < body_count; i++) {
+        const Body &body = bodies[i];
+        if (has_shape(body)) {
+            ccd.order[ccd.order_count++] = (u32)i;
+            max_extent = std::fmax(max_extent, ccd.swept[i].max.x - ccd.swept[i].min.x);
+        }
+
+        f32 distance = (body.transform.position - ccd.start_positions[i]).length();
+        if (body.kind == BodyKind::Dynamic && distance > bounding_radius(body.shape)) {
+            ccd.movers[ccd.mover_count++] = (u32)i;
+        }
+    }
+
+    const auto *swept = ccd.swept;
+    std::sort(ccd.order, ccd.order + ccd.order_count, [&](u32 a, u32 b) { return swept[a].min.x < swept[b].min.x; });
+
+    // Earliest impact of every mover, reading only the state left by the integration step
+    parallel_for(ccd.mover_count, CCD_BATCH, [&](usize begin, usize end) {
+        for (usize m = begin; m < end; m++) {
+            u32 mover = ccd.movers[m];
+            const auto &box = swept[mover];
+            auto &impact = ccd.impacts[m];
+            impact.body = mover;
+            impact.time = NO_IMPACT;
+
+            // Bodies starting further left than this cannot reach the mover along x
+            f32 reach = box.min.x - max_extent;
+            const u32 *first = std::lower_bound(ccd.order, ccd.order + ccd.order_count, reach,
+                                                [&](u32 body, f32 value) { return swept[body].min.x < value; });
+
+            Sweep sweep = {ccd.start_positions[mover], bodies[mover].transform.position,
+                           bodies[mover].transform.rotation};
+            for (const u32 *k = first; k < ccd.order + ccd.order_count && swept[*k].min.x <= box.max.x; k++) {
+                u32 other = *k;
+                if (other == mover || !aabb_overlap(box, swept[other])) continue;
+
+                Sweep other_sweep = {ccd.start_positions[other], bodies[other].transform.position,
+                                     bodies[other].transform.rotation};
+                f32 time;
+                Query contact;
+                if (!time_of_impact(bodies[mover].shape, sweep, bodies[other].shape, other_sweep, time, contact)) {
+                    continue;
+                }
+
+                if (time < impact.time) {
+                    impact.other = other;
+                    impact.time = time;
+                    impact.normal = contact.normal;
+                    impact.point = (contact.point_a + contact.point_b) * 0.5f;
+                }
+            }
+        }
+    });
+
+    // Pull each hit back to where it first touched and drop the velocity it was closing with
+    ccd.impact_count = 0;
+    for (usize m = 0; m < ccd.mover_count; m++) {
+        const auto &impact = ccd.impacts[m];
+        if (impact.time == NO_IMPACT) continue;
+
+        Body &body = bodies[impact.body];
+        Vec start = ccd.start_positions[impact.body];
+        body.transform.position = start + (body.transform.position - start) * impact.time;
+
+        Vec relative = body.transform.velocity - bodies[impact.other].transform.velocity;
+        f32 closing = relative.dot(impact.normal);
+        if (closing > 0.0f) body.transform.velocity -= impact.normal * closing;
+
+        ccd.impacts[ccd.impact_count++] = impact;
+    }
+
+    return ccd.impact_count;
+}
+
+template <typename CCD> static void deinit_continuous_collision_impl(CCD &ccd) {
+    free(ccd.start_positions);
+    free(ccd.swept);
+    free(ccd.order);
+    free(ccd.movers);
+    free(ccd.impacts);
+
+    ccd = {};
+}
+
+bool time_of_impact(const Shape2 &a, const Sweep2 &sweep_a, const Shape2 &b, const Sweep2 &sweep_b, float &time,
+                    ConvexQuery2 &contact) {
+    return time_of_impact_impl<Transform2, SimplexCache2>(a, sweep_a, b, sweep_b, time, contact);
+}
+
+bool time_of_impact(const Shape3 &a, const Sweep3 &sweep_a, const Shape3 &b, const Sweep3 &sweep_b, float &time,
+                    ConvexQuery3 &contact) {
+    return time_of_impact_impl<Transform3, SimplexCache3>(a, sweep_a, b, sweep_b, time, contact);
+}
+
+void init_continuous_collision(ContinuousCollision2 &ccd) {
+    ccd = {};
+}
+
+void init_continuous_collision(ContinuousCollision3 &ccd) {
+    ccd = {};
+}
+
+void deinit_continuous_collision(ContinuousCollision2 &ccd) {
+    deinit_continuous_collision_impl(ccd);
+}
+
+void deinit_continuous_collision(ContinuousCollision3 &ccd) {
+    deinit_continuous_collision_impl(ccd);
+}
+
+void begin_continuous_step(ContinuousCollision2 &ccd, const Body2 *bodies, usize body_count) {
+    begin_continuous_step_impl<Vec2>(ccd, bodies, body_count);
+}
+
+void begin_continuous_step(ContinuousCollision3 &ccd, const Body3 *bodies, usize body_count) {
+    begin_continuous_step_impl<Vec3>(ccd, bodies, body_count);
+}
+
+usize end_continuous_step(ContinuousCollision2 &ccd, Body2 *bodies, usize body_count) {
+    return end_continuous_step_impl<Vec2, Sweep2, ConvexQuery2>(ccd, bodies, body_count);
+}
+
+usize end_continuous_step(ContinuousCollision3 &ccd, Body3 *bodies, usize body_count) {
+    return end_continuous_step_impl<Vec3, Sweep3, ConvexQuery3>(ccd, bodies, body_count);
+}
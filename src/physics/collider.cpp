@@ -0,0 +1,262 @@
+#include "physics/collider.hpp"
+#include "math/constants.hpp"
+#include <cmath>
+#include <cstdlib>
+
+void push_pair(PairBuffer &buffer, u32 a, u32 b) {
+    if (buffer.count == buffer.capacity) {
+        buffer.capacity = buffer.capacity ? buffer.capacity * 2 : 256;
+        buffer.pairs = (BroadphasePair *)realloc(buffer.pairs, buffer.capacity * sizeof(BroadphasePair));
+    }
+    buffer.pairs[buffer.count++] = a < b ? BroadphasePair{a, b} : BroadphasePair{b, a};
+}
+
+static void extend_aabb(Aabb2 &aabb, Vec2 point) {
+    aabb.min = {std::fmin(aabb.min.x, point.x), std::fmin(aabb.min.y, point.y)};
+    aabb.max = {std::fmax(aabb.max.x, point.x), std::fmax(aabb.max.y, point.y)};
+}
+
+static Aabb2 aabb_from_points(const Vec2 *vertices, usize vertex_count, const Transform2 &transform) {
+    Aabb2 aabb = {transform.position, transform.position};
+    if (vertex_count == 0) return aabb;
+
+    Vec2 first = transform.position + transform.rotation.rotate(vertices[0]);
+    aabb = {first, first};
+    for (usize i = 1; i < vertex_count; i++) {
+        extend_aabb(aabb, transform.position + transform.rotation.rotate(vertices[i]));
+    }
+    return aabb;
+}
+
+Aabb2 compute_aabb(const Shape2 &shape, const Transform2 &transform) {
+    Vec2 position = transform.position;
+    Vec2 axis_x = transform.rotation.rotate({1.0f, 0.0f});
+    Vec2 axis_y = transform.rotation.rotate({0.0f, 1.0f});
+    Vec2 extent = Vec2::ZERO();
+
+    switch (shape.kind) {
+    case ShapeKind2::None:
+        break;
+    case ShapeKind2::Triangle:
+        return aabb_from_points(shape.triangle.vertices, 3, transform);
+    case ShapeKind2::Polygon:
+        return aabb_from_points(shape.polygon.vertices, shape.polygon.vertex_count, transform);
+    case ShapeKind2::Rectangle: {
+        Vec2 h = shape.rectangle.half_size;
+        extent = {std::fabs(axis_x.x) * h.x + std::fabs(axis_y.x) * h.y,
+                  std::fabs(axis_x.y) * h.x + std::fabs(axis_y.y) * h.y};
+        break;
+    }
+    case ShapeKind2::Circle:
+        extent = {shape.circle.radius, shape.circle.radius};
+        break;
+    case ShapeKind2::Ellipse: {
+        Vec2 h = shape.ellipse.half_size;
+        extent = {std::sqrt(axis_x.x * axis_x.x * h.x * h.x + axis_y.x * axis_y.x * h.y * h.y),
+                  std::sqrt(axis_x.y * axis_x.y * h.x * h.x + axis_y.y * axis_y.y * h.y * h.y)};
+        break;
+    }
+    case ShapeKind2::Capsule: {
+        float r = shape.capsule.radius;
+        float l = shape.capsule.half_length;
+        extent = {std::fabs(axis_y.x) * l + r, std::fabs(axis_y.y) * l + r};
+        break;
+    }
+    }
+
+    return {position - extent, position + extent};
+}
+
+// Extent of a disk of radius r with unit normal n along each world axis
+static Vec3 disk_extent(Vec3 normal, float radius) {
+    return {radius * std::sqrt(std::fmax(0.0f, 1.0f - normal.x * normal.x)),
+            radius * std::sqrt(std::fmax(0.0f, 1.0f - normal.y * normal.y)),
+            radius * std::sqrt(std::fmax(0.0f, 1.0f - normal.z * normal.z))};
+}
+
+Aabb3 compute_aabb(const Shape3 &shape, const Transform3 &transform) {
+    Vec3 position = transform.position;
+    Vec3 extent = Vec3::ZERO();
+
+    switch (shape.kind) {
+    case ShapeKind3::None:
+        break;
+    case ShapeKind3::Cuboid: {
+        Vec3 h = shape.cuboid.half_size;
+        Vec3 axis_x = transform.rotation.rotate({1.0f, 0.0f, 0.0f});
+        Vec3 axis_y = transform.rotation.rotate({0.0f, 1.0f, 0.0f});
+        Vec3 axis_z = transform.rotation.rotate({0.0f, 0.0f, 1.0f});
+        extent = {
+            std::fabs(axis_x.x) * h.x + std::fabs(axis_y.x) * h.y + std::fabs(axis_z.x) * h.z,
+            std::fabs(axis_x.y) * h.x + std::fabs(axis_y.y) * h.y + std::fabs(axis_z.y) * h.z,
+            std::fabs(axis_x.z) * h.x + std::fabs(axis_y.z) * h.y + std::fabs(axis_z.z) * h.z,
+        };
+        break;
+    }
+    case ShapeKind3::Sphere:
+        extent = {shape.sphere.radius, shape.sphere.radius, shape.sphere.radius};
+        break;
+    case ShapeKind3::Cylinder: {
+        Vec3 axis = transform.rotation.rotate({0.0f, 1.0f, 0.0f});
+        Vec3 cap = disk_extent(axis, shape.cylinder.radius);
+        float h = shape.cylinder.half_height;
+        extent = {std::fabs(axis.x) * h + cap.x, std::fabs(axis.y) * h + cap.y, std::fabs(axis.z) * h + cap.z};
+        break;
+    }
+    case ShapeKind3::ConicalFrustum: {
+        // Union of the bounds of the two end caps
+        const ConicalFrustum &frustum = shape.conical_frustum;
+        Vec3 axis = transform.rotation.rotate({0.0f, 1.0f, 0.0f});
+        Vec3 top = position + axis * (0.5f * frustum.height);
+        Vec3 bottom = position - axis * (0.5f * frustum.height);
+        Vec3 top_extent = disk_extent(axis, frustum.radius_top);
+        Vec3 bottom_extent = disk_extent(axis, frustum.radius_bottom);
+
+        Vec3 low_top = top - top_extent, high_top = top + top_extent;
+        Vec3 low_bottom = bottom - bottom_extent, high_bottom = bottom + bottom_extent;
+        return {
+            {std::fmin(low_top.x, low_bottom.x), std::fmin(low_top.y, low_bottom.y),
+             std::fmin(low_top.z, low_bottom.z)},
+            {std::fmax(high_top.x, high_bottom.x), std::fmax(high_top.y, high_bottom.y),
+             std::fmax(high_top.z, high_bottom.z)},
+        };
+    }
+    }
+
+    return {position - extent, position + extent};
+}
+
+float bounding_radius(const Shape2 &shape) {
+    float radius = 0.0f;
+
+    switch (shape.kind) {
+    case ShapeKind2::None:
+        break;
+    case ShapeKind2::Triangle:
+        for (u32 i = 0; i < 3; i++) {
+            radius = std::fmax(radius, shape.triangle.vertices[i].length());
+        }
+        break;
+    case ShapeKind2::Polygon:
+        for (usize i = 0; i < shape.polygon.vertex_count; i++) {
+            radius = std::fmax(radius, shape.polygon.vertices[i].length());
+        }
+        break;
+    case ShapeKind2::Rectangle:
+        radius = shape.rectangle.half_size.length();
+        break;
+    case ShapeKind2::Circle:
+        radius = shape.circle.radius;
+        break;
+    case ShapeKind2::Ellipse:
+        radius = std::fmax(shape.ellipse.half_size.x, shape.ellipse.half_size.y);
+        break;
+    case ShapeKind2::Capsule:
+        radius = shape.capsule.half_length + shape.capsule.radius;
+        break;
+    }
+
+    return radius;
+}
+
+float bounding_radius(const Shape3 &shape) {
+    switch (shape.kind) {
+    case ShapeKind3::None:
+        return 0.0f;
+    case ShapeKind3::Cuboid:
+        return shape.cuboid.half_size.length();
+    case ShapeKind3::Sphere:
+        return shape.sphere.radius;
+    case ShapeKind3::Cylinder:
+        return std::sqrt(shape.cylinder.radius * shape.cylinder.radius +
+                         shape.cylinder.half_height * shape.cylinder.half_height);
+    case ShapeKind3::ConicalFrustum: {
+        const ConicalFrustum &frustum = shape.conical_frustum;
+        float radius = std::fmax(frustum.radius_top, frustum.radius_bottom);
+        return std::sqrt(radius * radius + 0.25f * frustum.height * frustum.height);
+    }
+    }
+
+    return 0.0f;
+}
+
+float moment_of_inertia(const Shape2 &shape, float mass) {
+    switch (shape.kind) {
+    case ShapeKind2::None:
+        return 0.0f;
+    case ShapeKind2::Triangle:
+    case ShapeKind2::Polygon: {
+        const Vec2 *vertices = shape.kind == ShapeKind2::Triangle ? shape.triangle.vertices : shape.polygon.vertices;
+        usize count = shape.kind == ShapeKind2::Triangle ? 3 : shape.polygon.vertex_count;
+
+        // Fan of triangles from the origin; the signed areas cancel out whichever way the vertices wind
+        float area = 0.0f, moment = 0.0f;
+        for (usize i = 0; i < count; i++) {
+            Vec2 p = vertices[i], q = vertices[(i + 1) % count];
+            float cross = p.perp_dot(q);
+            area += cross;
+            moment += cross * (p.dot(p) + p.dot(q) + q.dot(q));
+        }
+        return area != 0.0f ? mass * moment / (6.0f * area) : 0.0f;
+    }
+    case ShapeKind2::Rectangle:
+        return mass * shape.rectangle.half_size.length_squared() / 3.0f;
+    case ShapeKind2::Circle:
+        return 0.5f * mass * shape.circle.radius * shape.circle.radius;
+    case ShapeKind2::Ellipse:
+        return 0.25f * mass * shape.ellipse.half_size.length_squared();
+    case ShapeKind2::Capsule: {
+        // Box between the cap centers plus two half-disks, split by area
+        float r = shape.capsule.radius, l = shape.capsule.half_length;
+        float box_area = 4.0f * r * l, caps_area = PI * r * r;
+        if (box_area + caps_area <= 0.0f) return 0.0f;
+        float box_mass = mass * box_area / (box_area + caps_area), caps_mass = mass - box_mass;
+        return box_mass * (r * r + l * l) / 3.0f +
+               caps_mass * (0.5f * r * r + l * l + 8.0f * r * l / (3.0f * PI));
+    }
+    }
+
+    return 0.0f;
+}
+
+Vec3 moment_of_inertia(const Shape3 &shape, float mass) {
+    switch (shape.kind) {
+    case ShapeKind3::None:
+        return Vec3::ZERO();
+    case ShapeKind3::Cuboid: {
+        Vec3 h = shape.cuboid.half_size;
+        float x = h.x * h.x, y = h.y * h.y, z = h.z * h.z;
+        return Vec3{y + z, x + z, x + y} * (mass / 3.0f);
+    }
+    case ShapeKind3::Sphere: {
+        float moment = 0.4f * mass * shape.sphere.radius * shape.sphere.radius;
+        return {moment, moment, moment};
+    }
+    case ShapeKind3::Cylinder: {
+        float r = shape.cylinder.radius, h = shape.cylinder.half_height;
+        float across = mass * (0.25f * r * r + h * h / 3.0f);
+        return {across, 0.5f * mass * r * r, across};
+    }
+    case ShapeKind3::ConicalFrustum: {
+        // The integrands over height are polynomials of degree four, which three-point Gauss-Legendre integrates
+        // exactly
+        const ConicalFrustum &frustum = shape.conical_frustum;
+        const float nodes[3] = {-0.774596669f, 0.0f, 0.774596669f};
+        const float weights[3] = {5.0f / 9.0f, 8.0f / 9.0f, 5.0f / 9.0f};
+        float volume = 0.0f, axial = 0.0f, across = 0.0f;
+        for (u32 i = 0; i < 3; i++) {
+            float y = 0.5f * frustum.height * nodes[i];
+            float r = 0.5f * (frustum.radius_bottom + frustum.radius_top) +
+                      0.5f * (frustum.radius_top - frustum.radius_bottom) * nodes[i];
+            float r2 = r * r;
+            volume += weights[i] * r2;
+            axial += weights[i] * 0.5f * r2 * r2;
+            across += weights[i] * (0.25f * r2 * r2 + r2 * y * y);
+        }
+        if (volume <= 0.0f) return Vec3::ZERO();
+        return Vec3{across, axial, across} * (mass / volume);
+    }
+    }
+
+    return Vec3::ZERO();
+}
@@ -0,0 +1,589 @@
+#include "physics/contact_solver.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const f32 BAUMGARTE = 0.2f;             // fraction of the penetration recovered per step
+static const f32 PENETRATION_SLOP = 0.005f;    // penetration left alone so resting contacts don't jitter
+static const f32 RESTITUTION_THRESHOLD = 1.0f; // approach speed below which contacts don't bounce
+static const f32 MAX_RECOVERY_SPEED = 1.0f;    // cap on the speed used to push out deep penetrations
+static const f32 SLEEP_SPEED = 0.05f;          // speed under which a body counts as resting
+static const f32 SLEEP_ANGULAR_SPEED = 0.05f;  // and the same for its spin, in radians per second
+static const f32 TIME_TO_SLEEP = 0.5f;         // seconds an entire island must rest before it sleeps
+static const u32 NO_ISLAND = ~0u;
+static const u32 AWAKE_ISLAND = ~0u - 1;       // root of an island with an awake member, before it is numbered
+
+template <typename Body> static inline bool is_movable(const Body &body) {
+    return body.kind == BodyKind::Dynamic && body.mass > 0.0f;
+}
+
+template <typename Body> static inline f32 inverse_mass(const Body &body) {
+    return is_movable(body) ? 1.0f / body.mass : 0.0f;
+}
+
+static inline f32 angular_speed_squared(const Body2 &body) {
+    return body.transform.angular_velocity * body.transform.angular_velocity;
+}
+
+static inline f32 angular_speed_squared(const Body3 &body) {
+    return body.transform.angular_velocity.length_squared();
+}
+
+static u32 find_root(u32 *parents, u32 i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+static inline f32 dot(f32 a, f32 b) {
+    return a * b;
+}
+
+static inline f32 dot(Vec3 a, Vec3 b) {
+    return a.dot(b);
+}
+
+static inline f32 cross(Vec2 a, Vec2 b) {
+    return a.perp_dot(b);
+}
+
+static inline Vec3 cross(Vec3 a, Vec3 b) {
+    return a.cross(b);
+}
+
+// Spin the body picks up from an angular impulse; zero for bodies that cannot move or have no shape to turn
+static f32 apply_inverse_inertia(const Body2 &body, f32 impulse) {
+    f32 inertia = is_movable(body) ? moment_of_inertia(body.shape, body.mass) : 0.0f;
+    return inertia > 0.0f ? impulse / inertia : 0.0f;
+}
+
+// The inertia is diagonal in the body frame, so the impulse is taken there and the spin brought back
+static Vec3 apply_inverse_inertia(const Body3 &body, Vec3 impulse) {
+    if (!is_movable(body)) return Vec3::ZERO();
+
+    Vec3 moments = moment_of_inertia(body.shape, body.mass);
+    Vec3 local = body.transform.rotation.reverse().rotate(impulse);
+    local.x = moments.x > 0.0f ? local.x / moments.x : 0.0f;
+    local.y = moments.y > 0.0f ? local.y / moments.y : 0.0f;
+    local.z = moments.z > 0.0f ? local.z / moments.z : 0.0f;
+    return body.transform.rotation.rotate(local);
+}
+
+template <typename Row, typename Vec, typename Body>
+static void make_row(Row &row, Vec direction, const Body &a, const Body &b, Vec offset_a, Vec offset_b,
+                     f32 inverse_masses) {
+    row.direction = direction;
+    row.arm_a = cross(offset_a, direction);
+    row.arm_b = cross(offset_b, direction);
+    row.angular_a = apply_inverse_inertia(a, row.arm_a);
+    row.angular_b = apply_inverse_inertia(b, row.arm_b);
+    row.mass = 1.0f / (inverse_masses + dot(row.arm_a, row.angular_a) + dot(row.arm_b, row.angular_b));
+}
+
+template <typename Row, typename Axis, typename Body>
+static void make_tilt_row(Row &row, Axis axis, const Body &a, const Body &b) {
+    row.direction = {};
+    row.arm_a = axis;
+    row.arm_b = axis;
+    row.angular_a = apply_inverse_inertia(a, axis);
+    row.angular_b = apply_inverse_inertia(b, axis);
+    f32 inverse_inertias = dot(axis, row.angular_a) + dot(axis, row.angular_b);
+    row.mass = inverse_inertias > 0.0f ? 1.0f / inverse_inertias : 0.0f;
+}
+
+static void make_tangents(ContactConstraint2 &constraint, const Body2 &a, const Body2 &b, Vec2 offset_a,
+                          Vec2 offset_b, f32 inverse_masses) {
+    Vec2 normal = constraint.normal.direction;
+    make_row(constraint.tangent, Vec2{-normal.y, normal.x}, a, b, offset_a, offset_b, inverse_masses);
+    make_tilt_row(constraint.tilt, 1.0f, a, b);
+}
+
+static void make_tangents(ContactConstraint3 &constraint, const Body3 &a, const Body3 &b, Vec3 offset_a,
+                          Vec3 offset_b, f32 inverse_masses) {
+    Vec3 normal = constraint.normal.direction;
+    Vec3 axis = std::fabs(normal.x) < 0.57f ? Vec3{1.0f, 0.0f, 0.0f} : Vec3{0.0f, 1.0f, 0.0f};
+    Vec3 first = normal.cross(axis).normalize();
+    make_row(constraint.tangents[0], first, a, b, offset_a, offset_b, inverse_masses);
+    make_row(constraint.tangents[1], normal.cross(first), a, b, offset_a, offset_b, inverse_masses);
+    for (u32 k = 0; k < 2; k++) {
+        make_tilt_row(constraint.tilts[k], constraint.tangents[k].direction, a, b);
+    }
+    make_tilt_row(constraint.twist, normal, a, b);
+}
+
+// Friction impulses are cached as the impulse on the lower-indexed body's partner, so the cache reads the same
+// whichever way round the narrowphase reports the pair
+static void load_impulse(ContactConstraint2 &constraint, const CachedImpulse2 *cached, f32 sign) {
+    constraint.normal.impulse = cached ? cached->normal : 0.0f;
+    constraint.tangent.impulse = cached ? sign * cached->friction.dot(constraint.tangent.direction) : 0.0f;
+    constraint.tilt.impulse = cached ? sign * cached->tilt : 0.0f;
+}
+
+static void load_impulse(ContactConstraint3 &constraint, const CachedImpulse3 *cached, f32 sign) {
+    constraint.normal.impulse = cached ? cached->normal : 0.0f;
+    for (u32 k = 0; k < 2; k++) {
+        const ContactRow3 &row = constraint.tangents[k];
+        constraint.tangents[k].impulse = cached ? sign * cached->friction.dot(row.direction) : 0.0f;
+        constraint.tilts[k].impulse = cached ? sign * cached->angular.dot(row.direction) : 0.0f;
+    }
+    constraint.twist.impulse = cached ? sign * cached->angular.dot(constraint.normal.direction) : 0.0f;
+}
+
+static CachedImpulse2 store_impulse(const ContactConstraint2 &constraint, f32 sign) {
+    return {constraint.normal.impulse, constraint.tangent.direction * (sign * constraint.tangent.impulse),
+            sign * constraint.tilt.impulse};
+}
+
+static CachedImpulse3 store_impulse(const ContactConstraint3 &constraint, f32 sign) {
+    Vec3 friction = constraint.tangents[0].direction * constraint.tangents[0].impulse +
+                    constraint.tangents[1].direction * constraint.tangents[1].impulse;
+    Vec3 angular = constraint.tilts[0].arm_b * constraint.tilts[0].impulse +
+                   constraint.tilts[1].arm_b * constraint.tilts[1].impulse +
+                   constraint.twist.arm_b * constraint.twist.impulse;
+    return {constraint.normal.impulse, friction * sign, angular * sign};
+}
+
+// Speed at which the contact points separate along the row's direction
+template <typename Row, typename Body> static inline f32 row_speed(const Row &row, const Body &a, const Body &b) {
+    return row.direction.dot(b.transform.velocity - a.transform.velocity) +
+           dot(row.arm_b, b.transform.angular_velocity) - dot(row.arm_a, a.transform.angular_velocity);
+}
+
+// Pushes b along the row's direction and a against it
+template <typename Body, typename Constraint, typename Row>
+static inline void apply_row(Body *bodies, const Constraint &constraint, const Row &row, f32 impulse) {
+    if (constraint.inverse_mass_a > 0.0f) {
+        Body &a = bodies[constraint.a];
+        a.transform.velocity -= row.direction * (impulse * constraint.inverse_mass_a);
+        a.transform.angular_velocity -= row.angular_a * impulse;
+    }
+    if (constraint.inverse_mass_b > 0.0f) {
+        Body &b = bodies[constraint.b];
+        b.transform.velocity += row.direction * (impulse * constraint.inverse_mass_b);
+        b.transform.angular_velocity += row.angular_b * impulse;
+    }
+}
+
+static void warm_start(Body2 *bodies, const ContactConstraint2 &constraint) {
+    apply_row(bodies, constraint, constraint.normal, constraint.normal.impulse);
+    apply_row(bodies, constraint, constraint.tangent, constraint.tangent.impulse);
+    apply_row(bodies, constraint, constraint.tilt, constraint.tilt.impulse);
+}
+
+static void warm_start(Body3 *bodies, const ContactConstraint3 &constraint) {
+    apply_row(bodies, constraint, constraint.normal, constraint.normal.impulse);
+    for (u32 k = 0; k < 2; k++) {
+        apply_row(bodies, constraint, constraint.tangents[k], constraint.tangents[k].impulse);
+        apply_row(bodies, constraint, constraint.tilts[k], constraint.tilts[k].impulse);
+    }
+    apply_row(bodies, constraint, constraint.twist, constraint.twist.impulse);
+}
+
+template <typename Body, typename Constraint> static void solve_normal(Body *bodies, Constraint &constraint) {
+    auto &row = constraint.normal;
+    f32 speed = row_speed(row, bodies[constraint.a], bodies[constraint.b]);
+
+    f32 previous = row.impulse;
+    row.impulse = std::fmax(previous + (constraint.bounce_speed - speed) * row.mass, 0.0f);
+    apply_row(bodies, constraint, row, row.impulse - previous);
+}
+
+// Same as the normal row, on the recovery velocities, which only translate
+template <typename Vec, typename Constraint> static void solve_recovery(Vec *velocities, Constraint &constraint) {
+    const auto &normal = constraint.normal.direction;
+    f32 speed = (velocities[constraint.b] - velocities[constraint.a]).dot(normal);
+
+    f32 previous = constraint.recovery_impulse;
+    constraint.recovery_impulse =
+        std::fmax(previous + (constraint.recovery_speed - speed) * constraint.recovery_mass, 0.0f);
+
+    Vec impulse = normal * (constraint.recovery_impulse - previous);
+    if (constraint.inverse_mass_a > 0.0f) velocities[constraint.a] -= impulse * constraint.inverse_mass_a;
+    if (constraint.inverse_mass_b > 0.0f) velocities[constraint.b] += impulse * constraint.inverse_mass_b;
+}
+
+static void solve_friction(Body2 *bodies, ContactConstraint2 &constraint, f32 friction) {
+    ContactRow2 &row = constraint.tangent;
+    f32 speed = row_speed(row, bodies[constraint.a], bodies[constraint.b]);
+    f32 limit = friction * constraint.normal.impulse;
+
+    f32 previous = row.impulse;
+    row.impulse = std::fmin(std::fmax(previous - speed * row.mass, -limit), limit);
+    apply_row(bodies, constraint, row, row.impulse - previous);
+}
+
+// Both tangent directions are solved together and clamped to the friction disk rather than a square
+static void solve_friction(Body3 *bodies, ContactConstraint3 &constraint, f32 friction) {
+    f32 limit = friction * constraint.normal.impulse;
+
+    f32 previous[2], impulses[2];
+    for (u32 k = 0; k < 2; k++) {
+        const ContactRow3 &row = constraint.tangents[k];
+        previous[k] = row.impulse;
+        impulses[k] = previous[k] - row_speed(row, bodies[constraint.a], bodies[constraint.b]) * row.mass;
+    }
+
+    f32 length = std::sqrt(impulses[0] * impulses[0] + impulses[1] * impulses[1]);
+    f32 scale = length > limit ? limit / length : 1.0f;
+    for (u32 k = 0; k < 2; k++) {
+        constraint.tangents[k].impulse = impulses[k] * scale;
+        apply_row(bodies, constraint, constraint.tangents[k], constraint.tangents[k].impulse - previous[k]);
+    }
+}
+
+// A patch can hold the bodies level until all of the normal impulse sits on one of its edges
+static void solve_tilt(Body2 *bodies, ContactConstraint2 &constraint) {
+    ContactRow2 &row = constraint.tilt;
+    f32 speed = row_speed(row, bodies[constraint.a], bodies[constraint.b]);
+    f32 limit = constraint.patch_radius * constraint.normal.impulse;
+
+    f32 previous = row.impulse;
+    row.impulse = std::fmin(std::fmax(previous - speed * row.mass, -limit), limit);
+    apply_row(bodies, constraint, row, row.impulse - previous);
+}
+
+// The patch is taken as a disk, so the two tilts are clamped together like friction
+static void solve_tilt(Body3 *bodies, ContactConstraint3 &constraint) {
+    f32 limit = constraint.patch_radius * constraint.normal.impulse;
+
+    f32 previous[2], impulses[2];
+    for (u32 k = 0; k < 2; k++) {
+        const ContactRow3 &row = constraint.tilts[k];
+        previous[k] = row.impulse;
+        impulses[k] = previous[k] - row_speed(row, bodies[constraint.a], bodies[constraint.b]) * row.mass;
+    }
+
+    f32 length = std::sqrt(impulses[0] * impulses[0] + impulses[1] * impulses[1]);
+    f32 scale = length > limit ? limit / length : 1.0f;
+    for (u32 k = 0; k < 2; k++) {
+        constraint.tilts[k].impulse = impulses[k] * scale;
+        apply_row(bodies, constraint, constraint.tilts[k], constraint.tilts[k].impulse - previous[k]);
+    }
+}
+
+// Coulomb friction spread evenly over a disk gives a torque of at most 2/3 of its radius times the friction force
+static void solve_twist(Body3 *bodies, ContactConstraint3 &constraint, f32 friction) {
+    ContactRow3 &row = constraint.twist;
+    f32 speed = row_speed(row, bodies[constraint.a], bodies[constraint.b]);
+    f32 limit = (2.0f / 3.0f) * constraint.patch_radius * friction * constraint.normal.impulse;
+
+    f32 previous = row.impulse;
+    row.impulse = std::fmin(std::fmax(previous - speed * row.mass, -limit), limit);
+    apply_row(bodies, constraint, row, row.impulse - previous);
+}
+
+// In the plane there is no axis along the normal to twist about
+static void solve_twist(Body2 *, ContactConstraint2 &, f32) {
+}
+
+template <typename Solver> static void reserve_solver(Solver &solver, usize body_count, usize contact_count) {
+    if (body_count > solver.body_capacity) {
+        usize previous_capacity = solver.body_capacity;
+        solver.body_capacity = body_count + body_count / 2;
+        solver.parents = (u32 *)realloc(solver.parents, solver.body_capacity * sizeof(u32));
+        solver.island_of = (u32 *)realloc(solver.island_of, solver.body_capacity * sizeof(u32));
+        solver.island_rest_times = (f32 *)realloc(solver.island_rest_times, solver.body_capacity * sizeof(f32));
+        solver.sleep_islands = (u32 *)realloc(solver.sleep_islands, solver.body_capacity * sizeof(u32));
+        solver.island_wakes = (u8 *)realloc(solver.island_wakes, solver.body_capacity * sizeof(u8));
+        for (usize i = previous_capacity; i < solver.body_capacity; i++) {
+            solver.sleep_islands[i] = (u32)i;
+        }
+        solver.recovery_velocities = (decltype(solver.recovery_velocities))realloc(
+            solver.recovery_velocities, solver.body_capacity * sizeof(*solver.recovery_velocities));
+        memset(solver.recovery_velocities, 0, solver.body_capacity * sizeof(*solver.recovery_velocities));
+    }
+
+    // island_starts always holds at least the closing offset, even before the first contact arrives
+    if (contact_count > solver.constraint_capacity || !solver.island_starts) {
+        solver.constraint_capacity = contact_count + contact_count / 2;
+        usize capacity = solver.constraint_capacity;
+        solver.constraints = (decltype(solver.constraints))realloc(solver.constraints,
+                                                                   capacity * sizeof(*solver.constraints));
+        solver.contact_islands = (u32 *)realloc(solver.contact_islands, capacity * sizeof(u32));
+        solver.island_starts = (u32 *)realloc(solver.island_starts, (capacity + 1) * sizeof(u32));
+        solver.island_order = (u32 *)realloc(solver.island_order, capacity * sizeof(u32));
+        solver.impulses = (decltype(solver.impulses))realloc(solver.impulses, capacity * sizeof(*solver.impulses));
+        solver.previous_impulses = (decltype(solver.impulses))realloc(solver.previous_impulses,
+                                                                      capacity * sizeof(*solver.impulses));
+    }
+}
+
+// Unions the bodies every contact moves, then numbers the islands that have something awake in them in order of their
+// first contact. Sleeping bodies in those islands are woken along with the rest of the island they fell asleep in;
+// fully sleeping islands are left out.
+template <typename Solver, typename Body, typename Contact>
+static void find_islands(Solver &solver, Body *bodies, usize body_count, const Contact *contacts,
+                         usize contact_count) {
+    for (usize i = 0; i < body_count; i++) {
+        solver.parents[i] = (u32)i;
+        solver.island_of[i] = NO_ISLAND;
+    }
+
+    for (usize c = 0; c < contact_count; c++) {
+        if (!is_movable(bodies[contacts[c].a]) || !is_movable(bodies[contacts[c].b])) continue;
+
+        u32 root_a = find_root(solver.parents, contacts[c].a);
+        u32 root_b = find_root(solver.parents, contacts[c].b);
+        if (root_a < root_b) {
+            solver.parents[root_b] = root_a;
+        } else if (root_b < root_a) {
+            solver.parents[root_a] = root_b;
+        }
+    }
+
+    for (usize c = 0; c < contact_count; c++) {
+        const Body &a = bodies[contacts[c].a], &b = bodies[contacts[c].b];
+        u32 body = is_movable(a) ? contacts[c].a : is_movable(b) ? contacts[c].b : NO_ISLAND;
+        if (body != NO_ISLAND && (can_disturb(a) || can_disturb(b))) {
+            solver.island_of[find_root(solver.parents, body)] = AWAKE_ISLAND;
+        }
+    }
+
+    solver.island_count = 0;
+    for (usize c = 0; c < contact_count; c++) {
+        u32 a = contacts[c].a, b = contacts[c].b;
+        u32 body = is_movable(bodies[a]) ? a : is_movable(bodies[b]) ? b : NO_ISLAND;
+        u32 root = body == NO_ISLAND ? NO_ISLAND : find_root(solver.parents, body);
+        if (root == NO_ISLAND || solver.island_of[root] == NO_ISLAND) {
+            solver.contact_islands[c] = NO_ISLAND;
+            continue;
+        }
+
+        if (solver.island_of[root] == AWAKE_ISLAND) solver.island_of[root] = (u32)solver.island_count++;
+        solver.contact_islands[c] = solver.island_of[root];
+    }
+
+    // Contacts between sleepers are never generated, so the island a body fell asleep in is the only record of what
+    // rests on it; waking only the sleepers touched now would wake a stack one layer per step while the rest sinks
+    u32 *sleep_islands = solver.sleep_islands;
+    memset(solver.island_wakes, 0, body_count);
+    for (usize i = 0; i < body_count; i++) {
+        if (sleep_islands[i] >= body_count) sleep_islands[i] = (u32)i;
+        if (!bodies[i].sleeping || !is_movable(bodies[i])) continue;
+        if (solver.island_of[find_root(solver.parents, (u32)i)] != NO_ISLAND) solver.island_wakes[sleep_islands[i]] = 1;
+    }
+    for (usize i = 0; i < body_count; i++) {
+        if (bodies[i].sleeping && is_movable(bodies[i]) && solver.island_wakes[sleep_islands[i]]) wake_body(bodies[i]);
+    }
+}
+
+template <typename Solver, typename Body, typename Contact>
+static void build_constraints(Solver &solver, const Body *bodies, const Contact *contacts, usize contact_count,
+                              f32 dt) {
+    auto swap = solver.impulses;
+    solver.impulses = solver.previous_impulses;
+    solver.previous_impulses = swap;
+
+    // Counting sort of the contacts by island, with island_order as the write cursors
+    u32 *starts = solver.island_starts;
+    for (usize i = 0; i <= solver.island_count; i++) {
+        starts[i] = 0;
+    }
+    for (usize c = 0; c < contact_count; c++) {
+        if (solver.contact_islands[c] != NO_ISLAND) starts[solver.contact_islands[c] + 1]++;
+    }
+    for (usize i = 0; i < solver.island_count; i++) {
+        starts[i + 1] += starts[i];
+        solver.island_order[i] = starts[i];
+    }
+    solver.constraint_count = starts[solver.island_count];
+
+    for (usize c = 0; c < contact_count; c++) {
+        if (solver.contact_islands[c] == NO_ISLAND) continue;
+
+        const Contact &contact = contacts[c];
+        const Body &a = bodies[contact.a];
+        const Body &b = bodies[contact.b];
+        auto &constraint = solver.constraints[solver.island_order[solver.contact_islands[c]]++];
+
+        constraint.a = contact.a;
+        constraint.b = contact.b;
+        constraint.inverse_mass_a = inverse_mass(a);
+        constraint.inverse_mass_b = inverse_mass(b);
+        f32 inverse_masses = constraint.inverse_mass_a + constraint.inverse_mass_b;
+        constraint.recovery_mass = 1.0f / inverse_masses;
+
+        auto offset_a = contact.point - a.transform.position;
+        auto offset_b = contact.point - b.transform.position;
+        make_row(constraint.normal, contact.normal, a, b, offset_a, offset_b, inverse_masses);
+        make_tangents(constraint, a, b, offset_a, offset_b, inverse_masses);
+        constraint.patch_radius = contact.patch_radius;
+
+        f32 approach = row_speed(constraint.normal, a, b);
+        f32 bounce = approach < -RESTITUTION_THRESHOLD ? -solver.restitution * approach : 0.0f;
+        f32 recovery = BAUMGARTE / dt * std::fmax(contact.depth - PENETRATION_SLOP, 0.0f);
+        constraint.bounce_speed = bounce;
+        constraint.recovery_speed = std::fmin(recovery, MAX_RECOVERY_SPEED);
+        constraint.recovery_impulse = 0.0f;
+
+        const u32 *cached = pair_table_find(solver.impulse_table, contact.a, contact.b);
+        f32 sign = contact.a < contact.b ? 1.0f : -1.0f;
+        load_impulse(constraint, cached ? solver.previous_impulses + *cached : nullptr, sign);
+    }
+
+    for (usize i = 0; i < solver.island_count; i++) {
+        solver.island_order[i] = (u32)i;
+    }
+    std::sort(solver.island_order, solver.island_order + solver.island_count, [&](u32 x, u32 y) {
+        u32 size_x = starts[x + 1] - starts[x], size_y = starts[y + 1] - starts[y];
+        return size_x != size_y ? size_x > size_y : x < y;
+    });
+}
+
+template <typename Solver, typename Body, typename Contact>
+static usize solve_contacts_impl(Solver &solver, Body *bodies, usize body_count, const Contact *contacts,
+                                 usize contact_count, f32 dt) {
+    reserve_solver(solver, body_count, contact_count);
+    find_islands(solver, bodies, body_count, contacts, contact_count);
+    build_constraints(solver, bodies, contacts, contact_count, dt);
+
+    // Islands share no movable body, so each runs its iterations on its own worker. Recovery velocities are zero
+    // outside this loop, and those of bodies that cannot move are never written.
+    auto *recovery = solver.recovery_velocities;
+    parallel_for(solver.island_count, 1, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            u32 island = solver.island_order[i];
+            auto *first = solver.constraints + solver.island_starts[island];
+            auto *last = solver.constraints + solver.island_starts[island + 1];
+
+            for (auto *constraint = first; constraint < last; constraint++) {
+                warm_start(bodies, *constraint);
+            }
+
+            for (u32 iteration = 0; iteration < solver.iterations; iteration++) {
+                for (auto *constraint = first; constraint < last; constraint++) {
+                    solve_friction(bodies, *constraint, solver.friction);
+                    solve_tilt(bodies, *constraint);
+                    solve_twist(bodies, *constraint, solver.friction);
+                    solve_normal(bodies, *constraint);
+                    solve_recovery(recovery, *constraint);
+                }
+            }
+
+            // Each body's recovery is applied once, then cleared so a second constraint on it adds nothing
+            for (auto *constraint = first; constraint < last; constraint++) {
+                u32 ends[2] = {constraint->a, constraint->b};
+                for (u32 body : ends) {
+                    if (!is_movable(bodies[body])) continue;
+                    bodies[body].transform.position += recovery[body] * dt;
+                    recovery[body] = {};
+                }
+            }
+        }
+    });
+
+    clear_pair_table(solver.impulse_table);
+    for (usize i = 0; i < solver.constraint_count; i++) {
+        const auto &constraint = solver.constraints[i];
+        *pair_table_insert(solver.impulse_table, constraint.a, constraint.b) = (u32)i;
+        solver.impulses[i] = store_impulse(constraint, constraint.a < constraint.b ? 1.0f : -1.0f);
+    }
+
+    return solver.island_count;
+}
+
+// Bodies accumulate time while slower than SLEEP_SPEED and spinning slower than SLEEP_ANGULAR_SPEED, and an island
+// sleeps once its least rested member has been resting for TIME_TO_SLEEP. Islands are those of the last solve, and a
+// body only rests while its island has contacts: nothing else holds it up once gravity stops acting on it.
+template <typename Solver, typename Body>
+static usize update_sleep_impl(Solver &solver, Body *bodies, usize body_count, f32 dt) {
+    f32 *rested = solver.island_rest_times;
+    for (usize i = 0; i < body_count; i++) {
+        rested[i] = FLT_MAX;
+    }
+
+    for (usize i = 0; i < body_count; i++) {
+        Body &body = bodies[i];
+        if (!is_movable(body)) continue;
+
+        u32 root = find_root(solver.parents, (u32)i);
+        if (!body.sleeping) {
+            bool slow = body.transform.velocity.length_squared() < SLEEP_SPEED * SLEEP_SPEED &&
+                        angular_speed_squared(body) < SLEEP_ANGULAR_SPEED * SLEEP_ANGULAR_SPEED;
+            bool held = solver.island_of[root] != NO_ISLAND;
+            body.sleep_time = slow && held ? body.sleep_time + dt : 0.0f;
+        }
+
+        rested[root] = std::fmin(rested[root], body.sleep_time);
+    }
+
+    usize sleeping = 0;
+    for (usize i = 0; i < body_count; i++) {
+        Body &body = bodies[i];
+        if (!is_movable(body)) continue;
+
+        u32 root = find_root(solver.parents, (u32)i);
+        if (!body.sleeping && rested[root] >= TIME_TO_SLEEP) {
+            body.sleeping = true;
+            solver.sleep_islands[i] = root;
+            body.transform.velocity = {};
+            body.transform.angular_velocity = {};
+        }
+        sleeping += body.sleeping ? 1 : 0;
+    }
+
+    return sleeping;
+}
+
+template <typename Solver> static void deinit_contact_solver_impl(Solver &solver) {
+    free(solver.parents);
+    free(solver.island_of);
+    free(solver.island_rest_times);
+    free(solver.sleep_islands);
+    free(solver.island_wakes);
+    free(solver.recovery_velocities);
+    free(solver.island_starts);
+    free(solver.island_order);
+    free(solver.constraints);
+    free(solver.contact_islands);
+    free(solver.impulses);
+    free(solver.previous_impulses);
+    deinit_pair_table(solver.impulse_table);
+
+    solver = {};
+}
+
+void init_contact_solver(ContactSolver2 &solver, float restitution, float friction, u32 iterations) {
+    solver = {};
+    solver.restitution = restitution;
+    solver.friction = friction;
+    solver.iterations = iterations;
+}
+
+void init_contact_solver(ContactSolver3 &solver, float restitution, float friction, u32 iterations) {
+    solver = {};
+    solver.restitution = restitution;
+    solver.friction = friction;
+    solver.iterations = iterations;
+}
+
+void deinit_contact_solver(ContactSolver2 &solver) {
+    deinit_contact_solver_impl(solver);
+}
+
+void deinit_contact_solver(ContactSolver3 &solver) {
+    deinit_contact_solver_impl(solver);
+}
+
+usize solve_contacts(ContactSolver2 &solver, Body2 *bodies, usize body_count, const Contact2 *contacts,
+                     usize contact_count, float dt) {
+    return solve_contacts_impl(solver, bodies, body_count, contacts, contact_count, dt);
+}
+
+usize solve_contacts(ContactSolver3 &solver, Body3 *bodies, usize body_count, const Contact3 *contacts,
+                     usize contact_count, float dt) {
+    return solve_contacts_impl(solver, bodies, body_count, contacts, contact_count, dt);
+}
+
+usize update_sleep(ContactSolver2 &solver, Body2 *bodies, usize body_count, float dt) {
+    return update_sleep_impl(solver, bodies, body_count, dt);
+}
+
+usize update_sleep(ContactSolver3 &solver, Body3 *bodies, usize body_count, float dt) {
+    return update_sleep_impl(solver, bodies, body_count, dt);
+}
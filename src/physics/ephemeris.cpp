@@ -0,0 +1,244 @@
+#include "physics/ephemeris.hpp"
+#include "common/parallel.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize EPHEMERIS_LANES = 64;   // times evaluated per kernel call
+static const usize EPHEMERIS_BATCH = 1024; // times per parallel task, a multiple of EPHEMERIS_LANES
+static const usize TRACK_BATCH = 256;      // a multiple of EPHEMERIS_LANES
+static const f64 PI_F64 = 3.14159265358979323846; // PI is single precision, too coarse for the node placement
+
+static inline f32 &axis(Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+// Segment holding `time` and where in it, as tau in [-1, 1]
+static inline void locate(const EphemerisTrack &track, u32 stride, f64 time, u32 &first, f64 &tau) {
+    f64 position = (time - track.start) / track.segment_duration;
+    f64 segment = std::floor(position);
+    segment = std::fmin(std::fmax(segment, 0.0), (f64)track.segment_count - 1.0);
+    tau = std::fmin(std::fmax(2.0 * (position - segment) - 1.0, -1.0), 1.0);
+    first = track.first_coefficient + (u32)segment * stride;
+}
+
+// Sums the series of every lane with the recurrences T[n+1] = 2 tau T[n] - T[n-1] and, for the derivative,
+// T'[n+1] = 2 T[n] + 2 tau T'[n] - T'[n-1], so position and velocity come out of one pass over the coefficients
+template <u32 D>
+static void evaluate_lanes(const f64 *coefficients, u32 degree, const u32 *firsts, const f64 *taus, const f64 *rates,
+                           usize count, f64 (*positions)[EPHEMERIS_LANES], f64 (*velocities)[EPHEMERIS_LANES]) {
+    f64 previous[EPHEMERIS_LANES], current[EPHEMERIS_LANES];
+    f64 previous_slope[EPHEMERIS_LANES], current_slope[EPHEMERIS_LANES];
+    u32 terms = degree + 1;
+
+    for (u32 k = 0; k < D; k++) {
+        for (usize l = 0; l < count; l++) {
+            const f64 *c = coefficients + firsts[l] + k * terms;
+            previous[l] = 1.0, current[l] = taus[l];
+            previous_slope[l] = 0.0, current_slope[l] = 1.0;
+            positions[k][l] = c[0] + c[1] * taus[l];
+            velocities[k][l] = c[1];
+        }
+
+        for (u32 n = 2; n < terms; n++) {
+            for (usize l = 0; l < count; l++) {
+                f64 c = coefficients[firsts[l] + k * terms + n];
+                f64 next = 2.0 * taus[l] * current[l] - previous[l];
+                f64 next_slope = 2.0 * current[l] + 2.0 * taus[l] * current_slope[l] - previous_slope[l];
+                previous[l] = current[l], current[l] = next;
+                previous_slope[l] = current_slope[l], current_slope[l] = next_slope;
+                positions[k][l] += c * next;
+                velocities[k][l] += c * next_slope;
+            }
+        }
+
+        for (usize l = 0; l < count; l++) {
+            velocities[k][l] *= rates[l];
+        }
+    }
+}
+
+template <typename Ephemeris> static void init_ephemeris_impl(Ephemeris &ephemeris, u32 degree) {
+    ephemeris = {};
+    ephemeris.degree = degree > 1 ? degree : 1;
+}
+
+template <typename Ephemeris> static void deinit_ephemeris_impl(Ephemeris &ephemeris) {
+    free(ephemeris.tracks);
+    free(ephemeris.coefficients);
+
+    ephemeris = {};
+}
+
+template <u32 D, typename Ephemeris, typename Fn>
+static u32 add_ephemeris_track_impl(Ephemeris &ephemeris, u32 body, f64 start, f64 end, f64 segment_duration, Fn fn,
+                                    void *context) {
+    u32 terms = ephemeris.degree + 1, stride = D * terms;
+    f64 span = end > start ? end - start : 0.0;
+    u32 segment_count = segment_duration > 0.0 ? (u32)std::ceil(span / segment_duration) : 0;
+    if (segment_count == 0) {
+        segment_count = 1;
+        segment_duration = span > 0.0 ? span : 1.0;
+    }
+
+    if (ephemeris.track_count == ephemeris.track_capacity) {
+        ephemeris.track_capacity = ephemeris.track_capacity ? ephemeris.track_capacity * 2 : 16;
+        ephemeris.tracks =
+            (EphemerisTrack *)realloc(ephemeris.tracks, ephemeris.track_capacity * sizeof(EphemerisTrack));
+    }
+    usize needed = ephemeris.coefficient_count + (usize)segment_count * stride;
+    if (needed > ephemeris.coefficient_capacity) {
+        ephemeris.coefficient_capacity = needed + needed / 2;
+        ephemeris.coefficients = (f64 *)realloc(ephemeris.coefficients, ephemeris.coefficient_capacity * sizeof(f64));
+    }
+
+    u32 index = (u32)ephemeris.track_count++;
+    EphemerisTrack &track = ephemeris.tracks[index];
+    track = {body, start, segment_duration, (u32)ephemeris.coefficient_count, segment_count};
+    ephemeris.coefficient_count = needed;
+
+    // Interpolation at the nodes tau_j = cos(pi (j + 1/2) / terms): c_n = 2 / terms * sum_j f(tau_j) T_n(tau_j),
+    // with c_0 halved, where T_n(cos(theta)) = cos(n theta)
+    f64 *values = (f64 *)malloc(D * terms * sizeof(f64));
+    for (u32 s = 0; s < segment_count; s++) {
+        f64 segment_start = start + s * segment_duration;
+        for (u32 j = 0; j < terms; j++) {
+            f64 tau = std::cos(PI_F64 * (j + 0.5) / terms);
+            auto position = fn(segment_start + (tau + 1.0) * 0.5 * segment_duration, context);
+            for (u32 k = 0; k < D; k++) {
+                values[k * terms + j] = axis(position, k);
+            }
+        }
+
+        f64 *c = ephemeris.coefficients + track.first_coefficient + s * stride;
+        for (u32 k = 0; k < D; k++) {
+            for (u32 n = 0; n < terms; n++) {
+                f64 sum = 0.0;
+                for (u32 j = 0; j < terms; j++) {
+                    sum += values[k * terms + j] * std::cos(PI_F64 * n * (j + 0.5) / terms);
+                }
+                c[k * terms + n] = sum * (n == 0 ? 1.0 : 2.0) / terms;
+            }
+        }
+    }
+    free(values);
+
+    return index;
+}
+
+template <u32 D, typename Ephemeris, typename Vec>
+static void evaluate_ephemeris_impl(const Ephemeris &ephemeris, u32 track_index, const f64 *times, usize count,
+                                    Vec *positions, Vec *velocities) {
+    const EphemerisTrack &track = ephemeris.tracks[track_index];
+    u32 stride = D * (ephemeris.degree + 1);
+    f64 rate = 2.0 / track.segment_duration;
+
+    parallel_for(count, EPHEMERIS_BATCH, [&](usize begin, usize end) {
+        u32 firsts[EPHEMERIS_LANES];
+        f64 taus[EPHEMERIS_LANES], rates[EPHEMERIS_LANES];
+        f64 place[D][EPHEMERIS_LANES], pace[D][EPHEMERIS_LANES];
+
+        for (usize base = begin; base < end; base += EPHEMERIS_LANES) {
+            usize lanes = end - base < EPHEMERIS_LANES ? end - base : EPHEMERIS_LANES;
+            for (usize l = 0; l < lanes; l++) {
+                locate(track, stride, times[base + l], firsts[l], taus[l]);
+                rates[l] = rate;
+            }
+
+            evaluate_lanes<D>(ephemeris.coefficients, ephemeris.degree, firsts, taus, rates, lanes, place, pace);
+
+            for (usize l = 0; l < lanes; l++) {
+                for (u32 k = 0; k < D; k++) {
+                    axis(positions[base + l], k) = (f32)place[k][l];
+                    if (velocities) axis(velocities[base + l], k) = (f32)pace[k][l];
+                }
+            }
+        }
+    });
+}
+
+template <u32 D, typename Ephemeris, typename Body>
+static void update_ephemeris_bodies_impl(const Ephemeris &ephemeris, Body *bodies, f64 time) {
+    u32 stride = D * (ephemeris.degree + 1);
+
+    // One lane per track, each with its own segment length
+    parallel_for(ephemeris.track_count, TRACK_BATCH, [&](usize begin, usize end) {
+        u32 firsts[EPHEMERIS_LANES];
+        f64 taus[EPHEMERIS_LANES], rates[EPHEMERIS_LANES];
+        f64 place[D][EPHEMERIS_LANES], pace[D][EPHEMERIS_LANES];
+
+        for (usize base = begin; base < end; base += EPHEMERIS_LANES) {
+            usize lanes = end - base < EPHEMERIS_LANES ? end - base : EPHEMERIS_LANES;
+            for (usize l = 0; l < lanes; l++) {
+                const EphemerisTrack &track = ephemeris.tracks[base + l];
+                locate(track, stride, time, firsts[l], taus[l]);
+                rates[l] = 2.0 / track.segment_duration;
+            }
+
+            evaluate_lanes<D>(ephemeris.coefficients, ephemeris.degree, firsts, taus, rates, lanes, place, pace);
+
+            for (usize l = 0; l < lanes; l++) {
+                Body &body = bodies[ephemeris.tracks[base + l].body];
+                for (u32 k = 0; k < D; k++) {
+                    axis(body.transform.position, k) = (f32)place[k][l];
+                    axis(body.transform.velocity, k) = (f32)pace[k][l];
+                }
+            }
+        }
+    });
+}
+
+void init_ephemeris(Ephemeris2 &ephemeris, u32 degree) {
+    init_ephemeris_impl(ephemeris, degree);
+}
+
+void init_ephemeris(Ephemeris3 &ephemeris, u32 degree) {
+    init_ephemeris_impl(ephemeris, degree);
+}
+
+void deinit_ephemeris(Ephemeris2 &ephemeris) {
+    deinit_ephemeris_impl(ephemeris);
+}
+
+void deinit_ephemeris(Ephemeris3 &ephemeris) {
+    deinit_ephemeris_impl(ephemeris);
+}
+
+u32 add_ephemeris_track(Ephemeris2 &ephemeris, u32 body, f64 start, f64 end, f64 segment_duration, EphemerisFn2 fn,
+                        void *context) {
+    return add_ephemeris_track_impl<2>(ephemeris, body, start, end, segment_duration, fn, context);
+}
+
+u32 add_ephemeris_track(Ephemeris3 &ephemeris, u32 body, f64 start, f64 end, f64 segment_duration, EphemerisFn3 fn,
+                        void *context) {
+    return add_ephemeris_track_impl<3>(ephemeris, body, start, end, segment_duration, fn, context);
+}
+
+void evaluate_ephemeris(const Ephemeris2 &ephemeris, u32 track, const f64 *times, usize count, Vec2 *positions,
+                        Vec2 *velocities) {
+    evaluate_ephemeris_impl<2>(ephemeris, track, times, count, positions, velocities);
+}
+
+void evaluate_ephemeris(const Ephemeris3 &ephemeris, u32 track, const f64 *times, usize count, Vec3 *positions,
+                        Vec3 *velocities) {
+    evaluate_ephemeris_impl<3>(ephemeris, track, times, count, positions, velocities);
+}
+
+void update_ephemeris_bodies(const Ephemeris2 &ephemeris, Body2 *bodies, f64 time) {
+    update_ephemeris_bodies_impl<2>(ephemeris, bodies, time);
+}
+
+void update_ephemeris_bodies(const Ephemeris3 &ephemeris, Body3 *bodies, f64 time) {
+    update_ephemeris_bodies_impl<3>(ephemeris, bodies, time);
+}
@@ -0,0 +1,261 @@
+#include "physics/event_detector.hpp"
+#include "common/parallel.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const u32 DEFAULT_MAX_ITERATIONS = 64;
+static const usize WATCH_BATCH = 256; // watches per parallel task
+
+// Cubic Hermite curve through the start and end states of a body over a step of length dt, at fraction s of it
+template <typename Vec>
+static inline void hermite(Vec p0, Vec v0, Vec p1, Vec v1, f32 dt, f32 s, Vec &position, Vec &velocity) {
+    f32 s2 = s * s, s3 = s2 * s;
+    f32 h00 = 2.0f * s3 - 3.0f * s2 + 1.0f, h10 = s3 - 2.0f * s2 + s;
+    f32 h01 = -2.0f * s3 + 3.0f * s2, h11 = s3 - s2;
+    position = p0 * h00 + v0 * (h10 * dt) + p1 * h01 + v1 * (h11 * dt);
+
+    f32 d00 = 6.0f * s2 - 6.0f * s, d10 = 3.0f * s2 - 4.0f * s + 1.0f;
+    f32 d11 = 3.0f * s2 - 2.0f * s;
+    velocity = (p0 - p1) * (d00 / dt) + v0 * d10 + v1 * d11;
+}
+
+template <typename Detector, typename Body, typename Vec>
+static void interpolate_body(const Detector &detector, const Body *bodies, u32 body, f32 dt, f32 s, Vec &position,
+                             Vec &velocity) {
+    hermite(detector.start_positions[body], detector.start_velocities[body], bodies[body].transform.position,
+            bodies[body].transform.velocity, dt, s, position, velocity);
+}
+
+// The watch's function at fraction s of the step, from the bodies' Hermite paths
+template <typename Vec, typename Detector, typename Watch, typename Body>
+static f32 evaluate_watch(const Detector &detector, const Watch &watch, const Body *bodies, f32 dt, f32 s) {
+    Vec position, velocity;
+    interpolate_body(detector, bodies, watch.body, dt, s, position, velocity);
+    if (watch.other != NO_EVENT_BODY) {
+        Vec other_position, other_velocity;
+        interpolate_body(detector, bodies, watch.other, dt, s, other_position, other_velocity);
+        position = position - other_position;
+        velocity = velocity - other_velocity;
+    }
+    return watch.fn(position, velocity, watch.context);
+}
+
+template <typename Vec, typename Watch, typename Body> static f32 evaluate_end(const Watch &watch, const Body *bodies) {
+    Vec position = bodies[watch.body].transform.position, velocity = bodies[watch.body].transform.velocity;
+    if (watch.other != NO_EVENT_BODY) {
+        position = position - bodies[watch.other].transform.position;
+        velocity = velocity - bodies[watch.other].transform.velocity;
+    }
+    return watch.fn(position, velocity, watch.context);
+}
+
+static inline bool crosses(EventDirection direction, f32 before, f32 after) {
+    bool rising = before < 0.0f && after >= 0.0f;
+    bool falling = before > 0.0f && after <= 0.0f;
+    return direction == EventDirection::Rising ? rising : direction == EventDirection::Falling ? falling
+                                                                                               : rising || falling;
+}
+
+// Illinois: regula falsi on the bracket [a, b], halving the function value kept at an end that is retained twice in a
+// row so the bracket shrinks from both sides instead of stalling at one
+template <typename Vec, typename Detector, typename Watch, typename Body>
+static f32 locate_crossing(const Detector &detector, const Watch &watch, const Body *bodies, f32 dt, f32 before,
+                           f32 after) {
+    f32 a = 0.0f, b = 1.0f, fa = before, fb = after;
+    f32 tolerance = dt > 0.0f ? detector.time_tolerance / dt : 1.0f;
+    i32 retained = 0; // negative when a was kept last, positive when b was
+
+    for (u32 iteration = 0; iteration < detector.max_iterations && b - a > tolerance; iteration++) {
+        f32 c = (a * fb - b * fa) / (fb - fa);
+        c = c > a && c < b ? c : 0.5f * (a + b);
+        f32 fc = evaluate_watch<Vec>(detector, watch, bodies, dt, c);
+        if (fc == 0.0f) return c;
+
+        if ((fc < 0.0f) == (fa < 0.0f)) {
+            a = c, fa = fc;
+            if (retained > 0) fb *= 0.5f;
+            retained = retained > 0 ? retained + 1 : 1;
+        } else {
+            b = c, fb = fc;
+            if (retained < 0) fa *= 0.5f;
+            retained = retained < 0 ? retained - 1 : -1;
+        }
+    }
+    return b;
+}
+
+template <typename Detector> static void init_event_detector_impl(Detector &detector, f32 time_tolerance) {
+    detector = {};
+    detector.time_tolerance = time_tolerance;
+    detector.max_iterations = DEFAULT_MAX_ITERATIONS;
+}
+
+template <typename Detector> static void deinit_event_detector_impl(Detector &detector) {
+    free(detector.watches);
+    free(detector.times);
+    free(detector.start_positions);
+    free(detector.start_velocities);
+
+    detector = {};
+}
+
+template <typename Detector, typename Watch, typename Fn>
+static u32 add_event_watch_impl(Detector &detector, u32 body, u32 other, Fn fn, const void *context,
+                                EventDirection direction) {
+    if (detector.watch_count == detector.watch_capacity) {
+        detector.watch_capacity = detector.watch_capacity ? detector.watch_capacity * 2 : 16;
+        detector.watches = (Watch *)realloc(detector.watches, detector.watch_capacity * sizeof(Watch));
+        detector.times = (f32 *)realloc(detector.times, detector.watch_capacity * sizeof(f32));
+    }
+
+    u32 index = (u32)detector.watch_count++;
+    Watch &watch = detector.watches[index];
+    watch = {};
+    watch.body = body;
+    watch.other = other;
+    watch.fn = fn;
+    watch.context = context;
+    watch.direction = direction;
+    return index;
+}
+
+template <typename Vec, typename Detector, typename Body>
+static void begin_event_step_impl(Detector &detector, const Body *bodies, usize body_count) {
+    if (body_count > detector.body_capacity) {
+        detector.body_capacity = body_count;
+        detector.start_positions = (Vec *)realloc(detector.start_positions, body_count * sizeof(Vec));
+        detector.start_velocities = (Vec *)realloc(detector.start_velocities, body_count * sizeof(Vec));
+    }
+
+    for (usize i = 0; i < body_count; i++) {
+        detector.start_positions[i] = bodies[i].transform.position;
+        detector.start_velocities[i] = bodies[i].transform.velocity;
+    }
+}
+
+template <typename Vec, typename Detector, typename Body, typename Event>
+static usize detect_events_impl(Detector &detector, const Body *bodies, usize body_count, f32 dt, Event *events,
+                                usize capacity) {
+    // Each watch is tested at the end state, its start value carried over from the previous step, and only the ones
+    // that changed sign in the wanted direction pay for the root search
+    parallel_for(detector.watch_count, WATCH_BATCH, [&](usize begin, usize end) {
+        for (usize w = begin; w < end; w++) {
+            auto &watch = detector.watches[w];
+            detector.times[w] = -1.0f;
+            if (watch.body >= body_count || (watch.other != NO_EVENT_BODY && watch.other >= body_count)) continue;
+
+            f32 before = watch.primed ? watch.value : evaluate_watch<Vec>(detector, watch, bodies, dt, 0.0f);
+            f32 after = evaluate_end<Vec>(watch, bodies);
+            watch.primed = true;
+            watch.value = after;
+
+            if (crosses(watch.direction, before, after)) {
+                detector.times[w] = locate_crossing<Vec>(detector, watch, bodies, dt, before, after);
+            }
+        }
+    });
+
+    // Insert the events found in time order, dropping the latest when they overflow; there are few per step
+    usize count = 0;
+    for (usize w = 0; w < detector.watch_count; w++) {
+        f32 s = detector.times[w];
+        if (s < 0.0f) continue;
+
+        usize slot = count++;
+        if (slot >= capacity) {
+            if (capacity == 0 || events[capacity - 1].time <= s * dt) continue;
+            slot = capacity - 1;
+        }
+
+        Event event;
+        event.watch = (u32)w;
+        event.time = s * dt;
+        interpolate_body(detector, bodies, detector.watches[w].body, dt, s, event.position, event.velocity);
+        while (slot > 0 && events[slot - 1].time > event.time) {
+            events[slot] = events[slot - 1];
+            slot--;
+        }
+        events[slot] = event;
+    }
+    return count;
+}
+
+void init_event_detector(EventDetector2 &detector, float time_tolerance) {
+    init_event_detector_impl(detector, time_tolerance);
+}
+
+void init_event_detector(EventDetector3 &detector, float time_tolerance) {
+    init_event_detector_impl(detector, time_tolerance);
+}
+
+void deinit_event_detector(EventDetector2 &detector) {
+    deinit_event_detector_impl(detector);
+}
+
+void deinit_event_detector(EventDetector3 &detector) {
+    deinit_event_detector_impl(detector);
+}
+
+u32 add_event_watch(EventDetector2 &detector, u32 body, u32 other, EventFn2 fn, const void *context,
+                    EventDirection direction) {
+    return add_event_watch_impl<EventDetector2, EventWatch2>(detector, body, other, fn, context, direction);
+}
+
+u32 add_event_watch(EventDetector3 &detector, u32 body, u32 other, EventFn3 fn, const void *context,
+                    EventDirection direction) {
+    return add_event_watch_impl<EventDetector3, EventWatch3>(detector, body, other, fn, context, direction);
+}
+
+void clear_event_watches(EventDetector2 &detector) {
+    detector.watch_count = 0;
+}
+
+void clear_event_watches(EventDetector3 &detector) {
+    detector.watch_count = 0;
+}
+
+void begin_event_step(EventDetector2 &detector, const Body2 *bodies, usize body_count) {
+    begin_event_step_impl<Vec2>(detector, bodies, body_count);
+}
+
+void begin_event_step(EventDetector3 &detector, const Body3 *bodies, usize body_count) {
+    begin_event_step_impl<Vec3>(detector, bodies, body_count);
+}
+
+usize detect_events(EventDetector2 &detector, const Body2 *bodies, usize body_count, float dt, Event2 *events,
+                    usize capacity) {
+    return detect_events_impl<Vec2>(detector, bodies, body_count, dt, events, capacity);
+}
+
+usize detect_events(EventDetector3 &detector, const Body3 *bodies, usize body_count, float dt, Event3 *events,
+                    usize capacity) {
+    return detect_events_impl<Vec3>(detector, bodies, body_count, dt, events, capacity);
+}
+
+float closest_approach_event(Vec2 relative_position, Vec2 relative_velocity, const void *) {
+    f32 distance = relative_position.length();
+    return distance > 0.0f ? relative_position.dot(relative_velocity) / distance : 0.0f;
+}
+
+float closest_approach_event(Vec3 relative_position, Vec3 relative_velocity, const void *) {
+    f32 distance = relative_position.length();
+    return distance > 0.0f ? relative_position.dot(relative_velocity) / distance : 0.0f;
+}
+
+float sphere_event(Vec2 relative_position, Vec2, const void *context) {
+    return relative_position.length() - *(const f32 *)context;
+}
+
+float sphere_event(Vec3 relative_position, Vec3, const void *context) {
+    return relative_position.length() - *(const f32 *)context;
+}
+
+float plane_event(Vec2 relative_position, Vec2, const void *context) {
+    const EventPlane2 &plane = *(const EventPlane2 *)context;
+    return plane.normal.dot(relative_position) - plane.offset;
+}
+
+float plane_event(Vec3 relative_position, Vec3, const void *context) {
+    const EventPlane3 &plane = *(const EventPlane3 *)context;
+    return plane.normal.dot(relative_position) - plane.offset;
+}
@@ -0,0 +1,342 @@
+#include "physics/field_cache.hpp"
+#include "common/parallel.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const usize ROW_BATCH = 8;
+static const usize RECEIVER_BATCH = 1024;
+static const u32 MAX_LEVELS = 24;
+static const u32 NEAR_NODES = 4;        // nodes on each side of a source that are flagged for the direct sum
+static const f32 MONOPOLE_SPREADS = 8.0f; // source spreads from the center of mass past which the monopole is used
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+template <u32 D> static inline usize level_size(u32 resolution) {
+    usize size = 1;
+    for (u32 k = 0; k < D; k++) {
+        size *= resolution;
+    }
+    return size;
+}
+
+// Half the side of a level, and the spacing of its nodes
+template <typename Cache> static inline f32 level_extent(const Cache &cache, u32 level) {
+    return cache.extent / (f32)(1u << (cache.level_count - 1 - level));
+}
+
+template <typename Cache> static inline f32 node_spacing(const Cache &cache, u32 level) {
+    return 2.0f * level_extent(cache, level) / (f32)(cache.resolution - 1);
+}
+
+// Direct sum over the sources, as in compute_accelerations
+template <u32 D, typename Cache, typename Vec> static Vec direct_field(const Cache &cache, Vec point) {
+    Vec acceleration = Vec::ZERO();
+    for (usize s = 0; s < cache.source_count; s++) {
+        Vec delta = cache.source_positions[s] - point;
+        f32 distance_squared = delta.length_squared();
+        if (distance_squared <= 0.0f) continue;
+        acceleration += delta * (GRAVITATIONAL_PARAMETER * cache.source_masses[s] /
+                                 (distance_squared * std::sqrt(distance_squared)));
+    }
+    return acceleration;
+}
+
+// Returns true when the sources are the same as in the last build; otherwise takes the new ones
+template <u32 D, typename Vec, typename Cache, typename Body>
+static bool same_sources(Cache &cache, const Body *bodies, usize body_count) {
+    usize count = 0;
+    bool same = true;
+    for (usize i = 0; i < body_count; i++) {
+        const Body &body = bodies[i];
+        if (body.kind != BodyKind::Kinematic || body.mass <= 0.0f) continue;
+
+        same = same && count < cache.source_count && cache.source_masses[count] == body.mass;
+        for (u32 k = 0; same && k < D; k++) {
+            same = axis(cache.source_positions[count], k) == axis(body.transform.position, k);
+        }
+        count++;
+    }
+    if (same && count == cache.source_count) return true;
+
+    if (count > cache.source_capacity) {
+        cache.source_capacity = count;
+        cache.source_positions = (Vec *)realloc(cache.source_positions, count * sizeof(Vec));
+        cache.source_masses = (f32 *)realloc(cache.source_masses, count * sizeof(f32));
+    }
+    cache.source_count = 0;
+    for (usize i = 0; i < body_count; i++) {
+        const Body &body = bodies[i];
+        if (body.kind != BodyKind::Kinematic || body.mass <= 0.0f) continue;
+        cache.source_positions[cache.source_count] = body.transform.position;
+        cache.source_masses[cache.source_count++] = body.mass;
+    }
+    return false;
+}
+
+// Centers the levels on the sources' bounds and sums every source at every node. Each row of nodes takes the sources
+// one at a time across the whole row, so the inner loop runs over plain arrays and vectorizes; the row is then
+// interleaved into the field, where a sample's corners share cache lines.
+template <u32 D, typename Vec, typename Cache> static void build_levels(Cache &cache) {
+    Vec low = cache.source_positions[0], high = low, weighted = Vec::ZERO();
+    cache.total_mass = 0.0f;
+    for (usize s = 0; s < cache.source_count; s++) {
+        for (u32 k = 0; k < D; k++) {
+            axis(low, k) = std::fmin(axis(low, k), axis(cache.source_positions[s], k));
+            axis(high, k) = std::fmax(axis(high, k), axis(cache.source_positions[s], k));
+        }
+        weighted += cache.source_positions[s] * cache.source_masses[s];
+        cache.total_mass += cache.source_masses[s];
+    }
+    cache.center = (low + high) * 0.5f;
+    cache.center_of_mass = weighted * (1.0f / cache.total_mass);
+    cache.source_spread = 0.0f;
+    for (usize s = 0; s < cache.source_count; s++) {
+        f32 distance = (cache.source_positions[s] - cache.center_of_mass).length();
+        cache.source_spread = std::fmax(cache.source_spread, distance);
+    }
+
+    u32 resolution = cache.resolution;
+    usize per_level = level_size<D>(resolution), rows = per_level / resolution;
+    memset(cache.near, 0, per_level * cache.level_count);
+
+    for (u32 level = 0; level < cache.level_count; level++) {
+        f32 spacing = node_spacing(cache, level), corner[D];
+        for (u32 k = 0; k < D; k++) {
+            corner[k] = axis(cache.center, k) - level_extent(cache, level);
+        }
+        usize offset = level * per_level;
+
+        parallel_for(rows, ROW_BATCH, [&](usize begin, usize end) {
+            f32 *rows_scratch = (f32 *)malloc(D * resolution * sizeof(f32));
+            for (usize row = begin; row < end; row++) {
+                f32 *out[D];
+                f32 fixed[D];
+                f32 *field = cache.fields + (offset + row * resolution) * D;
+                usize rest = row;
+                for (u32 k = 1; k < D; k++) {
+                    fixed[k] = corner[k] + (f32)(rest % resolution) * spacing;
+                    rest /= resolution;
+                }
+                for (u32 k = 0; k < D; k++) {
+                    out[k] = rows_scratch + k * resolution;
+                    memset(out[k], 0, resolution * sizeof(f32));
+                }
+
+                for (usize s = 0; s < cache.source_count; s++) {
+                    f32 source[D], fixed_squared = 0.0f;
+                    f32 strength = GRAVITATIONAL_PARAMETER * cache.source_masses[s];
+                    for (u32 k = 0; k < D; k++) {
+                        source[k] = axis(cache.source_positions[s], k);
+                    }
+                    for (u32 k = 1; k < D; k++) {
+                        fixed_squared += (source[k] - fixed[k]) * (source[k] - fixed[k]);
+                    }
+
+                    for (u32 i = 0; i < resolution; i++) {
+                        f32 dx = source[0] - (corner[0] + (f32)i * spacing);
+                        f32 distance_squared = dx * dx + fixed_squared;
+                        bool apart = distance_squared > 0.0f;
+                        f32 scale = apart ? strength / (distance_squared * std::sqrt(distance_squared)) : 0.0f;
+                        out[0][i] += dx * scale;
+                        for (u32 k = 1; k < D; k++) {
+                            out[k][i] += (source[k] - fixed[k]) * scale;
+                        }
+                    }
+                }
+
+                for (u32 i = 0; i < resolution; i++) {
+                    for (u32 k = 0; k < D; k++) {
+                        field[i * D + k] = out[k][i];
+                    }
+                }
+            }
+            free(rows_scratch);
+        });
+
+        // Flag the nodes around each source inside this level
+        for (usize s = 0; s < cache.source_count; s++) {
+            i32 low_node[D], high_node[D];
+            bool inside = true;
+            for (u32 k = 0; k < D; k++) {
+                f32 node = (axis(cache.source_positions[s], k) - corner[k]) / spacing;
+                low_node[k] = (i32)std::floor(node) - (i32)NEAR_NODES + 1;
+                high_node[k] = (i32)std::floor(node) + (i32)NEAR_NODES;
+                low_node[k] = low_node[k] > 0 ? low_node[k] : 0;
+                high_node[k] = high_node[k] < (i32)resolution - 1 ? high_node[k] : (i32)resolution - 1;
+                inside = inside && low_node[k] <= high_node[k];
+            }
+            if (!inside) continue;
+
+            usize span = 1;
+            for (u32 k = 0; k < D; k++) {
+                span *= (usize)(high_node[k] - low_node[k] + 1);
+            }
+            for (usize n = 0; n < span; n++) {
+                usize rest = n, index = 0, stride = 1;
+                for (u32 k = 0; k < D; k++) {
+                    u32 width = (u32)(high_node[k] - low_node[k] + 1);
+                    index += (usize)(low_node[k] + (i32)(rest % width)) * stride;
+                    rest /= width;
+                    stride *= resolution;
+                }
+                cache.near[offset + index] = 1;
+            }
+        }
+    }
+}
+
+template <u32 D, typename Cache, typename Vec> static Vec sample_field_cache_impl(const Cache &cache, Vec point) {
+    if (cache.source_count == 0) return Vec::ZERO();
+
+    // Finest level whose interior holds the point, leaving a node of room for the interpolation
+    f32 reach = 0.0f;
+    for (u32 k = 0; k < D; k++) {
+        reach = std::fmax(reach, std::fabs(axis(point, k) - axis(cache.center, k)));
+    }
+    u32 level = 0;
+    f32 extent = level_extent(cache, 0), spacing = node_spacing(cache, 0);
+    while (level < cache.level_count && reach >= extent - spacing) {
+        level++, extent *= 2.0f, spacing *= 2.0f;
+    }
+    if (level == cache.level_count) {
+        // The monopole is only good far from every source; the quadrupole error falls off as the spread over the
+        // distance squared
+        Vec delta = cache.center_of_mass - point;
+        f32 distance_squared = delta.length_squared();
+        f32 monopole_reach = MONOPOLE_SPREADS * cache.source_spread;
+        if (distance_squared <= monopole_reach * monopole_reach) return direct_field<D>(cache, point);
+        return delta * (GRAVITATIONAL_PARAMETER * cache.total_mass / (distance_squared * std::sqrt(distance_squared)));
+    }
+
+    u32 resolution = cache.resolution;
+    f32 inverse_spacing = 1.0f / spacing, t[D];
+    usize base = level * level_size<D>(resolution), stride = 1, strides[D];
+    for (u32 k = 0; k < D; k++) {
+        // The point is inside the level, so truncation floors the node coordinate without a call into libm
+        f32 node = (axis(point, k) - axis(cache.center, k) + extent) * inverse_spacing;
+        u32 cell = (u32)(i32)node;
+        t[k] = node - (f32)cell;
+        base += cell * stride;
+        strides[k] = stride;
+        stride *= resolution;
+    }
+    if (cache.near[base]) return direct_field<D>(cache, point);
+
+    // Gather the corners, then interpolate one axis at a time, halving them each time
+    f32 values[1u << D][D];
+    for (u32 corner = 0; corner < (1u << D); corner++) {
+        usize index = base;
+        for (u32 k = 0; k < D; k++) {
+            index += (corner >> k) & 1 ? strides[k] : 0;
+        }
+        for (u32 k = 0; k < D; k++) {
+            values[corner][k] = cache.fields[index * D + k];
+        }
+    }
+    for (u32 k = 0; k < D; k++) {
+        for (u32 c = 0; c < (1u << (D - 1 - k)); c++) {
+            for (u32 j = 0; j < D; j++) {
+                values[c][j] = values[2 * c][j] + t[k] * (values[2 * c + 1][j] - values[2 * c][j]);
+            }
+        }
+    }
+
+    Vec sum;
+    for (u32 k = 0; k < D; k++) {
+        axis(sum, k) = values[0][k];
+    }
+    return sum;
+}
+
+template <u32 D, typename Cache>
+static void init_field_cache_impl(Cache &cache, u32 resolution, u32 level_count, f32 extent) {
+    cache = {};
+    cache.resolution = resolution > 2 ? resolution : 2;
+    cache.level_count = level_count < 1 ? 1 : level_count > MAX_LEVELS ? MAX_LEVELS : level_count;
+    cache.extent = extent;
+
+    usize count = level_size<D>(cache.resolution) * cache.level_count;
+    cache.fields = (f32 *)malloc(count * D * sizeof(f32));
+    cache.near = (u8 *)malloc(count * sizeof(u8));
+}
+
+template <u32 D, typename Cache> static void deinit_field_cache_impl(Cache &cache) {
+    free(cache.fields);
+    free(cache.near);
+    free(cache.source_positions);
+    free(cache.source_masses);
+
+    cache = {};
+}
+
+template <u32 D, typename Vec, typename Cache, typename Body>
+static bool update_field_cache_impl(Cache &cache, const Body *bodies, usize body_count) {
+    if (same_sources<D, Vec>(cache, bodies, body_count)) return false;
+    if (cache.source_count > 0) build_levels<D, Vec>(cache);
+    return true;
+}
+
+template <u32 D, typename Cache, typename Body, typename Vec>
+static void add_cached_field_impl(const Cache &cache, const Body *bodies, usize body_count, Vec *accelerations) {
+    parallel_for(body_count, RECEIVER_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            if (bodies[i].kind != BodyKind::Dynamic || bodies[i].sleeping) continue;
+            accelerations[i] += sample_field_cache_impl<D>(cache, bodies[i].transform.position);
+        }
+    });
+}
+
+void init_field_cache(FieldCache2 &cache, u32 resolution, u32 level_count, float extent) {
+    init_field_cache_impl<2>(cache, resolution, level_count, extent);
+}
+
+void init_field_cache(FieldCache3 &cache, u32 resolution, u32 level_count, float extent) {
+    init_field_cache_impl<3>(cache, resolution, level_count, extent);
+}
+
+void deinit_field_cache(FieldCache2 &cache) {
+    deinit_field_cache_impl<2>(cache);
+}
+
+void deinit_field_cache(FieldCache3 &cache) {
+    deinit_field_cache_impl<3>(cache);
+}
+
+bool update_field_cache(FieldCache2 &cache, const Body2 *bodies, usize body_count) {
+    return update_field_cache_impl<2, Vec2>(cache, bodies, body_count);
+}
+
+bool update_field_cache(FieldCache3 &cache, const Body3 *bodies, usize body_count) {
+    return update_field_cache_impl<3, Vec3>(cache, bodies, body_count);
+}
+
+Vec2 sample_field_cache(const FieldCache2 &cache, Vec2 point) {
+    return sample_field_cache_impl<2>(cache, point);
+}
+
+Vec3 sample_field_cache(const FieldCache3 &cache, Vec3 point) {
+    return sample_field_cache_impl<3>(cache, point);
+}
+
+void add_cached_field(const FieldCache2 &cache, const Body2 *bodies, usize body_count, Vec2 *accelerations) {
+    add_cached_field_impl<2>(cache, bodies, body_count, accelerations);
+}
+
+void add_cached_field(const FieldCache3 &cache, const Body3 *bodies, usize body_count, Vec3 *accelerations) {
+    add_cached_field_impl<3>(cache, bodies, body_count, accelerations);
+}
@@ -0,0 +1,516 @@
+#include "physics/fluid_grid.hpp"
+#include "common/parallel.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize ROW_BATCH = 16;
+static const usize TRACER_BATCH = 1024;
+static const u32 DEFAULT_PRESSURE_ITERATIONS = 40;
+static const f32 MIN_CURL_GRADIENT = 1.0e-20f; // below this confinement has no direction to push in
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+// Index arithmetic over the padded arrays: cell (x, y, z) sits at x * stride[0] + y * stride[1] + z * stride[2],
+// where the interior runs from 1 to size along each axis
+template <u32 D> struct GridShape {
+    u32 size[D];
+    usize stride[D];
+    usize count; // cells including the boundary ring
+    usize rows;  // interior rows along axis 0
+};
+
+template <u32 D, typename Grid> static GridShape<D> grid_shape(const Grid &grid) {
+    GridShape<D> shape;
+    usize stride = 1;
+    shape.rows = 1;
+    for (u32 k = 0; k < D; k++) {
+        shape.size[k] = grid.size[k];
+        shape.stride[k] = stride;
+        stride *= grid.size[k] + 2;
+        if (k > 0) shape.rows *= grid.size[k];
+    }
+    shape.count = stride;
+    return shape;
+}
+
+// Index of the first interior cell of an interior row, and the sum of its coordinates for the red-black coloring
+template <u32 D> static usize row_start(const GridShape<D> &shape, usize row, u32 &parity) {
+    usize index = shape.stride[0];
+    parity = 1;
+    for (u32 k = 1; k < D; k++) {
+        usize coordinate = row % shape.size[k] + 1;
+        row /= shape.size[k];
+        index += coordinate * shape.stride[k];
+        parity += (u32)coordinate;
+    }
+    return index;
+}
+
+// Copies the outermost interior layer onto the boundary ring, negated for the velocity component that points into
+// the wall. Going axis by axis also fills the edges and corners, from values already copied along earlier axes.
+template <u32 D> static void set_boundary(const GridShape<D> &shape, f32 *field, i32 normal_axis) {
+    for (u32 k = 0; k < D; k++) {
+        usize stride = shape.stride[k], span = stride * (shape.size[k] + 2);
+        usize last = (usize)(shape.size[k] + 1) * stride;
+        f32 sign = (i32)k == normal_axis ? -1.0f : 1.0f;
+
+        for (usize block = 0; block < shape.count; block += span) {
+            for (usize j = 0; j < stride; j++) {
+                usize low = block + j, high = low + last;
+                field[low] = sign * field[low + stride];
+                field[high] = sign * field[high - stride];
+            }
+        }
+    }
+}
+
+// Corner and weights of the multilinear interpolation at a point in index space, where cell i's center is at i
+template <u32 D> struct Stencil {
+    usize base;
+    f32 t[D];
+};
+
+template <u32 D> static inline Stencil<D> make_stencil(const GridShape<D> &shape, const f32 *point) {
+    Stencil<D> stencil;
+    stencil.base = 0;
+    for (u32 k = 0; k < D; k++) {
+        f32 c = std::fmin(std::fmax(point[k], 0.5f), (f32)shape.size[k] + 0.5f);
+        f32 cell = std::floor(c);
+        stencil.t[k] = c - cell;
+        stencil.base += (usize)cell * shape.stride[k];
+    }
+    return stencil;
+}
+
+template <u32 D> static inline f32 sample(const GridShape<D> &shape, const Stencil<D> &stencil, const f32 *field) {
+    f32 sum = 0.0f;
+    for (u32 corner = 0; corner < (1u << D); corner++) {
+        f32 weight = 1.0f;
+        usize index = stencil.base;
+        for (u32 k = 0; k < D; k++) {
+            bool high = (corner >> k) & 1;
+            weight *= high ? stencil.t[k] : 1.0f - stencil.t[k];
+            index += high ? shape.stride[k] : 0;
+        }
+        sum += weight * field[index];
+    }
+    return sum;
+}
+
+// Point in index space of a world position
+template <u32 D, typename Grid, typename Vec>
+static inline void grid_point(const Grid &grid, Vec position, f32 *point) {
+    f32 inverse = 1.0f / grid.cell_size;
+    for (u32 k = 0; k < D; k++) {
+        point[k] = (axis(position, k) - axis(grid.origin, k)) * inverse + 0.5f;
+    }
+}
+
+static void allocate_fields(f32 **fields, usize field_count, usize count) {
+    for (usize f = 0; f < field_count; f++) {
+        fields[f] = (f32 *)calloc(count, sizeof(f32));
+    }
+}
+
+template <u32 D, typename Grid, typename Vec>
+static void init_fluid_grid_impl(Grid &grid, const u32 *size, f32 cell_size, Vec origin) {
+    grid = {};
+    for (u32 k = 0; k < D; k++) {
+        grid.size[k] = size[k];
+    }
+    grid.cell_size = cell_size;
+    grid.origin = origin;
+    grid.pressure_iterations = DEFAULT_PRESSURE_ITERATIONS;
+
+    usize count = grid_shape<D>(grid).count;
+    allocate_fields(grid.velocities, D, count);
+    allocate_fields(grid.velocity_scratch, D, count);
+    allocate_fields(&grid.densities, 1, count);
+    allocate_fields(&grid.density_scratch, 1, count);
+    allocate_fields(&grid.pressures, 1, count);
+    allocate_fields(&grid.divergences, 1, count);
+}
+
+template <u32 D, typename Grid> static void deinit_fluid_grid_impl(Grid &grid) {
+    for (u32 k = 0; k < D; k++) {
+        free(grid.velocities[k]);
+        free(grid.velocity_scratch[k]);
+    }
+    free(grid.densities);
+    free(grid.density_scratch);
+    free(grid.pressures);
+    free(grid.divergences);
+
+    grid = {};
+}
+
+template <u32 D, typename Grid, typename Vec>
+static void add_fluid_source_impl(Grid &grid, Vec position, f32 radius, Vec velocity, f32 density) {
+    GridShape<D> shape = grid_shape<D>(grid);
+    f32 center[D];
+    grid_point<D>(grid, position, center);
+    f32 reach = radius / grid.cell_size;
+    if (reach <= 0.0f) return;
+
+    // Interior cells inside the ball's bounding box
+    u32 low[D], high[D];
+    usize cells = 1;
+    for (u32 k = 0; k < D; k++) {
+        f32 first = std::fmax(std::ceil(center[k] - reach), 1.0f);
+        f32 last = std::fmin(std::floor(center[k] + reach), (f32)shape.size[k]);
+        if (first > last) return;
+        low[k] = (u32)first, high[k] = (u32)last;
+        cells *= high[k] - low[k] + 1;
+    }
+
+    for (usize c = 0; c < cells; c++) {
+        usize rest = c, index = 0;
+        f32 distance2 = 0.0f;
+        for (u32 k = 0; k < D; k++) {
+            u32 span = high[k] - low[k] + 1;
+            u32 coordinate = low[k] + (u32)(rest % span);
+            rest /= span;
+            index += coordinate * shape.stride[k];
+            f32 d = (f32)coordinate - center[k];
+            distance2 += d * d;
+        }
+
+        f32 weight = 1.0f - std::sqrt(distance2) / reach;
+        if (weight <= 0.0f) continue;
+        grid.densities[index] += density * weight;
+        for (u32 k = 0; k < D; k++) {
+            grid.velocities[k][index] += (axis(velocity, k) - grid.velocities[k][index]) * weight;
+        }
+    }
+}
+
+// Semi-Lagrangian: each cell takes the value found by tracing its center back along the velocity for dt
+template <u32 D>
+static void advect(const GridShape<D> &shape, f32 *const *velocities, const f32 *const *sources, f32 *const *targets,
+                   u32 field_count, f32 scale, f32 keep) {
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            usize start = row_start(shape, row, parity);
+            f32 point[D];
+            for (u32 k = 1; k < D; k++) {
+                point[k] = (f32)((start / shape.stride[k]) % (shape.size[k] + 2));
+            }
+
+            for (u32 x = 0; x < shape.size[0]; x++) {
+                usize i = start + x;
+                f32 back[D];
+                point[0] = (f32)(x + 1);
+                for (u32 k = 0; k < D; k++) {
+                    back[k] = point[k] - scale * velocities[k][i];
+                }
+
+                Stencil<D> stencil = make_stencil(shape, back);
+                for (u32 f = 0; f < field_count; f++) {
+                    targets[f][i] = sample(shape, stencil, sources[f]) * keep;
+                }
+            }
+        }
+    });
+}
+
+// Divergence of the velocity and the Poisson solve for the pressure that cancels it, in units where subtracting the
+// pressure's gradient leaves the velocity divergence-free
+template <u32 D, typename Grid> static void project(Grid &grid, const GridShape<D> &shape) {
+    f32 h = grid.cell_size, half = 0.5f / h;
+    f32 *pressures = grid.pressures, *divergences = grid.divergences;
+
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            f32 *divergence = divergences + row_start(shape, row, parity);
+            for (u32 k = 0; k < D; k++) {
+                const f32 *velocity = grid.velocities[k] + (divergence - divergences);
+                usize stride = shape.stride[k];
+                for (u32 x = 0; x < shape.size[0]; x++) {
+                    f32 term = (velocity[x + stride] - velocity[x - stride]) * half;
+                    divergence[x] = k == 0 ? term : divergence[x] + term;
+                }
+            }
+        }
+    });
+
+    // Red-black Gauss-Seidel: cells of one color only read cells of the other, so each half sweep is free of write
+    // conflicts and its cells can update in any order
+    f32 h2 = h * h, share = 1.0f / (2.0f * D);
+    for (u32 iteration = 0; iteration < grid.pressure_iterations; iteration++) {
+        for (u32 color = 0; color < 2; color++) {
+            parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+                for (usize row = begin; row < end; row++) {
+                    u32 parity;
+                    usize start = row_start(shape, row, parity);
+                    usize first = start + ((parity + color) & 1), last = start + shape.size[0];
+                    for (usize i = first; i < last; i += 2) {
+                        f32 sum = -h2 * divergences[i];
+                        for (u32 k = 0; k < D; k++) {
+                            sum += pressures[i - shape.stride[k]] + pressures[i + shape.stride[k]];
+                        }
+                        pressures[i] = sum * share;
+                    }
+                }
+            });
+        }
+        set_boundary(shape, pressures, -1);
+    }
+
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            usize start = row_start(shape, row, parity);
+            const f32 *pressure = pressures + start;
+            for (u32 k = 0; k < D; k++) {
+                f32 *velocity = grid.velocities[k] + start;
+                usize stride = shape.stride[k];
+                for (u32 x = 0; x < shape.size[0]; x++) {
+                    velocity[x] -= (pressure[x + stride] - pressure[x - stride]) * half;
+                }
+            }
+        }
+    });
+
+    for (u32 k = 0; k < D; k++) {
+        set_boundary(shape, grid.velocities[k], (i32)k);
+    }
+}
+
+// Curl of the velocity at the interior cells, written to the velocity scratch arrays (one in 2D, three in 3D)
+static void compute_curl(const FluidGrid2 &grid, const GridShape<2> &shape) {
+    f32 half = 0.5f / grid.cell_size;
+    usize sx = shape.stride[0], sy = shape.stride[1];
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            usize start = row_start(shape, row, parity);
+            const f32 *u = grid.velocities[0] + start, *v = grid.velocities[1] + start;
+            f32 *curl = grid.velocity_scratch[0] + start;
+            for (u32 x = 0; x < shape.size[0]; x++) {
+                curl[x] = (v[x + sx] - v[x - sx] - u[x + sy] + u[x - sy]) * half;
+            }
+        }
+    });
+    set_boundary(shape, grid.velocity_scratch[0], -1);
+}
+
+static void compute_curl(const FluidGrid3 &grid, const GridShape<3> &shape) {
+    f32 half = 0.5f / grid.cell_size;
+    usize sx = shape.stride[0], sy = shape.stride[1], sz = shape.stride[2];
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            usize start = row_start(shape, row, parity);
+            const f32 *u = grid.velocities[0] + start, *v = grid.velocities[1] + start;
+            const f32 *w = grid.velocities[2] + start;
+            f32 *cx = grid.velocity_scratch[0] + start, *cy = grid.velocity_scratch[1] + start;
+            f32 *cz = grid.velocity_scratch[2] + start;
+            for (u32 x = 0; x < shape.size[0]; x++) {
+                cx[x] = (w[x + sy] - w[x - sy] - v[x + sz] + v[x - sz]) * half;
+                cy[x] = (u[x + sz] - u[x - sz] - w[x + sx] + w[x - sx]) * half;
+                cz[x] = (v[x + sx] - v[x - sx] - u[x + sy] + u[x - sy]) * half;
+            }
+        }
+    });
+    for (u32 k = 0; k < 3; k++) {
+        set_boundary(shape, grid.velocity_scratch[k], -1);
+    }
+}
+
+// Pushes along N x curl, where N points up the gradient of the curl's magnitude, toward the vortex centers
+static void confine_vorticity(FluidGrid2 &grid, const GridShape<2> &shape, f32 dt) {
+    compute_curl(grid, shape);
+    f32 half = 0.5f / grid.cell_size, strength = grid.vorticity * grid.cell_size * dt;
+    usize sx = shape.stride[0], sy = shape.stride[1];
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            usize start = row_start(shape, row, parity);
+            const f32 *curl = grid.velocity_scratch[0] + start;
+            f32 *u = grid.velocities[0] + start, *v = grid.velocities[1] + start;
+            for (u32 x = 0; x < shape.size[0]; x++) {
+                f32 gx = (std::fabs(curl[x + sx]) - std::fabs(curl[x - sx])) * half;
+                f32 gy = (std::fabs(curl[x + sy]) - std::fabs(curl[x - sy])) * half;
+                f32 scale = strength / std::sqrt(gx * gx + gy * gy + MIN_CURL_GRADIENT);
+                u[x] += gy * curl[x] * scale;
+                v[x] -= gx * curl[x] * scale;
+            }
+        }
+    });
+}
+
+static void confine_vorticity(FluidGrid3 &grid, const GridShape<3> &shape, f32 dt) {
+    compute_curl(grid, shape);
+    f32 half = 0.5f / grid.cell_size, strength = grid.vorticity * grid.cell_size * dt;
+    parallel_for(shape.rows, ROW_BATCH, [&](usize begin, usize end) {
+        for (usize row = begin; row < end; row++) {
+            u32 parity;
+            usize start = row_start(shape, row, parity);
+            const f32 *cx = grid.velocity_scratch[0] + start, *cy = grid.velocity_scratch[1] + start;
+            const f32 *cz = grid.velocity_scratch[2] + start;
+            f32 *u = grid.velocities[0] + start, *v = grid.velocities[1] + start, *w = grid.velocities[2] + start;
+            for (u32 x = 0; x < shape.size[0]; x++) {
+                f32 g[3];
+                for (u32 k = 0; k < 3; k++) {
+                    usize s = shape.stride[k];
+                    f32 above = std::sqrt(cx[x + s] * cx[x + s] + cy[x + s] * cy[x + s] + cz[x + s] * cz[x + s]);
+                    f32 below = std::sqrt(cx[x - s] * cx[x - s] + cy[x - s] * cy[x - s] + cz[x - s] * cz[x - s]);
+                    g[k] = (above - below) * half;
+                }
+                f32 scale = strength / std::sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2] + MIN_CURL_GRADIENT);
+                u[x] += (g[1] * cz[x] - g[2] * cy[x]) * scale;
+                v[x] += (g[2] * cx[x] - g[0] * cz[x]) * scale;
+                w[x] += (g[0] * cy[x] - g[1] * cx[x]) * scale;
+            }
+        }
+    });
+}
+
+template <u32 D, typename Grid> static void step_fluid_grid_impl(Grid &grid, f32 dt) {
+    GridShape<D> shape = grid_shape<D>(grid);
+    f32 scale = dt / grid.cell_size;
+
+    // Velocity carries itself, read from the current arrays and written to the scratch ones
+    advect(shape, grid.velocities, grid.velocities, grid.velocity_scratch, D, scale, 1.0f);
+    for (u32 k = 0; k < D; k++) {
+        f32 *swap = grid.velocities[k];
+        grid.velocities[k] = grid.velocity_scratch[k];
+        grid.velocity_scratch[k] = swap;
+        set_boundary(shape, grid.velocities[k], (i32)k);
+    }
+
+    if (grid.vorticity > 0.0f) {
+        confine_vorticity(grid, shape, dt);
+        for (u32 k = 0; k < D; k++) {
+            set_boundary(shape, grid.velocities[k], (i32)k);
+        }
+    }
+
+    project(grid, shape);
+
+    f32 keep = std::fmax(1.0f - grid.density_decay * dt, 0.0f);
+    advect(shape, grid.velocities, &grid.densities, &grid.density_scratch, 1, scale, keep);
+    f32 *swap = grid.densities;
+    grid.densities = grid.density_scratch;
+    grid.density_scratch = swap;
+    set_boundary(shape, grid.densities, -1);
+}
+
+template <u32 D, typename Grid, typename Vec> static Vec sample_fluid_velocity_impl(const Grid &grid, Vec position) {
+    GridShape<D> shape = grid_shape<D>(grid);
+    f32 point[D];
+    grid_point<D>(grid, position, point);
+    Stencil<D> stencil = make_stencil(shape, point);
+
+    Vec velocity;
+    for (u32 k = 0; k < D; k++) {
+        axis(velocity, k) = sample(shape, stencil, grid.velocities[k]);
+    }
+    return velocity;
+}
+
+template <typename Body> static inline bool is_moving_body(const Body &body) {
+    return body.kind == BodyKind::Dynamic && !body.sleeping;
+}
+
+template <u32 D, typename Grid, typename Body>
+static void advect_fluid_tracers_impl(const Grid &grid, Body *bodies, usize body_count, f32 dt) {
+    parallel_for(body_count, TRACER_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            Body &body = bodies[i];
+            if (!is_moving_body(body) || body.mass > 0.0f) continue;
+
+            auto &position = body.transform.position;
+            auto start = sample_fluid_velocity_impl<D>(grid, position);
+            body.transform.velocity = sample_fluid_velocity_impl<D>(grid, position + start * (0.5f * dt));
+        }
+    });
+}
+
+template <u32 D, typename Grid, typename Body>
+static void apply_fluid_drag_impl(const Grid &grid, Body *bodies, usize body_count, f32 drag, f32 dt) {
+    f32 blend = std::fmin(drag * dt, 1.0f); // never past the flow's velocity
+    parallel_for(body_count, TRACER_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            Body &body = bodies[i];
+            if (!is_moving_body(body) || body.mass <= 0.0f) continue;
+
+            auto flow = sample_fluid_velocity_impl<D>(grid, body.transform.position);
+            body.transform.velocity += (flow - body.transform.velocity) * blend;
+        }
+    });
+}
+
+void init_fluid_grid(FluidGrid2 &grid, u32 width, u32 height, float cell_size, Vec2 origin) {
+    u32 size[2] = {width, height};
+    init_fluid_grid_impl<2>(grid, size, cell_size, origin);
+}
+
+void init_fluid_grid(FluidGrid3 &grid, u32 width, u32 height, u32 depth, float cell_size, Vec3 origin) {
+    u32 size[3] = {width, height, depth};
+    init_fluid_grid_impl<3>(grid, size, cell_size, origin);
+}
+
+void deinit_fluid_grid(FluidGrid2 &grid) {
+    deinit_fluid_grid_impl<2>(grid);
+}
+
+void deinit_fluid_grid(FluidGrid3 &grid) {
+    deinit_fluid_grid_impl<3>(grid);
+}
+
+void add_fluid_source(FluidGrid2 &grid, Vec2 position, float radius, Vec2 velocity, float density) {
+    add_fluid_source_impl<2>(grid, position, radius, velocity, density);
+}
+
+void add_fluid_source(FluidGrid3 &grid, Vec3 position, float radius, Vec3 velocity, float density) {
+    add_fluid_source_impl<3>(grid, position, radius, velocity, density);
+}
+
+void step_fluid_grid(FluidGrid2 &grid, float dt) {
+    step_fluid_grid_impl<2>(grid, dt);
+}
+
+void step_fluid_grid(FluidGrid3 &grid, float dt) {
+    step_fluid_grid_impl<3>(grid, dt);
+}
+
+Vec2 sample_fluid_velocity(const FluidGrid2 &grid, Vec2 position) {
+    return sample_fluid_velocity_impl<2>(grid, position);
+}
+
+Vec3 sample_fluid_velocity(const FluidGrid3 &grid, Vec3 position) {
+    return sample_fluid_velocity_impl<3>(grid, position);
+}
+
+void advect_fluid_tracers(const FluidGrid2 &grid, Body2 *bodies, usize body_count, float dt) {
+    advect_fluid_tracers_impl<2>(grid, bodies, body_count, dt);
+}
+
+void advect_fluid_tracers(const FluidGrid3 &grid, Body3 *bodies, usize body_count, float dt) {
+    advect_fluid_tracers_impl<3>(grid, bodies, body_count, dt);
+}
+
+void apply_fluid_drag(const FluidGrid2 &grid, Body2 *bodies, usize body_count, float drag, float dt) {
+    apply_fluid_drag_impl<2>(grid, bodies, body_count, drag, dt);
+}
+
+void apply_fluid_drag(const FluidGrid3 &grid, Body3 *bodies, usize body_count, float drag, float dt) {
+    apply_fluid_drag_impl<3>(grid, bodies, body_count, drag, dt);
+}
@@ -0,0 +1,796 @@
+#include "physics/gjk.hpp"
+#include "math/constants.hpp"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static const u32 GJK_MAX_ITERATIONS = 32;
+static const f32 GJK_TOLERANCE = 1.0e-5f; // relative progress below which GJK has converged
+static const f32 GJK_CONTACT_DISTANCE = 1.0e-5f;
+static const u32 EPA_MAX_ITERATIONS = 48;
+static const u32 EPA_MAX_VERTICES = 64;
+static const u32 EPA_MAX_FACES = 128;
+static const u32 EPA_MAX_EDGES = 96;
+static const f32 EPA_TOLERANCE = 1.0e-4f;
+static const f32 DEGENERATE = 1.0e-12f;
+static const f32 PATCH_TILT = 0.01f; // faces within about this many radians of the normal count as touching flat
+
+// Local-frame support functions, one type per shape so each pairing gets its own GJK instantiation
+
+struct CircleSupport {
+    f32 radius;
+
+    Vec2 operator()(Vec2 direction) const {
+        f32 length = direction.length();
+        return length > EPSILON ? direction * (radius / length) : Vec2{radius, 0.0f};
+    }
+};
+
+struct RectangleSupport {
+    Vec2 half_size;
+
+    Vec2 operator()(Vec2 direction) const {
+        return {direction.x < 0.0f ? -half_size.x : half_size.x, direction.y < 0.0f ? -half_size.y : half_size.y};
+    }
+};
+
+struct EllipseSupport {
+    Vec2 half_size;
+
+    Vec2 operator()(Vec2 direction) const {
+        Vec2 scaled = {half_size.x * direction.x, half_size.y * direction.y};
+        f32 length = scaled.length();
+        return length > EPSILON ? Vec2{half_size.x * scaled.x / length, half_size.y * scaled.y / length}
+                                : Vec2{half_size.x, 0.0f};
+    }
+};
+
+struct CapsuleSupport {
+    f32 radius;
+    f32 half_length;
+
+    Vec2 operator()(Vec2 direction) const {
+        Vec2 cap = CircleSupport{radius}(direction);
+        return {cap.x, cap.y + (direction.y < 0.0f ? -half_length : half_length)};
+    }
+};
+
+struct PolygonSupport {
+    const Vec2 *vertices;
+    usize vertex_count;
+
+    Vec2 operator()(Vec2 direction) const {
+        usize best = 0;
+        f32 best_dot = vertices[0].dot(direction);
+        for (usize i = 1; i < vertex_count; i++) {
+            f32 dot = vertices[i].dot(direction);
+            if (dot > best_dot) {
+                best = i;
+                best_dot = dot;
+            }
+        }
+        return vertices[best];
+    }
+};
+
+struct SphereSupport {
+    f32 radius;
+
+    Vec3 operator()(Vec3 direction) const {
+        f32 length = direction.length();
+        return length > EPSILON ? direction * (radius / length) : Vec3{radius, 0.0f, 0.0f};
+    }
+};
+
+struct CuboidSupport {
+    Vec3 half_size;
+
+    Vec3 operator()(Vec3 direction) const {
+        return {direction.x < 0.0f ? -half_size.x : half_size.x, direction.y < 0.0f ? -half_size.y : half_size.y,
+                direction.z < 0.0f ? -half_size.z : half_size.z};
+    }
+};
+
+// Furthest point of a disk of the given radius in the xz plane at height y
+static inline Vec3 disk_support(Vec3 direction, f32 radius, f32 y) {
+    f32 radial = std::sqrt(direction.x * direction.x + direction.z * direction.z);
+    if (radial <= EPSILON) return {0.0f, y, 0.0f};
+    return {direction.x * (radius / radial), y, direction.z * (radius / radial)};
+}
+
+struct CylinderSupport {
+    f32 radius;
+    f32 half_height;
+
+    Vec3 operator()(Vec3 direction) const {
+        return disk_support(direction, radius, direction.y < 0.0f ? -half_height : half_height);
+    }
+};
+
+struct FrustumSupport {
+    f32 radius_top;
+    f32 radius_bottom;
+    f32 half_height;
+
+    Vec3 operator()(Vec3 direction) const {
+        Vec3 top = disk_support(direction, radius_top, half_height);
+        Vec3 bottom = disk_support(direction, radius_bottom, -half_height);
+        return top.dot(direction) >= bottom.dot(direction) ? top : bottom;
+    }
+};
+
+// Vertex of the Minkowski difference A - B, with the shape points it came from
+template <typename Vec> struct SupportPoint {
+    Vec w;
+    Vec a, b;
+    Vec local_a, local_b;
+};
+
+template <typename Vec, u32 N> struct Simplex {
+    u32 count;
+    SupportPoint<Vec> points[N];
+    f32 weights[N];
+};
+
+template <typename Vec, typename Transform>
+static void place(SupportPoint<Vec> &point, const Transform &transform_a, const Transform &transform_b) {
+    point.a = transform_a.position + transform_a.rotation.rotate(point.local_a);
+    point.b = transform_b.position + transform_b.rotation.rotate(point.local_b);
+    point.w = point.a - point.b;
+}
+
+template <typename Vec, typename Transform, typename A, typename B>
+static SupportPoint<Vec> support_point(const A &a, const Transform &transform_a, const B &b,
+                                       const Transform &transform_b, Vec direction) {
+    SupportPoint<Vec> point;
+    point.local_a = a(transform_a.rotation.reverse().rotate(direction));
+    point.local_b = b(transform_b.rotation.reverse().rotate(direction * -1.0f));
+    place(point, transform_a, transform_b);
+    return point;
+}
+
+template <typename Vec, u32 N> static Vec closest_point(const Simplex<Vec, N> &simplex) {
+    Vec point = simplex.points[0].w * simplex.weights[0];
+    for (u32 i = 1; i < simplex.count; i++) {
+        point += simplex.points[i].w * simplex.weights[i];
+    }
+    return point;
+}
+
+template <typename Vec, u32 N> static void keep_vertex(Simplex<Vec, N> &simplex, u32 i) {
+    simplex.points[0] = simplex.points[i];
+    simplex.weights[0] = 1.0f;
+    simplex.count = 1;
+}
+
+template <typename Vec, u32 N> static void keep_edge(Simplex<Vec, N> &simplex, u32 i, u32 j, f32 t) {
+    SupportPoint<Vec> first = simplex.points[i], second = simplex.points[j];
+    simplex.points[0] = first;
+    simplex.points[1] = second;
+    simplex.weights[0] = 1.0f - t;
+    simplex.weights[1] = t;
+    simplex.count = 2;
+}
+
+template <typename Vec, u32 N> static void reduce_segment(Simplex<Vec, N> &simplex) {
+    Vec a = simplex.points[0].w;
+    Vec ab = simplex.points[1].w - a;
+    f32 t = -a.dot(ab);
+    f32 length_squared = ab.length_squared();
+
+    if (t <= 0.0f || length_squared <= DEGENERATE) {
+        keep_vertex(simplex, 0);
+    } else if (t >= length_squared) {
+        keep_vertex(simplex, 1);
+    } else {
+        keep_edge(simplex, 0, 1, t / length_squared);
+    }
+}
+
+// Closest feature of a triangle to the origin by Voronoi regions, using only dot products so it serves both
+// dimensions. Returns whether the closest point is interior to the triangle.
+template <typename Vec, u32 N> static bool reduce_triangle(Simplex<Vec, N> &simplex) {
+    Vec a = simplex.points[0].w, b = simplex.points[1].w, c = simplex.points[2].w;
+    Vec ab = b - a, ac = c - a;
+
+    f32 d1 = -ab.dot(a), d2 = -ac.dot(a);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        keep_vertex(simplex, 0);
+        return false;
+    }
+
+    f32 d3 = -ab.dot(b), d4 = -ac.dot(b);
+    if (d3 >= 0.0f && d4 <= d3) {
+        keep_vertex(simplex, 1);
+        return false;
+    }
+
+    f32 vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        keep_edge(simplex, 0, 1, d1 / (d1 - d3));
+        return false;
+    }
+
+    f32 d5 = -ab.dot(c), d6 = -ac.dot(c);
+    if (d6 >= 0.0f && d5 <= d6) {
+        keep_vertex(simplex, 2);
+        return false;
+    }
+
+    f32 vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        keep_edge(simplex, 0, 2, d2 / (d2 - d6));
+        return false;
+    }
+
+    f32 va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        keep_edge(simplex, 1, 2, (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        return false;
+    }
+
+    f32 total = va + vb + vc;
+    if (total <= DEGENERATE) {
+        // Collinear vertices: fall back to the first edge
+        simplex.count = 2;
+        reduce_segment(simplex);
+        return false;
+    }
+
+    simplex.weights[0] = va / total;
+    simplex.weights[1] = vb / total;
+    simplex.weights[2] = vc / total;
+    return true;
+}
+
+// Reduces the simplex to the feature closest to the origin; returns true when a full simplex contains the origin
+static bool reduce_simplex(Simplex<Vec2, 3> &simplex) {
+    switch (simplex.count) {
+    case 1:
+        simplex.weights[0] = 1.0f;
+        return false;
+    case 2:
+        reduce_segment(simplex);
+        return false;
+    default:
+        return reduce_triangle(simplex);
+    }
+}
+
+static bool reduce_simplex(Simplex<Vec3, 4> &simplex) {
+    switch (simplex.count) {
+    case 1:
+        simplex.weights[0] = 1.0f;
+        return false;
+    case 2:
+        reduce_segment(simplex);
+        return false;
+    case 3:
+        reduce_triangle(simplex);
+        return false;
+    default:
+        break;
+    }
+
+    // Tetrahedron: the closest feature lies on a face whose plane separates the origin from the opposite vertex
+    static const u32 faces[4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}};
+    Simplex<Vec3, 4> best = simplex;
+    f32 best_distance = FLT_MAX;
+    bool contains_origin = true;
+
+    for (u32 f = 0; f < 4; f++) {
+        Vec3 a = simplex.points[faces[f][0]].w;
+        Vec3 normal = (simplex.points[faces[f][1]].w - a).cross(simplex.points[faces[f][2]].w - a);
+        f32 origin_side = -normal.dot(a);
+        f32 opposite_side = normal.dot(simplex.points[faces[f][3]].w - a);
+        if (origin_side * opposite_side > 0.0f && std::fabs(opposite_side) > DEGENERATE) continue;
+
+        contains_origin = false;
+        Simplex<Vec3, 4> face;
+        face.count = 3;
+        for (u32 k = 0; k < 3; k++) {
+            face.points[k] = simplex.points[faces[f][k]];
+        }
+        reduce_triangle(face);
+
+        f32 distance = closest_point(face).length_squared();
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = face;
+        }
+    }
+
+    if (!contains_origin) simplex = best;
+    return contains_origin;
+}
+
+template <typename Vec, u32 N, typename Query>
+static void write_closest(const Simplex<Vec, N> &simplex, Query &result) {
+    result.point_a = simplex.points[0].a * simplex.weights[0];
+    result.point_b = simplex.points[0].b * simplex.weights[0];
+    for (u32 i = 1; i < simplex.count; i++) {
+        result.point_a += simplex.points[i].a * simplex.weights[i];
+        result.point_b += simplex.points[i].b * simplex.weights[i];
+    }
+}
+
+template <typename A, typename B>
+static void epa(const A &a, const Transform2 &transform_a, const B &b, const Transform2 &transform_b,
+                const Simplex<Vec2, 3> &simplex, ConvexQuery2 &result) {
+    SupportPoint<Vec2> polygon[EPA_MAX_VERTICES];
+    u32 count = simplex.count;
+    memcpy(polygon, simplex.points, count * sizeof(SupportPoint<Vec2>));
+
+    // Grow a touching simplex into a triangle
+    static const Vec2 axes[4] = {{1.0f, 0.0f}, {-1.0f, 0.0f}, {0.0f, 1.0f}, {0.0f, -1.0f}};
+    for (u32 k = 0; k < 4 && count == 1; k++) {
+        SupportPoint<Vec2> point = support_point(a, transform_a, b, transform_b, axes[k]);
+        if ((point.w - polygon[0].w).length_squared() > DEGENERATE) polygon[count++] = point;
+    }
+    if (count == 2) {
+        Vec2 edge = polygon[1].w - polygon[0].w;
+        Vec2 perpendicular = {-edge.y, edge.x};
+        SupportPoint<Vec2> point = support_point(a, transform_a, b, transform_b, perpendicular);
+        if (std::fabs(edge.perp_dot(point.w - polygon[0].w)) <= DEGENERATE) {
+            point = support_point(a, transform_a, b, transform_b, perpendicular * -1.0f);
+        }
+        polygon[count++] = point;
+    }
+
+    result.overlapping = true;
+    result.distance = 0.0f;
+    result.normal = (transform_b.position - transform_a.position).normalize();
+    result.point_a = polygon[0].a;
+    result.point_b = polygon[0].b;
+    if (count < 3) return;
+
+    if ((polygon[1].w - polygon[0].w).perp_dot(polygon[2].w - polygon[0].w) < 0.0f) {
+        SupportPoint<Vec2> swap = polygon[1];
+        polygon[1] = polygon[2];
+        polygon[2] = swap;
+    }
+
+    // Push out the edge closest to the origin until the boundary stops moving
+    for (u32 iteration = 0;; iteration++) {
+        u32 best = count;
+        f32 best_distance = FLT_MAX;
+        Vec2 best_normal = Vec2::ZERO();
+        for (u32 i = 0; i < count; i++) {
+            Vec2 edge = polygon[(i + 1) % count].w - polygon[i].w;
+            f32 length = edge.length();
+            if (length <= EPSILON) continue;
+
+            Vec2 normal = {edge.y / length, -edge.x / length};
+            f32 distance = normal.dot(polygon[i].w);
+            if (distance < best_distance) {
+                best = i;
+                best_distance = distance;
+                best_normal = normal;
+            }
+        }
+        if (best == count) return;
+
+        SupportPoint<Vec2> point = support_point(a, transform_a, b, transform_b, best_normal);
+        bool converged = best_normal.dot(point.w) - best_distance <= EPA_TOLERANCE;
+        if (converged || count == EPA_MAX_VERTICES || iteration == EPA_MAX_ITERATIONS) {
+            const SupportPoint<Vec2> &first = polygon[best];
+            const SupportPoint<Vec2> &second = polygon[(best + 1) % count];
+            Vec2 edge = second.w - first.w;
+            f32 t = (best_normal * best_distance - first.w).dot(edge) / edge.length_squared();
+            t = std::fmin(std::fmax(t, 0.0f), 1.0f);
+
+            result.distance = std::fmax(best_distance, 0.0f);
+            result.normal = best_normal;
+            result.point_a = first.a + (second.a - first.a) * t;
+            result.point_b = first.b + (second.b - first.b) * t;
+            return;
+        }
+
+        memmove(polygon + best + 2, polygon + best + 1, (count - best - 1) * sizeof(SupportPoint<Vec2>));
+        polygon[best + 1] = point;
+        count++;
+    }
+}
+
+struct EpaFace {
+    u32 vertices[3];
+    Vec3 normal;
+    f32 distance;
+};
+
+static EpaFace make_face(const SupportPoint<Vec3> *points, u32 a, u32 b, u32 c) {
+    EpaFace face = {{a, b, c}, Vec3::ZERO(), FLT_MAX};
+    Vec3 normal = (points[b].w - points[a].w).cross(points[c].w - points[a].w);
+    f32 length = normal.length();
+    if (length > DEGENERATE) {
+        face.normal = normal / length;
+        face.distance = face.normal.dot(points[a].w);
+    }
+    return face;
+}
+
+template <typename A, typename B>
+static void epa(const A &a, const Transform3 &transform_a, const B &b, const Transform3 &transform_b,
+                const Simplex<Vec3, 4> &simplex, ConvexQuery3 &result) {
+    SupportPoint<Vec3> points[EPA_MAX_VERTICES];
+    u32 count = simplex.count;
+    memcpy(points, simplex.points, count * sizeof(SupportPoint<Vec3>));
+
+    // Grow a touching simplex into a tetrahedron
+    static const Vec3 axes[6] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f},
+                                 {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+    for (u32 k = 0; k < 6 && count == 1; k++) {
+        SupportPoint<Vec3> point = support_point(a, transform_a, b, transform_b, axes[k]);
+        if ((point.w - points[0].w).length_squared() > DEGENERATE) points[count++] = point;
+    }
+    if (count == 2) {
+        Vec3 edge = (points[1].w - points[0].w).normalize();
+        Vec3 axis = std::fabs(edge.x) < 0.57f ? Vec3{1.0f, 0.0f, 0.0f}
+                    : std::fabs(edge.y) < 0.57f ? Vec3{0.0f, 1.0f, 0.0f}
+                                                : Vec3{0.0f, 0.0f, 1.0f};
+        Vec3 first = edge.cross(axis).normalize();
+        Vec3 second = edge.cross(first);
+        for (u32 k = 0; k < 6 && count == 2; k++) {
+            f32 angle = (f32)k * (PI / 3.0f);
+            Vec3 direction = first * std::cos(angle) + second * std::sin(angle);
+            SupportPoint<Vec3> point = support_point(a, transform_a, b, transform_b, direction);
+            if (edge.cross(point.w - points[0].w).length_squared() > DEGENERATE) points[count++] = point;
+        }
+    }
+    if (count == 3) {
+        Vec3 normal = (points[1].w - points[0].w).cross(points[2].w - points[0].w);
+        SupportPoint<Vec3> point = support_point(a, transform_a, b, transform_b, normal);
+        if (std::fabs(normal.dot(point.w - points[0].w)) <= DEGENERATE) {
+            point = support_point(a, transform_a, b, transform_b, normal * -1.0f);
+        }
+        points[count++] = point;
+    }
+
+    result.overlapping = true;
+    result.distance = 0.0f;
+    result.normal = (transform_b.position - transform_a.position).normalize();
+    result.point_a = points[0].a;
+    result.point_b = points[0].b;
+    if (count < 4) return;
+
+    EpaFace faces[EPA_MAX_FACES];
+    u32 face_count = 0;
+    static const u32 tetrahedron[4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}};
+    for (u32 f = 0; f < 4; f++) {
+        const u32 *v = tetrahedron[f];
+        EpaFace face = make_face(points, v[0], v[1], v[2]);
+        if (face.normal.dot(points[v[3]].w - points[v[0]].w) > 0.0f) {
+            face = make_face(points, v[0], v[2], v[1]);
+        }
+        faces[face_count++] = face;
+    }
+
+    // Expand the face closest to the origin, replacing the faces the new vertex sees with a fan over their horizon
+    for (u32 iteration = 0;; iteration++) {
+        u32 best = 0;
+        for (u32 f = 1; f < face_count; f++) {
+            if (faces[f].distance < faces[best].distance) best = f;
+        }
+        const EpaFace &face = faces[best];
+        if (face.distance == FLT_MAX) return;
+
+        SupportPoint<Vec3> point = support_point(a, transform_a, b, transform_b, face.normal);
+        bool converged = face.normal.dot(point.w) - face.distance <= EPA_TOLERANCE;
+
+        u32 edges[EPA_MAX_EDGES][2];
+        u32 edge_count = 0;
+        bool visible[EPA_MAX_FACES];
+        u32 visible_count = 0;
+        bool overflow = count == EPA_MAX_VERTICES;
+
+        for (u32 f = 0; f < face_count && !converged && !overflow; f++) {
+            visible[f] = faces[f].normal.dot(point.w - points[faces[f].vertices[0]].w) > 0.0f;
+            if (!visible[f]) continue;
+            visible_count++;
+
+            for (u32 k = 0; k < 3 && !overflow; k++) {
+                u32 from = faces[f].vertices[k], to = faces[f].vertices[(k + 1) % 3];
+
+                // An edge shared with another visible face is interior to the hole
+                bool shared = false;
+                for (u32 e = 0; e < edge_count; e++) {
+                    if (edges[e][0] == to && edges[e][1] == from) {
+                        edges[e][0] = edges[edge_count - 1][0];
+                        edges[e][1] = edges[edge_count - 1][1];
+                        edge_count--;
+                        shared = true;
+                        break;
+                    }
+                }
+                if (shared) continue;
+
+                if (edge_count == EPA_MAX_EDGES) {
+                    overflow = true;
+                } else {
+                    edges[edge_count][0] = from;
+                    edges[edge_count][1] = to;
+                    edge_count++;
+                }
+            }
+        }
+        overflow = overflow || face_count - visible_count + edge_count > EPA_MAX_FACES;
+
+        if (converged || overflow || iteration == EPA_MAX_ITERATIONS) {
+            // Barycentric coordinates of the origin's projection onto the face
+            const SupportPoint<Vec3> &p0 = points[face.vertices[0]];
+            const SupportPoint<Vec3> &p1 = points[face.vertices[1]];
+            const SupportPoint<Vec3> &p2 = points[face.vertices[2]];
+            Vec3 v0 = p1.w - p0.w, v1 = p2.w - p0.w, v2 = face.normal * face.distance - p0.w;
+            f32 d00 = v0.dot(v0), d01 = v0.dot(v1), d11 = v1.dot(v1), d20 = v2.dot(v0), d21 = v2.dot(v1);
+            f32 denominator = d00 * d11 - d01 * d01;
+            f32 v = denominator > DEGENERATE ? (d11 * d20 - d01 * d21) / denominator : 0.0f;
+            f32 w = denominator > DEGENERATE ? (d00 * d21 - d01 * d20) / denominator : 0.0f;
+            f32 u = 1.0f - v - w;
+
+            result.distance = std::fmax(face.distance, 0.0f);
+            result.normal = face.normal;
+            result.point_a = p0.a * u + p1.a * v + p2.a * w;
+            result.point_b = p0.b * u + p1.b * v + p2.b * w;
+            return;
+        }
+
+        u32 kept = 0;
+        for (u32 f = 0; f < face_count; f++) {
+            if (!visible[f]) faces[kept++] = faces[f];
+        }
+        face_count = kept;
+
+        points[count] = point;
+        for (u32 e = 0; e < edge_count; e++) {
+            faces[face_count++] = make_face(points, edges[e][0], edges[e][1], count);
+        }
+        count++;
+    }
+}
+
+template <typename Vec, typename Transform, typename S>
+static inline Vec world_support(const S &shape, const Transform &transform, Vec direction) {
+    return transform.position + transform.rotation.rotate(shape(transform.rotation.reverse().rotate(direction)));
+}
+
+// EPA finds the deepest point, which for shapes resting face to face is an arbitrary corner of the face. Both points
+// are slid along the surface to the middle of the patch where the faces overlap, found by tilting the normal slightly
+// each way so the supports land on the ends of any face lying across it, and the patch's size is reported so a solver
+// can resist rocking over it. Curved and cornered contacts have a patch of one point and keep theirs.
+template <typename A, typename B>
+static void center_on_patch(const A &a, const Transform2 &transform_a, const B &b, const Transform2 &transform_b,
+                            ConvexQuery2 &result) {
+    Vec2 normal = result.normal;
+    Vec2 tangent = {-normal.y, normal.x};
+    Vec2 tilt = tangent * PATCH_TILT;
+
+    f32 a_low = FLT_MAX, a_high = -FLT_MAX, b_low = FLT_MAX, b_high = -FLT_MAX;
+    const f32 sides[2] = {-1.0f, 1.0f};
+    for (f32 side : sides) {
+        f32 along_a = world_support(a, transform_a, normal + tilt * side).dot(tangent);
+        f32 along_b = world_support(b, transform_b, normal * -1.0f + tilt * side).dot(tangent);
+        a_low = std::fmin(a_low, along_a);
+        a_high = std::fmax(a_high, along_a);
+        b_low = std::fmin(b_low, along_b);
+        b_high = std::fmax(b_high, along_b);
+    }
+
+    f32 low = std::fmax(a_low, b_low), high = std::fmin(a_high, b_high);
+    result.patch_radius = 0.0f;
+    if (low > high) return;
+
+    f32 middle = 0.5f * (low + high);
+    result.patch_radius = 0.5f * (high - low);
+    result.point_a += tangent * (middle - result.point_a.dot(tangent));
+    result.point_b += tangent * (middle - result.point_b.dot(tangent));
+}
+
+// Same in the contact plane, with each patch bounded by a rectangle along the two tangents
+template <typename A, typename B>
+static void center_on_patch(const A &a, const Transform3 &transform_a, const B &b, const Transform3 &transform_b,
+                            ConvexQuery3 &result) {
+    Vec3 normal = result.normal;
+    Vec3 axis = std::fabs(normal.x) < 0.57f ? Vec3{1.0f, 0.0f, 0.0f} : Vec3{0.0f, 1.0f, 0.0f};
+    Vec3 tangents[2];
+    tangents[0] = normal.cross(axis).normalize();
+    tangents[1] = normal.cross(tangents[0]);
+
+    f32 a_low[2] = {FLT_MAX, FLT_MAX}, a_high[2] = {-FLT_MAX, -FLT_MAX};
+    f32 b_low[2] = {FLT_MAX, FLT_MAX}, b_high[2] = {-FLT_MAX, -FLT_MAX};
+    const f32 tilts[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    for (const auto &t : tilts) {
+        Vec3 tilt = (tangents[0] * t[0] + tangents[1] * t[1]) * PATCH_TILT;
+        Vec3 point_a = world_support(a, transform_a, normal + tilt);
+        Vec3 point_b = world_support(b, transform_b, normal * -1.0f + tilt);
+        for (u32 k = 0; k < 2; k++) {
+            a_low[k] = std::fmin(a_low[k], point_a.dot(tangents[k]));
+            a_high[k] = std::fmax(a_high[k], point_a.dot(tangents[k]));
+            b_low[k] = std::fmin(b_low[k], point_b.dot(tangents[k]));
+            b_high[k] = std::fmax(b_high[k], point_b.dot(tangents[k]));
+        }
+    }
+
+    result.patch_radius = FLT_MAX;
+    for (u32 k = 0; k < 2; k++) {
+        f32 low = std::fmax(a_low[k], b_low[k]), high = std::fmin(a_high[k], b_high[k]);
+        result.patch_radius = std::fmin(result.patch_radius, 0.5f * std::fmax(high - low, 0.0f));
+        if (low > high) continue;
+
+        f32 middle = 0.5f * (low + high);
+        result.point_a += tangents[k] * (middle - result.point_a.dot(tangents[k]));
+        result.point_b += tangents[k] * (middle - result.point_b.dot(tangents[k]));
+    }
+}
+
+template <typename Vec, u32 N, typename Transform, typename Cache, typename Query, typename A, typename B>
+static void gjk(const A &a, const Transform &transform_a, const B &b, const Transform &transform_b, Cache *cache,
+                Query &result) {
+    Simplex<Vec, N> simplex;
+    simplex.count = 0;
+
+    if (cache && cache->count > 0 && cache->count <= N) {
+        for (u32 i = 0; i < cache->count; i++) {
+            simplex.points[i].local_a = cache->local_a[i];
+            simplex.points[i].local_b = cache->local_b[i];
+            place(simplex.points[i], transform_a, transform_b);
+        }
+        simplex.count = cache->count;
+    } else {
+        Vec direction = transform_b.position - transform_a.position;
+        if (direction.length_squared() <= DEGENERATE) direction.x = 1.0f;
+        simplex.points[0] = support_point(a, transform_a, b, transform_b, direction);
+        simplex.count = 1;
+    }
+
+    bool overlapping = false;
+    u32 iterations = 0;
+    Vec closest = simplex.points[0].w;
+
+    for (;;) {
+        iterations++;
+        if (reduce_simplex(simplex)) {
+            overlapping = true;
+            break;
+        }
+
+        closest = closest_point(simplex);
+        f32 distance_squared = closest.length_squared();
+        if (distance_squared <= GJK_CONTACT_DISTANCE * GJK_CONTACT_DISTANCE) {
+            overlapping = true;
+            break;
+        }
+        if (iterations >= GJK_MAX_ITERATIONS) break;
+
+        SupportPoint<Vec> point = support_point(a, transform_a, b, transform_b, closest * -1.0f);
+        if (distance_squared - closest.dot(point.w) <= GJK_TOLERANCE * distance_squared) break;
+
+        bool duplicate = false;
+        for (u32 i = 0; i < simplex.count; i++) {
+            duplicate = duplicate || (simplex.points[i].w - point.w).length_squared() <= DEGENERATE;
+        }
+        if (duplicate) break;
+
+        simplex.points[simplex.count++] = point;
+    }
+
+    if (cache) {
+        cache->count = simplex.count;
+        for (u32 i = 0; i < simplex.count; i++) {
+            cache->local_a[i] = simplex.points[i].local_a;
+            cache->local_b[i] = simplex.points[i].local_b;
+        }
+    }
+
+    if (overlapping) {
+        epa(a, transform_a, b, transform_b, simplex, result);
+        center_on_patch(a, transform_a, b, transform_b, result);
+    } else {
+        f32 distance = closest.length();
+        result.overlapping = false;
+        result.distance = distance;
+        result.patch_radius = 0.0f;
+        result.normal = closest * (-1.0f / distance);
+        write_closest(simplex, result);
+    }
+    result.iterations = iterations;
+}
+
+template <typename A>
+static bool query_convex_with(const A &a, const Transform2 &transform_a, const Shape2 &b,
+                              const Transform2 &transform_b, SimplexCache2 *cache, ConvexQuery2 &result) {
+    switch (b.kind) {
+    case ShapeKind2::None:
+        return false;
+    case ShapeKind2::Triangle:
+        gjk<Vec2, 3>(a, transform_a, PolygonSupport{b.triangle.vertices, 3}, transform_b, cache, result);
+        break;
+    case ShapeKind2::Rectangle:
+        gjk<Vec2, 3>(a, transform_a, RectangleSupport{b.rectangle.half_size}, transform_b, cache, result);
+        break;
+    case ShapeKind2::Circle:
+        gjk<Vec2, 3>(a, transform_a, CircleSupport{b.circle.radius}, transform_b, cache, result);
+        break;
+    case ShapeKind2::Ellipse:
+        gjk<Vec2, 3>(a, transform_a, EllipseSupport{b.ellipse.half_size}, transform_b, cache, result);
+        break;
+    case ShapeKind2::Polygon:
+        gjk<Vec2, 3>(a, transform_a, PolygonSupport{b.polygon.vertices, b.polygon.vertex_count}, transform_b, cache,
+                     result);
+        break;
+    case ShapeKind2::Capsule:
+        gjk<Vec2, 3>(a, transform_a, CapsuleSupport{b.capsule.radius, b.capsule.half_length}, transform_b, cache,
+                     result);
+        break;
+    }
+    return true;
+}
+
+template <typename A>
+static bool query_convex_with(const A &a, const Transform3 &transform_a, const Shape3 &b,
+                              const Transform3 &transform_b, SimplexCache3 *cache, ConvexQuery3 &result) {
+    switch (b.kind) {
+    case ShapeKind3::None:
+        return false;
+    case ShapeKind3::Cuboid:
+        gjk<Vec3, 4>(a, transform_a, CuboidSupport{b.cuboid.half_size}, transform_b, cache, result);
+        break;
+    case ShapeKind3::Sphere:
+        gjk<Vec3, 4>(a, transform_a, SphereSupport{b.sphere.radius}, transform_b, cache, result);
+        break;
+    case ShapeKind3::Cylinder:
+        gjk<Vec3, 4>(a, transform_a, CylinderSupport{b.cylinder.radius, b.cylinder.half_height}, transform_b, cache,
+                     result);
+        break;
+    case ShapeKind3::ConicalFrustum: {
+        const ConicalFrustum &frustum = b.conical_frustum;
+        FrustumSupport support = {frustum.radius_top, frustum.radius_bottom, 0.5f * frustum.height};
+        gjk<Vec3, 4>(a, transform_a, support, transform_b, cache, result);
+        break;
+    }
+    }
+    return true;
+}
+
+bool query_convex(const Shape2 &a, const Transform2 &transform_a, const Shape2 &b, const Transform2 &transform_b,
+                  SimplexCache2 *cache, ConvexQuery2 &result) {
+    switch (a.kind) {
+    case ShapeKind2::None:
+        return false;
+    case ShapeKind2::Triangle:
+        return query_convex_with(PolygonSupport{a.triangle.vertices, 3}, transform_a, b, transform_b, cache, result);
+    case ShapeKind2::Rectangle:
+        return query_convex_with(RectangleSupport{a.rectangle.half_size}, transform_a, b, transform_b, cache, result);
+    case ShapeKind2::Circle:
+        return query_convex_with(CircleSupport{a.circle.radius}, transform_a, b, transform_b, cache, result);
+    case ShapeKind2::Ellipse:
+        return query_convex_with(EllipseSupport{a.ellipse.half_size}, transform_a, b, transform_b, cache, result);
+    case ShapeKind2::Polygon:
+        return query_convex_with(PolygonSupport{a.polygon.vertices, a.polygon.vertex_count}, transform_a, b,
+                                 transform_b, cache, result);
+    case ShapeKind2::Capsule:
+        return query_convex_with(CapsuleSupport{a.capsule.radius, a.capsule.half_length}, transform_a, b,
+                                 transform_b, cache, result);
+    }
+    return false;
+}
+
+bool query_convex(const Shape3 &a, const Transform3 &transform_a, const Shape3 &b, const Transform3 &transform_b,
+                  SimplexCache3 *cache, ConvexQuery3 &result) {
+    switch (a.kind) {
+    case ShapeKind3::None:
+        return false;
+    case ShapeKind3::Cuboid:
+        return query_convex_with(CuboidSupport{a.cuboid.half_size}, transform_a, b, transform_b, cache, result);
+    case ShapeKind3::Sphere:
+        return query_convex_with(SphereSupport{a.sphere.radius}, transform_a, b, transform_b, cache, result);
+    case ShapeKind3::Cylinder:
+        return query_convex_with(CylinderSupport{a.cylinder.radius, a.cylinder.half_height}, transform_a, b,
+                                 transform_b, cache, result);
+    case ShapeKind3::ConicalFrustum: {
+        const ConicalFrustum &frustum = a.conical_frustum;
+        FrustumSupport support = {frustum.radius_top, frustum.radius_bottom, 0.5f * frustum.height};
+        return query_convex_with(support, transform_a, b, transform_b, cache, result);
+    }
+    }
+    return false;
+}
@@ -1,9 +1,15 @@
 #include "physics/gravity.hpp"
+#include "common/parallel.hpp"
 #include "common/types.hpp"
 #include "math/constants.hpp"
+#include <cmath>
+#include <cstdlib>
 
-const float GRAVITATIONAL_CONSTANT = 6.674e-11;
-const float GRAVITATIONAL_FACTOR = 1.0e2;
+static const usize ROTOR_LANES = 64;              // bodies per batch of rotor updates
+static const f32 MIN_ROTOR_NORM_SQUARED = 1.0e-6f; // below this a rotor is reset to the identity
+static const usize FIELD_LANES = 64;               // points summed together per source
+static const usize FIELD_BATCH = 1024;             // points per parallel task, a multiple of FIELD_LANES
+static const usize FIELD_SOURCE_BLOCK = 2048;      // sources streamed past a task's points at a time
 
 static Vec2 calculate_acceleration(Vec2 kinematic_position, float kinematic_mass, Vec2 dynamic_position,
                                    float dynamic_mass) {
@@ -59,8 +65,8 @@ static Vec3 calculate_acceleration(Vec3 kinematic_position, float kinematic_mass
 
 void accelerate_rigid_bodies(Body2 *bodies, usize body_count) {
     for (usize i = 0; i < body_count; i++) {
-        // Skip kinematic bodies
-        if (bodies[i].kind != BodyKind::Dynamic) {
+        // Skip kinematic and sleeping bodies
+        if (bodies[i].kind != BodyKind::Dynamic || bodies[i].sleeping) {
             continue;
         }
 
@@ -83,8 +89,8 @@ void accelerate_rigid_bodies(Body2 *bodies, usize body_count) {
 
 void accelerate_rigid_bodies(Body3 *bodies, usize body_count) {
     for (usize i = 0; i < body_count; i++) {
-        // Skip kinematic bodies
-        if (bodies[i].kind != BodyKind::Dynamic) {
+        // Skip kinematic and sleeping bodies
+        if (bodies[i].kind != BodyKind::Dynamic || bodies[i].sleeping) {
             continue;
         }
 
@@ -105,20 +111,239 @@ void accelerate_rigid_bodies(Body3 *bodies, usize body_count) {
     }
 }
 
-void integrate_physics(Body2 *bodies, usize body_count, float dt) {
+// Kinematic bodies still pull on the others unless `kinematic_sources` is false, for callers that add their field
+// some other way
+template <typename Body, typename Vec>
+static void compute_accelerations_impl(const Body *bodies, usize body_count, Vec *accelerations,
+                                       bool kinematic_sources) {
     for (usize i = 0; i < body_count; i++) {
-        auto &body = bodies[i];
+        accelerations[i] = Vec::ZERO();
+        if (bodies[i].kind != BodyKind::Dynamic || bodies[i].sleeping) {
+            continue;
+        }
+
+        for (usize j = 0; j < body_count; j++) {
+            if (i == j || (!kinematic_sources && bodies[j].kind == BodyKind::Kinematic)) {
+                continue;
+            }
+
+            Vec delta_position = bodies[j].transform.position - bodies[i].transform.position;
+            float distance_squared = delta_position.length_squared();
+            if (distance_squared <= 0.0f) {
+                continue;
+            }
+
+            float inverse_distance_cubed = 1.0f / (distance_squared * std::sqrt(distance_squared));
+            accelerations[i] += delta_position * (GRAVITATIONAL_PARAMETER * bodies[j].mass * inverse_distance_cubed);
+        }
+    }
+}
+
+void compute_accelerations(const Body2 *bodies, usize body_count, Vec2 *accelerations) {
+    compute_accelerations_impl(bodies, body_count, accelerations, true);
+}
+
+void compute_accelerations(const Body3 *bodies, usize body_count, Vec3 *accelerations) {
+    compute_accelerations_impl(bodies, body_count, accelerations, true);
+}
+
+void compute_dynamic_accelerations(const Body2 *bodies, usize body_count, Vec2 *accelerations) {
+    compute_accelerations_impl(bodies, body_count, accelerations, false);
+}
+
+void compute_dynamic_accelerations(const Body3 *bodies, usize body_count, Vec3 *accelerations) {
+    compute_accelerations_impl(bodies, body_count, accelerations, false);
+}
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+template <u32 D, typename Body, typename Vec, typename Sample>
+static void evaluate_field_impl(const Body *bodies, usize body_count, const Vec *points, usize point_count,
+                                Sample *out) {
+    // Sources with mass, one array per axis and one of G * m
+    f32 *sources = (f32 *)malloc((D + 1) * (body_count > 0 ? body_count : 1) * sizeof(f32));
+    usize source_count = 0;
+    for (usize j = 0; j < body_count; j++) {
+        if (bodies[j].mass <= 0.0f) continue;
+        for (u32 k = 0; k < D; k++) {
+            sources[k * body_count + source_count] = axis(bodies[j].transform.position, k);
+        }
+        sources[D * body_count + source_count++] = GRAVITATIONAL_PARAMETER * bodies[j].mass;
+    }
+
+    parallel_for(point_count, FIELD_BATCH, [&](usize begin, usize end) {
+        f32 place[D][FIELD_BATCH], pull[D][FIELD_BATCH], potential[FIELD_BATCH];
+        usize count = end - begin;
+        for (usize i = 0; i < count; i++) {
+            for (u32 k = 0; k < D; k++) {
+                place[k][i] = axis(points[begin + i], k);
+                pull[k][i] = 0.0f;
+            }
+            potential[i] = 0.0f;
+        }
+
+        for (usize block = 0; block < source_count; block += FIELD_SOURCE_BLOCK) {
+            usize block_end = block + FIELD_SOURCE_BLOCK < source_count ? block + FIELD_SOURCE_BLOCK : source_count;
+            for (usize base = 0; base < count; base += FIELD_LANES) {
+                usize lanes = count - base < FIELD_LANES ? count - base : FIELD_LANES;
+                for (usize j = block; j < block_end; j++) {
+                    f32 source[D], strength = sources[D * body_count + j];
+                    for (u32 k = 0; k < D; k++) {
+                        source[k] = sources[k * body_count + j];
+                    }
+
+                    for (usize l = base; l < base + lanes; l++) {
+                        f32 delta[D], distance_squared = 0.0f;
+                        for (u32 k = 0; k < D; k++) {
+                            delta[k] = source[k] - place[k][l];
+                            distance_squared += delta[k] * delta[k];
+                        }
+                        bool apart = distance_squared > 0.0f;
+                        f32 inverse = apart ? 1.0f / std::sqrt(distance_squared) : 0.0f;
+                        f32 scale = strength * inverse;
+                        for (u32 k = 0; k < D; k++) {
+                            pull[k][l] += delta[k] * (scale * inverse * inverse);
+                        }
+                        potential[l] -= scale;
+                    }
+                }
+            }
+        }
+
+        for (usize i = 0; i < count; i++) {
+            for (u32 k = 0; k < D; k++) {
+                axis(out[begin + i].acceleration, k) = pull[k][i];
+            }
+            out[begin + i].potential = potential[i];
+        }
+    });
+
+    free(sources);
+}
+
+void evaluate_field(const Body2 *bodies, usize body_count, const Vec2 *points, usize point_count, FieldSample2 *out) {
+    evaluate_field_impl<2>(bodies, body_count, points, point_count, out);
+}
+
+void evaluate_field(const Body3 *bodies, usize body_count, const Vec3 *points, usize point_count, FieldSample3 *out) {
+    evaluate_field_impl<3>(bodies, body_count, points, point_count, out);
+}
+
+// Applies dR/dt = 0.5 * w * R to a batch of rotors as one explicit step and renormalizes, where w is the angular
+// velocity as a bivector. Rotors too short to normalize, such as zero-initialized ones, become the identity like they
+// do in Rot3::normalize. Both loops are branch-free over plain arrays so they compile to SIMD.
+static void step_rotors(f32 *scalar, f32 *bivector, const f32 *rate, usize count, float dt) {
+    for (usize i = 0; i < count; i++) {
+        f32 half = 0.5f * dt * rate[i];
+        f32 s = scalar[i] - half * bivector[i];
+        f32 b = bivector[i] + half * scalar[i];
+        f32 norm_squared = s * s + b * b;
+        bool degenerate = norm_squared < MIN_ROTOR_NORM_SQUARED;
+        f32 inverse_norm = 1.0f / std::sqrt(degenerate ? 1.0f : norm_squared);
+        scalar[i] = degenerate ? 1.0f : s * inverse_norm;
+        bivector[i] = degenerate ? 0.0f : b * inverse_norm;
+    }
+}
+
+static void step_rotors(f32 *scalar, f32 *b12, f32 *b23, f32 *b31, const f32 *rate_x, const f32 *rate_y,
+                        const f32 *rate_z, usize count, float dt) {
+    for (usize i = 0; i < count; i++) {
+        // Angular velocity about x, y and z maps onto the e23, e31 and e12 planes
+        f32 x = 0.5f * dt * rate_x[i], y = 0.5f * dt * rate_y[i], z = 0.5f * dt * rate_z[i];
+        f32 s = scalar[i] - z * b12[i] - x * b23[i] - y * b31[i];
+        f32 xy = b12[i] + z * scalar[i] + x * b31[i] - y * b23[i];
+        f32 yz = b23[i] + x * scalar[i] + y * b12[i] - z * b31[i];
+        f32 zx = b31[i] + y * scalar[i] + z * b23[i] - x * b12[i];
+        f32 norm_squared = s * s + xy * xy + yz * yz + zx * zx;
+        bool degenerate = norm_squared < MIN_ROTOR_NORM_SQUARED;
+        f32 inverse_norm = 1.0f / std::sqrt(degenerate ? 1.0f : norm_squared);
+        scalar[i] = degenerate ? 1.0f : s * inverse_norm;
+        b12[i] = degenerate ? 0.0f : xy * inverse_norm;
+        b23[i] = degenerate ? 0.0f : yz * inverse_norm;
+        b31[i] = degenerate ? 0.0f : zx * inverse_norm;
+    }
+}
+
+void integrate_physics(Body2 *bodies, usize body_count, float dt) {
+    f32 scalar[ROTOR_LANES], bivector[ROTOR_LANES], rate[ROTOR_LANES];
 
-        body.transform.velocity *= (1.0f - body.dampening.linear * dt);
-        body.transform.position += body.transform.velocity * dt;
+    for (usize base = 0; base < body_count; base += ROTOR_LANES) {
+        usize count = body_count - base < ROTOR_LANES ? body_count - base : ROTOR_LANES;
+
+        for (usize i = 0; i < count; i++) {
+            auto &body = bodies[base + i];
+            scalar[i] = body.transform.rotation.scalar;
+            bivector[i] = body.transform.rotation.bivector;
+            rate[i] = 0.0f;
+            if (body.sleeping) {
+                continue;
+            }
+
+            body.transform.velocity *= (1.0f - body.dampening.linear * dt);
+            body.transform.angular_velocity *= (1.0f - body.dampening.angular * dt);
+            body.transform.position += body.transform.velocity * dt;
+            rate[i] = body.transform.angular_velocity;
+        }
+
+        step_rotors(scalar, bivector, rate, count, dt);
+
+        for (usize i = 0; i < count; i++) {
+            auto &body = bodies[base + i];
+            if (!body.sleeping) {
+                body.transform.rotation = {.scalar = scalar[i], .bivector = bivector[i]};
+            }
+        }
     }
 }
 
 void integrate_physics(Body3 *bodies, usize body_count, float dt) {
-    for (usize i = 0; i < body_count; i++) {
-        auto &body = bodies[i];
+    f32 scalar[ROTOR_LANES], b12[ROTOR_LANES], b23[ROTOR_LANES], b31[ROTOR_LANES];
+    f32 rate_x[ROTOR_LANES], rate_y[ROTOR_LANES], rate_z[ROTOR_LANES];
 
-        body.transform.velocity *= (1.0f - body.dampening.linear * dt);
-        body.transform.position += body.transform.velocity * dt;
+    for (usize base = 0; base < body_count; base += ROTOR_LANES) {
+        usize count = body_count - base < ROTOR_LANES ? body_count - base : ROTOR_LANES;
+
+        for (usize i = 0; i < count; i++) {
+            auto &body = bodies[base + i];
+            const Rot3 &rotation = body.transform.rotation;
+            scalar[i] = rotation.scalar;
+            b12[i] = rotation.b12;
+            b23[i] = rotation.b23;
+            b31[i] = rotation.b31;
+            rate_x[i] = rate_y[i] = rate_z[i] = 0.0f;
+            if (body.sleeping) {
+                continue;
+            }
+
+            body.transform.velocity *= (1.0f - body.dampening.linear * dt);
+            body.transform.angular_velocity *= (1.0f - body.dampening.angular * dt);
+            body.transform.position += body.transform.velocity * dt;
+            rate_x[i] = body.transform.angular_velocity.x;
+            rate_y[i] = body.transform.angular_velocity.y;
+            rate_z[i] = body.transform.angular_velocity.z;
+        }
+
+        step_rotors(scalar, b12, b23, b31, rate_x, rate_y, rate_z, count, dt);
+
+        for (usize i = 0; i < count; i++) {
+            auto &body = bodies[base + i];
+            if (!body.sleeping) {
+                body.transform.rotation = {.scalar = scalar[i], .b12 = b12[i], .b23 = b23[i], .b31 = b31[i]};
+            }
+        }
     }
 }
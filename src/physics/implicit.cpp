@@ -0,0 +1,319 @@
+#include "physics/implicit.hpp"
+#include "common/parallel.hpp"
+#include "math/constants.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize IMPLICIT_BATCH = 1024;
+static const u32 IMPLICIT_DEFAULT_ITERATIONS = 64;
+static const float IMPLICIT_DEFAULT_TOLERANCE = 1e-4f;
+
+template <typename Body> static float effective_mass(const Body &body) {
+    return body.mass > EPSILON ? body.mass : 1.0f;
+}
+
+// Kinematic and sleeping bodies are held fixed by the solve
+template <typename Body> static bool is_free(const Body &body) {
+    return body.kind == BodyKind::Dynamic && !body.sleeping;
+}
+
+template <typename Solver, typename Vec>
+static void init_implicit_solver_impl(Solver &solver, usize body_count, const Spring *springs, usize spring_count) {
+    usize chunk_count = parallel_chunk_count(body_count, IMPLICIT_BATCH);
+
+    solver = {
+        .body_count = body_count,
+        .spring_count = spring_count,
+        .max_iterations = IMPLICIT_DEFAULT_ITERATIONS,
+        .tolerance = IMPLICIT_DEFAULT_TOLERANCE,
+        .spring_offsets = (u32 *)calloc(body_count + 1, sizeof(u32)),
+        .spring_indices = (u32 *)malloc(2 * spring_count * sizeof(u32) + 1),
+        .delta_velocity = (Vec *)calloc(body_count, sizeof(Vec)),
+        .rhs = (Vec *)malloc(body_count * sizeof(Vec)),
+        .residual = (Vec *)malloc(body_count * sizeof(Vec)),
+        .direction = (Vec *)malloc(body_count * sizeof(Vec)),
+        .product = (Vec *)malloc(body_count * sizeof(Vec)),
+        .preconditioner = (Vec *)malloc(body_count * sizeof(Vec)),
+        .spring_axes = (Vec *)malloc(spring_count * sizeof(Vec) + 1),
+        .spring_lateral = (float *)malloc(spring_count * sizeof(float) + 1),
+        .spring_axial = (float *)malloc(spring_count * sizeof(float) + 1),
+        .partials = (f64 *)malloc((chunk_count + 1) * sizeof(f64)),
+    };
+
+    // Springs attached to each body, so the operator can be applied per body without write conflicts
+    for (usize s = 0; s < spring_count; s++) {
+        solver.spring_offsets[springs[s].a + 1]++;
+        solver.spring_offsets[springs[s].b + 1]++;
+    }
+    for (usize i = 0; i < body_count; i++) {
+        solver.spring_offsets[i + 1] += solver.spring_offsets[i];
+    }
+
+    u32 *cursor = (u32 *)malloc((body_count + 1) * sizeof(u32));
+    for (usize i = 0; i <= body_count; i++) {
+        cursor[i] = solver.spring_offsets[i];
+    }
+    for (usize s = 0; s < spring_count; s++) {
+        solver.spring_indices[cursor[springs[s].a]++] = (u32)s;
+        solver.spring_indices[cursor[springs[s].b]++] = (u32)s;
+    }
+    free(cursor);
+}
+
+template <typename Solver> static void deinit_implicit_solver_impl(Solver &solver) {
+    free(solver.spring_offsets);
+    free(solver.spring_indices);
+    free(solver.delta_velocity);
+    free(solver.rhs);
+    free(solver.residual);
+    free(solver.direction);
+    free(solver.product);
+    free(solver.preconditioner);
+    free(solver.spring_axes);
+    free(solver.spring_lateral);
+    free(solver.spring_axial);
+    free(solver.partials);
+
+    solver = {};
+}
+
+template <typename Solver, typename Body, typename Vec>
+static void apply_operator(const Solver &solver, const Body *bodies, const Spring *springs, float dt, const Vec *x,
+                           Vec *out) {
+    parallel_for(solver.body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Body &body = bodies[i];
+            if (!is_free(body)) {
+                out[i] = x[i];
+                continue;
+            }
+
+            Vec result = x[i] * (effective_mass(body) * (1.0f + body.dampening.linear * dt));
+            for (u32 n = solver.spring_offsets[i]; n < solver.spring_offsets[i + 1]; n++) {
+                u32 s = solver.spring_indices[n];
+                u32 other = springs[s].a == i ? springs[s].b : springs[s].a;
+
+                Vec difference = is_free(bodies[other]) ? x[i] - x[other] : x[i];
+                Vec axis = solver.spring_axes[s];
+                result += difference * solver.spring_lateral[s];
+                result += axis * (solver.spring_axial[s] * axis.dot(difference));
+            }
+
+            out[i] = result;
+        }
+    });
+}
+
+template <typename Solver, typename Vec> static f64 parallel_dot(Solver &solver, const Vec *a, const Vec *b) {
+    parallel_for(solver.body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+        f64 sum = 0.0;
+        for (usize i = begin; i < end; i++) {
+            sum += a[i].dot(b[i]);
+        }
+        solver.partials[begin / IMPLICIT_BATCH] = sum;
+    });
+
+    f64 total = 0.0;
+    for (usize c = 0; c < parallel_chunk_count(solver.body_count, IMPLICIT_BATCH); c++) {
+        total += solver.partials[c];
+    }
+    return total;
+}
+
+// Linearization of the spring forces around the current state: lateral stiffness is clamped at zero under compression
+// so the system stays positive definite
+template <typename Solver, typename Body, typename Vec>
+static void prepare_springs(Solver &solver, const Body *bodies, const Spring *springs, float dt) {
+    parallel_for(solver.spring_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+        for (usize s = begin; s < end; s++) {
+            const Spring &spring = springs[s];
+            Vec delta_position = bodies[spring.b].transform.position - bodies[spring.a].transform.position;
+            float length = delta_position.length();
+
+            float lateral = 0.0f;
+            if (length > EPSILON && length > spring.rest_length) {
+                lateral = spring.stiffness * (1.0f - spring.rest_length / length);
+            }
+
+            solver.spring_axes[s] = delta_position.normalize();
+            solver.spring_lateral[s] = dt * dt * lateral;
+            solver.spring_axial[s] = dt * dt * (spring.stiffness - lateral) + dt * spring.damping;
+        }
+    });
+}
+
+// rhs = dt (f + dt K v), with the spring, dampening and external forces evaluated explicitly
+template <typename Solver, typename Body, typename Vec>
+static void build_rhs(Solver &solver, const Body *bodies, const Spring *springs, const Vec *external_accelerations,
+                      float dt) {
+    parallel_for(solver.body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Body &body = bodies[i];
+            if (!is_free(body)) {
+                solver.rhs[i] = Vec::ZERO();
+                solver.preconditioner[i] = Vec::ONE();
+                solver.delta_velocity[i] = Vec::ZERO();
+                continue;
+            }
+
+            float mass = effective_mass(body);
+            float diagonal = mass * (1.0f + body.dampening.linear * dt);
+            Vec force = body.transform.velocity * (-mass * body.dampening.linear);
+            if (external_accelerations) {
+                force += external_accelerations[i] * mass;
+            }
+
+            Vec stiffness_term = Vec::ZERO();
+            Vec diagonal_axial = Vec::ZERO();
+            float diagonal_lateral = 0.0f;
+
+            for (u32 n = solver.spring_offsets[i]; n < solver.spring_offsets[i + 1]; n++) {
+                u32 s = solver.spring_indices[n];
+                const Spring &spring = springs[s];
+                const Body &other = bodies[spring.a == i ? spring.b : spring.a];
+
+                Vec delta_position = other.transform.position - body.transform.position;
+                float length = delta_position.length();
+                Vec axis = delta_position.normalize();
+                Vec relative_velocity = body.transform.velocity - other.transform.velocity;
+
+                float stretch = length - spring.rest_length;
+                force += axis * (spring.stiffness * stretch - spring.damping * axis.dot(relative_velocity));
+
+                // dt^2 K (v_i - v_j), reusing the linearization minus its damping part
+                float lateral = solver.spring_lateral[s];
+                float axial = solver.spring_axial[s] - dt * spring.damping;
+                stiffness_term += relative_velocity * lateral + axis * (axial * axis.dot(relative_velocity));
+
+                diagonal_lateral += lateral;
+                diagonal_axial += axis * axis * solver.spring_axial[s];
+            }
+
+            solver.rhs[i] = force * dt - stiffness_term;
+
+            Vec inverse_diagonal = Vec::ONE() / (diagonal_axial + (diagonal + diagonal_lateral));
+            solver.preconditioner[i] = inverse_diagonal;
+        }
+    });
+}
+
+template <typename Solver, typename Body, typename Vec>
+static u32 integrate_implicit_impl(Solver &solver, Body *bodies, usize body_count, const Spring *springs,
+                                   const Vec *external_accelerations, float dt) {
+    if (body_count != solver.body_count) {
+        return 0;
+    }
+
+    // A spring from an awake body disturbs a sleeping one, which joins the solve
+    for (usize s = 0; s < solver.spring_count; s++) {
+        Body &a = bodies[springs[s].a], &b = bodies[springs[s].b];
+        if (is_free(a) && b.sleeping) wake_body(b);
+        if (is_free(b) && a.sleeping) wake_body(a);
+    }
+
+    prepare_springs<Solver, Body, Vec>(solver, bodies, springs, dt);
+    build_rhs<Solver, Body, Vec>(solver, bodies, springs, external_accelerations, dt);
+
+    Vec *x = solver.delta_velocity;
+    Vec *r = solver.residual;
+    Vec *p = solver.direction;
+    Vec *product = solver.product;
+    const Vec *preconditioner = solver.preconditioner;
+
+    // Preconditioned conjugate gradients starting from the previous solution
+    apply_operator<Solver, Body, Vec>(solver, bodies, springs, dt, x, product);
+    parallel_for(body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            r[i] = solver.rhs[i] - product[i];
+            p[i] = r[i] * preconditioner[i];
+        }
+    });
+
+    f64 rhs_norm_squared = parallel_dot(solver, solver.rhs, solver.rhs);
+    f64 threshold = (f64)solver.tolerance * solver.tolerance * rhs_norm_squared;
+    f64 rz = parallel_dot(solver, r, p);
+
+    u32 iteration = 0;
+    while (iteration < solver.max_iterations && parallel_dot(solver, r, r) > threshold) {
+        apply_operator<Solver, Body, Vec>(solver, bodies, springs, dt, p, product);
+
+        f64 curvature = parallel_dot(solver, p, product);
+        if (curvature <= 0.0) {
+            break;
+        }
+
+        float alpha = (float)(rz / curvature);
+        parallel_for(body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+            for (usize i = begin; i < end; i++) {
+                x[i] += p[i] * alpha;
+                r[i] -= product[i] * alpha;
+            }
+        });
+
+        parallel_for(body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+            f64 sum = 0.0;
+            for (usize i = begin; i < end; i++) {
+                sum += r[i].dot(r[i] * preconditioner[i]);
+            }
+            solver.partials[begin / IMPLICIT_BATCH] = sum;
+        });
+
+        f64 rz_next = 0.0;
+        for (usize c = 0; c < parallel_chunk_count(body_count, IMPLICIT_BATCH); c++) {
+            rz_next += solver.partials[c];
+        }
+
+        float beta = (float)(rz_next / rz);
+        rz = rz_next;
+        parallel_for(body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+            for (usize i = begin; i < end; i++) {
+                p[i] = r[i] * preconditioner[i] + p[i] * beta;
+            }
+        });
+
+        iteration++;
+    }
+
+    parallel_for(body_count, IMPLICIT_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            auto &body = bodies[i];
+            if (body.sleeping) {
+                continue;
+            }
+            if (body.kind == BodyKind::Dynamic) {
+                body.transform.velocity += x[i];
+            }
+            body.transform.position += body.transform.velocity * dt;
+        }
+    });
+
+    return iteration;
+}
+
+void init_implicit_solver(ImplicitSolver2 &solver, usize body_count, const Spring *springs, usize spring_count) {
+    init_implicit_solver_impl<ImplicitSolver2, Vec2>(solver, body_count, springs, spring_count);
+}
+
+void init_implicit_solver(ImplicitSolver3 &solver, usize body_count, const Spring *springs, usize spring_count) {
+    init_implicit_solver_impl<ImplicitSolver3, Vec3>(solver, body_count, springs, spring_count);
+}
+
+void deinit_implicit_solver(ImplicitSolver2 &solver) {
+    deinit_implicit_solver_impl(solver);
+}
+
+void deinit_implicit_solver(ImplicitSolver3 &solver) {
+    deinit_implicit_solver_impl(solver);
+}
+
+u32 integrate_implicit(ImplicitSolver2 &solver, Body2 *bodies, usize body_count, const Spring *springs,
+                       const Vec2 *external_accelerations, float dt) {
+    return integrate_implicit_impl<ImplicitSolver2, Body2, Vec2>(solver, bodies, body_count, springs,
+                                                                 external_accelerations, dt);
+}
+
+u32 integrate_implicit(ImplicitSolver3 &solver, Body3 *bodies, usize body_count, const Spring *springs,
+                       const Vec3 *external_accelerations, float dt) {
+    return integrate_implicit_impl<ImplicitSolver3, Body3, Vec3>(solver, bodies, body_count, springs,
+                                                                 external_accelerations, dt);
+}
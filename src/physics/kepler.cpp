@@ -0,0 +1,133 @@
+#include "physics/kepler.hpp"
+#include <cmath>
+
+static const u32 KEPLER_MAX_ITERATIONS = 64;
+static const f64 KEPLER_TOLERANCE = 1e-13;
+static const f64 KEPLER_TAU = 6.2831853071795864769252867665590;
+
+// Stumpff functions c2(z) = (1 - cos(sqrt(z))) / z and c3(z) = (sqrt(z) - sin(sqrt(z))) / sqrt(z)^3, with their
+// hyperbolic continuations for z < 0 and a series near zero where the closed forms cancel catastrophically
+static void stumpff(f64 z, f64 &c2, f64 &c3) {
+    if (z > 1e-3) {
+        f64 s = std::sqrt(z);
+        c2 = (1.0 - std::cos(s)) / z;
+        c3 = (s - std::sin(s)) / (z * s);
+    } else if (z < -1e-3) {
+        f64 s = std::sqrt(-z);
+        c2 = (std::cosh(s) - 1.0) / -z;
+        c3 = (std::sinh(s) - s) / (-z * s);
+    } else {
+        c2 = 1.0 / 2.0 - z * (1.0 / 24.0 - z * (1.0 / 720.0 - z / 40320.0));
+        c3 = 1.0 / 6.0 - z * (1.0 / 120.0 - z * (1.0 / 5040.0 - z / 362880.0));
+    }
+}
+
+static bool kepler_drift(f64 *x, f64 *v, f64 mu, f64 dt) {
+    if (mu <= 0.0) {
+        for (u32 k = 0; k < 3; k++) {
+            x[k] += v[k] * dt;
+        }
+        return true;
+    }
+
+    f64 r0 = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+    if (r0 <= 0.0) {
+        return false;
+    }
+
+    f64 v0_squared = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    f64 sqrt_mu = std::sqrt(mu);
+    f64 sigma0 = (x[0] * v[0] + x[1] * v[1] + x[2] * v[2]) / sqrt_mu;
+    f64 alpha = 2.0 / r0 - v0_squared / mu; // inverse semi-major axis
+    f64 beta = 1.0 - alpha * r0;
+
+    // Bound orbits repeat, so only the remainder of the step modulo the period needs solving
+    f64 t = dt;
+    if (alpha > 0.0) {
+        f64 period = KEPLER_TAU / (sqrt_mu * alpha * std::sqrt(alpha));
+        t = std::fmod(dt, period);
+    }
+
+    // Laguerre-Conway iteration on the universal Kepler equation; converges from crude guesses where Newton diverges
+    const f64 n = 5.0;
+    f64 chi = alpha > 0.0 ? sqrt_mu * t * alpha : sqrt_mu * t / r0;
+    f64 c2 = 0.5, c3 = 1.0 / 6.0, z = 0.0;
+    bool converged = false;
+
+    for (u32 iteration = 0; iteration < KEPLER_MAX_ITERATIONS; iteration++) {
+        f64 chi_squared = chi * chi;
+        z = alpha * chi_squared;
+        stumpff(z, c2, c3);
+
+        f64 f = r0 * chi + sigma0 * chi_squared * c2 + beta * chi_squared * chi * c3 - sqrt_mu * t;
+        f64 df = r0 + sigma0 * chi * (1.0 - z * c3) + beta * chi_squared * c2;
+        f64 ddf = sigma0 * (1.0 - z * c2) + beta * chi * (1.0 - z * c3);
+
+        f64 discriminant = std::sqrt(std::fabs((n - 1.0) * (n - 1.0) * df * df - n * (n - 1.0) * f * ddf));
+        f64 denominator = df + (df < 0.0 ? -discriminant : discriminant);
+        if (denominator == 0.0) {
+            break;
+        }
+
+        f64 delta = n * f / denominator;
+        chi -= delta;
+
+        if (std::fabs(delta) <= KEPLER_TOLERANCE * (1.0 + std::fabs(chi))) {
+            converged = true;
+            break;
+        }
+    }
+
+    if (!converged || !std::isfinite(chi)) {
+        return false;
+    }
+
+    f64 chi_squared = chi * chi;
+    z = alpha * chi_squared;
+    stumpff(z, c2, c3);
+
+    // Lagrange coefficients
+    f64 f = 1.0 - chi_squared * c2 / r0;
+    f64 g = t - chi_squared * chi * c3 / sqrt_mu;
+
+    f64 position[3];
+    for (u32 k = 0; k < 3; k++) {
+        position[k] = f * x[k] + g * v[k];
+    }
+
+    f64 r = std::sqrt(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+    f64 df = sqrt_mu / (r * r0) * chi * (z * c3 - 1.0);
+    f64 dg = 1.0 - chi_squared * c2 / r;
+
+    for (u32 k = 0; k < 3; k++) {
+        f64 velocity = df * x[k] + dg * v[k];
+        x[k] = position[k];
+        v[k] = velocity;
+    }
+
+    return true;
+}
+
+bool kepler_drift(Vec2 &position, Vec2 &velocity, f64 mu, f64 dt) {
+    f64 x[3] = {position.x, position.y, 0.0};
+    f64 v[3] = {velocity.x, velocity.y, 0.0};
+    if (!kepler_drift(x, v, mu, dt)) {
+        return false;
+    }
+
+    position = {(f32)x[0], (f32)x[1]};
+    velocity = {(f32)v[0], (f32)v[1]};
+    return true;
+}
+
+bool kepler_drift(Vec3 &position, Vec3 &velocity, f64 mu, f64 dt) {
+    f64 x[3] = {position.x, position.y, position.z};
+    f64 v[3] = {velocity.x, velocity.y, velocity.z};
+    if (!kepler_drift(x, v, mu, dt)) {
+        return false;
+    }
+
+    position = {(f32)x[0], (f32)x[1], (f32)x[2]};
+    velocity = {(f32)v[0], (f32)v[1], (f32)v[2]};
+    return true;
+}
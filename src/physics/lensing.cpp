@@ -0,0 +1,312 @@
+#include "physics/lensing.hpp"
+#include "common/parallel.hpp"
+#include "physics/collider.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize PHOTON_LANES = 64;
+static const usize PHOTON_BATCH = 256; // photons per parallel task, a multiple of PHOTON_LANES
+static const u32 DEFAULT_MAX_STEPS = 4096;
+static const f32 DEFAULT_STEP_FRACTION = 0.1f;
+static const f32 DEFAULT_MIN_STEP = 1.0e-5f; // of the region radius
+static const f32 DEFAULT_MAX_STEP = 0.05f;   // of the region radius
+static const f32 LENS_PADDING = 1.0e30f;     // distance reported when there are no lenses
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+// Lenses with mass, one array per axis plus G * m / c^2 and the squared capture radius
+template <u32 D> struct LensSet {
+    usize count;
+    f32 *positions[D];
+    f32 *strengths;
+    f32 *captures;
+};
+
+template <u32 D, typename Body>
+static LensSet<D> gather_lenses(const Body *lenses, usize lens_count, f32 speed_of_light) {
+    LensSet<D> set = {};
+    usize capacity = lens_count > 0 ? lens_count : 1;
+    for (u32 k = 0; k < D; k++) {
+        set.positions[k] = (f32 *)malloc(capacity * sizeof(f32));
+    }
+    set.strengths = (f32 *)malloc(capacity * sizeof(f32));
+    set.captures = (f32 *)malloc(capacity * sizeof(f32));
+
+    f32 inverse_c2 = 1.0f / (speed_of_light * speed_of_light);
+    for (usize j = 0; j < lens_count; j++) {
+        const Body &lens = lenses[j];
+        if (lens.mass <= 0.0f) continue;
+
+        f32 strength = GRAVITATIONAL_PARAMETER * lens.mass * inverse_c2;
+        f32 capture = std::fmax(bounding_radius(lens.shape), 2.0f * strength);
+        for (u32 k = 0; k < D; k++) {
+            set.positions[k][set.count] = axis(lens.transform.position, k);
+        }
+        set.strengths[set.count] = strength;
+        set.captures[set.count++] = capture * capture;
+    }
+    return set;
+}
+
+template <u32 D> static void free_lenses(LensSet<D> &set) {
+    for (u32 k = 0; k < D; k++) {
+        free(set.positions[k]);
+    }
+    free(set.strengths);
+    free(set.captures);
+}
+
+// Bending per unit length for each lane, 2 G m / c^2 / r^2 toward each lens with the part along the ray removed, and
+// the clearance to the nearest lens's capture radius (negative once inside it)
+template <u32 D>
+static void bend_lanes(const LensSet<D> &lenses, f32 (*position)[PHOTON_LANES], f32 (*direction)[PHOTON_LANES],
+                       usize count, f32 (*bend)[PHOTON_LANES], f32 *nearest, f32 *clearance) {
+    for (u32 k = 0; k < D; k++) {
+        for (usize l = 0; l < count; l++) {
+            bend[k][l] = 0.0f;
+        }
+    }
+    for (usize l = 0; l < count; l++) {
+        nearest[l] = LENS_PADDING;
+        clearance[l] = LENS_PADDING;
+    }
+
+    for (usize j = 0; j < lenses.count; j++) {
+        f32 lens[D], strength = 2.0f * lenses.strengths[j], capture = lenses.captures[j];
+        for (u32 k = 0; k < D; k++) {
+            lens[k] = lenses.positions[k][j];
+        }
+
+        for (usize l = 0; l < count; l++) {
+            f32 delta[D], distance_squared = 0.0f;
+            for (u32 k = 0; k < D; k++) {
+                delta[k] = lens[k] - position[k][l];
+                distance_squared += delta[k] * delta[k];
+            }
+            f32 safe = distance_squared > 0.0f ? distance_squared : 1.0f;
+            f32 inverse = 1.0f / std::sqrt(safe);
+            f32 scale = strength * inverse * inverse * inverse;
+            for (u32 k = 0; k < D; k++) {
+                bend[k][l] += delta[k] * scale;
+            }
+            f32 distance = safe * inverse, inside = distance_squared - capture;
+            nearest[l] = distance < nearest[l] ? distance : nearest[l];
+            clearance[l] = inside < clearance[l] ? inside : clearance[l];
+        }
+    }
+
+    for (usize l = 0; l < count; l++) {
+        f32 along = 0.0f;
+        for (u32 k = 0; k < D; k++) {
+            along += bend[k][l] * direction[k][l];
+        }
+        for (u32 k = 0; k < D; k++) {
+            bend[k][l] -= along * direction[k][l];
+        }
+    }
+}
+
+// Kick-drift-kick on the direction, with the bend at the end of one step reused at the start of the next
+template <u32 D, typename Bundle, typename Vec>
+static void trace_lane(Bundle &bundle, const LensSet<D> &lenses, Vec center, usize base, usize count) {
+    f32 position[D][PHOTON_LANES], direction[D][PHOTON_LANES], bend[D][PHOTON_LANES];
+    f32 nearest[PHOTON_LANES], clearance[PHOTON_LANES], step[PHOTON_LANES], moving[PHOTON_LANES];
+    PhotonState *states = bundle.states + base;
+    f32 radius2 = bundle.region_radius * bundle.region_radius;
+
+    for (u32 k = 0; k < D; k++) {
+        for (usize l = 0; l < count; l++) {
+            position[k][l] = bundle.positions[k][base + l];
+            direction[k][l] = bundle.directions[k][base + l];
+        }
+    }
+    bend_lanes(lenses, position, direction, count, bend, nearest, clearance);
+
+    for (u32 iteration = 0; iteration < bundle.max_steps; iteration++) {
+        // Retire rays that left the region heading outward or fell into a lens; the others take a step
+        usize traveling = 0;
+        for (usize l = 0; l < count; l++) {
+            f32 offset2 = 0.0f, outward = 0.0f;
+            for (u32 k = 0; k < D; k++) {
+                f32 offset = position[k][l] - axis(center, k);
+                offset2 += offset * offset;
+                outward += offset * direction[k][l];
+            }
+            bool escaped = offset2 > radius2 && outward > 0.0f;
+            bool captured = clearance[l] < 0.0f;
+            if (states[l] == PhotonState::Traveling) {
+                states[l] = escaped ? PhotonState::Escaped : captured ? PhotonState::Captured : states[l];
+            }
+            moving[l] = states[l] == PhotonState::Traveling ? 1.0f : 0.0f;
+            traveling += states[l] == PhotonState::Traveling;
+        }
+        if (traveling == 0) break;
+
+        for (usize l = 0; l < count; l++) {
+            f32 length = nearest[l] * bundle.step_fraction;
+            length = length > bundle.min_step ? length : bundle.min_step;
+            length = length < bundle.max_step ? length : bundle.max_step;
+            step[l] = length * moving[l];
+        }
+
+        for (u32 k = 0; k < D; k++) {
+            for (usize l = 0; l < count; l++) {
+                direction[k][l] += bend[k][l] * (0.5f * step[l]);
+                position[k][l] += direction[k][l] * step[l];
+            }
+        }
+        bend_lanes(lenses, position, direction, count, bend, nearest, clearance);
+
+        for (usize l = 0; l < count; l++) {
+            f32 norm2 = 0.0f;
+            for (u32 k = 0; k < D; k++) {
+                direction[k][l] += bend[k][l] * (0.5f * step[l]);
+                norm2 += direction[k][l] * direction[k][l];
+            }
+            f32 inverse = 1.0f / std::sqrt(norm2);
+            for (u32 k = 0; k < D; k++) {
+                direction[k][l] *= inverse;
+            }
+        }
+    }
+
+    for (u32 k = 0; k < D; k++) {
+        for (usize l = 0; l < count; l++) {
+            bundle.positions[k][base + l] = position[k][l];
+            bundle.directions[k][base + l] = direction[k][l];
+        }
+    }
+}
+
+template <u32 D, typename Bundle, typename Vec>
+static void init_photon_bundle_impl(Bundle &bundle, f32 speed_of_light, Vec region_center, f32 region_radius) {
+    bundle = {};
+    bundle.speed_of_light = speed_of_light;
+    bundle.region_center = region_center;
+    bundle.region_radius = region_radius;
+    bundle.step_fraction = DEFAULT_STEP_FRACTION;
+    bundle.min_step = DEFAULT_MIN_STEP * region_radius;
+    bundle.max_step = DEFAULT_MAX_STEP * region_radius;
+    bundle.max_steps = DEFAULT_MAX_STEPS;
+}
+
+template <u32 D, typename Bundle> static void deinit_photon_bundle_impl(Bundle &bundle) {
+    for (u32 k = 0; k < D; k++) {
+        free(bundle.positions[k]);
+        free(bundle.directions[k]);
+    }
+    free(bundle.states);
+
+    bundle = {};
+}
+
+template <u32 D, typename Bundle> static void reserve_photons(Bundle &bundle, usize count) {
+    if (count <= bundle.photon_capacity) return;
+
+    usize capacity = count > bundle.photon_capacity * 2 ? count : bundle.photon_capacity * 2;
+    bundle.photon_capacity = capacity;
+    for (u32 k = 0; k < D; k++) {
+        bundle.positions[k] = (f32 *)realloc(bundle.positions[k], capacity * sizeof(f32));
+        bundle.directions[k] = (f32 *)realloc(bundle.directions[k], capacity * sizeof(f32));
+    }
+    bundle.states = (PhotonState *)realloc(bundle.states, capacity * sizeof(PhotonState));
+}
+
+template <u32 D, typename Bundle, typename Vec>
+static void add_photon_impl(Bundle &bundle, Vec position, Vec direction) {
+    reserve_photons<D>(bundle, bundle.photon_count + 1);
+    usize i = bundle.photon_count++;
+    f32 length = direction.length();
+    f32 inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    for (u32 k = 0; k < D; k++) {
+        bundle.positions[k][i] = axis(position, k);
+        bundle.directions[k][i] = axis(direction, k) * inverse;
+    }
+    bundle.states[i] = PhotonState::Traveling;
+}
+
+template <u32 D, typename Bundle, typename Body>
+static void trace_photons_impl(Bundle &bundle, const Body *lenses, usize lens_count) {
+    LensSet<D> set = gather_lenses<D>(lenses, lens_count, bundle.speed_of_light);
+    parallel_for(bundle.photon_count, PHOTON_BATCH, [&](usize begin, usize end) {
+        for (usize base = begin; base < end; base += PHOTON_LANES) {
+            usize count = end - base < PHOTON_LANES ? end - base : PHOTON_LANES;
+            trace_lane<D>(bundle, set, bundle.region_center, base, count);
+        }
+    });
+    free_lenses(set);
+}
+
+void init_photon_bundle(PhotonBundle2 &bundle, float speed_of_light, Vec2 region_center, float region_radius) {
+    init_photon_bundle_impl<2>(bundle, speed_of_light, region_center, region_radius);
+}
+
+void init_photon_bundle(PhotonBundle3 &bundle, float speed_of_light, Vec3 region_center, float region_radius) {
+    init_photon_bundle_impl<3>(bundle, speed_of_light, region_center, region_radius);
+}
+
+void deinit_photon_bundle(PhotonBundle2 &bundle) {
+    deinit_photon_bundle_impl<2>(bundle);
+}
+
+void deinit_photon_bundle(PhotonBundle3 &bundle) {
+    deinit_photon_bundle_impl<3>(bundle);
+}
+
+void clear_photons(PhotonBundle2 &bundle) {
+    bundle.photon_count = 0;
+}
+
+void clear_photons(PhotonBundle3 &bundle) {
+    bundle.photon_count = 0;
+}
+
+void add_photon(PhotonBundle2 &bundle, Vec2 position, Vec2 direction) {
+    add_photon_impl<2>(bundle, position, direction);
+}
+
+void add_photon(PhotonBundle3 &bundle, Vec3 position, Vec3 direction) {
+    add_photon_impl<3>(bundle, position, direction);
+}
+
+void add_camera_photons(PhotonBundle3 &bundle, Vec3 eye, Vec3 forward, Vec3 up, float vertical_field_of_view,
+                        u32 width, u32 height) {
+    usize first = bundle.photon_count, count = (usize)width * height;
+    reserve_photons<3>(bundle, first + count);
+    bundle.photon_count = first + count;
+
+    Vec3 ahead = forward.normalize();
+    Vec3 right = ahead.cross(up).normalize();
+    Vec3 above = right.cross(ahead);
+    f32 half_height = std::tan(0.5f * vertical_field_of_view);
+    f32 half_width = half_height * (f32)width / (f32)(height > 0 ? height : 1);
+
+    parallel_for(count, PHOTON_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            u32 x = (u32)(i % width), y = (u32)(i / width);
+            f32 u = ((x + 0.5f) / width * 2.0f - 1.0f) * half_width;
+            f32 v = (1.0f - (y + 0.5f) / height * 2.0f) * half_height;
+            Vec3 direction = (ahead + right * u + above * v).normalize();
+
+            usize p = first + i;
+            bundle.positions[0][p] = eye.x, bundle.positions[1][p] = eye.y, bundle.positions[2][p] = eye.z;
+            bundle.directions[0][p] = direction.x, bundle.directions[1][p] = direction.y;
+            bundle.directions[2][p] = direction.z;
+            bundle.states[p] = PhotonState::Traveling;
+        }
+    });
+}
+
+void trace_photons(PhotonBundle2 &bundle, const Body2 *lenses, usize lens_count) {
+    trace_photons_impl<2>(bundle, lenses, lens_count);
+}
+
+void trace_photons(PhotonBundle3 &bundle, const Body3 *lenses, usize lens_count) {
+    trace_photons_impl<3>(bundle, lenses, lens_count);
+}
@@ -0,0 +1,567 @@
+#include "physics/narrowphase.hpp"
+#include "common/parallel.hpp"
+#include "math/constants.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const usize NARROW_LANES = 256;
+
+// Kernel output, in the frame the kernel works in
+struct Lanes2 {
+    f32 nx[NARROW_LANES], ny[NARROW_LANES];
+    f32 px[NARROW_LANES], py[NARROW_LANES];
+    f32 depth[NARROW_LANES];
+};
+
+struct Lanes3 {
+    f32 nx[NARROW_LANES], ny[NARROW_LANES], nz[NARROW_LANES];
+    f32 px[NARROW_LANES], py[NARROW_LANES], pz[NARROW_LANES];
+    f32 depth[NARROW_LANES];
+};
+
+// Plain comparisons rather than fmin/fmax, whose NaN handling keeps the kernels from vectorizing
+static inline f32 lane_min(f32 a, f32 b) {
+    return a < b ? a : b;
+}
+
+static inline f32 lane_max(f32 a, f32 b) {
+    return a > b ? a : b;
+}
+
+static inline f32 clamp01(f32 value) {
+    return lane_min(lane_max(value, 0.0f), 1.0f);
+}
+
+// Appends the pair as given, keeping the body order the bucket expects
+static void append_pair(PairBuffer &buffer, u32 a, u32 b) {
+    if (buffer.count == buffer.capacity) {
+        buffer.capacity = buffer.capacity ? buffer.capacity * 2 : 256;
+        buffer.pairs = (BroadphasePair *)realloc(buffer.pairs, buffer.capacity * sizeof(BroadphasePair));
+    }
+    buffer.pairs[buffer.count++] = {a, b};
+}
+
+// The primitive kernels touch at a single point, so their contacts have no patch
+static u32 emit_contacts(const Lanes2 &lanes, const BroadphasePair *pairs, usize count, Contact2 *out) {
+    u32 hits = 0;
+    for (usize i = 0; i < count; i++) {
+        if (lanes.depth[i] < 0.0f) continue;
+        out[hits++] = {pairs[i].a, pairs[i].b, {lanes.nx[i], lanes.ny[i]}, {lanes.px[i], lanes.py[i]}, lanes.depth[i],
+                       0.0f};
+    }
+    return hits;
+}
+
+static u32 emit_contacts(const Lanes3 &lanes, const BroadphasePair *pairs, usize count, Contact3 *out) {
+    u32 hits = 0;
+    for (usize i = 0; i < count; i++) {
+        if (lanes.depth[i] < 0.0f) continue;
+        out[hits++] = {pairs[i].a,
+                       pairs[i].b,
+                       {lanes.nx[i], lanes.ny[i], lanes.nz[i]},
+                       {lanes.px[i], lanes.py[i], lanes.pz[i]},
+                       lanes.depth[i],
+                       0.0f};
+    }
+    return hits;
+}
+
+static u32 circle_circle(const Body2 *bodies, const BroadphasePair *pairs, usize count, Contact2 *out) {
+    f32 ax[NARROW_LANES], ay[NARROW_LANES], bx[NARROW_LANES], by[NARROW_LANES];
+    f32 ra[NARROW_LANES], rb[NARROW_LANES];
+    Lanes2 lanes;
+
+    for (usize i = 0; i < count; i++) {
+        const Body2 &a = bodies[pairs[i].a];
+        const Body2 &b = bodies[pairs[i].b];
+        ax[i] = a.transform.position.x;
+        ay[i] = a.transform.position.y;
+        bx[i] = b.transform.position.x;
+        by[i] = b.transform.position.y;
+        ra[i] = a.shape.circle.radius;
+        rb[i] = b.shape.circle.radius;
+    }
+
+    for (usize i = 0; i < count; i++) {
+        f32 dx = bx[i] - ax[i], dy = by[i] - ay[i];
+        f32 distance = std::sqrt(dx * dx + dy * dy);
+        f32 inverse = 1.0f / lane_max(distance, EPSILON);
+        bool coincident = distance < EPSILON;
+
+        f32 nx = coincident ? 1.0f : dx * inverse;
+        f32 ny = coincident ? 0.0f : dy * inverse;
+        f32 depth = ra[i] + rb[i] - distance;
+
+        lanes.nx[i] = nx;
+        lanes.ny[i] = ny;
+        lanes.px[i] = ax[i] + nx * (ra[i] - 0.5f * depth);
+        lanes.py[i] = ay[i] + ny * (ra[i] - 0.5f * depth);
+        lanes.depth[i] = depth;
+    }
+
+    return emit_contacts(lanes, pairs, count, out);
+}
+
+// The circle center is taken into the rectangle's frame, and the results are rotated back out
+static u32 circle_rectangle(const Body2 *bodies, const BroadphasePair *pairs, usize count, Contact2 *out) {
+    f32 lx[NARROW_LANES], ly[NARROW_LANES], hx[NARROW_LANES], hy[NARROW_LANES], radius[NARROW_LANES];
+    Lanes2 lanes;
+
+    for (usize i = 0; i < count; i++) {
+        const Body2 &a = bodies[pairs[i].a];
+        const Body2 &b = bodies[pairs[i].b];
+        Vec2 local = b.transform.rotation.reverse().rotate(a.transform.position - b.transform.position);
+        lx[i] = local.x;
+        ly[i] = local.y;
+        hx[i] = b.shape.rectangle.half_size.x;
+        hy[i] = b.shape.rectangle.half_size.y;
+        radius[i] = a.shape.circle.radius;
+    }
+
+    for (usize i = 0; i < count; i++) {
+        f32 qx = lane_min(lane_max(lx[i], -hx[i]), hx[i]);
+        f32 qy = lane_min(lane_max(ly[i], -hy[i]), hy[i]);
+        f32 dx = qx - lx[i], dy = qy - ly[i];
+        f32 distance = std::sqrt(dx * dx + dy * dy);
+        f32 inverse = 1.0f / lane_max(distance, EPSILON);
+
+        // A center inside the rectangle is pushed out through the nearest face
+        bool inside = distance < EPSILON;
+        f32 gap_x = hx[i] - std::fabs(lx[i]);
+        f32 gap_y = hy[i] - std::fabs(ly[i]);
+        bool use_x = gap_x < gap_y;
+        f32 face_x = use_x ? (lx[i] < 0.0f ? 1.0f : -1.0f) : 0.0f;
+        f32 face_y = use_x ? 0.0f : (ly[i] < 0.0f ? 1.0f : -1.0f);
+
+        f32 nx = inside ? face_x : dx * inverse;
+        f32 ny = inside ? face_y : dy * inverse;
+        f32 depth = inside ? radius[i] + lane_min(gap_x, gap_y) : radius[i] - distance;
+
+        lanes.nx[i] = nx;
+        lanes.ny[i] = ny;
+        lanes.px[i] = lx[i] + nx * (radius[i] - 0.5f * depth);
+        lanes.py[i] = ly[i] + ny * (radius[i] - 0.5f * depth);
+        lanes.depth[i] = depth;
+    }
+
+    for (usize i = 0; i < count; i++) {
+        const Transform2 &transform = bodies[pairs[i].b].transform;
+        Vec2 normal = transform.rotation.rotate({lanes.nx[i], lanes.ny[i]});
+        Vec2 point = transform.position + transform.rotation.rotate({lanes.px[i], lanes.py[i]});
+        lanes.nx[i] = normal.x;
+        lanes.ny[i] = normal.y;
+        lanes.px[i] = point.x;
+        lanes.py[i] = point.y;
+    }
+
+    return emit_contacts(lanes, pairs, count, out);
+}
+
+// Segment from `start` along `direction`; circles are zero-length segments
+static void capsule_segment(const Body2 &body, Vec2 &start, Vec2 &direction, f32 &radius) {
+    if (body.shape.kind == ShapeKind2::Capsule) {
+        Vec2 half = body.transform.rotation.rotate({0.0f, body.shape.capsule.half_length});
+        start = body.transform.position - half;
+        direction = half * 2.0f;
+        radius = body.shape.capsule.radius;
+    } else {
+        start = body.transform.position;
+        direction = Vec2::ZERO();
+        radius = body.shape.circle.radius;
+    }
+}
+
+static u32 capsule_capsule(const Body2 *bodies, const BroadphasePair *pairs, usize count, Contact2 *out) {
+    f32 p1x[NARROW_LANES], p1y[NARROW_LANES], d1x[NARROW_LANES], d1y[NARROW_LANES], ra[NARROW_LANES];
+    f32 p2x[NARROW_LANES], p2y[NARROW_LANES], d2x[NARROW_LANES], d2y[NARROW_LANES], rb[NARROW_LANES];
+    Lanes2 lanes;
+
+    for (usize i = 0; i < count; i++) {
+        Vec2 start, direction;
+        capsule_segment(bodies[pairs[i].a], start, direction, ra[i]);
+        p1x[i] = start.x;
+        p1y[i] = start.y;
+        d1x[i] = direction.x;
+        d1y[i] = direction.y;
+
+        capsule_segment(bodies[pairs[i].b], start, direction, rb[i]);
+        p2x[i] = start.x;
+        p2y[i] = start.y;
+        d2x[i] = direction.x;
+        d2y[i] = direction.y;
+    }
+
+    // Closest points between the segments, then a circle-circle test between them
+    for (usize i = 0; i < count; i++) {
+        f32 rx = p1x[i] - p2x[i], ry = p1y[i] - p2y[i];
+        f32 a = d1x[i] * d1x[i] + d1y[i] * d1y[i];
+        f32 e = d2x[i] * d2x[i] + d2y[i] * d2y[i];
+        f32 b = d1x[i] * d2x[i] + d1y[i] * d2y[i];
+        f32 c = d1x[i] * rx + d1y[i] * ry;
+        f32 f = d2x[i] * rx + d2y[i] * ry;
+        f32 denominator = a * e - b * b;
+
+        // Parallel segments fall back to the start of the first. A zero-length second segment is a point, so the first
+        // is clamped toward it; a zero-length first one has b and c equal to zero and is handled by the t clamp below.
+        bool parallel = denominator <= EPSILON * a * e;
+        bool second_point = e <= EPSILON;
+        f32 s_point = second_point ? clamp01(-c / (a > 0.0f ? a : 1.0f)) : 0.0f;
+        f32 s = parallel ? s_point : clamp01((b * f - c * e) / (parallel ? 1.0f : denominator));
+        f32 t_free = second_point ? 0.0f : (b * s + f) / (second_point ? 1.0f : e);
+        f32 t = clamp01(t_free);
+        s = t != t_free ? clamp01((b * t - c) / (a > 0.0f ? a : 1.0f)) : s;
+
+        f32 c1x = p1x[i] + d1x[i] * s, c1y = p1y[i] + d1y[i] * s;
+        f32 dx = p2x[i] + d2x[i] * t - c1x, dy = p2y[i] + d2y[i] * t - c1y;
+        f32 distance = std::sqrt(dx * dx + dy * dy);
+        f32 inverse = 1.0f / lane_max(distance, EPSILON);
+
+        // Crossing segments separate along the perpendicular of the first one
+        f32 length = std::sqrt(a);
+        bool coincident = distance < EPSILON;
+        bool degenerate = length < EPSILON;
+        f32 fallback_x = degenerate ? 1.0f : -d1y[i] / lane_max(length, EPSILON);
+        f32 fallback_y = degenerate ? 0.0f : d1x[i] / lane_max(length, EPSILON);
+
+        f32 nx = coincident ? fallback_x : dx * inverse;
+        f32 ny = coincident ? fallback_y : dy * inverse;
+        f32 depth = ra[i] + rb[i] - distance;
+
+        lanes.nx[i] = nx;
+        lanes.ny[i] = ny;
+        lanes.px[i] = c1x + nx * (ra[i] - 0.5f * depth);
+        lanes.py[i] = c1y + ny * (ra[i] - 0.5f * depth);
+        lanes.depth[i] = depth;
+    }
+
+    return emit_contacts(lanes, pairs, count, out);
+}
+
+static u32 sphere_sphere(const Body3 *bodies, const BroadphasePair *pairs, usize count, Contact3 *out) {
+    f32 ax[NARROW_LANES], ay[NARROW_LANES], az[NARROW_LANES];
+    f32 bx[NARROW_LANES], by[NARROW_LANES], bz[NARROW_LANES];
+    f32 ra[NARROW_LANES], rb[NARROW_LANES];
+    Lanes3 lanes;
+
+    for (usize i = 0; i < count; i++) {
+        const Body3 &a = bodies[pairs[i].a];
+        const Body3 &b = bodies[pairs[i].b];
+        ax[i] = a.transform.position.x;
+        ay[i] = a.transform.position.y;
+        az[i] = a.transform.position.z;
+        bx[i] = b.transform.position.x;
+        by[i] = b.transform.position.y;
+        bz[i] = b.transform.position.z;
+        ra[i] = a.shape.sphere.radius;
+        rb[i] = b.shape.sphere.radius;
+    }
+
+    for (usize i = 0; i < count; i++) {
+        f32 dx = bx[i] - ax[i], dy = by[i] - ay[i], dz = bz[i] - az[i];
+        f32 distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        f32 inverse = 1.0f / lane_max(distance, EPSILON);
+        bool coincident = distance < EPSILON;
+
+        f32 nx = coincident ? 1.0f : dx * inverse;
+        f32 ny = coincident ? 0.0f : dy * inverse;
+        f32 nz = coincident ? 0.0f : dz * inverse;
+        f32 depth = ra[i] + rb[i] - distance;
+
+        lanes.nx[i] = nx;
+        lanes.ny[i] = ny;
+        lanes.nz[i] = nz;
+        lanes.px[i] = ax[i] + nx * (ra[i] - 0.5f * depth);
+        lanes.py[i] = ay[i] + ny * (ra[i] - 0.5f * depth);
+        lanes.pz[i] = az[i] + nz * (ra[i] - 0.5f * depth);
+        lanes.depth[i] = depth;
+    }
+
+    return emit_contacts(lanes, pairs, count, out);
+}
+
+static u32 sphere_cuboid(const Body3 *bodies, const BroadphasePair *pairs, usize count, Contact3 *out) {
+    f32 lx[NARROW_LANES], ly[NARROW_LANES], lz[NARROW_LANES];
+    f32 hx[NARROW_LANES], hy[NARROW_LANES], hz[NARROW_LANES], radius[NARROW_LANES];
+    Lanes3 lanes;
+
+    for (usize i = 0; i < count; i++) {
+        const Body3 &a = bodies[pairs[i].a];
+        const Body3 &b = bodies[pairs[i].b];
+        Vec3 local = b.transform.rotation.reverse().rotate(a.transform.position - b.transform.position);
+        lx[i] = local.x;
+        ly[i] = local.y;
+        lz[i] = local.z;
+        hx[i] = b.shape.cuboid.half_size.x;
+        hy[i] = b.shape.cuboid.half_size.y;
+        hz[i] = b.shape.cuboid.half_size.z;
+        radius[i] = a.shape.sphere.radius;
+    }
+
+    for (usize i = 0; i < count; i++) {
+        f32 qx = lane_min(lane_max(lx[i], -hx[i]), hx[i]);
+        f32 qy = lane_min(lane_max(ly[i], -hy[i]), hy[i]);
+        f32 qz = lane_min(lane_max(lz[i], -hz[i]), hz[i]);
+        f32 dx = qx - lx[i], dy = qy - ly[i], dz = qz - lz[i];
+        f32 distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        f32 inverse = 1.0f / lane_max(distance, EPSILON);
+
+        bool inside = distance < EPSILON;
+        f32 gap_x = hx[i] - std::fabs(lx[i]);
+        f32 gap_y = hy[i] - std::fabs(ly[i]);
+        f32 gap_z = hz[i] - std::fabs(lz[i]);
+        bool use_x = gap_x <= lane_min(gap_y, gap_z);
+        bool use_y = !use_x & (gap_y <= gap_z);
+        bool use_z = !use_x & !use_y;
+        f32 face_x = use_x ? (lx[i] < 0.0f ? 1.0f : -1.0f) : 0.0f;
+        f32 face_y = use_y ? (ly[i] < 0.0f ? 1.0f : -1.0f) : 0.0f;
+        f32 face_z = use_z ? (lz[i] < 0.0f ? 1.0f : -1.0f) : 0.0f;
+        f32 gap = lane_min(gap_x, lane_min(gap_y, gap_z));
+
+        f32 nx = inside ? face_x : dx * inverse;
+        f32 ny = inside ? face_y : dy * inverse;
+        f32 nz = inside ? face_z : dz * inverse;
+        f32 depth = inside ? radius[i] + gap : radius[i] - distance;
+
+        lanes.nx[i] = nx;
+        lanes.ny[i] = ny;
+        lanes.nz[i] = nz;
+        lanes.px[i] = lx[i] + nx * (radius[i] - 0.5f * depth);
+        lanes.py[i] = ly[i] + ny * (radius[i] - 0.5f * depth);
+        lanes.pz[i] = lz[i] + nz * (radius[i] - 0.5f * depth);
+        lanes.depth[i] = depth;
+    }
+
+    for (usize i = 0; i < count; i++) {
+        const Transform3 &transform = bodies[pairs[i].b].transform;
+        Vec3 normal = transform.rotation.rotate({lanes.nx[i], lanes.ny[i], lanes.nz[i]});
+        Vec3 point = transform.position + transform.rotation.rotate({lanes.px[i], lanes.py[i], lanes.pz[i]});
+        lanes.nx[i] = normal.x;
+        lanes.ny[i] = normal.y;
+        lanes.nz[i] = normal.z;
+        lanes.px[i] = point.x;
+        lanes.py[i] = point.y;
+        lanes.pz[i] = point.z;
+    }
+
+    return emit_contacts(lanes, pairs, count, out);
+}
+
+// Bucket of a pair and whether its bodies must be swapped into the bucket's order; -1 without a kernel
+static i32 contact_bucket(ShapeKind2 a, ShapeKind2 b, bool &swap) {
+    swap = false;
+    if (a == ShapeKind2::Circle && b == ShapeKind2::Circle) return (i32)ContactBucket2::CircleCircle;
+
+    if (a == ShapeKind2::Circle && b == ShapeKind2::Rectangle) return (i32)ContactBucket2::CircleRectangle;
+    if (a == ShapeKind2::Rectangle && b == ShapeKind2::Circle) {
+        swap = true;
+        return (i32)ContactBucket2::CircleRectangle;
+    }
+
+    bool round_a = a == ShapeKind2::Circle || a == ShapeKind2::Capsule;
+    bool round_b = b == ShapeKind2::Circle || b == ShapeKind2::Capsule;
+    if (round_a && round_b) return (i32)ContactBucket2::CapsuleCapsule;
+
+    if (a == ShapeKind2::None || b == ShapeKind2::None) return -1;
+    return (i32)ContactBucket2::Convex;
+}
+
+static i32 contact_bucket(ShapeKind3 a, ShapeKind3 b, bool &swap) {
+    swap = false;
+    if (a == ShapeKind3::Sphere && b == ShapeKind3::Sphere) return (i32)ContactBucket3::SphereSphere;
+
+    if (a == ShapeKind3::Sphere && b == ShapeKind3::Cuboid) return (i32)ContactBucket3::SphereCuboid;
+    if (a == ShapeKind3::Cuboid && b == ShapeKind3::Sphere) {
+        swap = true;
+        return (i32)ContactBucket3::SphereCuboid;
+    }
+
+    if (a == ShapeKind3::None || b == ShapeKind3::None) return -1;
+    return (i32)ContactBucket3::Convex;
+}
+
+// GJK/EPA for the pairs without a dedicated kernel, one pair at a time, each warm started from its cached simplex
+template <typename Query, typename Body, typename Cache, typename Contact>
+static u32 convex_contacts(const Body *bodies, const BroadphasePair *pairs, usize count, Cache *caches, Contact *out) {
+    u32 hits = 0;
+    for (usize i = 0; i < count; i++) {
+        const Body &a = bodies[pairs[i].a];
+        const Body &b = bodies[pairs[i].b];
+        Query query;
+        if (!query_convex(a.shape, a.transform, b.shape, b.transform, caches + i, query)) continue;
+        if (!query.overlapping) continue;
+
+        out[hits++] = {pairs[i].a, pairs[i].b, query.normal, (query.point_a + query.point_b) * 0.5f, query.distance,
+                       query.patch_radius};
+    }
+    return hits;
+}
+
+// Lines the simplex caches up with this step's convex bucket, carrying over the entries of pairs that persist
+template <typename Narrowphase> static void carry_simplex_caches(Narrowphase &narrowphase, const PairBuffer &convex) {
+    auto swap = narrowphase.caches;
+    narrowphase.caches = narrowphase.previous_caches;
+    narrowphase.previous_caches = swap;
+
+    if (convex.count > narrowphase.cache_capacity) {
+        narrowphase.cache_capacity = convex.count + convex.count / 2;
+        usize size = narrowphase.cache_capacity * sizeof(*narrowphase.caches);
+        narrowphase.caches = (decltype(narrowphase.caches))realloc(narrowphase.caches, size);
+        narrowphase.previous_caches = (decltype(narrowphase.caches))realloc(narrowphase.previous_caches, size);
+    }
+
+    for (usize i = 0; i < convex.count; i++) {
+        const u32 *previous = pair_table_find(narrowphase.cache_table, convex.pairs[i].a, convex.pairs[i].b);
+        if (previous) {
+            narrowphase.caches[i] = narrowphase.previous_caches[*previous];
+        } else {
+            narrowphase.caches[i].count = 0;
+        }
+    }
+
+    clear_pair_table(narrowphase.cache_table);
+    for (usize i = 0; i < convex.count; i++) {
+        *pair_table_insert(narrowphase.cache_table, convex.pairs[i].a, convex.pairs[i].b) = (u32)i;
+    }
+}
+
+// Pairs involving a sleeper that neither body can disturb, which the contact solver would not wake either
+template <typename Body> static inline bool is_resting_pair(const Body &a, const Body &b) {
+    return (a.sleeping || b.sleeping) && !can_disturb(a) && !can_disturb(b);
+}
+
+// Writes the contacts of up to NARROW_LANES pairs to `out`, returning how many there are
+typedef u32 (*ContactKernel2)(const Body2 *bodies, const BroadphasePair *pairs, usize count, Contact2 *out);
+typedef u32 (*ContactKernel3)(const Body3 *bodies, const BroadphasePair *pairs, usize count, Contact3 *out);
+
+// `kernels` covers the buckets before `convex_bucket`, the last one
+template <typename Contact, typename Query, typename Narrowphase, typename Body, typename Kernel>
+static usize generate_contacts_impl(Narrowphase &narrowphase, const Body *bodies, const BroadphasePair *pairs,
+                                    usize pair_count, const Kernel *kernels, usize convex_bucket) {
+    usize bucket_count = convex_bucket + 1;
+    for (usize bucket = 0; bucket < bucket_count; bucket++) {
+        narrowphase.buckets[bucket].count = 0;
+    }
+
+    for (usize p = 0; p < pair_count; p++) {
+        if (is_resting_pair(bodies[pairs[p].a], bodies[pairs[p].b])) continue;
+
+        bool swap;
+        i32 bucket = contact_bucket(bodies[pairs[p].a].shape.kind, bodies[pairs[p].b].shape.kind, swap);
+        if (bucket < 0) continue;
+
+        if (swap) {
+            append_pair(narrowphase.buckets[bucket], pairs[p].b, pairs[p].a);
+        } else {
+            append_pair(narrowphase.buckets[bucket], pairs[p].a, pairs[p].b);
+        }
+    }
+
+    carry_simplex_caches(narrowphase, narrowphase.buckets[convex_bucket]);
+
+    usize bucketed_count = 0;
+    usize chunk_count = 0;
+    for (usize bucket = 0; bucket < bucket_count; bucket++) {
+        bucketed_count += narrowphase.buckets[bucket].count;
+        chunk_count += parallel_chunk_count(narrowphase.buckets[bucket].count, NARROW_LANES);
+    }
+
+    if (bucketed_count > narrowphase.contact_capacity) {
+        narrowphase.contact_capacity = bucketed_count + bucketed_count / 2;
+        narrowphase.contacts =
+            (Contact *)realloc(narrowphase.contacts, narrowphase.contact_capacity * sizeof(Contact));
+    }
+    if (chunk_count > narrowphase.chunk_capacity) {
+        narrowphase.chunk_capacity = chunk_count;
+        narrowphase.chunk_counts = (u32 *)realloc(narrowphase.chunk_counts, chunk_count * sizeof(u32));
+    }
+
+    // Every lane writes its hits at the start of its own slot range, which are then packed in order
+    usize pair_offset = 0;
+    usize chunk_offset = 0;
+    for (usize bucket = 0; bucket < bucket_count; bucket++) {
+        const PairBuffer &buffer = narrowphase.buckets[bucket];
+        Contact *out = narrowphase.contacts + pair_offset;
+        u32 *counts = narrowphase.chunk_counts + chunk_offset;
+
+        if (bucket == convex_bucket) {
+            auto caches = narrowphase.caches;
+            parallel_for(buffer.count, NARROW_LANES, [&](usize begin, usize end) {
+                counts[begin / NARROW_LANES] =
+                    convex_contacts<Query>(bodies, buffer.pairs + begin, end - begin, caches + begin, out + begin);
+            });
+        } else {
+            auto kernel = kernels[bucket];
+            parallel_for(buffer.count, NARROW_LANES, [&](usize begin, usize end) {
+                counts[begin / NARROW_LANES] = kernel(bodies, buffer.pairs + begin, end - begin, out + begin);
+            });
+        }
+
+        pair_offset += buffer.count;
+        chunk_offset += parallel_chunk_count(buffer.count, NARROW_LANES);
+    }
+
+    usize contact_count = 0;
+    pair_offset = 0;
+    chunk_offset = 0;
+    for (usize bucket = 0; bucket < bucket_count; bucket++) {
+        usize count = narrowphase.buckets[bucket].count;
+        usize chunks = parallel_chunk_count(count, NARROW_LANES);
+
+        for (usize c = 0; c < chunks; c++) {
+            u32 hits = narrowphase.chunk_counts[chunk_offset + c];
+            memmove(narrowphase.contacts + contact_count, narrowphase.contacts + pair_offset + c * NARROW_LANES,
+                    hits * sizeof(Contact));
+            contact_count += hits;
+        }
+
+        pair_offset += count;
+        chunk_offset += chunks;
+    }
+
+    narrowphase.contact_count = contact_count;
+    return contact_count;
+}
+
+template <typename Narrowphase> static void deinit_narrowphase_impl(Narrowphase &narrowphase, usize bucket_count) {
+    for (usize bucket = 0; bucket < bucket_count; bucket++) {
+        free(narrowphase.buckets[bucket].pairs);
+    }
+
+    deinit_pair_table(narrowphase.cache_table);
+    free(narrowphase.caches);
+    free(narrowphase.previous_caches);
+
+    free(narrowphase.chunk_counts);
+    free(narrowphase.contacts);
+
+    narrowphase = {};
+}
+
+void init_narrowphase(Narrowphase2 &narrowphase) {
+    narrowphase = {};
+}
+
+void init_narrowphase(Narrowphase3 &narrowphase) {
+    narrowphase = {};
+}
+
+void deinit_narrowphase(Narrowphase2 &narrowphase) {
+    deinit_narrowphase_impl(narrowphase, (usize)ContactBucket2::Count);
+}
+
+void deinit_narrowphase(Narrowphase3 &narrowphase) {
+    deinit_narrowphase_impl(narrowphase, (usize)ContactBucket3::Count);
+}
+
+usize generate_contacts(Narrowphase2 &narrowphase, const Body2 *bodies, const BroadphasePair *pairs, usize pair_count) {
+    static const ContactKernel2 kernels[] = {circle_circle, circle_rectangle, capsule_capsule};
+    return generate_contacts_impl<Contact2, ConvexQuery2>(narrowphase, bodies, pairs, pair_count, kernels,
+                                                          (usize)ContactBucket2::Convex);
+}
+
+usize generate_contacts(Narrowphase3 &narrowphase, const Body3 *bodies, const BroadphasePair *pairs, usize pair_count) {
+    static const ContactKernel3 kernels[] = {sphere_sphere, sphere_cuboid};
+    return generate_contacts_impl<Contact3, ConvexQuery3>(narrowphase, bodies, pairs, pair_count, kernels,
+                                                          (usize)ContactBucket3::Convex);
+}
@@ -0,0 +1,299 @@
+#include "physics/orbit_predictor.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+static const u32 CANCEL_CHECK_INTERVAL = 8; // steps between checks for a newer request
+static const u32 SLOT_MASK = 3;
+static const u32 FRESH_SLOT = 4; // set on the shared slot when it holds a prediction the reader has not taken
+
+// A snapshot and what to predict from it
+template <typename Body> struct OrbitRequest {
+    u64 generation;
+    u32 step_count;
+    float dt;
+    void (*step)(Body *bodies, usize body_count, float dt, const void *context);
+    const void *context;
+
+    usize body_count;
+    usize body_capacity;
+    Body *bodies;
+
+    usize selected_count;
+    usize selected_capacity;
+    u32 *selected;
+};
+
+template <typename Body, typename Vec, typename Prediction> struct OrbitWorker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool shutdown;   // guarded by mutex
+    bool has_pending; // guarded by mutex
+
+    std::atomic<u64> generation; // of the newest request, or of the cancellation that superseded it
+    OrbitRequest<Body> pending;  // guarded by mutex
+    OrbitRequest<Body> running;  // owned by the worker thread
+    Vec *velocities;             // half-step velocities, owned by the worker thread
+    Vec *accelerations;
+    usize scratch_capacity;
+
+    // Triple buffer: the worker fills `back`, the reader holds `front`, and `shared` is swapped between them
+    Prediction slots[3];
+    std::atomic<u32> shared;
+    u32 back;
+    u32 front;
+};
+
+struct OrbitWorker2 : OrbitWorker<Body2, Vec2, OrbitPrediction2> {};
+struct OrbitWorker3 : OrbitWorker<Body3, Vec3, OrbitPrediction3> {};
+
+template <typename Body> static void free_request(OrbitRequest<Body> &request) {
+    free(request.bodies);
+    free(request.selected);
+
+    request = {};
+}
+
+template <typename Prediction> static void free_prediction(Prediction &prediction) {
+    free(prediction.bodies);
+    free(prediction.positions);
+
+    prediction = {};
+}
+
+template <typename Vec, typename Prediction>
+static void reserve_prediction(Prediction &prediction, usize body_count, u32 step_count) {
+    if (body_count > prediction.body_capacity) {
+        prediction.body_capacity = body_count;
+        prediction.bodies = (u32 *)realloc(prediction.bodies, body_count * sizeof(u32));
+    }
+    usize position_count = body_count * (step_count + 1);
+    if (position_count > prediction.position_capacity) {
+        prediction.position_capacity = position_count;
+        prediction.positions = (Vec *)realloc(prediction.positions, position_count * sizeof(Vec));
+    }
+}
+
+// Steps the running request's snapshot with its step function, or a leapfrog when it has none, into the back slot.
+// Returns false if a newer request superseded it.
+template <typename Body, typename Vec, typename Prediction>
+static bool integrate_request(OrbitWorker<Body, Vec, Prediction> &worker) {
+    OrbitRequest<Body> &request = worker.running;
+    Prediction &prediction = worker.slots[worker.back];
+    usize n = request.body_count;
+    u32 steps = request.step_count;
+    float dt = request.dt;
+
+    if (n > worker.scratch_capacity) {
+        worker.scratch_capacity = n;
+        worker.velocities = (Vec *)realloc(worker.velocities, n * sizeof(Vec));
+        worker.accelerations = (Vec *)realloc(worker.accelerations, n * sizeof(Vec));
+    }
+    reserve_prediction<Vec>(prediction, request.selected_count, steps);
+    prediction.generation = request.generation;
+    prediction.step_count = steps;
+    prediction.dt = dt;
+    prediction.body_count = request.selected_count;
+    memcpy(prediction.bodies, request.selected, request.selected_count * sizeof(u32));
+
+    Body *bodies = request.bodies;
+    for (usize s = 0; s < request.selected_count; s++) {
+        prediction.positions[s * (steps + 1)] = bodies[request.selected[s]].transform.position;
+    }
+    if (!request.step) {
+        for (usize i = 0; i < n; i++) {
+            worker.velocities[i] = bodies[i].transform.velocity;
+        }
+        compute_accelerations(bodies, n, worker.accelerations);
+    }
+
+    for (u32 step = 1; step <= steps; step++) {
+        if (step % CANCEL_CHECK_INTERVAL == 0 &&
+            worker.generation.load(std::memory_order_relaxed) != request.generation) {
+            return false;
+        }
+
+        if (request.step) {
+            request.step(bodies, n, dt, request.context);
+        } else {
+            for (usize i = 0; i < n; i++) {
+                worker.velocities[i] += worker.accelerations[i] * (0.5f * dt);
+                bodies[i].transform.position += worker.velocities[i] * dt;
+            }
+            compute_accelerations(bodies, n, worker.accelerations);
+            for (usize i = 0; i < n; i++) {
+                worker.velocities[i] += worker.accelerations[i] * (0.5f * dt);
+            }
+        }
+
+        for (usize s = 0; s < request.selected_count; s++) {
+            prediction.positions[s * (steps + 1) + step] = bodies[request.selected[s]].transform.position;
+        }
+    }
+    return true;
+}
+
+template <typename Body, typename Vec, typename Prediction>
+static void worker_main(OrbitWorker<Body, Vec, Prediction> *worker) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(worker->mutex);
+            worker->wake.wait(lock, [&] { return worker->shutdown || worker->has_pending; });
+            if (worker->shutdown) {
+                return;
+            }
+
+            // Swapping keeps both snapshots' buffers alive for reuse
+            OrbitRequest<Body> request = worker->running;
+            worker->running = worker->pending;
+            worker->pending = request;
+            worker->has_pending = false;
+        }
+
+        if (integrate_request(*worker)) {
+            u32 previous = worker->shared.exchange(worker->back | FRESH_SLOT, std::memory_order_acq_rel);
+            worker->back = previous & SLOT_MASK;
+        }
+    }
+}
+
+template <typename Worker> static void init_orbit_predictor_impl(Worker *&worker) {
+    worker = new Worker(); // value-initialized, so every buffer starts empty and every slot unpublished
+    worker->back = 1;
+    worker->front = 2;
+
+    worker->thread = std::thread([worker] { worker_main(worker); });
+}
+
+template <typename Worker> static void deinit_orbit_predictor_impl(Worker *&worker) {
+    if (!worker) return;
+
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->shutdown = true;
+        worker->generation.fetch_add(1);
+    }
+    worker->wake.notify_one();
+    worker->thread.join();
+
+    free_request(worker->pending);
+    free_request(worker->running);
+    free(worker->velocities);
+    free(worker->accelerations);
+    for (u32 i = 0; i < 3; i++) {
+        free_prediction(worker->slots[i]);
+    }
+    delete worker;
+
+    worker = nullptr;
+}
+
+template <typename Body, typename Vec, typename Prediction, typename StepFn>
+static u64 request_orbit_prediction_impl(OrbitWorker<Body, Vec, Prediction> &worker, const Body *bodies,
+                                         usize body_count, const u32 *selected, usize selected_count, u32 step_count,
+                                         float dt, StepFn step, const void *context) {
+    u64 generation;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        OrbitRequest<Body> &request = worker.pending;
+        if (body_count > request.body_capacity) {
+            request.body_capacity = body_count;
+            request.bodies = (Body *)realloc(request.bodies, body_count * sizeof(Body));
+        }
+        if (selected_count > request.selected_capacity) {
+            request.selected_capacity = selected_count;
+            request.selected = (u32 *)realloc(request.selected, selected_count * sizeof(u32));
+        }
+
+        memcpy(request.bodies, bodies, body_count * sizeof(Body));
+        request.body_count = body_count;
+        request.selected_count = 0;
+        for (usize s = 0; s < selected_count; s++) {
+            if (selected[s] < body_count) request.selected[request.selected_count++] = selected[s];
+        }
+        request.step_count = step_count;
+        request.dt = dt;
+        request.step = step;
+        request.context = context;
+
+        generation = worker.generation.fetch_add(1) + 1;
+        request.generation = generation;
+        worker.has_pending = true;
+    }
+    worker.wake.notify_one();
+
+    return generation;
+}
+
+template <typename Worker> static void cancel_orbit_prediction_impl(Worker &worker) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.has_pending = false;
+    worker.generation.fetch_add(1);
+}
+
+template <typename Prediction, typename Worker> static const Prediction *latest_orbit_prediction_impl(Worker &worker) {
+    if (worker.shared.load(std::memory_order_relaxed) & FRESH_SLOT) {
+        worker.front = worker.shared.exchange(worker.front, std::memory_order_acq_rel) & SLOT_MASK;
+    }
+
+    const Prediction &prediction = worker.slots[worker.front];
+    return prediction.generation ? &prediction : nullptr;
+}
+
+void init_orbit_predictor(OrbitPredictor2 &predictor) {
+    init_orbit_predictor_impl(predictor.worker);
+}
+
+void init_orbit_predictor(OrbitPredictor3 &predictor) {
+    init_orbit_predictor_impl(predictor.worker);
+}
+
+void deinit_orbit_predictor(OrbitPredictor2 &predictor) {
+    deinit_orbit_predictor_impl(predictor.worker);
+}
+
+void deinit_orbit_predictor(OrbitPredictor3 &predictor) {
+    deinit_orbit_predictor_impl(predictor.worker);
+}
+
+u64 request_orbit_prediction(OrbitPredictor2 &predictor, const Body2 *bodies, usize body_count, const u32 *selected,
+                             usize selected_count, u32 step_count, float dt, OrbitStepFn2 step, const void *context) {
+    return request_orbit_prediction_impl(*predictor.worker, bodies, body_count, selected, selected_count, step_count,
+                                         dt, step, context);
+}
+
+u64 request_orbit_prediction(OrbitPredictor3 &predictor, const Body3 *bodies, usize body_count, const u32 *selected,
+                             usize selected_count, u32 step_count, float dt, OrbitStepFn3 step, const void *context) {
+    return request_orbit_prediction_impl(*predictor.worker, bodies, body_count, selected, selected_count, step_count,
+                                         dt, step, context);
+}
+
+void cancel_orbit_prediction(OrbitPredictor2 &predictor) {
+    cancel_orbit_prediction_impl(*predictor.worker);
+}
+
+void cancel_orbit_prediction(OrbitPredictor3 &predictor) {
+    cancel_orbit_prediction_impl(*predictor.worker);
+}
+
+const OrbitPrediction2 *latest_orbit_prediction(OrbitPredictor2 &predictor) {
+    return latest_orbit_prediction_impl<OrbitPrediction2>(*predictor.worker);
+}
+
+const OrbitPrediction3 *latest_orbit_prediction(OrbitPredictor3 &predictor) {
+    return latest_orbit_prediction_impl<OrbitPrediction3>(*predictor.worker);
+}
+
+void step_rigid_bodies(Body2 *bodies, usize body_count, float dt, const void *) {
+    accelerate_rigid_bodies(bodies, body_count);
+    integrate_physics(bodies, body_count, dt);
+}
+
+void step_rigid_bodies(Body3 *bodies, usize body_count, float dt, const void *) {
+    accelerate_rigid_bodies(bodies, body_count);
+    integrate_physics(bodies, body_count, dt);
+}
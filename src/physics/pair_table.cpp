@@ -0,0 +1,121 @@
+#include "physics/pair_table.hpp"
+#include <cstdlib>
+#include <cstring>
+
+static const u64 EMPTY_KEY = ~0ull;
+static const usize MIN_CAPACITY = 64;
+
+static inline u64 pair_key(u32 a, u32 b) {
+    return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+}
+
+static inline usize pair_slot(u64 key, usize capacity) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return (usize)key & (capacity - 1);
+}
+
+static void rehash(PairTable &table, usize capacity) {
+    u64 *keys = table.keys;
+    u32 *values = table.values;
+    usize old_capacity = table.capacity;
+
+    table.capacity = capacity;
+    table.keys = (u64 *)malloc(capacity * sizeof(u64));
+    table.values = (u32 *)malloc(capacity * sizeof(u32));
+    memset(table.keys, 0xff, capacity * sizeof(u64));
+
+    for (usize i = 0; i < old_capacity; i++) {
+        if (keys[i] == EMPTY_KEY) continue;
+
+        usize slot = pair_slot(keys[i], capacity);
+        while (table.keys[slot] != EMPTY_KEY) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        table.keys[slot] = keys[i];
+        table.values[slot] = values[i];
+    }
+
+    free(keys);
+    free(values);
+}
+
+void init_pair_table(PairTable &table) {
+    table = {};
+}
+
+void deinit_pair_table(PairTable &table) {
+    free(table.keys);
+    free(table.values);
+    table = {};
+}
+
+void clear_pair_table(PairTable &table) {
+    if (table.capacity) {
+        memset(table.keys, 0xff, table.capacity * sizeof(u64));
+    }
+    table.count = 0;
+}
+
+u32 *pair_table_insert(PairTable &table, u32 a, u32 b, bool *inserted) {
+    // Keep the load factor at or below one half
+    if ((table.count + 1) * 2 > table.capacity) {
+        rehash(table, table.capacity ? table.capacity * 2 : MIN_CAPACITY);
+    }
+
+    u64 key = pair_key(a, b);
+    usize slot = pair_slot(key, table.capacity);
+    while (table.keys[slot] != EMPTY_KEY) {
+        if (table.keys[slot] == key) {
+            if (inserted) *inserted = false;
+            return &table.values[slot];
+        }
+        slot = (slot + 1) & (table.capacity - 1);
+    }
+
+    table.keys[slot] = key;
+    table.values[slot] = 0;
+    table.count++;
+    if (inserted) *inserted = true;
+    return &table.values[slot];
+}
+
+u32 *pair_table_find(const PairTable &table, u32 a, u32 b) {
+    if (table.count == 0) return nullptr;
+
+    u64 key = pair_key(a, b);
+    usize slot = pair_slot(key, table.capacity);
+    while (table.keys[slot] != EMPTY_KEY) {
+        if (table.keys[slot] == key) return &table.values[slot];
+        slot = (slot + 1) & (table.capacity - 1);
+    }
+    return nullptr;
+}
+
+bool pair_table_remove(PairTable &table, u32 a, u32 b) {
+    if (table.count == 0) return false;
+
+    u64 key = pair_key(a, b);
+    usize mask = table.capacity - 1;
+    usize slot = pair_slot(key, table.capacity);
+    while (table.keys[slot] != key) {
+        if (table.keys[slot] == EMPTY_KEY) return false;
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift later members of the probe run back into the hole so lookups never stop early
+    usize hole = slot;
+    for (usize next = (hole + 1) & mask; table.keys[next] != EMPTY_KEY; next = (next + 1) & mask) {
+        usize home = pair_slot(table.keys[next], table.capacity);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table.keys[hole] = table.keys[next];
+            table.values[hole] = table.values[next];
+            hole = next;
+        }
+    }
+
+    table.keys[hole] = EMPTY_KEY;
+    table.count--;
+    return true;
+}
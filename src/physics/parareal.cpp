@@ -0,0 +1,146 @@
+#include "physics/parareal.hpp"
+#include "common/parallel.hpp"
+#include <cstdlib>
+#include <cstring>
+
+// Kick-drift-kick leapfrog shared by the fine and the coarse propagator. Sleeping bodies stay put, as in
+// integrate_physics.
+template <typename Body, typename Vec>
+static void leapfrog(Body *bodies, usize body_count, Vec *accelerations, float dt, usize step_count) {
+    float half_dt = 0.5f * dt;
+    compute_accelerations(bodies, body_count, accelerations);
+
+    for (usize step = 0; step < step_count; step++) {
+        for (usize i = 0; i < body_count; i++) {
+            auto &body = bodies[i];
+            if (body.sleeping) {
+                continue;
+            }
+
+            body.transform.velocity += accelerations[i] * half_dt;
+            body.transform.velocity *= (1.0f - body.dampening.linear * dt);
+            body.transform.position += body.transform.velocity * dt;
+        }
+
+        compute_accelerations(bodies, body_count, accelerations);
+
+        for (usize i = 0; i < body_count; i++) {
+            if (!bodies[i].sleeping) {
+                bodies[i].transform.velocity += accelerations[i] * half_dt;
+            }
+        }
+    }
+}
+
+template <typename Body, typename Vec>
+static u32 integrate_parareal_impl(Body *bodies, usize body_count, float dt, usize step_count,
+                                   const PararealConfig &config) {
+    usize slice_count = config.slice_count;
+    if (slice_count > step_count) slice_count = step_count;
+    if (slice_count == 0 || body_count == 0) return 0;
+
+    usize state_size = body_count * sizeof(Body);
+
+    // Slice boundaries, the fine and coarse solutions of each slice and per-slice scratch for the fine solves
+    Body *boundaries = (Body *)malloc((slice_count + 1) * state_size);
+    Body *fine = (Body *)malloc(slice_count * state_size);
+    Body *coarse = (Body *)malloc(slice_count * state_size);
+    Body *coarse_next = (Body *)malloc(state_size);
+    Vec *accelerations = (Vec *)malloc((slice_count + 1) * body_count * sizeof(Vec));
+    Vec *coarse_accelerations = accelerations + slice_count * body_count;
+
+    usize *slice_steps = (usize *)malloc(slice_count * sizeof(usize));
+    for (usize n = 0; n < slice_count; n++) {
+        slice_steps[n] = step_count / slice_count + (n < step_count % slice_count ? 1 : 0);
+    }
+
+    u32 coarse_steps = config.coarse_steps > 0 ? config.coarse_steps : 1;
+    auto coarse_propagate = [&](Body *state, usize n) {
+        float slice_duration = dt * (float)slice_steps[n];
+        leapfrog(state, body_count, coarse_accelerations, slice_duration / coarse_steps, coarse_steps);
+    };
+
+    // Initial coarse sweep seeds every slice
+    memcpy(boundaries, bodies, state_size);
+    for (usize n = 0; n < slice_count; n++) {
+        Body *next = boundaries + (n + 1) * body_count;
+        memcpy(next, boundaries + n * body_count, state_size);
+        coarse_propagate(next, n);
+        memcpy(coarse + n * body_count, next, state_size);
+    }
+
+    // After sweep k the first k slices match the serial fine solution exactly, so only the rest are refined
+    u32 iterations = 0;
+    usize first_open = 0;
+    while (first_open < slice_count && iterations < config.max_iterations) {
+        parallel_for(slice_count - first_open, 1, [&](usize begin, usize end) {
+            for (usize k = begin; k < end; k++) {
+                usize n = first_open + k;
+                Body *state = fine + n * body_count;
+                memcpy(state, boundaries + n * body_count, state_size);
+                leapfrog(state, body_count, accelerations + n * body_count, dt, slice_steps[n]);
+            }
+        });
+
+        // Serial correction: U[n+1] = G(U[n]) + F(U_old[n]) - G(U_old[n])
+        float max_correction = 0.0f;
+        Body *exact = boundaries + (first_open + 1) * body_count;
+        for (usize i = 0; i < body_count; i++) {
+            const Body &fine_body = fine[first_open * body_count + i];
+            float correction = (fine_body.transform.position - exact[i].transform.position).length();
+            if (correction > max_correction) max_correction = correction;
+        }
+        memcpy(exact, fine + first_open * body_count, state_size);
+
+        for (usize n = first_open + 1; n < slice_count; n++) {
+            memcpy(coarse_next, boundaries + n * body_count, state_size);
+            coarse_propagate(coarse_next, n);
+
+            Body *next = boundaries + (n + 1) * body_count;
+            const Body *fine_state = fine + n * body_count;
+            Body *coarse_state = coarse + n * body_count;
+
+            for (usize i = 0; i < body_count; i++) {
+                auto &transform = next[i].transform;
+                Vec position = coarse_next[i].transform.position + fine_state[i].transform.position -
+                               coarse_state[i].transform.position;
+                Vec velocity = coarse_next[i].transform.velocity + fine_state[i].transform.velocity -
+                               coarse_state[i].transform.velocity;
+
+                float correction = (position - transform.position).length();
+                if (correction > max_correction) max_correction = correction;
+
+                transform.position = position;
+                transform.velocity = velocity;
+            }
+
+            memcpy(coarse_state, coarse_next, state_size);
+        }
+
+        iterations++;
+        first_open++;
+
+        if (max_correction <= config.tolerance) {
+            break;
+        }
+    }
+
+    memcpy(bodies, boundaries + slice_count * body_count, state_size);
+
+    free(slice_steps);
+    free(accelerations);
+    free(coarse_next);
+    free(coarse);
+    free(fine);
+    free(boundaries);
+
+    return iterations;
+}
+
+u32 integrate_parareal(Body2 *bodies, usize body_count, float dt, usize step_count, const PararealConfig &config) {
+    return integrate_parareal_impl<Body2, Vec2>(bodies, body_count, dt, step_count, config);
+}
+
+u32 integrate_parareal(Body3 *bodies, usize body_count, float dt, usize step_count, const PararealConfig &config) {
+    return integrate_parareal_impl<Body3, Vec3>(bodies, body_count, dt, step_count, config);
+}
@@ -0,0 +1,329 @@
+#include "physics/regularization.hpp"
+#include "math/constants.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize NO_PARTNER = (usize)-1;
+static const u32 REGULARIZED_STEPS_PER_ORBIT = 64;
+static const u32 REGULARIZED_MAX_STEPS = 1u << 16;
+
+// Levi-Civita map (2D): u -> r = L(u) u with r = |u|^2
+static void to_regularized(Vec2 position, Vec2 velocity, f64 *u, f64 *w) {
+    f64 x = position.x, y = position.y;
+    f64 r = std::sqrt(x * x + y * y);
+
+    if (x >= 0.0) {
+        u[0] = std::sqrt(0.5 * (r + x));
+        u[1] = y / (2.0 * u[0]);
+    } else {
+        u[1] = std::sqrt(0.5 * (r - x));
+        u[0] = y / (2.0 * u[1]);
+    }
+
+    // u' = 1/2 L(u)^T v, derivative with respect to the fictitious time s (dt = r ds)
+    w[0] = 0.5 * (u[0] * velocity.x + u[1] * velocity.y);
+    w[1] = 0.5 * (-u[1] * velocity.x + u[0] * velocity.y);
+}
+
+static void from_regularized(const f64 *u, const f64 *w, Vec2 &position, Vec2 &velocity) {
+    f64 r = u[0] * u[0] + u[1] * u[1];
+    position = {(f32)(u[0] * u[0] - u[1] * u[1]), (f32)(2.0 * u[0] * u[1])};
+    velocity = {(f32)(2.0 / r * (u[0] * w[0] - u[1] * w[1])), (f32)(2.0 / r * (u[1] * w[0] + u[0] * w[1]))};
+}
+
+static void transpose_product(const f64 *u, Vec2 p, f64 *out) {
+    out[0] = u[0] * p.x + u[1] * p.y;
+    out[1] = -u[1] * p.x + u[0] * p.y;
+}
+
+// Kustaanheimo-Stiefel map (3D): u in R^4 with the bilinear constraint keeping the fourth degree of freedom fixed
+static void transpose_product(const f64 *u, Vec3 p, f64 *out) {
+    out[0] = u[0] * p.x + u[1] * p.y + u[2] * p.z;
+    out[1] = -u[1] * p.x + u[0] * p.y + u[3] * p.z;
+    out[2] = -u[2] * p.x - u[3] * p.y + u[0] * p.z;
+    out[3] = u[3] * p.x - u[2] * p.y + u[1] * p.z;
+}
+
+static void to_regularized(Vec3 position, Vec3 velocity, f64 *u, f64 *w) {
+    f64 x = position.x, y = position.y, z = position.z;
+    f64 r = std::sqrt(x * x + y * y + z * z);
+
+    if (x >= 0.0) {
+        u[0] = std::sqrt(0.5 * (r + x));
+        u[1] = y / (2.0 * u[0]);
+        u[2] = z / (2.0 * u[0]);
+        u[3] = 0.0;
+    } else {
+        u[1] = std::sqrt(0.5 * (r - x));
+        u[0] = y / (2.0 * u[1]);
+        u[2] = 0.0;
+        u[3] = z / (2.0 * u[1]);
+    }
+
+    transpose_product(u, velocity * 0.5f, w);
+}
+
+static void from_regularized(const f64 *u, const f64 *w, Vec3 &position, Vec3 &velocity) {
+    f64 r = u[0] * u[0] + u[1] * u[1] + u[2] * u[2] + u[3] * u[3];
+    position = {
+        (f32)(u[0] * u[0] - u[1] * u[1] - u[2] * u[2] + u[3] * u[3]),
+        (f32)(2.0 * (u[0] * u[1] - u[2] * u[3])),
+        (f32)(2.0 * (u[0] * u[2] + u[1] * u[3])),
+    };
+
+    f64 scale = 2.0 / r;
+    velocity = {
+        (f32)(scale * (u[0] * w[0] - u[1] * w[1] - u[2] * w[2] + u[3] * w[3])),
+        (f32)(scale * (u[1] * w[0] + u[0] * w[1] - u[3] * w[2] - u[2] * w[3])),
+        (f32)(scale * (u[2] * w[0] + u[3] * w[1] + u[0] * w[2] + u[1] * w[3])),
+    };
+}
+
+// Regularized state: coordinates u, their s-derivatives w, the binding energy per unit reduced mass h and the
+// physical time t
+template <u32 N> struct RegularizedState {
+    f64 u[N], w[N], h, t;
+};
+
+// u'' = h/2 u + r/2 L^T P,  h' = 2 u' . L^T P,  t' = r
+template <u32 N, typename Vec>
+static void regularized_derivative(const RegularizedState<N> &state, Vec perturbation,
+                                   RegularizedState<N> &derivative) {
+    f64 r = 0.0;
+    for (u32 k = 0; k < N; k++) {
+        r += state.u[k] * state.u[k];
+    }
+
+    f64 q[N];
+    transpose_product(state.u, perturbation, q);
+
+    f64 energy_rate = 0.0;
+    for (u32 k = 0; k < N; k++) {
+        derivative.u[k] = state.w[k];
+        derivative.w[k] = 0.5 * state.h * state.u[k] + 0.5 * r * q[k];
+        energy_rate += 2.0 * state.w[k] * q[k];
+    }
+    derivative.h = energy_rate;
+    derivative.t = r;
+}
+
+template <u32 N, typename Vec>
+static void regularized_step(RegularizedState<N> &state, Vec perturbation, f64 ds) {
+    RegularizedState<N> k1, k2, k3, k4, temp;
+
+    auto axpy = [](const RegularizedState<N> &x, const RegularizedState<N> &d, f64 a, RegularizedState<N> &out) {
+        for (u32 k = 0; k < N; k++) {
+            out.u[k] = x.u[k] + a * d.u[k];
+            out.w[k] = x.w[k] + a * d.w[k];
+        }
+        out.h = x.h + a * d.h;
+        out.t = x.t + a * d.t;
+    };
+
+    regularized_derivative<N>(state, perturbation, k1);
+    axpy(state, k1, 0.5 * ds, temp);
+    regularized_derivative<N>(temp, perturbation, k2);
+    axpy(state, k2, 0.5 * ds, temp);
+    regularized_derivative<N>(temp, perturbation, k3);
+    axpy(state, k3, ds, temp);
+    regularized_derivative<N>(temp, perturbation, k4);
+
+    for (u32 k = 0; k < N; k++) {
+        state.u[k] += ds / 6.0 * (k1.u[k] + 2.0 * k2.u[k] + 2.0 * k3.u[k] + k4.u[k]);
+        state.w[k] += ds / 6.0 * (k1.w[k] + 2.0 * k2.w[k] + 2.0 * k3.w[k] + k4.w[k]);
+    }
+    state.h += ds / 6.0 * (k1.h + 2.0 * k2.h + 2.0 * k3.h + k4.h);
+    state.t += ds / 6.0 * (k1.t + 2.0 * k2.t + 2.0 * k3.t + k4.t);
+}
+
+// Advances the relative motion of a pair by physical time dt under the tidal perturbation of the rest of the system
+template <u32 N, typename Vec>
+static void integrate_relative_motion(Vec &separation, Vec &relative_velocity, f64 mu, Vec perturbation, f64 dt) {
+    RegularizedState<N> state;
+    to_regularized(separation, relative_velocity, state.u, state.w);
+
+    f64 r = separation.length();
+    state.h = 0.5 * relative_velocity.length_squared() - mu / r;
+    state.t = 0.0;
+
+    for (u32 step = 0; step < REGULARIZED_MAX_STEPS && state.t < dt; step++) {
+        r = 0.0;
+        for (u32 k = 0; k < N; k++) {
+            r += state.u[k] * state.u[k];
+        }
+
+        // The oscillator frequency in s is sqrt(-h / 2) for bound pairs; near-parabolic and hyperbolic pairs fall back
+        // to the local dynamical scale. An orbit spans pi / omega in s.
+        f64 omega = std::sqrt(0.5 * std::fabs(state.h) + mu / (8.0 * r));
+        f64 ds = PI / (omega * REGULARIZED_STEPS_PER_ORBIT);
+
+        if (state.t + r * ds < dt) {
+            regularized_step<N>(state, perturbation, ds);
+            continue;
+        }
+
+        // Final partial step: Newton iteration on s so the physical time lands exactly on dt
+        RegularizedState<N> start = state;
+        ds = (dt - start.t) / r;
+        for (u32 iteration = 0; iteration < 4; iteration++) {
+            state = start;
+            regularized_step<N>(state, perturbation, ds);
+
+            f64 r_end = 0.0;
+            for (u32 k = 0; k < N; k++) {
+                r_end += state.u[k] * state.u[k];
+            }
+            ds += (dt - state.t) / r_end;
+        }
+        break;
+    }
+
+    from_regularized(state.u, state.w, separation, relative_velocity);
+}
+
+// Bodies the step moves; kinematic ones drift and sleeping ones stay put
+template <typename Body> static bool is_free(const Body &body) {
+    return body.kind == BodyKind::Dynamic && !body.sleeping;
+}
+
+// Gravity from every body except the receiver's regularized partner
+template <typename Body, typename Vec>
+static void external_accelerations(const Body *bodies, usize body_count, const usize *partners, Vec *accelerations) {
+    for (usize i = 0; i < body_count; i++) {
+        accelerations[i] = Vec::ZERO();
+        if (!is_free(bodies[i])) {
+            continue;
+        }
+
+        for (usize j = 0; j < body_count; j++) {
+            if (i == j || j == partners[i] || bodies[j].mass <= 0.0f) {
+                continue;
+            }
+
+            Vec delta_position = bodies[j].transform.position - bodies[i].transform.position;
+            float distance_squared = delta_position.length_squared();
+            if (distance_squared <= 0.0f) {
+                continue;
+            }
+
+            float inverse_distance_cubed = 1.0f / (distance_squared * std::sqrt(distance_squared));
+            accelerations[i] += delta_position * (GRAVITATIONAL_PARAMETER * bodies[j].mass * inverse_distance_cubed);
+        }
+    }
+}
+
+// Pairs up dynamic bodies that are mutual nearest neighbors within the pair radius
+template <typename Body, typename Vec>
+static void find_pairs(const Body *bodies, usize body_count, float pair_radius, usize *partners) {
+    for (usize i = 0; i < body_count; i++) {
+        partners[i] = NO_PARTNER;
+        if (!is_free(bodies[i])) {
+            continue;
+        }
+
+        float nearest_distance_squared = pair_radius * pair_radius;
+        for (usize j = 0; j < body_count; j++) {
+            if (i == j || !is_free(bodies[j]) || bodies[i].mass + bodies[j].mass <= 0.0f) {
+                continue;
+            }
+
+            float distance_squared = (bodies[j].transform.position - bodies[i].transform.position).length_squared();
+            if (distance_squared < nearest_distance_squared && distance_squared > 0.0f) {
+                nearest_distance_squared = distance_squared;
+                partners[i] = j;
+            }
+        }
+    }
+
+    for (usize i = 0; i < body_count; i++) {
+        if (partners[i] != NO_PARTNER && partners[partners[i]] != i) {
+            partners[i] = NO_PARTNER;
+        }
+    }
+}
+
+// Pair members are kicked with the pair's center-of-mass acceleration; the differential part is handled in the
+// regularized relative motion
+template <typename Body, typename Vec>
+static void kick(Body *bodies, usize body_count, const usize *partners, const Vec *accelerations, float dt) {
+    for (usize i = 0; i < body_count; i++) {
+        if (!is_free(bodies[i])) {
+            continue;
+        }
+
+        usize j = partners[i];
+        if (j == NO_PARTNER) {
+            bodies[i].transform.velocity += accelerations[i] * dt;
+            continue;
+        }
+
+        float total_mass = bodies[i].mass + bodies[j].mass;
+        Vec center_acceleration = (accelerations[i] * bodies[i].mass + accelerations[j] * bodies[j].mass) / total_mass;
+        bodies[i].transform.velocity += center_acceleration * dt;
+    }
+}
+
+template <typename Body, typename Vec>
+static void integrate_regularized_impl(Body *bodies, usize body_count, float dt, float pair_radius) {
+    if (body_count == 0) return;
+
+    usize *partners = (usize *)malloc(body_count * sizeof(usize));
+    Vec *accelerations = (Vec *)malloc(body_count * sizeof(Vec));
+    const u32 N = sizeof(Vec) == sizeof(Vec2) ? 2 : 4;
+
+    find_pairs<Body, Vec>(bodies, body_count, pair_radius, partners);
+    external_accelerations<Body, Vec>(bodies, body_count, partners, accelerations);
+    kick<Body, Vec>(bodies, body_count, partners, accelerations, 0.5f * dt);
+
+    for (usize i = 0; i < body_count; i++) {
+        auto &body = bodies[i];
+        usize j = partners[i];
+        if (body.sleeping) {
+            continue;
+        }
+
+        if (j == NO_PARTNER) {
+            body.transform.velocity *= (1.0f - body.dampening.linear * dt);
+            body.transform.position += body.transform.velocity * dt;
+            continue;
+        }
+
+        // Each pair is advanced once, from its lower index
+        if (j < i) {
+            continue;
+        }
+
+        auto &partner = bodies[j];
+        float total_mass = body.mass + partner.mass;
+        f64 mu = (f64)GRAVITATIONAL_PARAMETER * (f64)total_mass;
+
+        Vec center = (body.transform.position * body.mass + partner.transform.position * partner.mass) / total_mass;
+        Vec center_velocity =
+            (body.transform.velocity * body.mass + partner.transform.velocity * partner.mass) / total_mass;
+        Vec separation = partner.transform.position - body.transform.position;
+        Vec relative_velocity = partner.transform.velocity - body.transform.velocity;
+        Vec perturbation = accelerations[j] - accelerations[i];
+
+        integrate_relative_motion<N, Vec>(separation, relative_velocity, mu, perturbation, dt);
+        center += center_velocity * dt;
+
+        body.transform.position = center - separation * (partner.mass / total_mass);
+        body.transform.velocity = center_velocity - relative_velocity * (partner.mass / total_mass);
+        partner.transform.position = center + separation * (body.mass / total_mass);
+        partner.transform.velocity = center_velocity + relative_velocity * (body.mass / total_mass);
+    }
+
+    external_accelerations<Body, Vec>(bodies, body_count, partners, accelerations);
+    kick<Body, Vec>(bodies, body_count, partners, accelerations, 0.5f * dt);
+
+    free(accelerations);
+    free(partners);
+}
+
+void integrate_regularized(Body2 *bodies, usize body_count, float dt, float pair_radius) {
+    integrate_regularized_impl<Body2, Vec2>(bodies, body_count, dt, pair_radius);
+}
+
+void integrate_regularized(Body3 *bodies, usize body_count, float dt, float pair_radius) {
+    integrate_regularized_impl<Body3, Vec3>(bodies, body_count, dt, pair_radius);
+}
@@ -0,0 +1,275 @@
+#include "physics/soft_body.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static const usize SOFT_LANES = 64;        // edges gathered per kernel call
+static const usize EDGE_BATCH = 1024;      // edges per parallel task, a multiple of SOFT_LANES
+static const usize PARTICLE_BATCH = 4096;
+static const f32 SOFT_MIN_LENGTH = 1.0e-6f; // edges shorter than this have no direction to push along
+static const u32 SERIAL_COLOR = SOFT_BODY_MAX_COLORS;
+
+// Undirected mesh edge as (low << 32 | high), with the vertex across from it in one of its triangles
+struct EdgeSide {
+    u64 key;
+    u32 opposite;
+};
+
+static inline u64 edge_key(u32 a, u32 b) {
+    return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+}
+
+static SoftEdge make_edge(const Vec3 *positions, u32 a, u32 b, f32 compliance) {
+    return {a, b, (positions[b] - positions[a]).length(), compliance};
+}
+
+// One stretch edge per distinct triangle edge, and a bend edge across every edge that two triangles share
+static usize build_edges(SoftBody &body, SoftEdge *edges, f32 stretch_compliance, f32 bend_compliance) {
+    usize side_count = body.triangle_count * 3;
+    EdgeSide *sides = (EdgeSide *)malloc(side_count * sizeof(EdgeSide));
+    for (usize t = 0; t < body.triangle_count; t++) {
+        const u32 *corners = body.triangles + t * 3;
+        for (u32 k = 0; k < 3; k++) {
+            sides[t * 3 + k] = {edge_key(corners[k], corners[(k + 1) % 3]), corners[(k + 2) % 3]};
+        }
+    }
+    std::sort(sides, sides + side_count, [](const EdgeSide &x, const EdgeSide &y) { return x.key < y.key; });
+
+    usize edge_count = 0;
+    for (usize s = 0; s < side_count;) {
+        usize run = s + 1;
+        while (run < side_count && sides[run].key == sides[s].key) run++;
+
+        u32 a = (u32)(sides[s].key >> 32), b = (u32)sides[s].key;
+        if (a != b) edges[edge_count++] = make_edge(body.positions, a, b, stretch_compliance);
+
+        if (run - s >= 2 && sides[s].opposite != sides[s + 1].opposite) {
+            edges[edge_count++] = make_edge(body.positions, sides[s].opposite, sides[s + 1].opposite, bend_compliance);
+        }
+        s = run;
+    }
+
+    free(sides);
+    return edge_count;
+}
+
+// Greedy coloring over both particles of each edge, then a counting sort of the edges into colors
+static void color_edges(SoftBody &body, const SoftEdge *unsorted) {
+    u64 *masks = (u64 *)calloc(body.particle_count, sizeof(u64));
+    u8 *colors = (u8 *)malloc(body.edge_count * sizeof(u8));
+    u32 *starts = body.color_starts;
+    for (usize c = 0; c < SOFT_BODY_MAX_COLORS + 2; c++) {
+        starts[c] = 0;
+    }
+
+    body.color_count = 0;
+    for (usize e = 0; e < body.edge_count; e++) {
+        u64 used = masks[unsorted[e].a] | masks[unsorted[e].b];
+        u32 color = ~used ? (u32)__builtin_ctzll(~used) : SERIAL_COLOR;
+        if (color < SERIAL_COLOR) {
+            masks[unsorted[e].a] |= 1ull << color;
+            masks[unsorted[e].b] |= 1ull << color;
+        }
+        colors[e] = (u8)color;
+        body.color_count = color + 1 > body.color_count ? color + 1 : body.color_count;
+        starts[color + 1]++;
+    }
+
+    for (usize c = 0; c <= SOFT_BODY_MAX_COLORS; c++) {
+        starts[c + 1] += starts[c];
+    }
+
+    // Scatter with the starts as cursors, then shift them back
+    for (usize e = 0; e < body.edge_count; e++) {
+        body.edges[starts[colors[e]]++] = unsorted[e];
+    }
+    for (usize c = SOFT_BODY_MAX_COLORS + 1; c > 0; c--) {
+        starts[c] = starts[c - 1];
+    }
+    starts[0] = 0;
+
+    free(masks);
+    free(colors);
+}
+
+static void build_vertex_triangles(SoftBody &body) {
+    u32 *starts = (u32 *)calloc(body.particle_count + 1, sizeof(u32));
+    for (usize k = 0; k < body.triangle_count * 3; k++) {
+        starts[body.triangles[k] + 1]++;
+    }
+    for (usize i = 0; i < body.particle_count; i++) {
+        starts[i + 1] += starts[i];
+    }
+
+    u32 *triangles = (u32 *)malloc(body.triangle_count * 3 * sizeof(u32));
+    u32 *cursors = (u32 *)malloc(body.particle_count * sizeof(u32));
+    for (usize i = 0; i < body.particle_count; i++) {
+        cursors[i] = starts[i];
+    }
+    for (usize k = 0; k < body.triangle_count * 3; k++) {
+        triangles[cursors[body.triangles[k]]++] = (u32)(k / 3);
+    }
+    free(cursors);
+
+    body.vertex_triangles = triangles;
+    body.vertex_triangle_starts = starts;
+}
+
+// C = |b - a| - rest_length, one XPBD correction per edge and substep, so no multiplier is carried between them
+static void solve_edges(SoftBody &body, usize begin, usize end, f32 h) {
+    f32 dx[SOFT_LANES], dy[SOFT_LANES], dz[SOFT_LANES];
+    f32 wa[SOFT_LANES], wb[SOFT_LANES], rest[SOFT_LANES], alpha[SOFT_LANES];
+    f32 px[SOFT_LANES], py[SOFT_LANES], pz[SOFT_LANES];
+    Vec3 *positions = body.positions;
+    const f32 *inverse_masses = body.inverse_masses;
+
+    for (usize base = begin; base < end; base += SOFT_LANES) {
+        usize count = end - base < SOFT_LANES ? end - base : SOFT_LANES;
+
+        for (usize i = 0; i < count; i++) {
+            const SoftEdge &edge = body.edges[base + i];
+            Vec3 delta = positions[edge.b] - positions[edge.a];
+            dx[i] = delta.x, dy[i] = delta.y, dz[i] = delta.z;
+            wa[i] = inverse_masses[edge.a], wb[i] = inverse_masses[edge.b];
+            rest[i] = edge.rest_length;
+            alpha[i] = edge.compliance / (h * h);
+        }
+
+        for (usize i = 0; i < count; i++) {
+            f32 length = std::sqrt(dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i]);
+            f32 denominator = wa[i] + wb[i] + alpha[i];
+            bool active = length > SOFT_MIN_LENGTH && denominator > 0.0f;
+            f32 scale = active ? (rest[i] - length) / ((denominator > 0.0f ? denominator : 1.0f) * length) : 0.0f;
+            px[i] = dx[i] * scale, py[i] = dy[i] * scale, pz[i] = dz[i] * scale;
+        }
+
+        for (usize i = 0; i < count; i++) {
+            const SoftEdge &edge = body.edges[base + i];
+            Vec3 correction = {px[i], py[i], pz[i]};
+            positions[edge.a] -= correction * wa[i];
+            positions[edge.b] += correction * wb[i];
+        }
+    }
+}
+
+static void update_normals(SoftBody &body) {
+    parallel_for(body.particle_count, PARTICLE_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            Vec3 sum = Vec3::ZERO();
+            for (u32 k = body.vertex_triangle_starts[i]; k < body.vertex_triangle_starts[i + 1]; k++) {
+                const u32 *corners = body.triangles + body.vertex_triangles[k] * 3;
+                const Vec3 &p0 = body.positions[corners[0]];
+                sum += (body.positions[corners[1]] - p0).cross(body.positions[corners[2]] - p0);
+            }
+
+            f32 length = sum.length();
+            body.normals[i] = length > 0.0f ? sum * (1.0f / length) : Vec3{0.0f, 1.0f, 0.0f};
+        }
+    });
+}
+
+void init_soft_body(SoftBody &body, const Mesh &mesh, float mass, float stretch_compliance, float bend_compliance,
+                    u32 substeps) {
+    body = {};
+    body.substeps = substeps;
+    body.gravity = {0.0f, -9.81f, 0.0f};
+
+    usize n = mesh.vertex_count;
+    body.particle_count = n;
+    body.positions = (Vec3 *)malloc(n * sizeof(Vec3));
+    body.previous_positions = (Vec3 *)malloc(n * sizeof(Vec3));
+    body.velocities = (Vec3 *)calloc(n, sizeof(Vec3));
+    body.normals = (Vec3 *)malloc(n * sizeof(Vec3));
+    body.inverse_masses = (f32 *)malloc(n * sizeof(f32));
+    f32 inverse_mass = n > 0 && mass > 0.0f ? (f32)n / mass : 0.0f;
+    for (usize i = 0; i < n; i++) {
+        body.positions[i] = mesh.vertices[i].position;
+        body.inverse_masses[i] = inverse_mass;
+    }
+
+    bool indexed = mesh.indices && mesh.index_count > 0;
+    body.triangle_count = (indexed ? mesh.index_count : n) / 3;
+    body.triangles = (u32 *)malloc(body.triangle_count * 3 * sizeof(u32));
+    for (usize k = 0; k < body.triangle_count * 3; k++) {
+        body.triangles[k] = indexed ? mesh.indices[k] : (u32)k;
+    }
+
+    // At most three stretch edges and three bend edges per triangle
+    SoftEdge *unsorted = (SoftEdge *)malloc(body.triangle_count * 6 * sizeof(SoftEdge));
+    body.edge_count = build_edges(body, unsorted, stretch_compliance, bend_compliance);
+    body.edges = (SoftEdge *)malloc(body.edge_count * sizeof(SoftEdge));
+    color_edges(body, unsorted);
+    free(unsorted);
+
+    build_vertex_triangles(body);
+    update_normals(body);
+}
+
+void deinit_soft_body(SoftBody &body) {
+    free(body.positions);
+    free(body.previous_positions);
+    free(body.velocities);
+    free(body.normals);
+    free(body.inverse_masses);
+    free(body.edges);
+    free(body.triangles);
+    free(body.vertex_triangles);
+    free(body.vertex_triangle_starts);
+
+    body = {};
+}
+
+void step_soft_body(SoftBody &body, float dt) {
+    u32 substeps = body.substeps > 0 ? body.substeps : 1;
+    f32 h = dt / (f32)substeps;
+    f32 keep = 1.0f - body.damping * h;
+    Vec3 fall = body.gravity * h;
+
+    for (u32 substep = 0; substep < substeps; substep++) {
+        parallel_for(body.particle_count, PARTICLE_BATCH, [&](usize begin, usize end) {
+            for (usize i = begin; i < end; i++) {
+                f32 movable = body.inverse_masses[i] > 0.0f ? 1.0f : 0.0f;
+                body.velocities[i] += fall * movable;
+                body.previous_positions[i] = body.positions[i];
+                body.positions[i] += body.velocities[i] * h;
+            }
+        });
+
+        // Edges of one color share no particle, so their lanes run on any worker in any order. The serial color
+        // holds what the coloring could not separate; its edges share particles, so each is solved alone against the
+        // positions the previous one left.
+        for (u32 color = 0; color < body.color_count; color++) {
+            usize begin = body.color_starts[color], end = body.color_starts[color + 1];
+            if (color == SERIAL_COLOR) {
+                for (usize e = begin; e < end; e++) {
+                    solve_edges(body, e, e + 1, h);
+                }
+            } else if (begin < end) {
+                parallel_for(end - begin, EDGE_BATCH, [&](usize first, usize last) {
+                    solve_edges(body, begin + first, begin + last, h);
+                });
+            }
+        }
+
+        parallel_for(body.particle_count, PARTICLE_BATCH, [&](usize begin, usize end) {
+            for (usize i = begin; i < end; i++) {
+                body.velocities[i] = (body.positions[i] - body.previous_positions[i]) * (keep / h);
+            }
+        });
+    }
+
+    update_normals(body);
+}
+
+void update_soft_body_mesh(const SoftBody &body, Mesh &mesh) {
+    usize count = body.particle_count < mesh.vertex_count ? body.particle_count : mesh.vertex_count;
+    parallel_for(count, PARTICLE_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            mesh.vertices[i].position = body.positions[i];
+            mesh.vertices[i].normal = body.normals[i];
+        }
+    });
+
+    update_mesh_vertices(mesh, mesh.vertices, mesh.vertex_count);
+}
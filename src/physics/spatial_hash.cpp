@@ -0,0 +1,389 @@
+#include "physics/spatial_hash.hpp"
+#include "common/parallel.hpp"
+#include "math/constants.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const usize HASH_BATCH = 4096;
+static const usize HASH_BUCKET_BATCH = 1024;
+static const u32 HASH_PARTITION_BITS = 8;
+static const u32 HASH_PARTITIONS = 1u << HASH_PARTITION_BITS;
+static const i32 HASH_MAX_CELLS_PER_AXIS = 4;
+static const u32 HASH_SIZE_SAMPLES = 1024;
+static const u32 HASH_OVERSIZED = 0xffffffffu;
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline bool has_shape(const Body2 &body) {
+    return body.shape.kind != ShapeKind2::None;
+}
+
+static inline bool has_shape(const Body3 &body) {
+    return body.shape.kind != ShapeKind3::None;
+}
+
+static inline u32 hash_cell(const i32 *cell) {
+    u32 hash = ((u32)cell[0] * 73856093u) ^ ((u32)cell[1] * 19349663u) ^ ((u32)cell[2] * 83492791u);
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+static inline i32 cell_coordinate(f32 value, f32 inverse_cell_size) {
+    f32 cell = std::floor(value * inverse_cell_size);
+    return (i32)std::fmax(-1.0e9f, std::fmin(1.0e9f, cell));
+}
+
+template <typename Hash> static void reserve_buffers(Hash &hash, usize count) {
+    if (count <= hash.buffer_count) return;
+
+    hash.buffers = (PairBuffer *)realloc(hash.buffers, count * sizeof(PairBuffer));
+    memset(hash.buffers + hash.buffer_count, 0, (count - hash.buffer_count) * sizeof(PairBuffer));
+    hash.buffer_count = count;
+}
+
+template <typename Hash, typename Aabb> static void reserve_bodies(Hash &hash, usize body_count) {
+    if (body_count + 1 <= hash.body_capacity) return;
+
+    hash.body_capacity = body_count + 1;
+    hash.bounds = (Aabb *)realloc(hash.bounds, hash.body_capacity * sizeof(Aabb));
+    hash.entry_counts = (u32 *)realloc(hash.entry_counts, hash.body_capacity * sizeof(u32));
+    hash.oversized = (u32 *)realloc(hash.oversized, hash.body_capacity * sizeof(u32));
+}
+
+template <typename Hash> static void reserve_entries(Hash &hash, usize entry_count, usize bucket_count) {
+    if (entry_count > hash.entry_capacity) {
+        hash.entry_capacity = entry_count + entry_count / 2;
+        hash.entries = (SpatialHashEntry *)realloc(hash.entries, hash.entry_capacity * sizeof(SpatialHashEntry));
+        hash.sorted_entries =
+            (SpatialHashEntry *)realloc(hash.sorted_entries, hash.entry_capacity * sizeof(SpatialHashEntry));
+    }
+
+    if (bucket_count + 1 > hash.bucket_capacity) {
+        hash.bucket_capacity = bucket_count + 1;
+        hash.bucket_offsets = (u32 *)realloc(hash.bucket_offsets, hash.bucket_capacity * sizeof(u32));
+    }
+
+    usize histogram_count = parallel_chunk_count(entry_count, HASH_BATCH) * HASH_PARTITIONS + HASH_PARTITIONS + 1;
+    if (histogram_count > hash.histogram_capacity) {
+        hash.histogram_capacity = histogram_count;
+        hash.histograms = (u32 *)realloc(hash.histograms, hash.histogram_capacity * sizeof(u32));
+    }
+}
+
+// Cell size from the distribution of shape sizes: large enough that nine in ten shapes touch at most 2 cells per axis
+template <u32 D, typename Body, typename Aabb>
+static float choose_cell_size(const Body *bodies, const Aabb *bounds, usize body_count) {
+    f32 samples[HASH_SIZE_SAMPLES];
+    u32 sample_count = 0;
+    usize stride = body_count / HASH_SIZE_SAMPLES + 1;
+
+    for (usize i = 0; i < body_count && sample_count < HASH_SIZE_SAMPLES; i += stride) {
+        if (!has_shape(bodies[i])) continue;
+
+        f32 size = 0.0f;
+        for (u32 k = 0; k < D; k++) {
+            size = std::fmax(size, axis(bounds[i].max, k) - axis(bounds[i].min, k));
+        }
+        samples[sample_count++] = size;
+    }
+
+    if (sample_count == 0) return 1.0f;
+
+    u32 percentile = sample_count * 9 / 10;
+    std::nth_element(samples, samples + percentile, samples + sample_count);
+    return samples[percentile] > EPSILON ? samples[percentile] : 1.0f;
+}
+
+template <u32 D, typename Aabb> static void cell_range(const Aabb &aabb, f32 inverse_cell_size, i32 *low, i32 *high) {
+    for (u32 k = 0; k < 3; k++) {
+        low[k] = k < D ? cell_coordinate(axis(aabb.min, k), inverse_cell_size) : 0;
+        high[k] = k < D ? cell_coordinate(axis(aabb.max, k), inverse_cell_size) : 0;
+    }
+}
+
+template <u32 D, typename Hash, typename Body, typename Aabb>
+static usize find_overlapping_pairs_impl(Hash &hash, const Body *bodies, usize body_count) {
+    reserve_bodies<Hash, Aabb>(hash, body_count);
+    hash.pair_count = 0;
+    hash.oversized_count = 0;
+    if (body_count == 0) return 0;
+
+    Aabb *bounds = hash.bounds;
+    parallel_for(body_count, HASH_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            if (has_shape(bodies[i])) {
+                bounds[i] = compute_aabb(bodies[i].shape, bodies[i].transform);
+            }
+        }
+    });
+
+    hash.cell_size = hash.fixed_cell_size > 0.0f ? hash.fixed_cell_size
+                                                 : choose_cell_size<D, Body, Aabb>(bodies, bounds, body_count);
+    f32 inverse_cell_size = 1.0f / hash.cell_size;
+
+    // Cells covered by each body
+    u32 *entry_counts = hash.entry_counts;
+    parallel_for(body_count, HASH_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            entry_counts[i] = 0;
+            if (!has_shape(bodies[i])) continue;
+
+            i32 low[3], high[3];
+            cell_range<D>(bounds[i], inverse_cell_size, low, high);
+
+            u32 count = 1;
+            for (u32 k = 0; k < D; k++) {
+                i32 span = high[k] - low[k] + 1;
+                if (span > HASH_MAX_CELLS_PER_AXIS) {
+                    count = HASH_OVERSIZED;
+                    break;
+                }
+                count *= (u32)span;
+            }
+            entry_counts[i] = count;
+        }
+    });
+
+    usize entry_count = 0;
+    for (usize i = 0; i < body_count; i++) {
+        u32 count = entry_counts[i];
+        if (count == HASH_OVERSIZED) {
+            hash.oversized[hash.oversized_count++] = (u32)i;
+            count = 0;
+        }
+        entry_counts[i] = (u32)entry_count;
+        entry_count += count;
+    }
+    entry_counts[body_count] = (u32)entry_count;
+
+    u32 bucket_bits = HASH_PARTITION_BITS;
+    while (((usize)1 << bucket_bits) < entry_count) {
+        bucket_bits++;
+    }
+    usize bucket_count = (usize)1 << bucket_bits;
+    u32 partition_shift = bucket_bits - HASH_PARTITION_BITS;
+
+    reserve_entries(hash, entry_count, bucket_count);
+    SpatialHashEntry *entries = hash.entries;
+    SpatialHashEntry *sorted_entries = hash.sorted_entries;
+    u32 *bucket_offsets = hash.bucket_offsets;
+
+    parallel_for(body_count, HASH_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            u32 offset = entry_counts[i];
+            if (offset == entry_counts[i + 1]) continue;
+
+            i32 low[3], high[3];
+            cell_range<D>(bounds[i], inverse_cell_size, low, high);
+
+            for (i32 z = low[2]; z <= high[2]; z++) {
+                for (i32 y = low[1]; y <= high[1]; y++) {
+                    for (i32 x = low[0]; x <= high[0]; x++) {
+                        SpatialHashEntry &entry = entries[offset++];
+                        entry.cell[0] = x;
+                        entry.cell[1] = y;
+                        entry.cell[2] = z;
+                        entry.bucket = hash_cell(entry.cell) & (u32)(bucket_count - 1);
+                        entry.body = (u32)i;
+                    }
+                }
+            }
+        }
+    });
+
+    // Stable counting sort by bucket in two parallel passes: scatter into partitions on the high bucket bits with
+    // per-chunk histograms, then sort each partition by the full bucket independently
+    usize chunk_count = parallel_chunk_count(entry_count, HASH_BATCH);
+    u32 *histograms = hash.histograms;
+    u32 *partition_offsets = histograms + chunk_count * HASH_PARTITIONS;
+
+    parallel_for(entry_count, HASH_BATCH, [&](usize begin, usize end) {
+        u32 *histogram = histograms + (begin / HASH_BATCH) * HASH_PARTITIONS;
+        memset(histogram, 0, HASH_PARTITIONS * sizeof(u32));
+        for (usize e = begin; e < end; e++) {
+            histogram[entries[e].bucket >> partition_shift]++;
+        }
+    });
+
+    u32 running = 0;
+    for (u32 p = 0; p < HASH_PARTITIONS; p++) {
+        partition_offsets[p] = running;
+        for (usize c = 0; c < chunk_count; c++) {
+            u32 count = histograms[c * HASH_PARTITIONS + p];
+            histograms[c * HASH_PARTITIONS + p] = running;
+            running += count;
+        }
+    }
+    partition_offsets[HASH_PARTITIONS] = running;
+
+    parallel_for(entry_count, HASH_BATCH, [&](usize begin, usize end) {
+        u32 *cursor = histograms + (begin / HASH_BATCH) * HASH_PARTITIONS;
+        for (usize e = begin; e < end; e++) {
+            sorted_entries[cursor[entries[e].bucket >> partition_shift]++] = entries[e];
+        }
+    });
+
+    usize partition_size = (usize)1 << partition_shift;
+    parallel_for(HASH_PARTITIONS, 1, [&](usize begin, usize end) {
+        u32 *cursor = (u32 *)malloc(partition_size * sizeof(u32));
+
+        for (usize p = begin; p < end; p++) {
+            u32 *offsets = bucket_offsets + p * partition_size;
+            memset(offsets, 0, partition_size * sizeof(u32));
+
+            u32 first = partition_offsets[p], last = partition_offsets[p + 1];
+            for (u32 e = first; e < last; e++) {
+                offsets[sorted_entries[e].bucket - p * partition_size]++;
+            }
+
+            u32 offset = first;
+            for (usize b = 0; b < partition_size; b++) {
+                u32 count = offsets[b];
+                offsets[b] = offset;
+                cursor[b] = offset;
+                offset += count;
+            }
+
+            for (u32 e = first; e < last; e++) {
+                entries[cursor[sorted_entries[e].bucket - p * partition_size]++] = sorted_entries[e];
+            }
+        }
+
+        free(cursor);
+    });
+    bucket_offsets[bucket_count] = (u32)entry_count;
+
+    // Pairs within each cell, reported only from the cell that holds the minimum corner of the overlap
+    usize bucket_chunk_count = parallel_chunk_count(bucket_count, HASH_BUCKET_BATCH);
+    usize oversized_chunk_count = hash.oversized_count ? parallel_chunk_count(body_count, HASH_BATCH) : 0;
+    reserve_buffers(hash, bucket_chunk_count + oversized_chunk_count);
+    PairBuffer *buffers = hash.buffers;
+
+    parallel_for(bucket_count, HASH_BUCKET_BATCH, [&](usize begin, usize end) {
+        PairBuffer &buffer = buffers[begin / HASH_BUCKET_BATCH];
+        buffer.count = 0;
+
+        for (usize b = begin; b < end; b++) {
+            for (u32 e = bucket_offsets[b]; e < bucket_offsets[b + 1]; e++) {
+                const SpatialHashEntry &entry = entries[e];
+
+                for (u32 f = e + 1; f < bucket_offsets[b + 1]; f++) {
+                    const SpatialHashEntry &other = entries[f];
+                    if (entry.cell[0] != other.cell[0] || entry.cell[1] != other.cell[1] ||
+                        entry.cell[2] != other.cell[2]) {
+                        continue;
+                    }
+
+                    const Aabb &a = bounds[entry.body];
+                    const Aabb &c = bounds[other.body];
+                    if (!aabb_overlap(a, c)) continue;
+
+                    bool owner = true;
+                    for (u32 k = 0; k < D && owner; k++) {
+                        f32 corner = std::fmax(axis(a.min, k), axis(c.min, k));
+                        owner = cell_coordinate(corner, inverse_cell_size) == entry.cell[k];
+                    }
+
+                    if (owner) {
+                        push_pair(buffer, entry.body, other.body);
+                    }
+                }
+            }
+        }
+    });
+
+    // Oversized bodies against everything; pairs of two oversized bodies come from the lower index
+    if (hash.oversized_count) {
+        const u32 *oversized = hash.oversized;
+        usize oversized_count = hash.oversized_count;
+
+        parallel_for(body_count, HASH_BATCH, [&](usize begin, usize end) {
+            PairBuffer &buffer = buffers[bucket_chunk_count + begin / HASH_BATCH];
+            buffer.count = 0;
+
+            for (usize i = begin; i < end; i++) {
+                if (!has_shape(bodies[i])) continue;
+                bool i_oversized = entry_counts[i] == entry_counts[i + 1];
+
+                for (usize o = 0; o < oversized_count; o++) {
+                    u32 j = oversized[o];
+                    if (j == i || (i_oversized && i > j)) continue;
+
+                    if (aabb_overlap(bounds[i], bounds[j])) {
+                        push_pair(buffer, (u32)i, j);
+                    }
+                }
+            }
+        });
+    }
+
+    usize buffer_count = bucket_chunk_count + oversized_chunk_count;
+    usize pair_count = 0;
+    for (usize c = 0; c < buffer_count; c++) {
+        pair_count += buffers[c].count;
+    }
+
+    if (pair_count > hash.pair_capacity) {
+        hash.pair_capacity = pair_count + pair_count / 2;
+        hash.pairs = (BroadphasePair *)realloc(hash.pairs, hash.pair_capacity * sizeof(BroadphasePair));
+    }
+
+    for (usize c = 0; c < buffer_count; c++) {
+        memcpy(hash.pairs + hash.pair_count, buffers[c].pairs, buffers[c].count * sizeof(BroadphasePair));
+        hash.pair_count += buffers[c].count;
+    }
+
+    return hash.pair_count;
+}
+
+template <typename Hash> static void deinit_spatial_hash_impl(Hash &hash) {
+    for (usize c = 0; c < hash.buffer_count; c++) {
+        free(hash.buffers[c].pairs);
+    }
+
+    free(hash.buffers);
+    free(hash.bounds);
+    free(hash.entry_counts);
+    free(hash.oversized);
+    free(hash.entries);
+    free(hash.sorted_entries);
+    free(hash.bucket_offsets);
+    free(hash.histograms);
+    free(hash.pairs);
+
+    hash = {};
+}
+
+void init_spatial_hash(SpatialHash2 &hash) {
+    hash = {};
+}
+
+void init_spatial_hash(SpatialHash3 &hash) {
+    hash = {};
+}
+
+void deinit_spatial_hash(SpatialHash2 &hash) {
+    deinit_spatial_hash_impl(hash);
+}
+
+void deinit_spatial_hash(SpatialHash3 &hash) {
+    deinit_spatial_hash_impl(hash);
+}
+
+usize find_overlapping_pairs(SpatialHash2 &hash, const Body2 *bodies, usize body_count) {
+    return find_overlapping_pairs_impl<2, SpatialHash2, Body2, Aabb2>(hash, bodies, body_count);
+}
+
+usize find_overlapping_pairs(SpatialHash3 &hash, const Body3 *bodies, usize body_count) {
+    return find_overlapping_pairs_impl<3, SpatialHash3, Body3, Aabb3>(hash, bodies, body_count);
+}
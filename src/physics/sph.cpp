@@ -0,0 +1,511 @@
+#include "physics/sph.hpp"
+#include "common/parallel.hpp"
+#include "math/constants.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+static const usize SPH_BATCH = 4096;
+static const usize SPH_CELL_BATCH = 64;
+static const u32 SPH_RADIX_BITS = 8;
+static const u32 SPH_RADIX = 1u << SPH_RADIX_BITS;
+static const usize SPH_LANES = 8;       // independent partial sums per neighbor loop
+static const f32 SPH_PADDING = 1.0e30f; // position of the padding lanes, outside every kernel
+static const f32 SPH_MIN_DISTANCE_SQUARED = 1.0e-12f;
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 &axis(Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+// Morton interleaving: up to 32 bits per axis in 2D, 21 in 3D
+static inline u64 spread_bits(u64 x, std::integral_constant<u32, 2>) {
+    x &= 0xffffffffull;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+static inline u64 spread_bits(u64 x, std::integral_constant<u32, 3>) {
+    x &= 0x1fffffull;
+    x = (x | (x << 32)) & 0x001f00000000ffffull;
+    x = (x | (x << 16)) & 0x001f0000ff0000ffull;
+    x = (x | (x << 8)) & 0x100f00f00f00f00full;
+    x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+    x = (x | (x << 2)) & 0x1249249249249249ull;
+    return x;
+}
+
+static inline u64 compact_bits(u64 x, std::integral_constant<u32, 2>) {
+    x &= 0x5555555555555555ull;
+    x = (x ^ (x >> 1)) & 0x3333333333333333ull;
+    x = (x ^ (x >> 2)) & 0x0f0f0f0f0f0f0f0full;
+    x = (x ^ (x >> 4)) & 0x00ff00ff00ff00ffull;
+    x = (x ^ (x >> 8)) & 0x0000ffff0000ffffull;
+    x = (x ^ (x >> 16)) & 0xffffffffull;
+    return x;
+}
+
+static inline u64 compact_bits(u64 x, std::integral_constant<u32, 3>) {
+    x &= 0x1249249249249249ull;
+    x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ull;
+    x = (x ^ (x >> 4)) & 0x100f00f00f00f00full;
+    x = (x ^ (x >> 8)) & 0x001f0000ff0000ffull;
+    x = (x ^ (x >> 16)) & 0x001f00000000ffffull;
+    x = (x ^ (x >> 32)) & 0x1fffffull;
+    return x;
+}
+
+template <u32 D> static inline u64 morton_code(const u32 *cell) {
+    u64 code = 0;
+    for (u32 k = 0; k < D; k++) {
+        code |= spread_bits(cell[k], std::integral_constant<u32, D>()) << k;
+    }
+    return code;
+}
+
+template <u32 D> static inline void morton_cell(u64 code, u32 *cell) {
+    for (u32 k = 0; k < D; k++) {
+        cell[k] = (u32)compact_bits(code >> k, std::integral_constant<u32, D>());
+    }
+}
+
+// Kernel normalizations for support radius h
+template <u32 D> struct SphKernels {
+    f32 density;   // spiky: W = density * (h - r)^3
+    f32 pressure;  // its gradient: |grad W| = pressure * (h - r)^2
+    f32 viscosity; // viscosity: laplacian W = viscosity * (h - r)
+};
+
+static SphKernels<2> sph_kernels(f32 h, std::integral_constant<u32, 2>) {
+    f32 h2 = h * h, h5 = h2 * h2 * h;
+    return {10.0f / (PI * h5), 30.0f / (PI * h5), 40.0f / (PI * h5)};
+}
+
+static SphKernels<3> sph_kernels(f32 h, std::integral_constant<u32, 3>) {
+    f32 h2 = h * h, h6 = h2 * h2 * h2;
+    return {15.0f / (PI * h6), 45.0f / (PI * h6), 45.0f / (PI * h6)};
+}
+
+template <u32 D, typename Sph> static void reserve_particles(Sph &sph, usize count) {
+    if (count <= sph.particle_capacity) return;
+
+    usize capacity = count + count / 2;
+    sph.particle_capacity = capacity;
+    sph.codes = (u64 *)realloc(sph.codes, capacity * sizeof(u64));
+    sph.code_scratch = (u64 *)realloc(sph.code_scratch, capacity * sizeof(u64));
+    sph.order = (u32 *)realloc(sph.order, capacity * sizeof(u32));
+    sph.order_scratch = (u32 *)realloc(sph.order_scratch, capacity * sizeof(u32));
+    for (u32 k = 0; k < D; k++) {
+        sph.positions[k] = (f32 *)realloc(sph.positions[k], capacity * sizeof(f32));
+        sph.velocities[k] = (f32 *)realloc(sph.velocities[k], capacity * sizeof(f32));
+    }
+    sph.masses = (f32 *)realloc(sph.masses, capacity * sizeof(f32));
+    sph.densities = (f32 *)realloc(sph.densities, capacity * sizeof(f32));
+    sph.pressures = (f32 *)realloc(sph.pressures, capacity * sizeof(f32));
+
+    // One cell per particle at most, and the neighbor table per cell
+    sph.cell_capacity = capacity;
+    sph.cell_codes = (u64 *)realloc(sph.cell_codes, capacity * sizeof(u64));
+    sph.cell_starts = (u32 *)realloc(sph.cell_starts, (capacity + 1) * sizeof(u32));
+    u32 neighbors = D == 2 ? 9 : 27;
+    sph.cell_neighbors = (u32 *)realloc(sph.cell_neighbors, capacity * neighbors * sizeof(u32));
+
+    usize histogram_count = parallel_chunk_count(capacity, SPH_BATCH) * SPH_RADIX;
+    if (histogram_count > sph.histogram_capacity) {
+        sph.histogram_capacity = histogram_count;
+        sph.histograms = (u32 *)realloc(sph.histograms, histogram_count * sizeof(u32));
+    }
+}
+
+// Stable LSD radix sort of the codes, carrying the body order, over the low `bits` bits. Each pass counts digits per
+// chunk in parallel, prefix-sums them by (digit, chunk) and scatters every chunk in parallel at its own offsets.
+template <typename Sph> static void radix_sort(Sph &sph, usize count, u32 bits) {
+    usize chunk_count = parallel_chunk_count(count, SPH_BATCH);
+    u32 *histograms = sph.histograms;
+
+    for (u32 shift = 0; shift < bits; shift += SPH_RADIX_BITS) {
+        const u64 *codes = sph.codes;
+        const u32 *order = sph.order;
+        u64 *sorted_codes = sph.code_scratch;
+        u32 *sorted_order = sph.order_scratch;
+
+        parallel_for(count, SPH_BATCH, [&](usize begin, usize end) {
+            u32 *histogram = histograms + (begin / SPH_BATCH) * SPH_RADIX;
+            memset(histogram, 0, SPH_RADIX * sizeof(u32));
+            for (usize i = begin; i < end; i++) {
+                histogram[(codes[i] >> shift) & (SPH_RADIX - 1)]++;
+            }
+        });
+
+        u32 running = 0;
+        for (u32 digit = 0; digit < SPH_RADIX; digit++) {
+            for (usize c = 0; c < chunk_count; c++) {
+                u32 digit_count = histograms[c * SPH_RADIX + digit];
+                histograms[c * SPH_RADIX + digit] = running;
+                running += digit_count;
+            }
+        }
+
+        parallel_for(count, SPH_BATCH, [&](usize begin, usize end) {
+            u32 *cursor = histograms + (begin / SPH_BATCH) * SPH_RADIX;
+            for (usize i = begin; i < end; i++) {
+                u32 slot = cursor[(codes[i] >> shift) & (SPH_RADIX - 1)]++;
+                sorted_codes[slot] = codes[i];
+                sorted_order[slot] = order[i];
+            }
+        });
+
+        std::swap(sph.codes, sph.code_scratch);
+        std::swap(sph.order, sph.order_scratch);
+    }
+}
+
+// Sorts the particles into cells and fills the sorted arrays and the cell neighbor table
+template <u32 D, typename Sph, typename Body> static void build_grid(Sph &sph, const Body *bodies, usize count) {
+    const u32 max_bits = D == 2 ? 24 : 21;
+    f32 inverse_cell_size = 1.0f / sph.smoothing_length;
+
+    f32 low[D], high[D];
+    for (u32 k = 0; k < D; k++) {
+        low[k] = high[k] = axis(bodies[0].transform.position, k);
+    }
+    for (usize i = 1; i < count; i++) {
+        for (u32 k = 0; k < D; k++) {
+            low[k] = std::fmin(low[k], axis(bodies[i].transform.position, k));
+            high[k] = std::fmax(high[k], axis(bodies[i].transform.position, k));
+        }
+    }
+
+    // Only as many bits per axis as the cells spanned need, so the radix sort makes as few passes as it can
+    u32 bits = 1;
+    for (u32 k = 0; k < D; k++) {
+        f32 cells = std::fmin((high[k] - low[k]) * inverse_cell_size + 1.0f, 4.0e9f);
+        while (bits < max_bits && (f32)(1ull << bits) < cells) bits++;
+    }
+    u32 max_cell = (u32)((1ull << bits) - 1);
+
+    parallel_for(count, SPH_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            u32 cell[D];
+            for (u32 k = 0; k < D; k++) {
+                f32 c = (axis(bodies[i].transform.position, k) - low[k]) * inverse_cell_size;
+                cell[k] = (u32)std::fmin(std::fmax(c, 0.0f), (f32)max_cell);
+            }
+            sph.codes[i] = morton_code<D>(cell);
+            sph.order[i] = (u32)i;
+        }
+    });
+    radix_sort(sph, count, bits * D);
+
+    parallel_for(count, SPH_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Body &body = bodies[sph.order[i]];
+            for (u32 k = 0; k < D; k++) {
+                sph.positions[k][i] = axis(body.transform.position, k);
+                sph.velocities[k][i] = axis(body.transform.velocity, k);
+            }
+            sph.masses[i] = body.mass;
+        }
+    });
+
+    sph.cell_count = 0;
+    for (usize i = 0; i < count; i++) {
+        if (i == 0 || sph.codes[i] != sph.codes[i - 1]) {
+            sph.cell_codes[sph.cell_count] = sph.codes[i];
+            sph.cell_starts[sph.cell_count++] = (u32)i;
+        }
+    }
+    sph.cell_starts[sph.cell_count] = (u32)count;
+
+    const u32 neighbor_count = D == 2 ? 9 : 27;
+    parallel_for(sph.cell_count, SPH_BATCH, [&](usize begin, usize end) {
+        for (usize c = begin; c < end; c++) {
+            u32 cell[D];
+            morton_cell<D>(sph.cell_codes[c], cell);
+
+            for (u32 n = 0; n < neighbor_count; n++) {
+                u32 neighbor[D];
+                bool inside = true;
+                for (u32 k = 0, rest = n; k < D; k++, rest /= 3) {
+                    i64 coordinate = (i64)cell[k] + (i64)(rest % 3) - 1;
+                    inside = inside && coordinate >= 0 && coordinate <= (i64)max_cell;
+                    neighbor[k] = (u32)coordinate;
+                }
+
+                u32 &slot = sph.cell_neighbors[c * neighbor_count + n];
+                slot = ~0u;
+                if (!inside) continue;
+
+                u64 code = morton_code<D>(neighbor);
+                const u64 *found = std::lower_bound(sph.cell_codes, sph.cell_codes + sph.cell_count, code);
+                if (found != sph.cell_codes + sph.cell_count && *found == code) {
+                    slot = (u32)(found - sph.cell_codes);
+                }
+            }
+        }
+    });
+}
+
+// Copies of the particles around one cell, padded to a whole number of lanes with particles outside every kernel,
+// and what each of them contributes to the particle being summed
+template <u32 D> struct Neighborhood {
+    usize capacity;
+    usize count;
+    f32 *positions[D];
+    f32 *velocities[D];
+    f32 *masses;
+    f32 *densities;
+    f32 *pressures;
+    f32 *terms[D];
+};
+
+template <u32 D, typename Sph>
+static void gather_neighborhood(const Sph &sph, usize cell, Neighborhood<D> &around, bool with_pressure) {
+    const u32 neighbor_count = D == 2 ? 9 : 27;
+    const u32 *neighbors = sph.cell_neighbors + cell * neighbor_count;
+
+    usize count = 0;
+    for (u32 n = 0; n < neighbor_count; n++) {
+        if (neighbors[n] != ~0u) count += sph.cell_starts[neighbors[n] + 1] - sph.cell_starts[neighbors[n]];
+    }
+    usize padded = (count + SPH_LANES - 1) / SPH_LANES * SPH_LANES;
+
+    if (padded > around.capacity) {
+        around.capacity = padded * 2;
+        for (u32 k = 0; k < D; k++) {
+            around.positions[k] = (f32 *)realloc(around.positions[k], around.capacity * sizeof(f32));
+            around.velocities[k] = (f32 *)realloc(around.velocities[k], around.capacity * sizeof(f32));
+            around.terms[k] = (f32 *)realloc(around.terms[k], around.capacity * sizeof(f32));
+        }
+        around.masses = (f32 *)realloc(around.masses, around.capacity * sizeof(f32));
+        around.densities = (f32 *)realloc(around.densities, around.capacity * sizeof(f32));
+        around.pressures = (f32 *)realloc(around.pressures, around.capacity * sizeof(f32));
+    }
+
+    usize offset = 0;
+    for (u32 n = 0; n < neighbor_count; n++) {
+        if (neighbors[n] == ~0u) continue;
+
+        u32 first = sph.cell_starts[neighbors[n]], run = sph.cell_starts[neighbors[n] + 1] - first;
+        for (u32 k = 0; k < D; k++) {
+            memcpy(around.positions[k] + offset, sph.positions[k] + first, run * sizeof(f32));
+            if (with_pressure) memcpy(around.velocities[k] + offset, sph.velocities[k] + first, run * sizeof(f32));
+        }
+        memcpy(around.masses + offset, sph.masses + first, run * sizeof(f32));
+        if (with_pressure) {
+            memcpy(around.densities + offset, sph.densities + first, run * sizeof(f32));
+            memcpy(around.pressures + offset, sph.pressures + first, run * sizeof(f32));
+        }
+        offset += run;
+    }
+
+    for (usize j = count; j < padded; j++) {
+        for (u32 k = 0; k < D; k++) {
+            around.positions[k][j] = SPH_PADDING;
+            around.velocities[k][j] = 0.0f;
+        }
+        around.masses[j] = 0.0f;
+        around.densities[j] = 1.0f;
+        around.pressures[j] = 0.0f;
+    }
+    around.count = padded;
+}
+
+// Sum over a whole number of lanes, with independent partial sums so the additions vectorize
+static inline f32 sum_lanes(const f32 *terms, usize count) {
+    f32 sums[SPH_LANES] = {};
+    for (usize base = 0; base < count; base += SPH_LANES) {
+        for (usize l = 0; l < SPH_LANES; l++) {
+            sums[l] += terms[base + l];
+        }
+    }
+
+    f32 sum = 0.0f;
+    for (usize l = 0; l < SPH_LANES; l++) {
+        sum += sums[l];
+    }
+    return sum;
+}
+
+template <u32 D> static void free_neighborhood(Neighborhood<D> &around) {
+    for (u32 k = 0; k < D; k++) {
+        free(around.positions[k]);
+        free(around.velocities[k]);
+        free(around.terms[k]);
+    }
+    free(around.masses);
+    free(around.densities);
+    free(around.pressures);
+}
+
+template <u32 D, typename Sph> static void compute_densities(Sph &sph) {
+    f32 h = sph.smoothing_length, h2 = h * h;
+    SphKernels<D> kernels = sph_kernels(h, std::integral_constant<u32, D>());
+
+    parallel_for(sph.cell_count, SPH_CELL_BATCH, [&](usize begin, usize end) {
+        Neighborhood<D> around = {};
+
+        for (usize c = begin; c < end; c++) {
+            gather_neighborhood<D>(sph, c, around, false);
+
+            for (u32 i = sph.cell_starts[c]; i < sph.cell_starts[c + 1]; i++) {
+                f32 center[D];
+                for (u32 k = 0; k < D; k++) {
+                    center[k] = sph.positions[k][i];
+                }
+
+                f32 *terms = around.terms[0];
+                for (usize j = 0; j < around.count; j++) {
+                    f32 r2 = 0.0f;
+                    for (u32 k = 0; k < D; k++) {
+                        f32 d = around.positions[k][j] - center[k];
+                        r2 += d * d;
+                    }
+                    f32 q = r2 < h2 ? h - std::sqrt(r2) : 0.0f;
+                    terms[j] = around.masses[j] * q * q * q;
+                }
+
+                f32 density = sum_lanes(terms, around.count) * kernels.density;
+                sph.densities[i] = density;
+                sph.pressures[i] = std::fmax(sph.stiffness * (density - sph.rest_density), 0.0f);
+            }
+        }
+
+        free_neighborhood(around);
+    });
+}
+
+template <u32 D, typename Sph, typename Body> static void apply_forces(Sph &sph, Body *bodies, f32 dt) {
+    f32 h = sph.smoothing_length, h2 = h * h;
+    SphKernels<D> kernels = sph_kernels(h, std::integral_constant<u32, D>());
+
+    parallel_for(sph.cell_count, SPH_CELL_BATCH, [&](usize begin, usize end) {
+        Neighborhood<D> around = {};
+
+        for (usize c = begin; c < end; c++) {
+            gather_neighborhood<D>(sph, c, around, true);
+
+            for (u32 i = sph.cell_starts[c]; i < sph.cell_starts[c + 1]; i++) {
+                Body &body = bodies[sph.order[i]];
+                if (body.kind != BodyKind::Dynamic || body.sleeping) continue;
+
+                f32 density = sph.densities[i];
+                f32 pressure = sph.pressures[i] / density; // p_i / rho_i^2, times rho_i undone by the final scale
+                f32 center[D], velocity[D];
+                for (u32 k = 0; k < D; k++) {
+                    center[k] = sph.positions[k][i];
+                    velocity[k] = sph.velocities[k][i];
+                }
+
+                for (usize j = 0; j < around.count; j++) {
+                    f32 d[D], r2 = 0.0f;
+                    for (u32 k = 0; k < D; k++) {
+                        d[k] = around.positions[k][j] - center[k];
+                        r2 += d[k] * d[k];
+                    }
+
+                    // Pushed away from j by both pressures (the symmetric p / rho^2 form, which conserves momentum
+                    // and energy), and dragged along with j's velocity
+                    bool inside = r2 < h2 && r2 > SPH_MIN_DISTANCE_SQUARED;
+                    f32 r = std::sqrt(r2);
+                    f32 q = inside ? h - r : 0.0f;
+                    f32 rho = around.densities[j];
+                    f32 both = pressure + around.pressures[j] * density / (rho * rho);
+                    f32 push = -around.masses[j] * both * kernels.pressure * q * q / (inside ? r : 1.0f);
+                    f32 drag = around.masses[j] / rho * sph.viscosity * kernels.viscosity * q;
+                    for (u32 k = 0; k < D; k++) {
+                        around.terms[k][j] = push * d[k] + drag * (around.velocities[k][j] - velocity[k]);
+                    }
+                }
+
+                f32 scale = dt / density;
+                for (u32 k = 0; k < D; k++) {
+                    axis(body.transform.velocity, k) += sum_lanes(around.terms[k], around.count) * scale;
+                }
+            }
+        }
+
+        free_neighborhood(around);
+    });
+}
+
+template <u32 D, typename Sph, typename Body>
+static void apply_sph_forces_impl(Sph &sph, Body *bodies, usize body_count, f32 dt) {
+    sph.particle_count = body_count;
+    if (body_count == 0) return;
+
+    reserve_particles<D>(sph, body_count);
+    build_grid<D>(sph, bodies, body_count);
+    compute_densities<D>(sph);
+    apply_forces<D>(sph, bodies, dt);
+}
+
+template <typename Sph>
+static void init_sph_impl(Sph &sph, f32 smoothing_length, f32 rest_density, f32 stiffness, f32 viscosity) {
+    sph = {};
+    sph.smoothing_length = smoothing_length;
+    sph.rest_density = rest_density;
+    sph.stiffness = stiffness;
+    sph.viscosity = viscosity;
+}
+
+template <u32 D, typename Sph> static void deinit_sph_impl(Sph &sph) {
+    free(sph.codes);
+    free(sph.code_scratch);
+    free(sph.order);
+    free(sph.order_scratch);
+    for (u32 k = 0; k < D; k++) {
+        free(sph.positions[k]);
+        free(sph.velocities[k]);
+    }
+    free(sph.masses);
+    free(sph.densities);
+    free(sph.pressures);
+    free(sph.histograms);
+    free(sph.cell_codes);
+    free(sph.cell_starts);
+    free(sph.cell_neighbors);
+
+    sph = {};
+}
+
+void init_sph(Sph2 &sph, float smoothing_length, float rest_density, float stiffness, float viscosity) {
+    init_sph_impl(sph, smoothing_length, rest_density, stiffness, viscosity);
+}
+
+void init_sph(Sph3 &sph, float smoothing_length, float rest_density, float stiffness, float viscosity) {
+    init_sph_impl(sph, smoothing_length, rest_density, stiffness, viscosity);
+}
+
+void deinit_sph(Sph2 &sph) {
+    deinit_sph_impl<2>(sph);
+}
+
+void deinit_sph(Sph3 &sph) {
+    deinit_sph_impl<3>(sph);
+}
+
+void apply_sph_forces(Sph2 &sph, Body2 *bodies, usize body_count, float dt) {
+    apply_sph_forces_impl<2>(sph, bodies, body_count, dt);
+}
+
+void apply_sph_forces(Sph3 &sph, Body3 *bodies, usize body_count, float dt) {
+    apply_sph_forces_impl<3>(sph, bodies, body_count, dt);
+}
@@ -0,0 +1,215 @@
+#include "physics/sweep_and_prune.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static const usize SWEEP_BATCH = 4096;
+
+static inline f32 axis(const Vec2 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline f32 axis(const Vec3 &v, u32 k) {
+    return (&v.x)[k];
+}
+
+static inline bool has_shape(const Body2 &body) {
+    return body.shape.kind != ShapeKind2::None;
+}
+
+static inline bool has_shape(const Body3 &body) {
+    return body.shape.kind != ShapeKind3::None;
+}
+
+// Minimum endpoints sort before maximum endpoints of equal value, so touching boxes count as overlapping
+static inline bool endpoint_less(const SweepEndpoint &a, const SweepEndpoint &b) {
+    return a.value < b.value || (a.value == b.value && !(a.data & 1) && (b.data & 1));
+}
+
+static inline bool endpoint_order(const SweepEndpoint &a, const SweepEndpoint &b) {
+    if (endpoint_less(a, b)) return true;
+    if (endpoint_less(b, a)) return false;
+    return a.data < b.data;
+}
+
+template <u32 D, typename Sap, typename Aabb> static void rebuild(Sap &sap) {
+    for (usize slot = 0; slot < sap.overlaps.capacity; slot++) {
+        if (pair_table_slot_used(sap.overlaps, slot)) {
+            push_pair(sap.ended, pair_table_slot_a(sap.overlaps, slot), pair_table_slot_b(sap.overlaps, slot));
+        }
+    }
+    clear_pair_table(sap.overlaps);
+
+    usize endpoint_count = 0;
+    for (usize i = 0; i < sap.body_count; i++) {
+        endpoint_count += sap.tracked[i] ? 2 : 0;
+    }
+
+    if (endpoint_count > sap.endpoint_count) {
+        for (u32 k = 0; k < D; k++) {
+            sap.endpoints[k] = (SweepEndpoint *)realloc(sap.endpoints[k], endpoint_count * sizeof(SweepEndpoint));
+        }
+    }
+    sap.endpoint_count = endpoint_count;
+
+    for (u32 k = 0; k < D; k++) {
+        SweepEndpoint *endpoints = sap.endpoints[k];
+        usize e = 0;
+        for (usize i = 0; i < sap.body_count; i++) {
+            if (!sap.tracked[i]) continue;
+            endpoints[e++] = {axis(sap.bounds[i].min, k), (u32)i << 1};
+            endpoints[e++] = {axis(sap.bounds[i].max, k), (u32)i << 1 | 1};
+        }
+        std::sort(endpoints, endpoints + endpoint_count, endpoint_order);
+    }
+
+    // One sweep along the first axis finds the initial overlaps
+    u32 *active = (u32 *)malloc((endpoint_count / 2 + 1) * sizeof(u32));
+    usize active_count = 0;
+
+    for (usize e = 0; e < endpoint_count; e++) {
+        const SweepEndpoint &endpoint = sap.endpoints[0][e];
+        u32 body = endpoint.data >> 1;
+
+        if (endpoint.data & 1) {
+            for (usize j = 0; j < active_count; j++) {
+                if (active[j] == body) {
+                    active[j] = active[--active_count];
+                    break;
+                }
+            }
+            continue;
+        }
+
+        for (usize j = 0; j < active_count; j++) {
+            if (aabb_overlap(sap.bounds[body], sap.bounds[active[j]])) {
+                pair_table_insert(sap.overlaps, body, active[j]);
+                push_pair(sap.began, body, active[j]);
+            }
+        }
+        active[active_count++] = body;
+    }
+
+    free(active);
+}
+
+template <typename Sap> static void sort_axis(Sap &sap, SweepEndpoint *endpoints) {
+    for (usize i = 1; i < sap.endpoint_count; i++) {
+        SweepEndpoint endpoint = endpoints[i];
+        u32 body = endpoint.data >> 1;
+        bool is_max = endpoint.data & 1;
+
+        usize j = i;
+        while (j > 0 && endpoint_less(endpoint, endpoints[j - 1])) {
+            const SweepEndpoint &passed = endpoints[j - 1];
+            u32 other = passed.data >> 1;
+            bool passed_max = passed.data & 1;
+
+            if (!is_max && passed_max) {
+                // Entered the other interval on this axis
+                bool inserted = false;
+                if (aabb_overlap(sap.bounds[body], sap.bounds[other])) {
+                    pair_table_insert(sap.overlaps, body, other, &inserted);
+                }
+                if (inserted) push_pair(sap.began, body, other);
+            } else if (is_max && !passed_max) {
+                // Left the other interval on this axis
+                if (pair_table_remove(sap.overlaps, body, other)) push_pair(sap.ended, body, other);
+            }
+
+            endpoints[j] = passed;
+            j--;
+        }
+        endpoints[j] = endpoint;
+    }
+}
+
+template <u32 D, typename Sap, typename Body, typename Aabb>
+static void update_sweep_and_prune_impl(Sap &sap, const Body *bodies, usize body_count) {
+    sap.began.count = 0;
+    sap.ended.count = 0;
+
+    bool needs_rebuild = body_count != sap.body_count;
+    if (body_count > sap.body_capacity) {
+        sap.body_capacity = body_count;
+        sap.bounds = (Aabb *)realloc(sap.bounds, body_count * sizeof(Aabb));
+        sap.tracked = (u8 *)realloc(sap.tracked, body_count * sizeof(u8));
+    }
+    if (needs_rebuild) {
+        memset(sap.tracked, 0, body_count * sizeof(u8));
+    }
+    sap.body_count = body_count;
+
+    Aabb *bounds = sap.bounds;
+    const u8 *tracked = sap.tracked;
+    parallel_for(body_count, SWEEP_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            // Sleeping bodies keep the bounds they had when they fell asleep
+            if (has_shape(bodies[i]) && !(bodies[i].sleeping && tracked[i])) {
+                bounds[i] = compute_aabb(bodies[i].shape, bodies[i].transform);
+            }
+        }
+    });
+
+    for (usize i = 0; i < body_count; i++) {
+        u8 shaped = has_shape(bodies[i]) ? 1 : 0;
+        if (shaped != sap.tracked[i]) {
+            sap.tracked[i] = shaped;
+            needs_rebuild = true;
+        }
+    }
+
+    if (needs_rebuild) {
+        rebuild<D, Sap, Aabb>(sap);
+        return;
+    }
+
+    for (u32 k = 0; k < D; k++) {
+        SweepEndpoint *endpoints = sap.endpoints[k];
+        for (usize e = 0; e < sap.endpoint_count; e++) {
+            const Aabb &aabb = bounds[endpoints[e].data >> 1];
+            endpoints[e].value = endpoints[e].data & 1 ? axis(aabb.max, k) : axis(aabb.min, k);
+        }
+
+        sort_axis(sap, endpoints);
+    }
+}
+
+template <u32 D, typename Sap> static void deinit_sweep_and_prune_impl(Sap &sap) {
+    for (u32 k = 0; k < D; k++) {
+        free(sap.endpoints[k]);
+    }
+
+    free(sap.bounds);
+    free(sap.tracked);
+    free(sap.began.pairs);
+    free(sap.ended.pairs);
+    deinit_pair_table(sap.overlaps);
+
+    sap = {};
+}
+
+void init_sweep_and_prune(SweepAndPrune2 &sap) {
+    sap = {};
+}
+
+void init_sweep_and_prune(SweepAndPrune3 &sap) {
+    sap = {};
+}
+
+void deinit_sweep_and_prune(SweepAndPrune2 &sap) {
+    deinit_sweep_and_prune_impl<2>(sap);
+}
+
+void deinit_sweep_and_prune(SweepAndPrune3 &sap) {
+    deinit_sweep_and_prune_impl<3>(sap);
+}
+
+void update_sweep_and_prune(SweepAndPrune2 &sap, const Body2 *bodies, usize body_count) {
+    update_sweep_and_prune_impl<2, SweepAndPrune2, Body2, Aabb2>(sap, bodies, body_count);
+}
+
+void update_sweep_and_prune(SweepAndPrune3 &sap, const Body3 *bodies, usize body_count) {
+    update_sweep_and_prune_impl<3, SweepAndPrune3, Body3, Aabb3>(sap, bodies, body_count);
+}
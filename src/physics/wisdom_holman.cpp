@@ -0,0 +1,160 @@
+#include "physics/wisdom_holman.hpp"
+#include "physics/kepler.hpp"
+#include <cmath>
+
+// Bodies taking part in the split: everything except kinematic bodies, which only ride along, and sleeping ones, which
+// stay put
+template <typename Body> static bool is_orbiting(const Body &body) {
+    return body.kind == BodyKind::Dynamic && !body.sleeping;
+}
+
+// Mutual attraction between the non-central bodies. Positions don't change during a kick, so each pair is visited once
+// and both velocities are updated in place.
+template <typename Body, typename Vec>
+static void interaction_kick(Body *bodies, usize body_count, usize central_index, float dt) {
+    for (usize i = 0; i < body_count; i++) {
+        if (i == central_index || !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        for (usize j = i + 1; j < body_count; j++) {
+            if (j == central_index || !is_orbiting(bodies[j])) {
+                continue;
+            }
+
+            Vec delta_position = bodies[j].transform.position - bodies[i].transform.position;
+            float distance_squared = delta_position.length_squared();
+            if (distance_squared <= 0.0f) {
+                continue;
+            }
+
+            float inverse_distance_cubed = 1.0f / (distance_squared * std::sqrt(distance_squared));
+            Vec impulse = delta_position * (GRAVITATIONAL_PARAMETER * inverse_distance_cubed * dt);
+            bodies[i].transform.velocity += impulse * bodies[j].mass;
+            bodies[j].transform.velocity -= impulse * bodies[i].mass;
+        }
+    }
+}
+
+// Momentum of the bodies relative to the barycenter shifts the heliocentric positions
+template <typename Body, typename Vec>
+static void jump(Body *bodies, usize body_count, usize central_index, float dt) {
+    Vec momentum = Vec::ZERO();
+    for (usize i = 0; i < body_count; i++) {
+        if (i == central_index || !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        momentum += bodies[i].transform.velocity * bodies[i].mass;
+    }
+
+    Vec shift = momentum * (dt / bodies[central_index].mass);
+    for (usize i = 0; i < body_count; i++) {
+        if (i == central_index || !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        bodies[i].transform.position += shift;
+    }
+}
+
+template <typename Body, typename Vec>
+static void kepler_step(Body *bodies, usize body_count, usize central_index, float dt) {
+    f64 mu = (f64)GRAVITATIONAL_PARAMETER * (f64)bodies[central_index].mass;
+
+    for (usize i = 0; i < body_count; i++) {
+        auto &transform = bodies[i].transform;
+
+        // The central slot holds the barycenter, which moves uniformly
+        bool orbiting = i != central_index && is_orbiting(bodies[i]);
+        if (i != central_index && bodies[i].sleeping) {
+            continue;
+        }
+        if (!orbiting || !kepler_drift(transform.position, transform.velocity, mu, dt)) {
+            transform.position += transform.velocity * dt;
+        }
+    }
+}
+
+template <typename Body, typename Vec>
+static void integrate_wisdom_holman_impl(Body *bodies, usize body_count, usize central_index, float dt) {
+    if (central_index >= body_count || bodies[central_index].mass <= 0.0f) {
+        return;
+    }
+
+    // The split moves the central body with the barycenter, so it cannot stay asleep
+    if (bodies[central_index].sleeping) {
+        wake_body(bodies[central_index]);
+    }
+
+    auto &central = bodies[central_index].transform;
+
+    // Inertial -> democratic heliocentric: positions relative to the central body, velocities relative to the
+    // barycenter. The central slot stores the barycenter itself.
+    float total_mass = 0.0f;
+    Vec barycenter = Vec::ZERO();
+    Vec barycenter_velocity = Vec::ZERO();
+    for (usize i = 0; i < body_count; i++) {
+        if (i != central_index && !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        total_mass += bodies[i].mass;
+        barycenter += bodies[i].transform.position * bodies[i].mass;
+        barycenter_velocity += bodies[i].transform.velocity * bodies[i].mass;
+    }
+    barycenter /= total_mass;
+    barycenter_velocity /= total_mass;
+
+    for (usize i = 0; i < body_count; i++) {
+        if (i == central_index || !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        bodies[i].transform.position -= central.position;
+        bodies[i].transform.velocity -= barycenter_velocity;
+    }
+    central.position = barycenter;
+    central.velocity = barycenter_velocity;
+
+    float half_dt = dt * 0.5f;
+    interaction_kick<Body, Vec>(bodies, body_count, central_index, half_dt);
+    jump<Body, Vec>(bodies, body_count, central_index, half_dt);
+    kepler_step<Body, Vec>(bodies, body_count, central_index, dt);
+    jump<Body, Vec>(bodies, body_count, central_index, half_dt);
+    interaction_kick<Body, Vec>(bodies, body_count, central_index, half_dt);
+
+    // Democratic heliocentric -> inertial
+    Vec weighted_position = Vec::ZERO();
+    Vec momentum = Vec::ZERO();
+    for (usize i = 0; i < body_count; i++) {
+        if (i == central_index || !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        weighted_position += bodies[i].transform.position * bodies[i].mass;
+        momentum += bodies[i].transform.velocity * bodies[i].mass;
+    }
+
+    barycenter = central.position;
+    barycenter_velocity = central.velocity;
+    central.position = barycenter - weighted_position / total_mass;
+    central.velocity = barycenter_velocity - momentum / bodies[central_index].mass;
+
+    for (usize i = 0; i < body_count; i++) {
+        if (i == central_index || !is_orbiting(bodies[i])) {
+            continue;
+        }
+
+        bodies[i].transform.position += central.position;
+        bodies[i].transform.velocity += barycenter_velocity;
+    }
+}
+
+void integrate_wisdom_holman(Body2 *bodies, usize body_count, usize central_index, float dt) {
+    integrate_wisdom_holman_impl<Body2, Vec2>(bodies, body_count, central_index, dt);
+}
+
+void integrate_wisdom_holman(Body3 *bodies, usize body_count, usize central_index, float dt) {
+    integrate_wisdom_holman_impl<Body3, Vec3>(bodies, body_count, central_index, dt);
+}
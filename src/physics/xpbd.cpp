@@ -0,0 +1,542 @@
+#include "physics/xpbd.hpp"
+#include "common/parallel.hpp"
+#include "physics/collider.hpp"
+#include <cmath>
+#include <cstdlib>
+
+static const usize XPBD_LANES = 64;        // rows gathered per kernel call, also the parallel batch
+static const usize XPBD_BODY_BATCH = 1024;
+static const f32 XPBD_MIN_LENGTH = 1.0e-6f; // separations below this have no direction to push along
+static const u32 SERIAL_COLOR = XPBD_MAX_COLORS;
+
+static inline bool is_movable(const Body2 &body) {
+    return body.kind == BodyKind::Dynamic && body.mass > 0.0f && !body.sleeping;
+}
+
+static inline bool is_movable(const Body3 &body) {
+    return body.kind == BodyKind::Dynamic && body.mass > 0.0f && !body.sleeping;
+}
+
+// Small rotation by the given angle (a vector in 3D), as in integrate_physics
+static inline void turn(Rot2 &rotation, f32 angle) {
+    f32 half = 0.5f * angle;
+    Rot2 turned = {.scalar = rotation.scalar - half * rotation.bivector,
+                   .bivector = rotation.bivector + half * rotation.scalar};
+    f32 inverse_norm = 1.0f / std::sqrt(turned.scalar * turned.scalar + turned.bivector * turned.bivector);
+    rotation = {.scalar = turned.scalar * inverse_norm, .bivector = turned.bivector * inverse_norm};
+}
+
+static inline void turn(Rot3 &rotation, Vec3 angle) {
+    Rot3 delta = {.scalar = 0.0f, .b12 = 0.5f * angle.z, .b23 = 0.5f * angle.x, .b31 = 0.5f * angle.y};
+    Rot3 product = delta * rotation;
+    rotation = Rot3{.scalar = rotation.scalar + product.scalar,
+                    .b12 = rotation.b12 + product.b12,
+                    .b23 = rotation.b23 + product.b23,
+                    .b31 = rotation.b31 + product.b31}
+                   .normalize();
+}
+
+static void push_row(XpbdRow2 *rows, usize &count, XpbdRowKind kind, const Joint2 &joint, f32 rest_length) {
+    rows[count++] = {kind, joint.a, joint.b, joint.anchor_a, joint.anchor_b, rest_length, joint.compliance, 0.0f};
+}
+
+static void push_row(XpbdRow3 *rows, usize &count, XpbdRowKind kind, const Joint3 &joint, f32 rest_length) {
+    rows[count++] = {kind, joint.a, joint.b, joint.anchor_a, joint.anchor_b, rest_length, joint.compliance, 0.0f};
+}
+
+static usize rows_per_joint(const Joint2 &) {
+    return 1;
+}
+
+static usize rows_per_joint(const Joint3 &joint) {
+    return joint.kind == JointKind::Hinge ? 2 : 1;
+}
+
+static void push_joint_rows(XpbdRow2 *rows, usize &count, const Joint2 &joint) {
+    push_row(rows, count, XpbdRowKind::Point, joint, joint.kind == JointKind::Distance ? joint.rest_length : 0.0f);
+}
+
+static void push_joint_rows(XpbdRow3 *rows, usize &count, const Joint3 &joint) {
+    push_row(rows, count, XpbdRowKind::Point, joint, joint.kind == JointKind::Distance ? joint.rest_length : 0.0f);
+    if (joint.kind == JointKind::Hinge) {
+        rows[count++] = {XpbdRowKind::Align, joint.a, joint.b, joint.axis_a, joint.axis_b, 0.0f, joint.compliance,
+                         0.0f};
+    }
+}
+
+static void reserve_inertias(XpbdSolver2 &solver) {
+    solver.inverse_inertias = (f32 *)realloc(solver.inverse_inertias, solver.body_capacity * sizeof(f32));
+}
+
+static void reserve_inertias(XpbdSolver3 &solver) {
+    solver.inverse_moments = (Vec3 *)realloc(solver.inverse_moments, solver.body_capacity * sizeof(Vec3));
+    solver.inverse_inertias = (f32 *)realloc(solver.inverse_inertias, solver.body_capacity * 6 * sizeof(f32));
+}
+
+template <typename Solver> static void reserve_bodies(Solver &solver, usize body_count) {
+    if (body_count <= solver.body_capacity) return;
+
+    solver.body_capacity = body_count + body_count / 2;
+    solver.inverse_masses = (f32 *)realloc(solver.inverse_masses, solver.body_capacity * sizeof(f32));
+    solver.color_masks = (u64 *)realloc(solver.color_masks, solver.body_capacity * sizeof(u64));
+    reserve_inertias(solver);
+}
+
+template <typename Solver> static void reserve_rows(Solver &solver, usize row_count) {
+    if (row_count <= solver.row_capacity) return;
+
+    solver.row_capacity = row_count + row_count / 2;
+    solver.rows = (decltype(solver.rows))realloc(solver.rows, solver.row_capacity * sizeof(*solver.rows));
+    solver.scratch = (decltype(solver.rows))realloc(solver.scratch, solver.row_capacity * sizeof(*solver.rows));
+    solver.row_colors = (u8 *)realloc(solver.row_colors, solver.row_capacity * sizeof(u8));
+    solver.lambdas = (f32 *)realloc(solver.lambdas, solver.row_capacity * sizeof(f32));
+}
+
+// Expands the joints and springs into rows, in `scratch`, and wakes sleeping bodies held by awake ones
+template <typename Solver, typename Body, typename Joint>
+static void build_rows(Solver &solver, Body *bodies, const Joint *joints, usize joint_count, const Spring *springs,
+                       usize spring_count) {
+    usize row_count = spring_count;
+    for (usize j = 0; j < joint_count; j++) {
+        row_count += rows_per_joint(joints[j]);
+    }
+    reserve_rows(solver, row_count);
+
+    solver.row_count = 0;
+    for (usize j = 0; j < joint_count; j++) {
+        push_joint_rows(solver.scratch, solver.row_count, joints[j]);
+    }
+    for (usize s = 0; s < spring_count; s++) {
+        const Spring &spring = springs[s];
+        if (spring.stiffness <= 0.0f) continue;
+
+        auto &row = solver.scratch[solver.row_count++];
+        row = {};
+        row.kind = XpbdRowKind::Point;
+        row.a = spring.a;
+        row.b = spring.b;
+        row.rest_length = spring.rest_length;
+        row.compliance = 1.0f / spring.stiffness;
+        row.damping = spring.damping;
+    }
+
+    for (usize r = 0; r < solver.row_count; r++) {
+        Body &a = bodies[solver.scratch[r].a], &b = bodies[solver.scratch[r].b];
+        bool awake_a = a.kind == BodyKind::Dynamic && !a.sleeping;
+        bool awake_b = b.kind == BodyKind::Dynamic && !b.sleeping;
+        if (awake_a && b.sleeping) wake_body(b);
+        if (awake_b && a.sleeping) wake_body(a);
+    }
+}
+
+// Greedy coloring over the bodies each row moves, then a counting sort of the rows into (color, kind) batches.
+// Returns the number of colors used.
+template <typename Solver, typename Body> static u32 color_rows(Solver &solver, const Body *bodies, usize body_count) {
+    for (usize i = 0; i < body_count; i++) {
+        solver.color_masks[i] = 0;
+    }
+
+    const usize batch_count = (XPBD_MAX_COLORS + 1) * 2;
+    u32 *starts = solver.batch_starts;
+    for (usize k = 0; k <= batch_count; k++) {
+        starts[k] = 0;
+    }
+
+    u32 color_count = 0;
+    for (usize r = 0; r < solver.row_count; r++) {
+        const auto &row = solver.scratch[r];
+        bool moves_a = is_movable(bodies[row.a]), moves_b = is_movable(bodies[row.b]);
+        u64 used = (moves_a ? solver.color_masks[row.a] : 0) | (moves_b ? solver.color_masks[row.b] : 0);
+
+        u32 color = ~used ? (u32)__builtin_ctzll(~used) : SERIAL_COLOR;
+        if (color < SERIAL_COLOR) {
+            if (moves_a) solver.color_masks[row.a] |= 1ull << color;
+            if (moves_b) solver.color_masks[row.b] |= 1ull << color;
+        }
+        solver.row_colors[r] = (u8)color;
+        color_count = color + 1 > color_count ? color + 1 : color_count;
+        starts[color * 2 + (u32)row.kind + 1]++;
+    }
+
+    for (usize k = 0; k < batch_count; k++) {
+        starts[k + 1] += starts[k];
+    }
+
+    // Scatter with the starts as cursors, then shift them back
+    for (usize r = 0; r < solver.row_count; r++) {
+        u32 batch = solver.row_colors[r] * 2 + (u32)solver.scratch[r].kind;
+        solver.rows[starts[batch]++] = solver.scratch[r];
+    }
+    for (usize k = batch_count; k > 0; k--) {
+        starts[k] = starts[k - 1];
+    }
+    starts[0] = 0;
+
+    return color_count;
+}
+
+// Point rows: C = |(b + r_b) - (a + r_a)| - rest_length, with XPBD damping along the separation
+static void solve_point_rows(XpbdSolver2 &solver, Body2 *bodies, usize begin, usize end, f32 h) {
+    f32 dx[XPBD_LANES], dy[XPBD_LANES], rax[XPBD_LANES], ray[XPBD_LANES], rbx[XPBD_LANES], rby[XPBD_LANES];
+    f32 mx[XPBD_LANES], my[XPBD_LANES];
+    f32 wa[XPBD_LANES], wb[XPBD_LANES], ia[XPBD_LANES], ib[XPBD_LANES];
+    f32 rest[XPBD_LANES], alpha[XPBD_LANES], gamma[XPBD_LANES], lambda[XPBD_LANES];
+    f32 px[XPBD_LANES], py[XPBD_LANES], turn_a[XPBD_LANES], turn_b[XPBD_LANES];
+
+    for (usize base = begin; base < end; base += XPBD_LANES) {
+        usize count = end - base < XPBD_LANES ? end - base : XPBD_LANES;
+
+        for (usize i = 0; i < count; i++) {
+            const XpbdRow2 &row = solver.rows[base + i];
+            const Transform2 &a = bodies[row.a].transform, &b = bodies[row.b].transform;
+            Vec2 arm_a = a.rotation.rotate(row.anchor_a), arm_b = b.rotation.rotate(row.anchor_b);
+            Vec2 delta = (b.position + arm_b) - (a.position + arm_a);
+            Vec2 motion = (b.velocity - a.velocity) * h;
+            dx[i] = delta.x, dy[i] = delta.y;
+            rax[i] = arm_a.x, ray[i] = arm_a.y, rbx[i] = arm_b.x, rby[i] = arm_b.y;
+            mx[i] = motion.x, my[i] = motion.y;
+            wa[i] = solver.inverse_masses[row.a], wb[i] = solver.inverse_masses[row.b];
+            ia[i] = solver.inverse_inertias[row.a], ib[i] = solver.inverse_inertias[row.b];
+            rest[i] = row.rest_length;
+            alpha[i] = row.compliance / (h * h);
+            gamma[i] = row.compliance * row.damping / h;
+            lambda[i] = solver.lambdas[base + i];
+        }
+
+        for (usize i = 0; i < count; i++) {
+            f32 length = std::sqrt(dx[i] * dx[i] + dy[i] * dy[i]);
+            f32 inverse_length = 1.0f / (length > XPBD_MIN_LENGTH ? length : 1.0f);
+            f32 nx = length > XPBD_MIN_LENGTH ? dx[i] * inverse_length : 0.0f;
+            f32 ny = length > XPBD_MIN_LENGTH ? dy[i] * inverse_length : 0.0f;
+
+            f32 arm_a = rax[i] * ny - ray[i] * nx, arm_b = rbx[i] * ny - rby[i] * nx;
+            f32 w = wa[i] + wb[i] + ia[i] * arm_a * arm_a + ib[i] * arm_b * arm_b;
+            f32 denominator = (1.0f + gamma[i]) * w + alpha[i];
+            f32 numerator = -(length - rest[i]) - alpha[i] * lambda[i] - gamma[i] * (mx[i] * nx + my[i] * ny);
+            f32 delta = denominator > 0.0f ? numerator / (denominator > 0.0f ? denominator : 1.0f) : 0.0f;
+
+            lambda[i] += delta;
+            px[i] = nx * delta, py[i] = ny * delta;
+            turn_a[i] = -ia[i] * (rax[i] * py[i] - ray[i] * px[i]);
+            turn_b[i] = ib[i] * (rbx[i] * py[i] - rby[i] * px[i]);
+        }
+
+        for (usize i = 0; i < count; i++) {
+            const XpbdRow2 &row = solver.rows[base + i];
+            solver.lambdas[base + i] = lambda[i];
+            Vec2 impulse = {px[i], py[i]};
+            if (wa[i] > 0.0f) {
+                Transform2 &a = bodies[row.a].transform;
+                a.position -= impulse * wa[i];
+                a.velocity -= impulse * (wa[i] / h);
+                turn(a.rotation, turn_a[i]);
+                a.angular_velocity += turn_a[i] / h;
+            }
+            if (wb[i] > 0.0f) {
+                Transform2 &b = bodies[row.b].transform;
+                b.position += impulse * wb[i];
+                b.velocity += impulse * (wb[i] / h);
+                turn(b.rotation, turn_b[i]);
+                b.angular_velocity += turn_b[i] / h;
+            }
+        }
+    }
+}
+
+// Symmetric tensor stored as xx, yy, zz, xy, xz, yz, times a vector
+#define TENSOR_TIMES(t, x, y, z, out_x, out_y, out_z)                                                                  \
+    f32 out_x = t[0] * (x) + t[3] * (y) + t[4] * (z);                                                                  \
+    f32 out_y = t[3] * (x) + t[1] * (y) + t[5] * (z);                                                                  \
+    f32 out_z = t[4] * (x) + t[5] * (y) + t[2] * (z);
+
+static void solve_point_rows(XpbdSolver3 &solver, Body3 *bodies, usize begin, usize end, f32 h) {
+    f32 dx[XPBD_LANES], dy[XPBD_LANES], dz[XPBD_LANES];
+    f32 rax[XPBD_LANES], ray[XPBD_LANES], raz[XPBD_LANES], rbx[XPBD_LANES], rby[XPBD_LANES], rbz[XPBD_LANES];
+    f32 mx[XPBD_LANES], my[XPBD_LANES], mz[XPBD_LANES];
+    f32 wa[XPBD_LANES], wb[XPBD_LANES], ia[6][XPBD_LANES], ib[6][XPBD_LANES];
+    f32 rest[XPBD_LANES], alpha[XPBD_LANES], gamma[XPBD_LANES], lambda[XPBD_LANES];
+    f32 px[XPBD_LANES], py[XPBD_LANES], pz[XPBD_LANES];
+    f32 tax[XPBD_LANES], tay[XPBD_LANES], taz[XPBD_LANES], tbx[XPBD_LANES], tby[XPBD_LANES], tbz[XPBD_LANES];
+
+    for (usize base = begin; base < end; base += XPBD_LANES) {
+        usize count = end - base < XPBD_LANES ? end - base : XPBD_LANES;
+
+        for (usize i = 0; i < count; i++) {
+            const XpbdRow3 &row = solver.rows[base + i];
+            const Transform3 &a = bodies[row.a].transform, &b = bodies[row.b].transform;
+            Vec3 arm_a = a.rotation.rotate(row.anchor_a), arm_b = b.rotation.rotate(row.anchor_b);
+            Vec3 delta = (b.position + arm_b) - (a.position + arm_a);
+            Vec3 motion = (b.velocity - a.velocity) * h;
+            dx[i] = delta.x, dy[i] = delta.y, dz[i] = delta.z;
+            rax[i] = arm_a.x, ray[i] = arm_a.y, raz[i] = arm_a.z;
+            rbx[i] = arm_b.x, rby[i] = arm_b.y, rbz[i] = arm_b.z;
+            mx[i] = motion.x, my[i] = motion.y, mz[i] = motion.z;
+            wa[i] = solver.inverse_masses[row.a], wb[i] = solver.inverse_masses[row.b];
+            for (u32 k = 0; k < 6; k++) {
+                ia[k][i] = solver.inverse_inertias[row.a * 6 + k];
+                ib[k][i] = solver.inverse_inertias[row.b * 6 + k];
+            }
+            rest[i] = row.rest_length;
+            alpha[i] = row.compliance / (h * h);
+            gamma[i] = row.compliance * row.damping / h;
+            lambda[i] = solver.lambdas[base + i];
+        }
+
+        for (usize i = 0; i < count; i++) {
+            f32 length = std::sqrt(dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i]);
+            f32 inverse_length = 1.0f / (length > XPBD_MIN_LENGTH ? length : 1.0f);
+            f32 nx = length > XPBD_MIN_LENGTH ? dx[i] * inverse_length : 0.0f;
+            f32 ny = length > XPBD_MIN_LENGTH ? dy[i] * inverse_length : 0.0f;
+            f32 nz = length > XPBD_MIN_LENGTH ? dz[i] * inverse_length : 0.0f;
+
+            // r x n for each body, and the spin a unit impulse along n gives it
+            f32 cax = ray[i] * nz - raz[i] * ny, cay = raz[i] * nx - rax[i] * nz, caz = rax[i] * ny - ray[i] * nx;
+            f32 cbx = rby[i] * nz - rbz[i] * ny, cby = rbz[i] * nx - rbx[i] * nz, cbz = rbx[i] * ny - rby[i] * nx;
+            f32 ta[6] = {ia[0][i], ia[1][i], ia[2][i], ia[3][i], ia[4][i], ia[5][i]};
+            f32 tb[6] = {ib[0][i], ib[1][i], ib[2][i], ib[3][i], ib[4][i], ib[5][i]};
+            TENSOR_TIMES(ta, cax, cay, caz, sax, say, saz)
+            TENSOR_TIMES(tb, cbx, cby, cbz, sbx, sby, sbz)
+
+            f32 w = wa[i] + wb[i] + cax * sax + cay * say + caz * saz + cbx * sbx + cby * sby + cbz * sbz;
+            f32 denominator = (1.0f + gamma[i]) * w + alpha[i];
+            f32 approach = mx[i] * nx + my[i] * ny + mz[i] * nz;
+            f32 numerator = -(length - rest[i]) - alpha[i] * lambda[i] - gamma[i] * approach;
+            f32 delta = denominator > 0.0f ? numerator / (denominator > 0.0f ? denominator : 1.0f) : 0.0f;
+
+            lambda[i] += delta;
+            px[i] = nx * delta, py[i] = ny * delta, pz[i] = nz * delta;
+            tax[i] = -sax * delta, tay[i] = -say * delta, taz[i] = -saz * delta;
+            tbx[i] = sbx * delta, tby[i] = sby * delta, tbz[i] = sbz * delta;
+        }
+
+        for (usize i = 0; i < count; i++) {
+            const XpbdRow3 &row = solver.rows[base + i];
+            solver.lambdas[base + i] = lambda[i];
+            Vec3 impulse = {px[i], py[i], pz[i]};
+            if (wa[i] > 0.0f) {
+                Transform3 &a = bodies[row.a].transform;
+                Vec3 angle = {tax[i], tay[i], taz[i]};
+                a.position -= impulse * wa[i];
+                a.velocity -= impulse * (wa[i] / h);
+                turn(a.rotation, angle);
+                a.angular_velocity += angle * (1.0f / h);
+            }
+            if (wb[i] > 0.0f) {
+                Transform3 &b = bodies[row.b].transform;
+                Vec3 angle = {tbx[i], tby[i], tbz[i]};
+                b.position += impulse * wb[i];
+                b.velocity += impulse * (wb[i] / h);
+                turn(b.rotation, angle);
+                b.angular_velocity += angle * (1.0f / h);
+            }
+        }
+    }
+}
+
+// Align rows: C is the angle between the bodies' axes, taken as the sine for small misalignments, about their cross
+// product. Only rotations change.
+static void solve_align_rows(XpbdSolver3 &solver, Body3 *bodies, usize begin, usize end, f32 h) {
+    f32 cx[XPBD_LANES], cy[XPBD_LANES], cz[XPBD_LANES];
+    f32 wa[XPBD_LANES], wb[XPBD_LANES], ia[6][XPBD_LANES], ib[6][XPBD_LANES];
+    f32 alpha[XPBD_LANES], lambda[XPBD_LANES];
+    f32 tax[XPBD_LANES], tay[XPBD_LANES], taz[XPBD_LANES], tbx[XPBD_LANES], tby[XPBD_LANES], tbz[XPBD_LANES];
+
+    for (usize base = begin; base < end; base += XPBD_LANES) {
+        usize count = end - base < XPBD_LANES ? end - base : XPBD_LANES;
+
+        for (usize i = 0; i < count; i++) {
+            const XpbdRow3 &row = solver.rows[base + i];
+            Vec3 axis_a = bodies[row.a].transform.rotation.rotate(row.anchor_a).normalize();
+            Vec3 axis_b = bodies[row.b].transform.rotation.rotate(row.anchor_b).normalize();
+            Vec3 cross = axis_a.cross(axis_b);
+            cx[i] = cross.x, cy[i] = cross.y, cz[i] = cross.z;
+            wa[i] = solver.inverse_masses[row.a], wb[i] = solver.inverse_masses[row.b];
+            for (u32 k = 0; k < 6; k++) {
+                ia[k][i] = solver.inverse_inertias[row.a * 6 + k];
+                ib[k][i] = solver.inverse_inertias[row.b * 6 + k];
+            }
+            alpha[i] = row.compliance / (h * h);
+            lambda[i] = solver.lambdas[base + i];
+        }
+
+        for (usize i = 0; i < count; i++) {
+            f32 angle = std::sqrt(cx[i] * cx[i] + cy[i] * cy[i] + cz[i] * cz[i]);
+            f32 inverse_angle = 1.0f / (angle > XPBD_MIN_LENGTH ? angle : 1.0f);
+            f32 nx = angle > XPBD_MIN_LENGTH ? cx[i] * inverse_angle : 0.0f;
+            f32 ny = angle > XPBD_MIN_LENGTH ? cy[i] * inverse_angle : 0.0f;
+            f32 nz = angle > XPBD_MIN_LENGTH ? cz[i] * inverse_angle : 0.0f;
+
+            f32 ta[6] = {ia[0][i], ia[1][i], ia[2][i], ia[3][i], ia[4][i], ia[5][i]};
+            f32 tb[6] = {ib[0][i], ib[1][i], ib[2][i], ib[3][i], ib[4][i], ib[5][i]};
+            TENSOR_TIMES(ta, nx, ny, nz, sax, say, saz)
+            TENSOR_TIMES(tb, nx, ny, nz, sbx, sby, sbz)
+
+            // Turning a about the cross product brings its axis towards b's, and turning b does the opposite
+            f32 w = nx * (sax + sbx) + ny * (say + sby) + nz * (saz + sbz);
+            f32 denominator = w + alpha[i];
+            f32 numerator = -angle - alpha[i] * lambda[i];
+            f32 delta = denominator > 0.0f ? numerator / (denominator > 0.0f ? denominator : 1.0f) : 0.0f;
+
+            lambda[i] += delta;
+            tax[i] = -sax * delta, tay[i] = -say * delta, taz[i] = -saz * delta;
+            tbx[i] = sbx * delta, tby[i] = sby * delta, tbz[i] = sbz * delta;
+        }
+
+        for (usize i = 0; i < count; i++) {
+            const XpbdRow3 &row = solver.rows[base + i];
+            solver.lambdas[base + i] = lambda[i];
+            if (wa[i] > 0.0f) {
+                Transform3 &a = bodies[row.a].transform;
+                Vec3 angle = {tax[i], tay[i], taz[i]};
+                turn(a.rotation, angle);
+                a.angular_velocity += angle * (1.0f / h);
+            }
+            if (wb[i] > 0.0f) {
+                Transform3 &b = bodies[row.b].transform;
+                Vec3 angle = {tbx[i], tby[i], tbz[i]};
+                turn(b.rotation, angle);
+                b.angular_velocity += angle * (1.0f / h);
+            }
+        }
+    }
+}
+
+#undef TENSOR_TIMES
+
+static void solve_align_rows(XpbdSolver2 &, Body2 *, usize, usize, f32) {
+}
+
+static void prepare_bodies(XpbdSolver2 &solver, const Body2 *bodies, usize body_count) {
+    parallel_for(body_count, XPBD_BODY_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Body2 &body = bodies[i];
+            f32 inertia = is_movable(body) ? moment_of_inertia(body.shape, body.mass) : 0.0f;
+            solver.inverse_masses[i] = is_movable(body) ? 1.0f / body.mass : 0.0f;
+            solver.inverse_inertias[i] = inertia > 0.0f ? 1.0f / inertia : 0.0f;
+        }
+    });
+}
+
+static void prepare_bodies(XpbdSolver3 &solver, const Body3 *bodies, usize body_count) {
+    parallel_for(body_count, XPBD_BODY_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Body3 &body = bodies[i];
+            Vec3 moments = is_movable(body) ? moment_of_inertia(body.shape, body.mass) : Vec3::ZERO();
+            solver.inverse_masses[i] = is_movable(body) ? 1.0f / body.mass : 0.0f;
+            solver.inverse_moments[i] = {moments.x > 0.0f ? 1.0f / moments.x : 0.0f,
+                                         moments.y > 0.0f ? 1.0f / moments.y : 0.0f,
+                                         moments.z > 0.0f ? 1.0f / moments.z : 0.0f};
+        }
+    });
+}
+
+static void orient_inertias(XpbdSolver2 &, const Body2 *, usize) {
+}
+
+// R diag(inverse moments) R^T from the rotated body axes, once per substep
+static void orient_inertias(XpbdSolver3 &solver, const Body3 *bodies, usize body_count) {
+    parallel_for(body_count, XPBD_BODY_BATCH, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const Rot3 &rotation = bodies[i].transform.rotation;
+            Vec3 moments = solver.inverse_moments[i];
+            Vec3 x = rotation.rotate({1.0f, 0.0f, 0.0f}) * std::sqrt(moments.x);
+            Vec3 y = rotation.rotate({0.0f, 1.0f, 0.0f}) * std::sqrt(moments.y);
+            Vec3 z = rotation.rotate({0.0f, 0.0f, 1.0f}) * std::sqrt(moments.z);
+
+            f32 *tensor = solver.inverse_inertias + i * 6;
+            tensor[0] = x.x * x.x + y.x * y.x + z.x * z.x;
+            tensor[1] = x.y * x.y + y.y * y.y + z.y * z.y;
+            tensor[2] = x.z * x.z + y.z * y.z + z.z * z.z;
+            tensor[3] = x.x * x.y + y.x * y.y + z.x * z.y;
+            tensor[4] = x.x * x.z + y.x * y.z + z.x * z.z;
+            tensor[5] = x.y * x.z + y.y * y.z + z.y * z.z;
+        }
+    });
+}
+
+template <typename Solver, typename Body, typename Joint>
+static u32 step_xpbd_impl(Solver &solver, Body *bodies, usize body_count, const Joint *joints, usize joint_count,
+                          const Spring *springs, usize spring_count, f32 dt) {
+    reserve_bodies(solver, body_count);
+    build_rows(solver, bodies, joints, joint_count, springs, spring_count);
+    u32 color_count = color_rows(solver, bodies, body_count);
+    prepare_bodies(solver, bodies, body_count);
+
+    u32 substeps = solver.substeps > 0 ? solver.substeps : 1;
+    f32 h = dt / (f32)substeps;
+    for (u32 substep = 0; substep < substeps; substep++) {
+        integrate_physics(bodies, body_count, h);
+        orient_inertias(solver, bodies, body_count);
+        for (usize r = 0; r < solver.row_count; r++) {
+            solver.lambdas[r] = 0.0f;
+        }
+
+        // Rows of one color share no movable body, so their lanes run on any worker in any order. The serial color
+        // holds what the coloring could not separate; its rows share bodies, so each is solved alone against the
+        // state the previous one left.
+        for (u32 color = 0; color <= SERIAL_COLOR; color++) {
+            for (u32 kind = 0; kind < 2; kind++) {
+                usize begin = solver.batch_starts[color * 2 + kind], end = solver.batch_starts[color * 2 + kind + 1];
+                auto solve_rows = [&](usize first, usize last) {
+                    if (kind == (u32)XpbdRowKind::Point) {
+                        solve_point_rows(solver, bodies, first, last, h);
+                    } else {
+                        solve_align_rows(solver, bodies, first, last, h);
+                    }
+                };
+
+                if (color == SERIAL_COLOR) {
+                    for (usize r = begin; r < end; r++) {
+                        solve_rows(r, r + 1);
+                    }
+                } else if (begin < end) {
+                    parallel_for(end - begin, XPBD_LANES,
+                                 [&](usize first, usize last) { solve_rows(begin + first, begin + last); });
+                }
+            }
+        }
+    }
+
+    return color_count;
+}
+
+template <typename Solver> static void deinit_xpbd_solver_impl(Solver &solver) {
+    free(solver.inverse_masses);
+    free(solver.inverse_inertias);
+    free(solver.color_masks);
+    free(solver.rows);
+    free(solver.scratch);
+    free(solver.row_colors);
+    free(solver.lambdas);
+
+    solver = {};
+}
+
+void init_xpbd_solver(XpbdSolver2 &solver, u32 substeps) {
+    solver = {};
+    solver.substeps = substeps;
+}
+
+void init_xpbd_solver(XpbdSolver3 &solver, u32 substeps) {
+    solver = {};
+    solver.substeps = substeps;
+}
+
+void deinit_xpbd_solver(XpbdSolver2 &solver) {
+    deinit_xpbd_solver_impl(solver);
+}
+
+void deinit_xpbd_solver(XpbdSolver3 &solver) {
+    free(solver.inverse_moments);
+    deinit_xpbd_solver_impl(solver);
+}
+
+u32 step_xpbd(XpbdSolver2 &solver, Body2 *bodies, usize body_count, const Joint2 *joints, usize joint_count,
+              const Spring *springs, usize spring_count, float dt) {
+    return step_xpbd_impl(solver, bodies, body_count, joints, joint_count, springs, spring_count, dt);
+}
+
+u32 step_xpbd(XpbdSolver3 &solver, Body3 *bodies, usize body_count, const Joint3 *joints, usize joint_count,
+              const Spring *springs, usize spring_count, float dt) {
+    return step_xpbd_impl(solver, bodies, body_count, joints, joint_count, springs, spring_count, dt);
+}
@@ -1,4 +1,9 @@
 #include "physics/gravity.hpp"
+#include "math/constants.hpp"
+#include "physics/contact_solver.hpp"
+#include "physics/narrowphase.hpp"
+#include "physics/wisdom_holman.hpp"
+#include <cmath>
 #include <iostream>
 
 const float dt = 0.016f; // ~60fps
@@ -23,7 +28,7 @@ void test_2d_physics() {
     std::cout << "\n=== Testing 2D Physics ===\n" << std::endl;
 
     const int NUM_BODIES = 3;
-    Body2 bodies[NUM_BODIES];
+    Body2 bodies[NUM_BODIES] = {};
 
     // Set up a massive "sun" at center
     bodies[0].transform.position = {0.0f, 0.0f};
@@ -76,7 +81,7 @@ void test_3d_physics() {
     std::cout << "\n=== Testing 3D Physics ===\n" << std::endl;
 
     const int NUM_BODIES = 3;
-    Body3 bodies[NUM_BODIES];
+    Body3 bodies[NUM_BODIES] = {};
 
     // Set up a massive "sun" at center
     bodies[0].transform.position = {0.0f, 0.0f, 0.0f};
@@ -124,11 +129,220 @@ void test_3d_physics() {
     print_body_state(bodies[2], "Photon");
 }
 
+// Test the Wisdom-Holman integrator on a planet in a circular orbit, stepping 1/20 of its period at a time
+void test_wisdom_holman() {
+    std::cout << "\n=== Testing Wisdom-Holman ===\n" << std::endl;
+
+    const int NUM_BODIES = 3;
+    const int NUM_ORBITS = 1000;
+    Body3 bodies[NUM_BODIES] = {};
+
+    bodies[0].mass = 1.0e10f;
+    bodies[0].kind = BodyKind::Dynamic;
+
+    float radius = 100.0f;
+    float speed = std::sqrt(GRAVITATIONAL_PARAMETER * bodies[0].mass / radius);
+    float period = 2.0f * PI * radius / speed;
+
+    bodies[1].transform.position = {radius, 0.0f, 0.0f};
+    bodies[1].transform.velocity = {0.0f, speed, 0.0f};
+    bodies[1].mass = 1.0e4f;
+    bodies[1].kind = BodyKind::Dynamic;
+
+    bodies[2].transform.position = {-100.0f, 50.0f, 25.0f};
+    bodies[2].transform.velocity = {20.0f, 0.0f, -5.0f};
+    bodies[2].mass = 0.0f;
+    bodies[2].kind = BodyKind::Dynamic;
+
+    std::cout << "Initial state:" << std::endl;
+    print_body_state(bodies[0], "Sun");
+    print_body_state(bodies[1], "Planet");
+    print_body_state(bodies[2], "Photon");
+
+    for (int step = 0; step < NUM_ORBITS * 20; step++) {
+        integrate_wisdom_holman(bodies, NUM_BODIES, 0, period / 20.0f);
+    }
+
+    Vec3 offset = bodies[1].transform.position - bodies[0].transform.position;
+    std::cout << "\nFinal state after " << NUM_ORBITS << " orbits (radius " << offset.length() << "):" << std::endl;
+    print_body_state(bodies[0], "Sun");
+    print_body_state(bodies[1], "Planet");
+    print_body_state(bodies[2], "Photon");
+}
+
+// Unit boxes stacked on a kinematic floor, every pair of bodies handed to the narrowphase
+const int STACK_BODIES = 6;
+const float STACK_DT = 1.0f / 60.0f;
+const float STACK_GRAVITY = -9.8f;
+
+void build_stack(Body2 *bodies, BroadphasePair *pairs, usize &pair_count) {
+    bodies[0].kind = BodyKind::Kinematic;
+    bodies[0].transform.position = {0.0f, -0.5f};
+    bodies[0].transform.rotation = Rot2::IDENTITY();
+    bodies[0].shape.kind = ShapeKind2::Rectangle;
+    bodies[0].shape.rectangle.half_size = {10.0f, 0.5f};
+
+    for (int i = 1; i < STACK_BODIES; i++) {
+        bodies[i].kind = BodyKind::Dynamic;
+        bodies[i].mass = 1.0f;
+        bodies[i].transform.position = {0.0f, i - 0.5f};
+        bodies[i].transform.rotation = Rot2::IDENTITY();
+        bodies[i].shape.kind = ShapeKind2::Rectangle;
+        bodies[i].shape.rectangle.half_size = {0.5f, 0.5f};
+    }
+
+    pair_count = 0;
+    for (u32 a = 0; a < STACK_BODIES; a++) {
+        for (u32 b = a + 1; b < STACK_BODIES; b++) {
+            pairs[pair_count++] = {a, b};
+        }
+    }
+}
+
+void step_stack(Narrowphase2 &narrowphase, ContactSolver2 &solver, Body2 *bodies, const BroadphasePair *pairs,
+                usize pair_count) {
+    for (int i = 1; i < STACK_BODIES; i++) {
+        if (!bodies[i].sleeping) {
+            bodies[i].transform.velocity.y += STACK_GRAVITY * STACK_DT;
+        }
+    }
+
+    usize contact_count = generate_contacts(narrowphase, bodies, pairs, pair_count);
+    solve_contacts(solver, bodies, STACK_BODIES, narrowphase.contacts, contact_count, STACK_DT);
+    integrate_physics(bodies, STACK_BODIES, STACK_DT);
+}
+
+void print_stack(const Body2 *bodies) {
+    for (int i = 1; i < STACK_BODIES; i++) {
+        std::cout << "Box " << i << " - Height: " << bodies[i].transform.position.y << " (rest " << i - 0.5f
+                  << "), Speed: " << bodies[i].transform.velocity.length() << std::endl;
+    }
+}
+
+// Test the contact solver on a stack of boxes under gravity, which should come to rest at the boxes' rest heights
+void test_stack_settling() {
+    std::cout << "\n=== Testing Stack Settling ===\n" << std::endl;
+
+    const int NUM_STACK_STEPS = 600;
+    Body2 bodies[STACK_BODIES] = {};
+    BroadphasePair pairs[STACK_BODIES * STACK_BODIES];
+    usize pair_count;
+    build_stack(bodies, pairs, pair_count);
+
+    Narrowphase2 narrowphase;
+    ContactSolver2 solver;
+    init_narrowphase(narrowphase);
+    init_contact_solver(solver, 0.0f, 0.5f, 10);
+
+    for (int step = 0; step < NUM_STACK_STEPS; step++) {
+        step_stack(narrowphase, solver, bodies, pairs, pair_count);
+    }
+
+    std::cout << "State after " << NUM_STACK_STEPS << " steps:" << std::endl;
+    print_stack(bodies);
+
+    deinit_contact_solver(solver);
+    deinit_narrowphase(narrowphase);
+}
+
+void print_sleeping(const Body2 *bodies, usize body_count, const char *label) {
+    std::cout << label << " - Sleeping:";
+    for (usize i = 0; i < body_count; i++) {
+        if (bodies[i].kind == BodyKind::Dynamic) {
+            std::cout << " " << bodies[i].sleeping;
+        }
+    }
+    std::cout << std::endl;
+}
+
+// Test that a settled stack falls asleep, and that waking its top box wakes every box in it within the same step
+void test_island_wake() {
+    std::cout << "\n=== Testing Island Wake ===\n" << std::endl;
+
+    const int NUM_STACK_STEPS = 600;
+    Body2 bodies[STACK_BODIES] = {};
+    BroadphasePair pairs[STACK_BODIES * STACK_BODIES];
+    usize pair_count;
+    build_stack(bodies, pairs, pair_count);
+
+    Narrowphase2 narrowphase;
+    ContactSolver2 solver;
+    init_narrowphase(narrowphase);
+    init_contact_solver(solver, 0.0f, 0.5f, 10);
+
+    for (int step = 0; step < NUM_STACK_STEPS; step++) {
+        step_stack(narrowphase, solver, bodies, pairs, pair_count);
+        update_sleep(solver, bodies, STACK_BODIES, STACK_DT);
+    }
+    print_sleeping(bodies, STACK_BODIES, "Settled");
+
+    // Push the top box down into the sleeping boxes below it
+    Body2 &top = bodies[STACK_BODIES - 1];
+    top.transform.velocity = {0.0f, -2.0f};
+    wake_body(top);
+    step_stack(narrowphase, solver, bodies, pairs, pair_count);
+    update_sleep(solver, bodies, STACK_BODIES, STACK_DT);
+    print_sleeping(bodies, STACK_BODIES, "Pushed");
+
+    for (int step = 0; step < NUM_STACK_STEPS; step++) {
+        step_stack(narrowphase, solver, bodies, pairs, pair_count);
+        update_sleep(solver, bodies, STACK_BODIES, STACK_DT);
+    }
+    print_sleeping(bodies, STACK_BODIES, "Resettled");
+    print_stack(bodies);
+
+    deinit_contact_solver(solver);
+    deinit_narrowphase(narrowphase);
+}
+
+// Test that a body at rest in a weak field, touching nothing, stays awake and starts to fall
+void test_weak_field_sleep() {
+    std::cout << "\n=== Testing Weak Field Sleep ===\n" << std::endl;
+
+    const int NUM_BODIES = 2;
+    const int NUM_FALL_STEPS = 600;
+    Body2 bodies[NUM_BODIES] = {};
+
+    bodies[0].kind = BodyKind::Kinematic;
+    bodies[0].mass = 1.0e7f;
+
+    bodies[1].transform.position = {10.0f, 0.0f};
+    bodies[1].mass = 1.0f;
+    bodies[1].kind = BodyKind::Dynamic;
+
+    ContactSolver2 solver;
+    init_contact_solver(solver, 0.0f, 0.5f, 10);
+
+    Vec2 accelerations[NUM_BODIES];
+    compute_accelerations(bodies, NUM_BODIES, accelerations);
+    float expected_speed = accelerations[1].length() * NUM_FALL_STEPS * STACK_DT;
+
+    for (int step = 0; step < NUM_FALL_STEPS; step++) {
+        compute_accelerations(bodies, NUM_BODIES, accelerations);
+        bodies[1].transform.velocity += accelerations[1] * STACK_DT;
+        solve_contacts(solver, bodies, NUM_BODIES, nullptr, 0, STACK_DT);
+        integrate_physics(bodies, NUM_BODIES, STACK_DT);
+        update_sleep(solver, bodies, NUM_BODIES, STACK_DT);
+    }
+
+    // Still well under the sleep speed, so only the lack of contacts keeps it awake
+    std::cout << "After " << NUM_FALL_STEPS * STACK_DT << " s (expected speed about " << expected_speed
+              << "):" << std::endl;
+    print_sleeping(bodies, NUM_BODIES, "Falling");
+    print_body_state(bodies[1], "Body");
+
+    deinit_contact_solver(solver);
+}
+
 int main() {
     std::cout << "Testing gravitational physics system with massive and massless bodies" << std::endl;
 
     test_2d_physics();
     test_3d_physics();
+    test_wisdom_holman();
+    test_stack_settling();
+    test_island_wake();
+    test_weak_field_sleep();
 
     std::cout << "\nSimulation complete." << std::endl;
     return 0;